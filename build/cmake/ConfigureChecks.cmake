@@ -82,6 +82,18 @@ check_cxx_source_compiles(
   STRERROR_R_CHAR_P)
 
 
+if(WITH_ALLOC_TRACKING)
+  set(THRIFT_ALLOC_TRACKING 1)
+endif()
+
+if(WITH_ZSTD)
+  set(HAVE_ZSTD 1)
+endif()
+
+if(WITH_LZ4)
+  set(HAVE_LZ4 1)
+endif()
+
 set(PACKAGE ${PACKAGE_NAME})
 set(PACKAGE_STRING "${PACKAGE_NAME} ${PACKAGE_VERSION}")
 set(VERSION ${thrift_VERSION})
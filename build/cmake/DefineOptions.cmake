@@ -67,12 +67,20 @@ if(WITH_CPP)
     find_package(ZLIB QUIET)
     CMAKE_DEPENDENT_OPTION(WITH_ZLIB "Build with ZLIB support" ON
                            "ZLIB_FOUND" OFF)
+    # Further codecs for TCompressedTransport, which lives in thriftz
+    find_package(Zstd QUIET)
+    CMAKE_DEPENDENT_OPTION(WITH_ZSTD "Build with zstd support" ON
+                           "WITH_ZLIB;Zstd_FOUND" OFF)
+    find_package(LZ4 QUIET)
+    CMAKE_DEPENDENT_OPTION(WITH_LZ4 "Build with lz4 support" ON
+                           "WITH_ZLIB;LZ4_FOUND" OFF)
     find_package(Libevent QUIET)
     CMAKE_DEPENDENT_OPTION(WITH_LIBEVENT "Build with libevent support" ON
                            "Libevent_FOUND" OFF)
     find_package(Qt5 QUIET COMPONENTS Core Network)
     CMAKE_DEPENDENT_OPTION(WITH_QT5 "Build with Qt5 support" ON
                            "Qt5_FOUND" OFF)
+    option(WITH_ALLOC_TRACKING "Count heap allocations for TAllocTracker (programs opt in with thrift/TAllocTrackerNew.h)" OFF)
 endif()
 CMAKE_DEPENDENT_OPTION(BUILD_CPP "Build C++ library" ON
                        "BUILD_LIBRARIES;WITH_CPP" OFF)
@@ -185,6 +193,9 @@ if (BUILD_CPP)
     message(STATUS "    Build with libevent support:              ${WITH_LIBEVENT}")
     message(STATUS "    Build with Qt5 support:                   ${WITH_QT5}")
     message(STATUS "    Build with ZLIB support:                  ${WITH_ZLIB}")
+    message(STATUS "    Build with zstd support:                  ${WITH_ZSTD}")
+    message(STATUS "    Build with lz4 support:                   ${WITH_LZ4}")
+    message(STATUS "    Build with allocation tracking:           ${WITH_ALLOC_TRACKING}")
 endif ()
 message(STATUS)
 message(STATUS "  Build C (GLib) library:                     ${BUILD_C_GLIB}")
@@ -0,0 +1,32 @@
+# find lz4
+# an extremely fast compression library (https://lz4.org/)
+#
+# Usage:
+# LZ4_INCLUDE_DIRS, where to find lz4 headers
+# LZ4_LIBRARIES, lz4 libraries
+# LZ4_FOUND, If false, do not try to use lz4
+
+find_path(LZ4_INCLUDE_DIRS lz4frame.h)
+find_library(LZ4_LIBRARIES NAMES lz4)
+
+if (LZ4_LIBRARIES AND LZ4_INCLUDE_DIRS)
+  set(LZ4_FOUND TRUE)
+else ()
+  set(LZ4_FOUND FALSE)
+endif ()
+
+if (LZ4_FOUND)
+  if (NOT LZ4_FIND_QUIETLY)
+    message(STATUS "Found lz4: ${LZ4_LIBRARIES}")
+  endif ()
+else ()
+  if (LZ4_FIND_REQUIRED)
+    message(FATAL_ERROR "Could NOT find lz4.")
+  endif ()
+  message(STATUS "lz4 NOT found.")
+endif ()
+
+mark_as_advanced(
+    LZ4_LIBRARIES
+    LZ4_INCLUDE_DIRS
+  )
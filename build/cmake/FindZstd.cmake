@@ -0,0 +1,32 @@
+# find zstd
+# a fast lossless compression library (https://facebook.github.io/zstd/)
+#
+# Usage:
+# ZSTD_INCLUDE_DIRS, where to find zstd headers
+# ZSTD_LIBRARIES, zstd libraries
+# Zstd_FOUND, If false, do not try to use zstd
+
+find_path(ZSTD_INCLUDE_DIRS zstd.h)
+find_library(ZSTD_LIBRARIES NAMES zstd)
+
+if (ZSTD_LIBRARIES AND ZSTD_INCLUDE_DIRS)
+  set(Zstd_FOUND TRUE)
+else ()
+  set(Zstd_FOUND FALSE)
+endif ()
+
+if (Zstd_FOUND)
+  if (NOT Zstd_FIND_QUIETLY)
+    message(STATUS "Found zstd: ${ZSTD_LIBRARIES}")
+  endif ()
+else ()
+  if (Zstd_FIND_REQUIRED)
+    message(FATAL_ERROR "Could NOT find zstd.")
+  endif ()
+  message(STATUS "zstd NOT found.")
+endif ()
+
+mark_as_advanced(
+    ZSTD_LIBRARIES
+    ZSTD_INCLUDE_DIRS
+  )
@@ -67,6 +67,8 @@ public:
     gen_no_ostream_operators_ = false;
     gen_no_skeleton_ = false;
     gen_no_constructors_ = false;
+    gen_table_driven_ = false;
+    gen_reuse_objects_ = false;
     has_members_ = false;
 
     for( iter = parsed_options.begin(); iter != parsed_options.end(); ++iter) {
@@ -91,11 +93,19 @@ public:
         gen_no_skeleton_ = true;
       } else if ( iter->first.compare("no_constructors") == 0) {
         gen_no_constructors_ = true;
+      } else if ( iter->first.compare("table_driven") == 0) {
+        gen_table_driven_ = true;
+      } else if ( iter->first.compare("reuse_objects") == 0) {
+        gen_reuse_objects_ = true;
       } else {
         throw "unknown option cpp:" + iter->first;
       }
     }
 
+    if (gen_table_driven_ && gen_templates_) {
+      throw "cpp:table_driven cannot be combined with cpp:templates";
+    }
+
     out_dir_base_ = "gen-cpp";
   }
 
@@ -158,9 +168,11 @@ public:
   void generate_move_assignment_operator(std::ostream& out, t_struct* tstruct);
   void generate_assignment_helper(std::ostream& out, t_struct* tstruct, bool is_move);
   void generate_struct_reader(std::ostream& out, t_struct* tstruct, bool pointers = false);
+  void generate_struct_isset_reset(std::ostream& out, t_struct* tstruct);
   void generate_struct_writer(std::ostream& out, t_struct* tstruct, bool pointers = false);
   void generate_struct_result_writer(std::ostream& out, t_struct* tstruct, bool pointers = false);
   void generate_struct_swap(std::ostream& out, t_struct* tstruct);
+  void generate_struct_table(std::ostream& out, t_struct* tstruct);
   void generate_struct_print_method(std::ostream& out, t_struct* tstruct);
   void generate_exception_what_method(std::ostream& out, t_struct* tstruct);
 
@@ -199,15 +211,25 @@ public:
 
   void generate_deserialize_container(std::ostream& out, t_type* ttype, std::string prefix = "");
 
-  void generate_deserialize_set_element(std::ostream& out, t_set* tset, std::string prefix = "");
+  void generate_deserialize_set_element(std::ostream& out,
+                                        t_set* tset,
+                                        std::string prefix,
+                                        std::string elem,
+                                        bool declared);
 
-  void generate_deserialize_map_element(std::ostream& out, t_map* tmap, std::string prefix = "");
+  void generate_deserialize_map_element(std::ostream& out,
+                                        t_map* tmap,
+                                        std::string prefix,
+                                        std::string key,
+                                        bool declared);
 
   void generate_deserialize_list_element(std::ostream& out,
                                          t_list* tlist,
                                          std::string prefix,
                                          bool push_back,
-                                         std::string index);
+                                         std::string index,
+                                         std::string elem,
+                                         bool declared);
 
   void generate_serialize_field(std::ostream& out,
                                 t_field* tfield,
@@ -384,6 +406,18 @@ private:
    */
   bool gen_no_constructors_;
 
+  /**
+   * True if structs should be (de)serialized by the shared table-driven
+   * TTableSerializer instead of unrolled read()/write() methods.
+   */
+  bool gen_table_driven_;
+
+  /**
+   * True if read() should decode into the existing contents of a struct,
+   * keeping the storage of its strings and lists, instead of rebuilding them.
+   */
+  bool gen_reuse_objects_;
+
   /**
    * True if thrift has member(s)
    */
@@ -459,6 +493,7 @@ void t_cpp_generator::init_generator() {
            << "#include <thrift/TApplicationException.h>" << '\n'
            << "#include <thrift/TBase.h>" << '\n'
            << "#include <thrift/protocol/TProtocol.h>" << '\n'
+           << "#include <thrift/protocol/TSerializedSize.h>" << '\n'
            << "#include <thrift/transport/TTransport.h>" << '\n'
            << '\n';
   // Include C++xx compatibility header
@@ -500,6 +535,9 @@ void t_cpp_generator::init_generator() {
   // for operator<<
   f_types_impl_ << "#include <ostream>" << '\n' << '\n';
   f_types_impl_ << "#include <thrift/TToString.h>" << '\n' << '\n';
+  if (gen_table_driven_) {
+    f_types_impl_ << "#include <thrift/protocol/TTableSerializer.h>" << '\n' << '\n';
+  }
 
   // Open namespace
   ns_open_ = namespace_open(program_->get_namespace("cpp"));
@@ -929,8 +967,12 @@ void t_cpp_generator::generate_cpp_struct(t_struct* tstruct, bool is_exception)
   generate_struct_definition(f_types_impl_, f_types_impl_, tstruct, true, true, false);
 
   std::ostream& out = (gen_templates_ ? f_types_tcc_ : f_types_impl_);
-  generate_struct_reader(out, tstruct);
-  generate_struct_writer(out, tstruct);
+  if (gen_table_driven_) {
+    generate_struct_table(out, tstruct);
+  } else {
+    generate_struct_reader(out, tstruct);
+    generate_struct_writer(out, tstruct);
+  }
   generate_struct_swap(f_types_impl_, tstruct);
   if (!gen_no_default_operators_) {
     generate_equality_operator(f_types_impl_, tstruct);
@@ -1260,9 +1302,13 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
     }
     out << " {}" << '\n';
 
+    // The table-driven serializer addresses isset flags by offset, which
+    // rules out bitfields.
+    bool isset_bitfields = !(gen_table_driven_ && is_user_struct);
     for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
       if ((*m_iter)->get_req() != t_field::T_REQUIRED) {
-        indent(out) << "bool " << (*m_iter)->get_name() << " :1;" << '\n';
+        indent(out) << "bool " << (*m_iter)->get_name() << (isset_bitfields ? " :1;" : ";")
+                    << '\n';
       }
     }
 
@@ -1387,6 +1433,12 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
         out << " override";
       out << ';' << '\n';
     }
+    if (is_user_struct) {
+      out << '\n' << indent() << "template <class Protocol_>" << '\n' << indent()
+          << "uint32_t serializedSize() const {" << '\n' << indent()
+          << "  return ::apache::thrift::protocol::serializedSize<Protocol_>(*this);" << '\n'
+          << indent() << "}" << '\n';
+    }
   }
   out << '\n';
 
@@ -1523,6 +1575,10 @@ void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bo
   }
   out << '\n';
 
+  if (gen_reuse_objects_ && !pointers) {
+    generate_struct_isset_reset(out, tstruct);
+  }
+
   // Loop over reading in fields
   indent(out) << "while (true)" << '\n';
   scope_up(out);
@@ -1607,6 +1663,25 @@ void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bo
   indent(out) << "}" << '\n' << '\n';
 }
 
+/**
+ * With reuse_objects, read() decodes over whatever the struct held before,
+ * so fields absent from the message would otherwise still read as set.
+ */
+void t_cpp_generator::generate_struct_isset_reset(ostream& out, t_struct* tstruct) {
+  const vector<t_field*>& fields = tstruct->get_members();
+  vector<t_field*>::const_iterator f_iter;
+  bool any = false;
+  for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
+    if ((*f_iter)->get_req() != t_field::T_REQUIRED) {
+      indent(out) << "this->__isset." << (*f_iter)->get_name() << " = false;" << '\n';
+      any = true;
+    }
+  }
+  if (any) {
+    out << '\n';
+  }
+}
+
 /**
  * Generates the write function.
  *
@@ -1671,6 +1746,164 @@ void t_cpp_generator::generate_struct_writer(ostream& out, t_struct* tstruct, bo
   indent(out) << "}" << '\n' << '\n';
 }
 
+/**
+ * Generates the descriptor table for a struct along with read() and write()
+ * methods that hand it to the shared TTableSerializer. Only fields the
+ * serializer cannot handle by offset get a generated helper function.
+ *
+ * @param out Stream to write to
+ * @param tstruct The struct
+ */
+void t_cpp_generator::generate_struct_table(ostream& out, t_struct* tstruct) {
+  string name = tstruct->get_name();
+  const vector<t_field*>& fields = tstruct->get_sorted_members();
+  vector<t_field*>::const_iterator f_iter;
+
+  // Map each field onto a serializer kind; anything that isn't a plain
+  // scalar or std::string member needs generated code.
+  vector<string> kinds;
+  for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
+    t_type* type = get_true_type((*f_iter)->get_type());
+    string kind = "T_FIELD_CUSTOM";
+    if (type->is_base_type() && !is_reference(*f_iter)
+        && type_name(type) == base_type_name(((t_base_type*)type)->get_base())) {
+      switch (((t_base_type*)type)->get_base()) {
+      case t_base_type::TYPE_BOOL:
+        kind = "T_FIELD_BOOL";
+        break;
+      case t_base_type::TYPE_I8:
+        kind = "T_FIELD_BYTE";
+        break;
+      case t_base_type::TYPE_I16:
+        kind = "T_FIELD_I16";
+        break;
+      case t_base_type::TYPE_I32:
+        kind = "T_FIELD_I32";
+        break;
+      case t_base_type::TYPE_I64:
+        kind = "T_FIELD_I64";
+        break;
+      case t_base_type::TYPE_DOUBLE:
+        kind = "T_FIELD_DOUBLE";
+        break;
+      case t_base_type::TYPE_STRING:
+        kind = type->is_binary() ? "T_FIELD_BINARY" : "T_FIELD_STRING";
+        break;
+      default:
+        break;
+      }
+    }
+    kinds.push_back(kind);
+  }
+
+  indent(out) << "namespace {" << '\n' << '\n';
+
+  // Helpers for the fields the table can't describe directly
+  for (size_t i = 0; i < fields.size(); ++i) {
+    if (kinds[i] != "T_FIELD_CUSTOM") {
+      continue;
+    }
+    t_field* tfield = fields[i];
+
+    indent(out) << "uint32_t " << name << "_table_read_" << tfield->get_name()
+                << "(::apache::thrift::protocol::TProtocol* iprot, void* obj) {" << '\n';
+    indent_up();
+    indent(out) << "uint32_t xfer = 0;" << '\n';
+    indent(out) << name << "* self = static_cast<" << name << "*>(obj);" << '\n';
+    generate_deserialize_field(out, tfield, "self->");
+    indent(out) << "return xfer;" << '\n';
+    indent_down();
+    indent(out) << "}" << '\n' << '\n';
+
+    indent(out) << "uint32_t " << name << "_table_write_" << tfield->get_name()
+                << "(::apache::thrift::protocol::TProtocol* oprot, const void* obj) {" << '\n';
+    indent_up();
+    indent(out) << "uint32_t xfer = 0;" << '\n';
+    indent(out) << "const " << name << "* self = static_cast<const " << name << "*>(obj);"
+                << '\n';
+    generate_serialize_field(out, tfield, "self->");
+    indent(out) << "return xfer;" << '\n';
+    indent_down();
+    indent(out) << "}" << '\n' << '\n';
+  }
+
+  indent(out) << "const ::apache::thrift::protocol::TStructDescriptor& " << name << "_table() {"
+              << '\n';
+  indent_up();
+  indent(out) << "using ::apache::thrift::protocol::TTableSerializer;" << '\n';
+  if (!fields.empty()) {
+    indent(out) << "static const ::apache::thrift::protocol::TFieldDescriptor fields[] = {"
+                << '\n';
+    indent_up();
+    for (size_t i = 0; i < fields.size(); ++i) {
+      t_field* tfield = fields[i];
+      bool required = tfield->get_req() == t_field::T_REQUIRED;
+      bool write_if_set = tfield->get_req() == t_field::T_OPTIONAL
+                          || (tfield->get_type()->is_xception() && !required);
+      string requiredness = required ? "T_FIELD_REQUIRED"
+                                     : (tfield->get_req() == t_field::T_OPTIONAL
+                                            ? "T_FIELD_OPTIONAL"
+                                            : "T_FIELD_DEFAULT");
+      bool custom = kinds[i] == "T_FIELD_CUSTOM";
+
+      indent(out) << "{\"" << tfield->get_name() << "\", " << tfield->get_key() << ", "
+                  << type_to_enum(tfield->get_type()) << "," << '\n';
+      indent(out) << " ::apache::thrift::protocol::" << kinds[i]
+                  << ", ::apache::thrift::protocol::" << requiredness << ", "
+                  << (write_if_set ? "true" : "false") << "," << '\n';
+      indent(out) << " "
+                  << (custom ? string("0")
+                             : "TTableSerializer::fieldOffset(&" + name + "::"
+                                   + tfield->get_name() + ")")
+                  << "," << '\n';
+      indent(out) << " "
+                  << (required ? string("-1")
+                               : "TTableSerializer::issetOffset(&" + name
+                                     + "::__isset, offsetof(_" + name + "__isset, "
+                                     + tfield->get_name() + "))")
+                  << "," << '\n';
+      if (custom) {
+        indent(out) << " " << name << "_table_read_" << tfield->get_name() << ", " << name
+                    << "_table_write_" << tfield->get_name() << "}";
+      } else {
+        indent(out) << " nullptr, nullptr}";
+      }
+      out << (i + 1 < fields.size() ? "," : "") << '\n';
+    }
+    indent_down();
+    indent(out) << "};" << '\n';
+    indent(out) << "static const ::apache::thrift::protocol::TStructDescriptor desc = {\""
+                << name << "\", fields, " << fields.size() << "};" << '\n';
+  } else {
+    indent(out) << "static const ::apache::thrift::protocol::TStructDescriptor desc = {\""
+                << name << "\", nullptr, 0};" << '\n';
+  }
+  indent(out) << "return desc;" << '\n';
+  indent_down();
+  indent(out) << "}" << '\n' << '\n';
+
+  indent(out) << "} // namespace" << '\n' << '\n';
+
+  indent(out) << "uint32_t " << name
+              << "::read(::apache::thrift::protocol::TProtocol* iprot) {" << '\n';
+  indent_up();
+  if (gen_reuse_objects_) {
+    generate_struct_isset_reset(out, tstruct);
+  }
+  indent(out) << "return ::apache::thrift::protocol::TTableSerializer::read(iprot, " << name
+              << "_table(), this);" << '\n';
+  indent_down();
+  indent(out) << "}" << '\n' << '\n';
+
+  indent(out) << "uint32_t " << name
+              << "::write(::apache::thrift::protocol::TProtocol* oprot) const {" << '\n';
+  indent_up();
+  indent(out) << "return ::apache::thrift::protocol::TTableSerializer::write(oprot, " << name
+              << "_table(), this);" << '\n';
+  indent_down();
+  indent(out) << "}" << '\n' << '\n';
+}
+
 /**
  * Struct writer for result of a function, which can have only one of its
  * fields set and does a conditional if else look up into the __isset field
@@ -3343,6 +3576,13 @@ void ProcessorGenerator::generate_class_definition() {
   indent_down();
   f_header_ << indent() << "}" << '\n' << '\n' << indent() << "virtual ~" << class_name_ << "() {}"
             << '\n';
+  if (style_ != "Cob") {
+    // Routing processors may bypass process(), which is only safe as long as
+    // a subclass has not overridden it.
+    f_header_ << '\n' << indent() << "bool canDispatchMessage() const override {" << '\n'
+              << indent() << "  return typeid(*this) == typeid(" << class_name_ << ");" << '\n'
+              << indent() << "}" << '\n';
+  }
   indent_down();
   f_header_ << "};" << '\n' << '\n';
 
@@ -4144,7 +4384,16 @@ void t_cpp_generator::generate_deserialize_container(ostream& out, t_type* ttype
   t_container* tcontainer = (t_container*)ttype;
   bool use_push = tcontainer->has_cpp_name();
 
-  indent(out) << prefix << ".clear();" << '\n' << indent() << "uint32_t " << size << ";" << '\n';
+  // With reuse_objects a list is resized rather than cleared, so elements
+  // are decoded over the old ones and keep their storage.  Sets, maps and
+  // custom list types have to be rebuilt, but a string key or element is
+  // read into one temporary that lives across the loop.
+  bool in_place = gen_reuse_objects_ && ttype->is_list() && !use_push;
+
+  if (!in_place) {
+    indent(out) << prefix << ".clear();" << '\n';
+  }
+  indent(out) << "uint32_t " << size << ";" << '\n';
 
   // Declare variables, read header
   if (ttype->is_map()) {
@@ -4162,6 +4411,23 @@ void t_cpp_generator::generate_deserialize_container(ostream& out, t_type* ttype
     }
   }
 
+  t_type* elem_type = nullptr;
+  if (ttype->is_map()) {
+    elem_type = ((t_map*)ttype)->get_key_type();
+  } else if (ttype->is_set()) {
+    elem_type = ((t_set*)ttype)->get_elem_type();
+  } else if (use_push) {
+    elem_type = ((t_list*)ttype)->get_elem_type();
+  }
+  string elem;
+  bool declared = false;
+  if (gen_reuse_objects_ && elem_type != nullptr && get_true_type(elem_type)->is_string()) {
+    elem = tmp(ttype->is_map() ? "_key" : "_elem");
+    t_field felem(elem_type, elem);
+    indent(out) << declare_field(&felem) << '\n';
+    declared = true;
+  }
+
   // For loop iterates over elements
   string i = tmp("_i");
   out << indent() << "uint32_t " << i << ";" << '\n' << indent() << "for (" << i << " = 0; " << i
@@ -4170,11 +4436,11 @@ void t_cpp_generator::generate_deserialize_container(ostream& out, t_type* ttype
   scope_up(out);
 
   if (ttype->is_map()) {
-    generate_deserialize_map_element(out, (t_map*)ttype, prefix);
+    generate_deserialize_map_element(out, (t_map*)ttype, prefix, elem, declared);
   } else if (ttype->is_set()) {
-    generate_deserialize_set_element(out, (t_set*)ttype, prefix);
+    generate_deserialize_set_element(out, (t_set*)ttype, prefix, elem, declared);
   } else if (ttype->is_list()) {
-    generate_deserialize_list_element(out, (t_list*)ttype, prefix, use_push, i);
+    generate_deserialize_list_element(out, (t_list*)ttype, prefix, use_push, i, elem, declared);
   }
 
   scope_down(out);
@@ -4194,13 +4460,21 @@ void t_cpp_generator::generate_deserialize_container(ostream& out, t_type* ttype
 /**
  * Generates code to deserialize a map
  */
-void t_cpp_generator::generate_deserialize_map_element(ostream& out, t_map* tmap, string prefix) {
-  string key = tmp("_key");
+void t_cpp_generator::generate_deserialize_map_element(ostream& out,
+                                                       t_map* tmap,
+                                                       string prefix,
+                                                       string key,
+                                                       bool declared) {
+  if (!declared) {
+    key = tmp("_key");
+  }
   string val = tmp("_val");
   t_field fkey(tmap->get_key_type(), key);
   t_field fval(tmap->get_val_type(), val);
 
-  out << indent() << declare_field(&fkey) << '\n';
+  if (!declared) {
+    out << indent() << declare_field(&fkey) << '\n';
+  }
 
   generate_deserialize_field(out, &fkey);
   indent(out) << declare_field(&fval, false, false, false, true) << " = " << prefix << "[" << key
@@ -4209,11 +4483,19 @@ void t_cpp_generator::generate_deserialize_map_element(ostream& out, t_map* tmap
   generate_deserialize_field(out, &fval);
 }
 
-void t_cpp_generator::generate_deserialize_set_element(ostream& out, t_set* tset, string prefix) {
-  string elem = tmp("_elem");
+void t_cpp_generator::generate_deserialize_set_element(ostream& out,
+                                                       t_set* tset,
+                                                       string prefix,
+                                                       string elem,
+                                                       bool declared) {
+  if (!declared) {
+    elem = tmp("_elem");
+  }
   t_field felem(tset->get_elem_type(), elem);
 
-  indent(out) << declare_field(&felem) << '\n';
+  if (!declared) {
+    indent(out) << declare_field(&felem) << '\n';
+  }
 
   generate_deserialize_field(out, &felem);
 
@@ -4224,11 +4506,17 @@ void t_cpp_generator::generate_deserialize_list_element(ostream& out,
                                                         t_list* tlist,
                                                         string prefix,
                                                         bool use_push,
-                                                        string index) {
+                                                        string index,
+                                                        string elem,
+                                                        bool declared) {
   if (use_push) {
-    string elem = tmp("_elem");
+    if (!declared) {
+      elem = tmp("_elem");
+    }
     t_field felem(tlist->get_elem_type(), elem);
-    indent(out) << declare_field(&felem) << '\n';
+    if (!declared) {
+      indent(out) << declare_field(&felem) << '\n';
+    }
     generate_deserialize_field(out, &felem);
     indent(out) << prefix << ".push_back(" << elem << ");" << '\n';
   } else {
@@ -4495,6 +4783,10 @@ string t_cpp_generator::type_name(t_type* ttype, bool in_typedef, bool arg) {
     std::map<string, std::vector<string>>::iterator it = ttype->annotations_.find("cpp.type");
     if (it != ttype->annotations_.end() && !it->second.empty()) {
       bname = it->second.back();
+    } else if (((t_base_type*)ttype)->get_base() == t_base_type::TYPE_STRING
+               && ttype->annotations_.count("cpp.inline_string")) {
+      // Short strings stored inside the object, see TInlineString.h
+      bname = "::apache::thrift::TInlineString";
     }
 
     if (!arg) {
@@ -4874,4 +5166,9 @@ THRIFT_REGISTER_GENERATOR(
     "    moveable_types:  Generate move constructors and assignment operators.\n"
     "    no_ostream_operators:\n"
     "                     Omit generation of ostream definitions.\n"
-    "    no_skeleton:     Omits generation of skeleton.\n")
+    "    no_skeleton:     Omits generation of skeleton.\n"
+    "    table_driven:    Serialize structs through a shared descriptor-table codec instead\n"
+    "                     of generating read()/write() per struct.\n"
+    "    reuse_objects:   Deserialize into the existing contents of a struct, keeping the\n"
+    "                     buffers of its strings and lists, for reading into one instance\n"
+    "                     repeatedly.\n")
@@ -691,8 +691,8 @@ thrift_binary_protocol_read_bool (ThriftProtocol *protocol, gboolean *value,
   g_return_val_if_fail (THRIFT_IS_BINARY_PROTOCOL (protocol), -1);
 
   if ((ret = 
-       thrift_transport_read_all (protocol->transport,
-                                  b, 1, error)) < 0)
+       thrift_transport_read_fixed (protocol->transport,
+                                    b, 1, error)) < 0)
   {
     return -1;
   }
@@ -710,8 +710,8 @@ thrift_binary_protocol_read_byte (ThriftProtocol *protocol, gint8 *value,
   g_return_val_if_fail (THRIFT_IS_BINARY_PROTOCOL (protocol), -1);
 
   if ((ret =
-       thrift_transport_read_all (protocol->transport,
-                                  b, 1, error)) < 0)
+       thrift_transport_read_fixed (protocol->transport,
+                                    b, 1, error)) < 0)
   {
     return -1;
   }
@@ -733,8 +733,8 @@ thrift_binary_protocol_read_i16 (ThriftProtocol *protocol, gint16 *value,
   g_return_val_if_fail (THRIFT_IS_BINARY_PROTOCOL (protocol), -1);
 
   if ((ret =
-       thrift_transport_read_all (protocol->transport,
-                                  b.byte_array, 2, error)) < 0)
+       thrift_transport_read_fixed (protocol->transport,
+                                    b.byte_array, 2, error)) < 0)
   {
     return -1;
   }
@@ -756,8 +756,8 @@ thrift_binary_protocol_read_i32 (ThriftProtocol *protocol, gint32 *value,
   g_return_val_if_fail (THRIFT_IS_BINARY_PROTOCOL (protocol), -1);
 
   if ((ret =
-       thrift_transport_read_all (protocol->transport,
-                                  b.byte_array, 4, error)) < 0)
+       thrift_transport_read_fixed (protocol->transport,
+                                    b.byte_array, 4, error)) < 0)
   {
     return -1;
   }
@@ -779,8 +779,8 @@ thrift_binary_protocol_read_i64 (ThriftProtocol *protocol, gint64 *value,
   g_return_val_if_fail (THRIFT_IS_BINARY_PROTOCOL (protocol), -1);
 
   if ((ret =
-       thrift_transport_read_all (protocol->transport,
-                                  b.byte_array, 8, error)) < 0)
+       thrift_transport_read_fixed (protocol->transport,
+                                    b.byte_array, 8, error)) < 0)
   {
     return -1;
   }
@@ -802,8 +802,8 @@ thrift_binary_protocol_read_double (ThriftProtocol *protocol,
   g_return_val_if_fail (THRIFT_IS_BINARY_PROTOCOL (protocol), -1);
 
   if ((ret =
-       thrift_transport_read_all (protocol->transport,
-                                  b.byte_array, 8, error)) < 0)
+       thrift_transport_read_fixed (protocol->transport,
+                                    b.byte_array, 8, error)) < 0)
   {
     return -1;
   }
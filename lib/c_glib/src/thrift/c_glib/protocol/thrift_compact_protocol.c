@@ -275,6 +275,8 @@ thrift_compact_protocol_read_varint64 (ThriftCompactProtocol *protocol,
   guint64 val;
   gint shift;
   guint8 byte;
+  const guint8 *borrowed;
+  guint32 avail;
 
   tp = THRIFT_PROTOCOL (protocol);
   xfer = 0;
@@ -282,6 +284,37 @@ thrift_compact_protocol_read_varint64 (ThriftCompactProtocol *protocol,
   shift = 0;
   byte = 0;
 
+  /* fast path: decode directly from the transport's buffer when the whole
+   * varint is already there */
+  avail = 1;
+  if ((borrowed = thrift_transport_borrow (tp->transport, &avail)) != NULL) {
+    while ((guint32) xfer < avail) {
+      byte = borrowed[xfer];
+      ++xfer;
+      val |= (guint64)(byte & 0x7f) << shift;
+      shift += 7;
+      if (!(byte & 0x80)) {
+        if (!thrift_transport_consume (tp->transport, xfer, error)) {
+          return -1;
+        }
+        *i64 = (gint64) val;
+        return xfer;
+      }
+      if (G_UNLIKELY (xfer == 10)) { /* 7 * 9 < 64 < 7 * 10 */
+        g_set_error (error, THRIFT_PROTOCOL_ERROR,
+                     THRIFT_PROTOCOL_ERROR_INVALID_DATA,
+                     "variable-length int over 10 bytes");
+        return -1;
+      }
+    }
+
+    /* the varint continues past the buffered data; nothing has been
+     * consumed yet, so start over a byte at a time */
+    xfer = 0;
+    val = 0;
+    shift = 0;
+  }
+
   while (TRUE) {
     if ((ret = thrift_transport_read_all (tp->transport,
                                           (gpointer) &byte, 1, error)) < 0) {
@@ -1263,8 +1296,8 @@ thrift_compact_protocol_read_byte (ThriftProtocol *protocol, gint8 *value,
   g_return_val_if_fail (THRIFT_IS_COMPACT_PROTOCOL (protocol), -1);
 
   if ((ret =
-       thrift_transport_read_all (protocol->transport,
-                                  b, 1, error)) < 0) {
+       thrift_transport_read_fixed (protocol->transport,
+                                    b, 1, error)) < 0) {
     return -1;
   }
   *value = *(gint8 *) b;
@@ -1364,8 +1397,8 @@ thrift_compact_protocol_read_double (ThriftProtocol *protocol,
   g_return_val_if_fail (THRIFT_IS_COMPACT_PROTOCOL (protocol), -1);
 
   if ((ret =
-       thrift_transport_read_all (protocol->transport,
-                                  u.b, 8, error)) < 0) {
+       thrift_transport_read_fixed (protocol->transport,
+                                    u.b, 8, error)) < 0) {
     return -1;
   }
   u.bits = GUINT64_FROM_LE (u.bits);
@@ -55,7 +55,8 @@ gboolean
 thrift_buffered_transport_peek (ThriftTransport *transport, GError **error)
 {
   ThriftBufferedTransport *t = THRIFT_BUFFERED_TRANSPORT (transport);
-  return (t->r_buf->len > 0) || thrift_transport_peek (t->transport, error);
+  return (t->r_buf->len > t->r_buf_pos) ||
+    thrift_transport_peek (t->transport, error);
 }
 
 /* implements thrift_transport_open */
@@ -84,18 +85,17 @@ thrift_buffered_transport_read_slow (ThriftTransport *transport, gpointer buf,
   guint32 want = len;
   guint32 got = 0;
   guchar *tmpdata = g_new0 (guchar, len);
-  guint32 have = t->r_buf->len;
+  guint32 have = t->r_buf->len - t->r_buf_pos;
 
 
   /* we shouldn't hit this unless the buffer doesn't have enough to read */
-  g_assert (t->r_buf->len < want);
+  g_assert (have < want);
 
-  /* first copy what we have in our buffer. */
+  /* first copy what we have in our buffer, which empties it. */
   if (have > 0)
   {
-    memcpy (buf, t->r_buf, t->r_buf->len);
-    want -= t->r_buf->len;
-    t->r_buf = g_byte_array_remove_range (t->r_buf, 0, t->r_buf->len);
+    thrift_transport_buffer_take (t->r_buf, &t->r_buf_pos, buf, have);
+    want -= have;
   }
 
   /* if the buffer is still smaller than what we want to read, then just
@@ -127,14 +127,15 @@ thrift_buffered_transport_read_slow (ThriftTransport *transport, gpointer buf,
       return ret;
     }
     got += ret;
+    thrift_transport_buffer_compact (t->r_buf, &t->r_buf_pos);
     t->r_buf = g_byte_array_append (t->r_buf, tmpdata, got);
     g_free (tmpdata);
     /* hand over what we have up to what the caller wants */
     give = want < t->r_buf->len ? want : t->r_buf->len;
 
 
-    memcpy ((guint8 *)buf + len - want, t->r_buf->data, give);
-    t->r_buf = g_byte_array_remove_range (t->r_buf, 0, give);
+    thrift_transport_buffer_take (t->r_buf, &t->r_buf_pos,
+                                  (guint8 *)buf + len - want, give);
     want -= give;
 
     return (len - want);
@@ -155,16 +156,34 @@ thrift_buffered_transport_read (ThriftTransport *transport, gpointer buf,
 
   /* if we have enough buffer data to fulfill the read, just use
    * a memcpy */
-  if (len <= t->r_buf->len)
+  if (len <= t->r_buf->len - t->r_buf_pos)
   {
-    memcpy (buf, t->r_buf->data, len);
-    g_byte_array_remove_range (t->r_buf, 0, len);
+    thrift_transport_buffer_take (t->r_buf, &t->r_buf_pos, buf, len);
     return len;
   }
 
   return thrift_buffered_transport_read_slow (transport, buf, len, error);
 }
 
+/* implements thrift_transport_borrow */
+const guint8 *
+thrift_buffered_transport_borrow (ThriftTransport *transport, guint32 *len)
+{
+  ThriftBufferedTransport *t = THRIFT_BUFFERED_TRANSPORT (transport);
+
+  return thrift_transport_buffer_borrow (t->r_buf, t->r_buf_pos, len);
+}
+
+/* implements thrift_transport_consume */
+gboolean
+thrift_buffered_transport_consume (ThriftTransport *transport, guint32 len, GError **error)
+{
+  ThriftBufferedTransport *t = THRIFT_BUFFERED_TRANSPORT (transport);
+
+  return thrift_transport_buffer_consume (transport, t->r_buf, &t->r_buf_pos,
+                                          len, error);
+}
+
 /* implements thrift_transport_read_end
  * called when write is complete.  nothing to do on our end. */
 gboolean
@@ -455,6 +474,8 @@ thrift_buffered_transport_class_init (ThriftBufferedTransportClass *cls)
   ttc->close = thrift_buffered_transport_close;
   ttc->read = thrift_buffered_transport_read;
   ttc->read_end = thrift_buffered_transport_read_end;
+  ttc->borrow = thrift_buffered_transport_borrow;
+  ttc->consume = thrift_buffered_transport_consume;
   ttc->write = thrift_buffered_transport_write;
   ttc->write_end = thrift_buffered_transport_write_end;
   ttc->flush = thrift_buffered_transport_flush;
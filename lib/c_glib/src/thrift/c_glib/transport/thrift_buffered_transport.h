@@ -55,6 +55,7 @@ struct _ThriftBufferedTransport
   /* private */
   GByteArray *r_buf;
   GByteArray *w_buf;
+  guint32 r_buf_pos;
   guint32 r_buf_size;
   guint32 w_buf_size;
 };
@@ -58,7 +58,8 @@ gboolean
 thrift_framed_transport_peek (ThriftTransport *transport, GError **error)
 {
   ThriftFramedTransport *t = THRIFT_FRAMED_TRANSPORT (transport);
-  return (t->r_buf->len > 0) || thrift_transport_peek (t->transport, error);
+  return (t->r_buf->len > t->r_buf_pos) ||
+    thrift_transport_peek (t->transport, error);
 }
 
 /* implements thrift_transport_open */
@@ -112,6 +113,7 @@ thrift_framed_transport_read_frame (ThriftTransport *transport,
     if (bytes > 0 && (error == NULL || *error == NULL))
     {
       /* add the data to the buffer */
+      thrift_transport_buffer_compact (t->r_buf, &t->r_buf_pos);
       g_byte_array_append (t->r_buf, tmpdata, bytes);
 
       result = TRUE;
@@ -129,29 +131,29 @@ thrift_framed_transport_read_slow (ThriftTransport *transport, gpointer buf,
 {
   ThriftFramedTransport *t = THRIFT_FRAMED_TRANSPORT (transport);
   guint32 want = len;
-  guint32 have = t->r_buf->len;
+  guint32 have = t->r_buf->len - t->r_buf_pos;
   gint32 result = -1;
 
   /* we shouldn't hit this unless the buffer doesn't have enough to read */
-  g_assert (t->r_buf->len < want);
+  g_assert (have < want);
 
   /* first copy what we have in our buffer, if there is anything left */
   if (have > 0)
   {
-    memcpy (buf, t->r_buf, t->r_buf->len);
-    want -= t->r_buf->len;
-    t->r_buf = g_byte_array_remove_range (t->r_buf, 0, t->r_buf->len);
+    thrift_transport_buffer_take (t->r_buf, &t->r_buf_pos, buf, have);
+    want -= have;
   }
 
   /* read a frame of input and buffer it */
   if (thrift_framed_transport_read_frame (transport, error) == TRUE)
   {
     /* hand over what we have up to what the caller wants */
-    guint32 give = want < t->r_buf->len ? want : t->r_buf->len;
+    guint32 give = want < t->r_buf->len - t->r_buf_pos ?
+                   want : t->r_buf->len - t->r_buf_pos;
 
     /* copy the data into the buffer */
-    memcpy ((guint8 *)buf + len - want, t->r_buf->data, give);
-    t->r_buf = g_byte_array_remove_range (t->r_buf, 0, give);
+    thrift_transport_buffer_take (t->r_buf, &t->r_buf_pos,
+                                  (guint8 *)buf + len - want, give);
     want -= give;
 
     result = len - want;
@@ -175,16 +177,34 @@ thrift_framed_transport_read (ThriftTransport *transport, gpointer buf,
 
   /* if we have enough buffer data to fulfill the read, just use
    * a memcpy from the buffer */
-  if (len <= t->r_buf->len)
+  if (len <= t->r_buf->len - t->r_buf_pos)
   {
-    memcpy (buf, t->r_buf->data, len);
-    g_byte_array_remove_range (t->r_buf, 0, len);
+    thrift_transport_buffer_take (t->r_buf, &t->r_buf_pos, buf, len);
     return len;
   }
 
   return thrift_framed_transport_read_slow (transport, buf, len, error);
 }
 
+/* implements thrift_transport_borrow */
+const guint8 *
+thrift_framed_transport_borrow (ThriftTransport *transport, guint32 *len)
+{
+  ThriftFramedTransport *t = THRIFT_FRAMED_TRANSPORT (transport);
+
+  return thrift_transport_buffer_borrow (t->r_buf, t->r_buf_pos, len);
+}
+
+/* implements thrift_transport_consume */
+gboolean
+thrift_framed_transport_consume (ThriftTransport *transport, guint32 len, GError **error)
+{
+  ThriftFramedTransport *t = THRIFT_FRAMED_TRANSPORT (transport);
+
+  return thrift_transport_buffer_consume (transport, t->r_buf, &t->r_buf_pos,
+                                          len, error);
+}
+
 /* implements thrift_transport_read_end
  * called when read is complete.  nothing to do on our end. */
 gboolean
@@ -458,6 +478,8 @@ thrift_framed_transport_class_init (ThriftFramedTransportClass *cls)
   ttc->close = thrift_framed_transport_close;
   ttc->read = thrift_framed_transport_read;
   ttc->read_end = thrift_framed_transport_read_end;
+  ttc->borrow = thrift_framed_transport_borrow;
+  ttc->consume = thrift_framed_transport_consume;
   ttc->write = thrift_framed_transport_write;
   ttc->write_end = thrift_framed_transport_write_end;
   ttc->flush = thrift_framed_transport_flush;
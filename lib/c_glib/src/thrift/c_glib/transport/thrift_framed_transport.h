@@ -56,6 +56,7 @@ struct _ThriftFramedTransport
   guint32 max_frame_size;
   GByteArray *r_buf;
   GByteArray *w_buf;
+  guint32 r_buf_pos;
   guint32 r_buf_size;
   guint32 w_buf_size;
 };
@@ -86,29 +86,51 @@ thrift_memory_buffer_read (ThriftTransport *transport, gpointer buf,
 
   /* if the requested bytes are more than what we have available,
    * just give all that we have the buffer */
-  if (t->buf->len < len)
+  if (t->buf->len - t->buf_pos < len)
   {
-    give = t->buf->len;
+    give = t->buf->len - t->buf_pos;
   }
 
   if (give == 0) {
     return -1;
   }
 
-  memcpy (buf, t->buf->data, give);
-  g_byte_array_remove_range (t->buf, 0, give);
+  thrift_transport_buffer_take (t->buf, &t->buf_pos, buf, give);
 
   return give;
 }
 
+/* implements thrift_transport_borrow */
+const guint8 *
+thrift_memory_buffer_borrow (ThriftTransport *transport, guint32 *len)
+{
+  ThriftMemoryBuffer *t = THRIFT_MEMORY_BUFFER (transport);
+
+  return thrift_transport_buffer_borrow (t->buf, t->buf_pos, len);
+}
+
+/* implements thrift_transport_consume */
+gboolean
+thrift_memory_buffer_consume (ThriftTransport *transport, guint32 len, GError **error)
+{
+  ThriftMemoryBuffer *t = THRIFT_MEMORY_BUFFER (transport);
+
+  return thrift_transport_buffer_consume (transport, t->buf, &t->buf_pos, len,
+                                          error);
+}
+
 /* implements thrift_transport_read_end
- * called when read is complete.  nothing to do on our end. */
+ * called when read is complete.  drops what has been read, so that a buffer
+ * owned by the caller only holds unread data between messages. */
 gboolean
 thrift_memory_buffer_read_end (ThriftTransport *transport, GError **error)
 {
+  ThriftMemoryBuffer *t = THRIFT_MEMORY_BUFFER (transport);
+
   /* satisfy -Wall */
-  THRIFT_UNUSED_VAR (transport);
   THRIFT_UNUSED_VAR (error);
+
+  thrift_transport_buffer_compact (t->buf, &t->buf_pos);
   return TRUE;
 }
 
@@ -122,6 +144,13 @@ thrift_memory_buffer_write (ThriftTransport *transport,
 
   THRIFT_UNUSED_VAR (error);
 
+  /* drop what has been read only when short of room, so that alternating
+   * reads and writes do not move the unread bytes every time */
+  if (len > t->buf_size - t->buf->len)
+  {
+    thrift_transport_buffer_compact (t->buf, &t->buf_pos);
+  }
+
   /* return an exception if the buffer doesn't have enough space. */
   if (len > t->buf_size - t->buf->len)
   {
@@ -193,6 +222,10 @@ thrift_memory_buffer_get_property (GObject *object, guint property_id,
       g_value_set_uint (value, t->buf_size);
       break;
     case PROP_THRIFT_MEMORY_BUFFER_BUFFER:
+      if (t->buf != NULL)
+      {
+        thrift_transport_buffer_compact (t->buf, &t->buf_pos);
+      }
       g_value_set_pointer (value, (gpointer) (t->buf));
       break;
     case PROP_THRIFT_MEMORY_BUFFER_OWNER:
@@ -231,6 +264,7 @@ thrift_memory_buffer_set_property (GObject *object, guint property_id,
       break;
     case PROP_THRIFT_MEMORY_BUFFER_BUFFER:
       t->buf = (GByteArray*) g_value_get_pointer (value);
+      t->buf_pos = 0;
       break;
     case PROP_THRIFT_MEMORY_BUFFER_OWNER:
       t->owner = g_value_get_boolean (value);
@@ -347,6 +381,8 @@ thrift_memory_buffer_class_init (ThriftMemoryBufferClass *cls)
   ttc->close = thrift_memory_buffer_close;
   ttc->read = thrift_memory_buffer_read;
   ttc->read_end = thrift_memory_buffer_read_end;
+  ttc->borrow = thrift_memory_buffer_borrow;
+  ttc->consume = thrift_memory_buffer_consume;
   ttc->write = thrift_memory_buffer_write;
   ttc->write_end = thrift_memory_buffer_write_end;
   ttc->flush = thrift_memory_buffer_flush;
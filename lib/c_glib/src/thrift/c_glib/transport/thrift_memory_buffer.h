@@ -50,6 +50,7 @@ struct _ThriftMemoryBuffer
 
   /* private */
   GByteArray *buf;
+  guint32 buf_pos;
   guint32 buf_size;
   gboolean owner;
 };
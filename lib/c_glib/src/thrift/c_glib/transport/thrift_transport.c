@@ -18,6 +18,7 @@
  */
 
 #include <errno.h>
+#include <string.h>
 #include <glib.h>
 #include <thrift/c_glib/thrift.h>
 #include <thrift/c_glib/transport/thrift_transport.h>
@@ -105,6 +106,108 @@ thrift_transport_read_all (ThriftTransport *transport, gpointer buf,
                                                            len, error);
 }
 
+const guint8 *
+thrift_transport_borrow (ThriftTransport *transport, guint32 *len)
+{
+  return THRIFT_TRANSPORT_GET_CLASS (transport)->borrow (transport, len);
+}
+
+gboolean
+thrift_transport_consume (ThriftTransport *transport, guint32 len,
+                          GError **error)
+{
+  return THRIFT_TRANSPORT_GET_CLASS (transport)->consume (transport, len,
+                                                          error);
+}
+
+gint32
+thrift_transport_read_fixed (ThriftTransport *transport, gpointer buf,
+                             guint32 len, GError **error)
+{
+  const guint8 *borrowed;
+  guint32 avail = len;
+
+  if ((borrowed = thrift_transport_borrow (transport, &avail)) != NULL)
+  {
+    memcpy (buf, borrowed, len);
+    if (!thrift_transport_consume (transport, len, error))
+    {
+      return -1;
+    }
+    return len;
+  }
+
+  return thrift_transport_read_all (transport, buf, len, error);
+}
+
+/* moves the read position of a buffer forward, starting over at the front
+ * without moving anything once it has been drained */
+static void
+thrift_transport_buffer_advance (GByteArray *buf, guint32 *pos, guint32 len)
+{
+  *pos += len;
+  if (*pos == buf->len)
+  {
+    g_byte_array_set_size (buf, 0);
+    *pos = 0;
+  }
+}
+
+const guint8 *
+thrift_transport_buffer_borrow (GByteArray *buf, guint32 pos, guint32 *len)
+{
+  if (*len > buf->len - pos)
+  {
+    return NULL;
+  }
+
+  *len = buf->len - pos;
+  return buf->data + pos;
+}
+
+gboolean
+thrift_transport_buffer_consume (ThriftTransport *transport, GByteArray *buf,
+                                 guint32 *pos, guint32 len, GError **error)
+{
+  ThriftTransportClass *ttc = THRIFT_TRANSPORT_GET_CLASS (transport);
+
+  if (!ttc->checkReadBytesAvailable (transport, len, error))
+  {
+    return FALSE;
+  }
+
+  if (len > buf->len - *pos)
+  {
+    g_set_error (error, THRIFT_TRANSPORT_ERROR, THRIFT_TRANSPORT_ERROR_RECEIVE,
+                 "unable to consume %u bytes, only %u buffered",
+                 len, buf->len - *pos);
+    return FALSE;
+  }
+
+  thrift_transport_buffer_advance (buf, pos, len);
+  return TRUE;
+}
+
+void
+thrift_transport_buffer_take (GByteArray *buf, guint32 *pos, gpointer dst,
+                              guint32 len)
+{
+  g_assert (len <= buf->len - *pos);
+
+  memcpy (dst, buf->data + *pos, len);
+  thrift_transport_buffer_advance (buf, pos, len);
+}
+
+void
+thrift_transport_buffer_compact (GByteArray *buf, guint32 *pos)
+{
+  if (*pos > 0)
+  {
+    g_byte_array_remove_range (buf, 0, *pos);
+    *pos = 0;
+  }
+}
+
 /* by default, peek returns true if and only if the transport is open */
 static gboolean
 thrift_transport_real_peek (ThriftTransport *transport, GError **error)
@@ -141,6 +244,30 @@ thrift_transport_real_read_all (ThriftTransport *transport, gpointer buf,
   return have;
 }
 
+/* by default, transports have nothing to lend */
+static const guint8 *
+thrift_transport_real_borrow (ThriftTransport *transport, guint32 *len)
+{
+  THRIFT_UNUSED_VAR (transport);
+  THRIFT_UNUSED_VAR (len);
+
+  return NULL;
+}
+
+/* consume is only legal after a successful borrow, which the default
+ * implementation never grants */
+static gboolean
+thrift_transport_real_consume (ThriftTransport *transport, guint32 len,
+                               GError **error)
+{
+  THRIFT_UNUSED_VAR (transport);
+
+  g_set_error (error, THRIFT_TRANSPORT_ERROR,
+               THRIFT_TRANSPORT_ERROR_RECEIVE,
+               "consume of %u bytes not supported by this transport", len);
+  return FALSE;
+}
+
 gboolean
 thrift_transport_updateKnownMessageSize(ThriftTransport *transport, glong size, GError **error)
 {
@@ -357,6 +484,10 @@ thrift_transport_class_init (ThriftTransportClass *cls)
   cls->peek = thrift_transport_real_peek;
   cls->read_all = thrift_transport_real_read_all;
 
+  /* buffered transports override these to enable zero-copy reads */
+  cls->borrow = thrift_transport_real_borrow;
+  cls->consume = thrift_transport_real_consume;
+
   cls->updateKnownMessageSize = thrift_transport_updateKnownMessageSize;
   cls->checkReadBytesAvailable = thrift_transport_checkReadBytesAvailable;
   cls->resetConsumedMessageSize = thrift_transport_resetConsumedMessageSize;
@@ -86,6 +86,8 @@ struct _ThriftTransportClass
   gboolean (*checkReadBytesAvailable) (ThriftTransport *transport, glong numBytes, GError **error);
   gboolean (*resetConsumedMessageSize) (ThriftTransport *transport, glong newSize, GError **error);
   gboolean (*countConsumedMessageBytes) (ThriftTransport *transport, glong numBytes, GError **error);
+  const guint8 *(*borrow) (ThriftTransport *transport, guint32 *len);
+  gboolean (*consume) (ThriftTransport *transport, guint32 len, GError **error);
 };
 
 /* used by THRIFT_TYPE_TRANSPORT */
@@ -163,6 +165,73 @@ gboolean thrift_transport_flush (ThriftTransport *transport, GError **error);
 gint32 thrift_transport_read_all (ThriftTransport *transport, gpointer buf,
                                   guint32 len, GError **error);
 
+/*!
+ * Attempts to return a pointer to len bytes of already-buffered data without
+ * copying it.  On success *len is set to the number of bytes available at the
+ * returned pointer (at least the number requested).  Returns NULL if the
+ * transport does not buffer reads or does not have len bytes buffered; the
+ * caller must then fall back to thrift_transport_read_all.
+ *
+ * The returned data remains owned by the transport and stays valid only
+ * until the next read, consume or write call.  Borrowing does not advance
+ * the read position, call thrift_transport_consume for that.
+ * \public \memberof ThriftTransportInterface
+ */
+const guint8 *thrift_transport_borrow (ThriftTransport *transport,
+                                       guint32 *len);
+
+/*!
+ * Advances the read position by len bytes previously obtained from
+ * thrift_transport_borrow.
+ * \public \memberof ThriftTransportInterface
+ */
+gboolean thrift_transport_consume (ThriftTransport *transport, guint32 len,
+                                   GError **error);
+
+/*!
+ * Reads exactly len bytes into buf like thrift_transport_read_all, copying
+ * them straight out of the transport's buffer when it can lend them.  Meant
+ * for the small fixed-width reads a protocol makes for each primitive.
+ * \public \memberof ThriftTransportInterface
+ */
+gint32 thrift_transport_read_fixed (ThriftTransport *transport, gpointer buf,
+                                    guint32 len, GError **error);
+
+/*!
+ * Helpers for transports that keep received data in a GByteArray.  The bytes
+ * before *pos have already been handed out.  Rather than moving the rest to
+ * the front on every read, the array is emptied once it has been drained and
+ * compacted only before more data is appended to it.
+ */
+
+/*!
+ * Implements thrift_transport_borrow on the unread bytes of buf.
+ * \protected \memberof ThriftTransportClass
+ */
+const guint8 *thrift_transport_buffer_borrow (GByteArray *buf, guint32 pos,
+                                              guint32 *len);
+
+/*!
+ * Implements thrift_transport_consume on the unread bytes of buf.
+ * \protected \memberof ThriftTransportClass
+ */
+gboolean thrift_transport_buffer_consume (ThriftTransport *transport,
+                                          GByteArray *buf, guint32 *pos,
+                                          guint32 len, GError **error);
+
+/*!
+ * Copies the next len unread bytes of buf, which must all be there, into dst.
+ * \protected \memberof ThriftTransportClass
+ */
+void thrift_transport_buffer_take (GByteArray *buf, guint32 *pos,
+                                   gpointer dst, guint32 len);
+
+/*!
+ * Drops the bytes of buf that have already been read, before appending to it.
+ * \protected \memberof ThriftTransportClass
+ */
+void thrift_transport_buffer_compact (GByteArray *buf, guint32 *pos);
+
 /* define error/exception types */
 typedef enum
 {
@@ -199,6 +199,87 @@ test_read_and_write_external (void)
   g_object_unref (tbuffer);
 }
 
+static void
+test_borrow_and_consume (void)
+{
+  ThriftMemoryBuffer *tbuffer = NULL;
+  const guint8 *borrowed;
+  guint32 len;
+  gchar read[10];
+  GError *error = NULL;
+
+  tbuffer = g_object_new (THRIFT_TYPE_MEMORY_BUFFER, NULL);
+  g_assert (thrift_memory_buffer_write (THRIFT_TRANSPORT (tbuffer),
+                                      (gpointer) TEST_DATA, 10, &error) == TRUE);
+  g_assert (error == NULL);
+
+  /* borrowing more than is buffered fails without consuming anything */
+  len = 11;
+  g_assert (thrift_memory_buffer_borrow (THRIFT_TRANSPORT (tbuffer),
+                                         &len) == NULL);
+
+  /* a successful borrow reports everything that is available */
+  len = 4;
+  borrowed = thrift_memory_buffer_borrow (THRIFT_TRANSPORT (tbuffer), &len);
+  g_assert (borrowed != NULL);
+  g_assert (len == 10);
+  g_assert (memcmp (borrowed, TEST_DATA, 4) == 0);
+  g_assert (thrift_memory_buffer_consume (THRIFT_TRANSPORT (tbuffer),
+                                          4, &error) == TRUE);
+  g_assert (error == NULL);
+
+  /* consumed bytes are not returned by subsequent reads */
+  memset (read, 0, 10);
+  g_assert (thrift_memory_buffer_read (THRIFT_TRANSPORT (tbuffer),
+                                       (gpointer) read, 6, &error) == 6);
+  g_assert (memcmp (read, TEST_DATA + 4, 6) == 0);
+
+  /* consuming more than is buffered is an error */
+  g_assert (thrift_memory_buffer_consume (THRIFT_TRANSPORT (tbuffer),
+                                          1, &error) == FALSE);
+  g_assert (error != NULL);
+  g_error_free (error);
+
+  g_object_unref (tbuffer);
+}
+
+static void
+test_partial_reads (void)
+{
+  ThriftMemoryBuffer *tbuffer = NULL;
+  const guint8 *borrowed;
+  guint32 len;
+  gchar read[10];
+  GError *error = NULL;
+
+  tbuffer = g_object_new (THRIFT_TYPE_MEMORY_BUFFER, "buf_size", 10, NULL);
+  g_assert (thrift_memory_buffer_write (THRIFT_TRANSPORT (tbuffer),
+                                      (gpointer) TEST_DATA, 10, &error) == TRUE);
+  g_assert (error == NULL);
+
+  /* borrowing after a read starts at the first unread byte */
+  g_assert (thrift_memory_buffer_read (THRIFT_TRANSPORT (tbuffer),
+                                       (gpointer) read, 4, &error) == 4);
+  len = 1;
+  borrowed = thrift_memory_buffer_borrow (THRIFT_TRANSPORT (tbuffer), &len);
+  g_assert (borrowed != NULL);
+  g_assert (len == 6);
+  g_assert (memcmp (borrowed, TEST_DATA + 4, 6) == 0);
+
+  /* the bytes already read make room for more writes */
+  g_assert (thrift_memory_buffer_write (THRIFT_TRANSPORT (tbuffer),
+                                      (gpointer) TEST_DATA, 4, &error) == TRUE);
+  g_assert (error == NULL);
+
+  memset (read, 0, 10);
+  g_assert (thrift_memory_buffer_read (THRIFT_TRANSPORT (tbuffer),
+                                       (gpointer) read, 10, &error) == 10);
+  g_assert (memcmp (read, TEST_DATA + 4, 6) == 0);
+  g_assert (memcmp (read + 6, TEST_DATA, 4) == 0);
+
+  g_object_unref (tbuffer);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -217,6 +298,8 @@ main(int argc, char *argv[])
   g_test_add_func ("/testmemorybuffer/ReadAndWrite", test_read_and_write);
   g_test_add_func ("/testmemorybuffer/ReadAndWriteUnlimited", test_read_and_write_default);
   g_test_add_func ("/testmemorybuffer/ReadAndWriteExternal", test_read_and_write_external);
+  g_test_add_func ("/testmemorybuffer/BorrowAndConsume", test_borrow_and_consume);
+  g_test_add_func ("/testmemorybuffer/PartialReads", test_partial_reads);
 
   return g_test_run ();
 }
@@ -0,0 +1,78 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+#include <thrift/TAllocTracker.h>
+
+#ifdef THRIFT_ALLOC_TRACKING
+#include <atomic>
+#endif
+
+namespace apache {
+namespace thrift {
+
+#ifdef THRIFT_ALLOC_TRACKING
+namespace {
+// Plain counters so that no dynamic initialization happens inside
+// operator new.
+thread_local uint64_t tl_allocations = 0;
+thread_local uint64_t tl_bytes = 0;
+
+// Set by the first allocation counted, so a program that does not include
+// TAllocTrackerNew.h reports tracking as disabled
+std::atomic<bool> g_recording(false);
+}
+
+bool TAllocTracker::enabled() {
+  return g_recording.load(std::memory_order_relaxed);
+}
+
+TAllocCounts TAllocTracker::current() {
+  return TAllocCounts(tl_allocations, tl_bytes);
+}
+
+void TAllocTracker::record(std::size_t bytes) noexcept {
+  ++tl_allocations;
+  tl_bytes += bytes;
+  // Only written once, so threads do not contend for the cache line
+  if (!g_recording.load(std::memory_order_relaxed)) {
+    g_recording.store(true, std::memory_order_relaxed);
+  }
+}
+
+void TAllocTracker::recordMalloc(std::size_t bytes) noexcept {
+  if (enabled()) {
+    record(bytes);
+  }
+}
+#else
+bool TAllocTracker::enabled() {
+  return false;
+}
+
+TAllocCounts TAllocTracker::current() {
+  return TAllocCounts();
+}
+
+void TAllocTracker::record(std::size_t) noexcept {}
+
+void TAllocTracker::recordMalloc(std::size_t) noexcept {}
+#endif
+}
+} // apache::thrift
@@ -0,0 +1,107 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TALLOCTRACKER_H_
+#define _THRIFT_TALLOCTRACKER_H_ 1
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace apache {
+namespace thrift {
+
+/**
+ * A number of heap allocations and the bytes they requested.
+ */
+struct TAllocCounts {
+  TAllocCounts() : allocations(0), bytes(0) {}
+  TAllocCounts(uint64_t a, uint64_t b) : allocations(a), bytes(b) {}
+
+  TAllocCounts& operator+=(const TAllocCounts& other) {
+    allocations += other.allocations;
+    bytes += other.bytes;
+    return *this;
+  }
+
+  TAllocCounts operator-(const TAllocCounts& other) const {
+    return TAllocCounts(allocations - other.allocations, bytes - other.bytes);
+  }
+
+  uint64_t allocations;
+  uint64_t bytes;
+};
+
+/**
+ * Per-thread heap allocation counters.
+ *
+ * Counting is only compiled in when the library is built with
+ * THRIFT_ALLOC_TRACKING (cmake -DWITH_ALLOC_TRACKING=ON or configure
+ * --enable-alloc-tracking).  The library itself leaves the global operator
+ * new alone: a program that wants its allocations counted, typically a test
+ * or benchmark, includes <thrift/TAllocTrackerNew.h> in one of its source
+ * files, and every allocation is then counted against the thread that made
+ * it.  Otherwise enabled() is false and the counters stay at zero, so
+ * instrumented code can be left in place.
+ *
+ * Buffers that Thrift grows with malloc() and realloc() instead of new, the
+ * TMemoryBuffer storage and the TCompactProtocol string buffer, are counted
+ * through recordMalloc().  Other C allocations, such as those made inside
+ * OpenSSL or libevent, are not.
+ */
+class TAllocTracker {
+public:
+  /**
+   * Whether allocations are being counted: the library was built with
+   * THRIFT_ALLOC_TRACKING and the program replaces operator new with
+   * <thrift/TAllocTrackerNew.h>.
+   */
+  static bool enabled();
+
+  /** Running totals for the calling thread. */
+  static TAllocCounts current();
+
+  /**
+   * Counts an allocation of \p bytes against the calling thread.  Called by
+   * the operator new of <thrift/TAllocTrackerNew.h>; must not allocate.
+   */
+  static void record(std::size_t bytes) noexcept;
+
+  /**
+   * Counts a malloc() or realloc() of \p bytes, which operator new does not
+   * see, if allocations are being counted.
+   */
+  static void recordMalloc(std::size_t bytes) noexcept;
+};
+
+/**
+ * Measures the allocations made by the current thread during its lifetime.
+ */
+class TAllocScope {
+public:
+  TAllocScope() : start_(TAllocTracker::current()) {}
+
+  TAllocCounts counts() const { return TAllocTracker::current() - start_; }
+
+private:
+  TAllocCounts start_;
+};
+}
+} // apache::thrift
+
+#endif // #ifndef _THRIFT_TALLOCTRACKER_H_
@@ -0,0 +1,97 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TALLOCTRACKERNEW_H_
+#define _THRIFT_TALLOCTRACKERNEW_H_ 1
+
+/*
+ * Replaces the global operator new and delete with versions that count
+ * every allocation in TAllocTracker.  Include this in exactly one source
+ * file of a program, such as a test or benchmark, to enable
+ * TAllocTracker there.  Without THRIFT_ALLOC_TRACKING it defines nothing.
+ */
+
+#include <thrift/thrift-config.h>
+#include <thrift/TAllocTracker.h>
+
+#ifdef THRIFT_ALLOC_TRACKING
+#include <cstdlib>
+#include <new>
+
+namespace apache {
+namespace thrift {
+namespace {
+inline void* trackedAlloc(std::size_t size) {
+  TAllocTracker::record(size);
+  return std::malloc(size ? size : 1);
+}
+}
+}
+} // apache::thrift
+
+void* operator new(std::size_t size) {
+  if (void* p = apache::thrift::trackedAlloc(size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+  if (void* p = apache::thrift::trackedAlloc(size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return apache::thrift::trackedAlloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return apache::thrift::trackedAlloc(size);
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  std::free(p);
+}
+
+#if __cpp_sized_deallocation
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+  std::free(p);
+}
+#endif
+#endif // THRIFT_ALLOC_TRACKING
+
+#endif // #ifndef _THRIFT_TALLOCTRACKERNEW_H_
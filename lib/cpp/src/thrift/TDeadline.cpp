@@ -0,0 +1,102 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/TDeadline.h>
+
+namespace apache {
+namespace thrift {
+
+// Same name and meaning as the header used by fbthrift clients
+const char* const TDeadline::HEADER = "client_timeout";
+
+namespace {
+thread_local TDeadline::clock::time_point tl_deadline = TDeadline::clock::time_point::max();
+// min() means "not recorded"
+thread_local TDeadline::clock::time_point tl_received = TDeadline::clock::time_point::min();
+}
+
+bool TDeadline::isSet() {
+  return tl_deadline != clock::time_point::max();
+}
+
+TDeadline::clock::time_point TDeadline::get() {
+  return tl_deadline;
+}
+
+void TDeadline::set(clock::time_point deadline) {
+  tl_deadline = deadline;
+}
+
+void TDeadline::clear() {
+  tl_deadline = clock::time_point::max();
+}
+
+std::chrono::milliseconds TDeadline::remaining() {
+  if (!isSet()) {
+    return std::chrono::milliseconds::max();
+  }
+  clock::time_point now = clock::now();
+  if (now >= tl_deadline) {
+    return std::chrono::milliseconds::zero();
+  }
+  // Round up so that a deadline that has not passed never reads as zero
+  auto left = tl_deadline - now;
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(left);
+  return ms < left ? ms + std::chrono::milliseconds(1) : ms;
+}
+
+bool TDeadline::expired() {
+  return isSet() && clock::now() >= tl_deadline;
+}
+
+TDeadline::clock::time_point TDeadline::received() {
+  return tl_received == clock::time_point::min() ? clock::now() : tl_received;
+}
+
+void TDeadline::setReceived(clock::time_point when) {
+  tl_received = when;
+}
+
+TDeadline::clock::time_point TDeadline::after(clock::time_point start,
+                                              std::chrono::milliseconds timeout) {
+  if (timeout <= std::chrono::milliseconds::zero()) {
+    return start;
+  }
+  auto headroom = std::chrono::duration_cast<std::chrono::milliseconds>(clock::time_point::max()
+                                                                        - start);
+  return timeout < headroom ? start + timeout : clock::time_point::max();
+}
+
+TDeadlineScope::TDeadlineScope() : deadline_(tl_deadline), received_(tl_received) {
+}
+
+TDeadlineScope::TDeadlineScope(std::chrono::milliseconds timeout)
+  : deadline_(tl_deadline), received_(tl_received) {
+  TDeadline::clock::time_point deadline = TDeadline::after(TDeadline::clock::now(), timeout);
+  if (deadline < tl_deadline) {
+    tl_deadline = deadline;
+  }
+}
+
+TDeadlineScope::~TDeadlineScope() {
+  tl_deadline = deadline_;
+  tl_received = received_;
+}
+}
+} // apache::thrift
@@ -0,0 +1,111 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TDEADLINE_H_
+#define _THRIFT_TDEADLINE_H_ 1
+
+#include <chrono>
+
+namespace apache {
+namespace thrift {
+
+/**
+ * The deadline of the call the current thread is working on.
+ *
+ * Clients set a deadline with TDeadlineScope.  THeaderProtocol sends the
+ * remaining time with every outgoing call as the TDeadline::HEADER info
+ * header, and on the server sets the deadline of the incoming call from it,
+ * so a handler sees its caller's deadline through remaining() and passes it
+ * on to the calls it makes itself.  Processors drop calls whose deadline has
+ * already passed before dispatching them to the handler.
+ *
+ * The header carries a relative timeout in milliseconds, so clocks need not
+ * be synchronized; on the server it counts from when the request was
+ * received (see setReceived()).
+ */
+class TDeadline {
+public:
+  typedef std::chrono::steady_clock clock;
+
+  /// Info header carrying the caller's remaining time in milliseconds
+  static const char* const HEADER;
+
+  /** Whether the current thread has a deadline. */
+  static bool isSet();
+
+  /** The current deadline, or clock::time_point::max() if none is set. */
+  static clock::time_point get();
+
+  static void set(clock::time_point deadline);
+
+  static void clear();
+
+  /**
+   * Time left until the deadline: zero once it has passed, and
+   * milliseconds::max() if no deadline is set.
+   */
+  static std::chrono::milliseconds remaining();
+
+  /** Whether a deadline is set and has passed. */
+  static bool expired();
+
+  /**
+   * When the request being processed was received.  Servers that queue
+   * requests record this so that the queueing time counts against deadlines
+   * read from the request; otherwise it is the current time.
+   */
+  static clock::time_point received();
+
+  static void setReceived(clock::time_point when);
+
+  /**
+   * \p timeout after \p start, saturating at clock::time_point::max();
+   * negative timeouts count as zero.
+   */
+  static clock::time_point after(clock::time_point start, std::chrono::milliseconds timeout);
+};
+
+/**
+ * Sets, or narrows, the current thread's deadline and restores the previous
+ * deadline and received time when it goes out of scope.
+ */
+class TDeadlineScope {
+public:
+  /** Keeps the current deadline; only restores it on exit. */
+  TDeadlineScope();
+
+  /**
+   * The deadline becomes \p timeout from now, unless an existing deadline is
+   * earlier.
+   */
+  explicit TDeadlineScope(std::chrono::milliseconds timeout);
+
+  ~TDeadlineScope();
+
+private:
+  TDeadlineScope(const TDeadlineScope&) = delete;
+  TDeadlineScope& operator=(const TDeadlineScope&) = delete;
+
+  TDeadline::clock::time_point deadline_;
+  TDeadline::clock::time_point received_;
+};
+}
+} // apache::thrift
+
+#endif // #ifndef _THRIFT_TDEADLINE_H_
@@ -19,11 +19,57 @@
 #ifndef _THRIFT_TDISPATCHPROCESSOR_H_
 #define _THRIFT_TDISPATCHPROCESSOR_H_ 1
 
+#include <thrift/TApplicationException.h>
+#include <thrift/TDeadline.h>
 #include <thrift/TProcessor.h>
 
+#include <typeinfo>
+
 namespace apache {
 namespace thrift {
 
+/**
+ * Refuse a call whose message header has been read, without dispatching it
+ * to the handler.  The arguments are skipped and, unless the call is oneway,
+ * the caller receives a TApplicationException with the given message.
+ */
+inline void rejectCall(protocol::TProtocol* in,
+                       protocol::TProtocol* out,
+                       const std::string& fname,
+                       protocol::TMessageType mtype,
+                       int32_t seqid,
+                       const std::string& message) {
+  in->skip(protocol::T_STRUCT);
+  in->readMessageEnd();
+  in->getTransport()->readEnd();
+
+  if (mtype == protocol::T_CALL) {
+    TApplicationException x(TApplicationException::INTERNAL_ERROR, message);
+    out->writeMessageBegin(fname, protocol::T_EXCEPTION, seqid);
+    x.write(out);
+    out->writeMessageEnd();
+    out->getTransport()->writeEnd();
+    out->getTransport()->flush();
+  }
+}
+
+/**
+ * Drop a call whose deadline (see TDeadline) has already passed.
+ *
+ * @return true if the call was dropped.
+ */
+inline bool dropExpiredCall(protocol::TProtocol* in,
+                            protocol::TProtocol* out,
+                            const std::string& fname,
+                            protocol::TMessageType mtype,
+                            int32_t seqid) {
+  if (!TDeadline::expired()) {
+    return false;
+  }
+  rejectCall(in, out, fname, mtype, seqid, "Deadline exceeded before " + fname + " was dispatched");
+  return true;
+}
+
 /**
  * TDispatchProcessor is a helper class to parse the message header then call
  * another function to dispatch based on the function name.
@@ -36,6 +82,9 @@ public:
   bool process(std::shared_ptr<protocol::TProtocol> in,
                        std::shared_ptr<protocol::TProtocol> out,
                        void* connectionContext) override {
+    // The deadline read with the message only applies to this call
+    TDeadlineScope deadlineScope;
+
     protocol::TProtocol* inRaw = in.get();
     protocol::TProtocol* outRaw = out.get();
 
@@ -65,6 +114,36 @@ public:
       return false;
     }
 
+    if (dropExpiredCall(inRaw, outRaw, fname, mtype, seqid)) {
+      return true;
+    }
+    return this->dispatchCall(inRaw, outRaw, fname, seqid, connectionContext);
+  }
+
+  bool dispatchMessage(std::shared_ptr<protocol::TProtocol> in,
+                       std::shared_ptr<protocol::TProtocol> out,
+                       const std::string& fname,
+                       protocol::TMessageType mtype,
+                       int32_t seqid,
+                       void* connectionContext) override {
+    if (mtype != protocol::T_CALL && mtype != protocol::T_ONEWAY) {
+      GlobalOutput.printf("received invalid message type %d from client", mtype);
+      return false;
+    }
+
+    protocol::TProtocol* inRaw = in.get();
+    protocol::TProtocol* outRaw = out.get();
+    if (dropExpiredCall(inRaw, outRaw, fname, mtype, seqid)) {
+      return true;
+    }
+    auto* specificIn = dynamic_cast<Protocol_*>(inRaw);
+    auto* specificOut = dynamic_cast<Protocol_*>(outRaw);
+    if (specificIn && specificOut) {
+      return this->dispatchCallTemplated(specificIn, specificOut, fname, seqid, connectionContext);
+    }
+
+    T_GENERIC_PROTOCOL(this, inRaw, specificIn);
+    T_GENERIC_PROTOCOL(this, outRaw, specificOut);
     return this->dispatchCall(inRaw, outRaw, fname, seqid, connectionContext);
   }
 
@@ -80,6 +159,9 @@ protected:
       return false;
     }
 
+    if (dropExpiredCall(in, out, fname, mtype, seqid)) {
+      return true;
+    }
     return this->dispatchCallTemplated(in, out, fname, seqid, connectionContext);
   }
 
@@ -108,6 +190,9 @@ public:
   bool process(std::shared_ptr<protocol::TProtocol> in,
                        std::shared_ptr<protocol::TProtocol> out,
                        void* connectionContext) override {
+    // The deadline read with the message only applies to this call
+    TDeadlineScope deadlineScope;
+
     std::string fname;
     protocol::TMessageType mtype;
     int32_t seqid;
@@ -118,6 +203,26 @@ public:
       return false;
     }
 
+    if (dropExpiredCall(in.get(), out.get(), fname, mtype, seqid)) {
+      return true;
+    }
+    return dispatchCall(in.get(), out.get(), fname, seqid, connectionContext);
+  }
+
+  bool dispatchMessage(std::shared_ptr<protocol::TProtocol> in,
+                       std::shared_ptr<protocol::TProtocol> out,
+                       const std::string& fname,
+                       protocol::TMessageType mtype,
+                       int32_t seqid,
+                       void* connectionContext) override {
+    if (mtype != protocol::T_CALL && mtype != protocol::T_ONEWAY) {
+      GlobalOutput.printf("received invalid message type %d from client", mtype);
+      return false;
+    }
+
+    if (dropExpiredCall(in.get(), out.get(), fname, mtype, seqid)) {
+      return true;
+    }
     return dispatchCall(in.get(), out.get(), fname, seqid, connectionContext);
   }
 
@@ -0,0 +1,277 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TINLINESTRING_H_
+#define _THRIFT_TINLINESTRING_H_ 1
+
+#include <thrift/Thrift.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <ostream>
+#include <string>
+
+namespace apache {
+namespace thrift {
+
+/**
+ * String type with inline storage for short values.
+ *
+ * Strings of up to INLINE_CAPACITY bytes are kept inside the object itself,
+ * so reading or copying them never touches the heap; longer values fall back
+ * to a heap buffer.  The protocols read directly into this storage, from the
+ * transport's buffer when it can be borrowed.
+ *
+ * Generated code uses this type for strings annotated with
+ * (cpp.inline_string), e.g. "1: string (cpp.inline_string) key" or
+ * "list<string (cpp.inline_string)> keys".
+ */
+class TInlineString {
+public:
+  typedef char value_type;
+  typedef char* iterator;
+  typedef const char* const_iterator;
+  typedef std::size_t size_type;
+
+  static const size_type INLINE_CAPACITY = 31;
+
+  TInlineString() noexcept : data_(inline_), size_(0), capacity_(INLINE_CAPACITY) {
+    inline_[0] = '\0';
+  }
+
+  TInlineString(const char* str) : TInlineString() { assign(str, std::strlen(str)); }
+
+  TInlineString(const char* str, size_type len) : TInlineString() { assign(str, len); }
+
+  TInlineString(const std::string& str) : TInlineString() { assign(str.data(), str.size()); }
+
+  TInlineString(const TInlineString& other) : TInlineString() {
+    assign(other.data_, other.size_);
+  }
+
+  TInlineString(TInlineString&& other) noexcept : TInlineString() { moveFrom(other); }
+
+  ~TInlineString() {
+    if (!isInline()) {
+      std::free(data_);
+    }
+  }
+
+  TInlineString& operator=(const TInlineString& other) {
+    if (this != &other) {
+      assign(other.data_, other.size_);
+    }
+    return *this;
+  }
+
+  TInlineString& operator=(TInlineString&& other) noexcept {
+    if (this != &other) {
+      if (!isInline()) {
+        std::free(data_);
+        data_ = inline_;
+        capacity_ = INLINE_CAPACITY;
+      }
+      moveFrom(other);
+    }
+    return *this;
+  }
+
+  TInlineString& operator=(const std::string& str) { return assign(str.data(), str.size()); }
+
+  TInlineString& operator=(const char* str) { return assign(str, std::strlen(str)); }
+
+  TInlineString& assign(const char* str, size_type len) {
+    if (len > capacity_) {
+      grow(len, false);
+    }
+    if (len > 0) {
+      std::memmove(data_, str, len);
+    }
+    size_ = static_cast<uint32_t>(len);
+    data_[size_] = '\0';
+    return *this;
+  }
+
+  /**
+   * Changes the length, keeping the existing prefix.  Any new bytes are left
+   * uninitialized, as they are about to be overwritten by a read.
+   */
+  void resize(size_type len) {
+    if (len > capacity_) {
+      grow(len, true);
+    }
+    size_ = static_cast<uint32_t>(len);
+    data_[size_] = '\0';
+  }
+
+  void reserve(size_type len) {
+    if (len > capacity_) {
+      grow(len, true);
+    }
+  }
+
+  void clear() noexcept {
+    size_ = 0;
+    data_[0] = '\0';
+  }
+
+  const char* data() const noexcept { return data_; }
+  char* data() noexcept { return data_; }
+  const char* c_str() const noexcept { return data_; }
+  size_type size() const noexcept { return size_; }
+  size_type length() const noexcept { return size_; }
+  size_type capacity() const noexcept { return capacity_; }
+  bool empty() const noexcept { return size_ == 0; }
+
+  /**
+   * Whether the value currently lives in the object's inline storage.
+   */
+  bool isInline() const noexcept { return data_ == inline_; }
+
+  char& operator[](size_type pos) noexcept { return data_[pos]; }
+  const char& operator[](size_type pos) const noexcept { return data_[pos]; }
+
+  iterator begin() noexcept { return data_; }
+  const_iterator begin() const noexcept { return data_; }
+  iterator end() noexcept { return data_ + size_; }
+  const_iterator end() const noexcept { return data_ + size_; }
+
+  std::string str() const { return std::string(data_, size_); }
+
+  int compare(const char* str, size_type len) const noexcept {
+    int result = std::memcmp(data_, str, (std::min)(static_cast<size_type>(size_), len));
+    if (result != 0) {
+      return result;
+    }
+    return size_ < len ? -1 : (size_ > len ? 1 : 0);
+  }
+
+  int compare(const TInlineString& other) const noexcept {
+    return compare(other.data_, other.size_);
+  }
+
+  void swap(TInlineString& other) noexcept {
+    TInlineString tmp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(tmp);
+  }
+
+private:
+  void grow(size_type len, bool keep) {
+    const size_type limit = (std::numeric_limits<uint32_t>::max)() - 1;
+    if (len > limit) {
+      throw std::bad_alloc();
+    }
+    // Grow geometrically so repeated resizes stay amortized.
+    size_type capacity = (std::max)(len, static_cast<size_type>(capacity_) * 2);
+    if (capacity > limit) {
+      capacity = len;
+    }
+    char* buf;
+    if (isInline()) {
+      buf = static_cast<char*>(std::malloc(capacity + 1));
+      if (buf != nullptr && keep) {
+        std::memcpy(buf, inline_, size_ + 1);
+      }
+    } else if (keep) {
+      buf = static_cast<char*>(std::realloc(data_, capacity + 1));
+    } else {
+      std::free(data_);
+      data_ = inline_;
+      capacity_ = INLINE_CAPACITY;
+      size_ = 0;
+      inline_[0] = '\0';
+      buf = static_cast<char*>(std::malloc(capacity + 1));
+    }
+    if (buf == nullptr) {
+      throw std::bad_alloc();
+    }
+    data_ = buf;
+    capacity_ = static_cast<uint32_t>(capacity);
+  }
+
+  // Requires that this object holds no heap buffer.
+  void moveFrom(TInlineString& other) noexcept {
+    if (other.isInline()) {
+      std::memcpy(inline_, other.inline_, other.size_ + 1);
+    } else {
+      data_ = other.data_;
+      capacity_ = other.capacity_;
+      other.data_ = other.inline_;
+      other.capacity_ = INLINE_CAPACITY;
+    }
+    size_ = other.size_;
+    other.size_ = 0;
+    other.inline_[0] = '\0';
+  }
+
+  char* data_;
+  uint32_t size_;
+  uint32_t capacity_;
+  char inline_[INLINE_CAPACITY + 1];
+};
+
+inline void swap(TInlineString& lhs, TInlineString& rhs) noexcept {
+  lhs.swap(rhs);
+}
+
+inline bool operator==(const TInlineString& lhs, const TInlineString& rhs) {
+  return lhs.compare(rhs) == 0;
+}
+
+inline bool operator==(const TInlineString& lhs, const std::string& rhs) {
+  return lhs.compare(rhs.data(), rhs.size()) == 0;
+}
+
+inline bool operator==(const std::string& lhs, const TInlineString& rhs) {
+  return rhs == lhs;
+}
+
+inline bool operator==(const TInlineString& lhs, const char* rhs) {
+  return lhs.compare(rhs, std::strlen(rhs)) == 0;
+}
+
+inline bool operator!=(const TInlineString& lhs, const TInlineString& rhs) {
+  return !(lhs == rhs);
+}
+
+inline bool operator!=(const TInlineString& lhs, const std::string& rhs) {
+  return !(lhs == rhs);
+}
+
+inline bool operator!=(const TInlineString& lhs, const char* rhs) {
+  return !(lhs == rhs);
+}
+
+inline bool operator<(const TInlineString& lhs, const TInlineString& rhs) {
+  return lhs.compare(rhs) < 0;
+}
+
+inline std::ostream& operator<<(std::ostream& out, const TInlineString& obj) {
+  out.write(obj.data(), static_cast<std::streamsize>(obj.size()));
+  return out;
+}
+
+} // namespace thrift
+} // namespace apache
+
+#endif // #ifndef _THRIFT_TINLINESTRING_H_
@@ -149,6 +149,38 @@ public:
     return process(io, io, connectionContext);
   }
 
+  /**
+   * Whether dispatchMessage() is implemented.  Routing processors such as
+   * TMultiplexedProcessor read the message header themselves; processors
+   * returning true here can be handed that header directly instead of
+   * having it replayed through a decorating protocol.
+   *
+   * Returning true means process() is never called for those messages, so
+   * a processor should only do so when its process() is the one that goes
+   * with its dispatchMessage().  Generated processors check that they are
+   * not a subclass, which may have overridden process().
+   */
+  virtual bool canDispatchMessage() const { return false; }
+
+  /**
+   * Process a message whose header has already been read from \p in.
+   * Only called when canDispatchMessage() returns true.
+   */
+  virtual bool dispatchMessage(std::shared_ptr<protocol::TProtocol> in,
+                               std::shared_ptr<protocol::TProtocol> out,
+                               const std::string& fname,
+                               protocol::TMessageType mtype,
+                               int32_t seqid,
+                               void* connectionContext) {
+    (void)in;
+    (void)out;
+    (void)fname;
+    (void)mtype;
+    (void)seqid;
+    (void)connectionContext;
+    throw TException("TProcessor::dispatchMessage() is not supported");
+  }
+
   std::shared_ptr<TProcessorEventHandler> getEventHandler() const { return eventHandler_; }
 
   void setEventHandler(std::shared_ptr<TProcessorEventHandler> eventHandler) {
@@ -0,0 +1,204 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/concurrency/TaskQueue.h>
+
+#include <algorithm>
+
+namespace apache {
+namespace thrift {
+namespace concurrency {
+
+using std::shared_ptr;
+
+void FifoTaskQueue::push(shared_ptr<Runnable> task, const TaskClass& taskClass) {
+  (void)taskClass;
+  tasks_.push_back(std::move(task));
+}
+
+shared_ptr<Runnable> FifoTaskQueue::pop() {
+  if (tasks_.empty()) {
+    return shared_ptr<Runnable>();
+  }
+  shared_ptr<Runnable> task = std::move(tasks_.front());
+  tasks_.pop_front();
+  return task;
+}
+
+std::vector<shared_ptr<Runnable> > FifoTaskQueue::removeIf(const Predicate& predicate,
+                                                          bool justOne) {
+  std::vector<shared_ptr<Runnable> > removed;
+  for (auto it = tasks_.begin(); it != tasks_.end();) {
+    if (predicate(*it)) {
+      removed.push_back(*it);
+      it = tasks_.erase(it);
+      if (justOne) {
+        break;
+      }
+    } else {
+      ++it;
+    }
+  }
+  return removed;
+}
+
+FairTaskQueue::FairTaskQueue() : size_(0) {
+}
+
+void FairTaskQueue::setWeight(const std::string& tenant, uint32_t weight) {
+  weight = std::max<uint32_t>(weight, 1);
+  Guard g(mutex_);
+  weights_[tenant] = weight;
+  for (auto& level : levels_) {
+    auto it = level.second.tenants.find(tenant);
+    if (it != level.second.tenants.end()) {
+      it->second.weight = weight;
+      it->second.deficit = std::min(it->second.deficit, weight);
+    }
+  }
+}
+
+uint32_t FairTaskQueue::getWeight(const std::string& tenant) const {
+  Guard g(mutex_);
+  auto it = weights_.find(tenant);
+  return it == weights_.end() ? 1 : it->second;
+}
+
+TaskClassStats FairTaskQueue::getStats(int priority) const {
+  Guard g(mutex_);
+  auto it = levels_.find(priority);
+  return it == levels_.end() ? TaskClassStats() : it->second.stats;
+}
+
+std::map<int, TaskClassStats> FairTaskQueue::getStats() const {
+  Guard g(mutex_);
+  std::map<int, TaskClassStats> stats;
+  for (const auto& level : levels_) {
+    stats[level.first] = level.second.stats;
+  }
+  return stats;
+}
+
+void FairTaskQueue::push(shared_ptr<Runnable> task, const TaskClass& taskClass) {
+  Guard g(mutex_);
+  Level& level = levels_[taskClass.priority];
+  auto inserted = level.tenants.emplace(taskClass.tenant, Tenant());
+  Tenant& tenant = inserted.first->second;
+  if (inserted.second) {
+    tenant.name = taskClass.tenant;
+    auto weight = weights_.find(taskClass.tenant);
+    if (weight != weights_.end()) {
+      tenant.weight = weight->second;
+    }
+    level.active.push_back(&tenant);
+  }
+
+  Entry entry;
+  entry.task = std::move(task);
+  entry.added = std::chrono::steady_clock::now();
+  tenant.tasks.push_back(std::move(entry));
+  ++level.stats.depth;
+  ++size_;
+}
+
+shared_ptr<Runnable> FairTaskQueue::pop() {
+  Guard g(mutex_);
+  for (auto& it : levels_) {
+    Level& level = it.second;
+    if (level.active.empty()) {
+      continue;
+    }
+
+    // The tenant at the front has the turn; a new turn grants its weight
+    Tenant* tenant = level.active.front();
+    if (tenant->deficit == 0) {
+      tenant->deficit = tenant->weight;
+    }
+    Entry entry = std::move(tenant->tasks.front());
+    tenant->tasks.pop_front();
+    --tenant->deficit;
+
+    std::chrono::nanoseconds wait = std::chrono::steady_clock::now() - entry.added;
+    --level.stats.depth;
+    ++level.stats.dequeued;
+    level.stats.totalWait += wait;
+    level.stats.maxWait = std::max(level.stats.maxWait, wait);
+    --size_;
+
+    if (tenant->tasks.empty()) {
+      retire(level, tenant);
+    } else if (tenant->deficit == 0) {
+      level.active.pop_front();
+      level.active.push_back(tenant);
+    }
+    return entry.task;
+  }
+  return shared_ptr<Runnable>();
+}
+
+std::vector<shared_ptr<Runnable> > FairTaskQueue::removeIf(const Predicate& predicate,
+                                                          bool justOne) {
+  Guard g(mutex_);
+  std::vector<shared_ptr<Runnable> > removed;
+  for (auto& it : levels_) {
+    Level& level = it.second;
+    std::vector<Tenant*> emptied;
+    for (Tenant* tenant : level.active) {
+      for (auto entry = tenant->tasks.begin(); entry != tenant->tasks.end();) {
+        if (predicate(entry->task)) {
+          removed.push_back(entry->task);
+          entry = tenant->tasks.erase(entry);
+          --level.stats.depth;
+          --size_;
+          if (justOne) {
+            break;
+          }
+        } else {
+          ++entry;
+        }
+      }
+      if (tenant->tasks.empty()) {
+        emptied.push_back(tenant);
+      }
+      if (justOne && !removed.empty()) {
+        break;
+      }
+    }
+    for (Tenant* tenant : emptied) {
+      retire(level, tenant);
+    }
+    if (justOne && !removed.empty()) {
+      break;
+    }
+  }
+  return removed;
+}
+
+size_t FairTaskQueue::size() const {
+  Guard g(mutex_);
+  return size_;
+}
+
+void FairTaskQueue::retire(Level& level, Tenant* tenant) {
+  level.active.erase(std::find(level.active.begin(), level.active.end(), tenant));
+  level.tenants.erase(tenant->name);
+}
+}
+}
+} // apache::thrift::concurrency
@@ -0,0 +1,197 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_CONCURRENCY_TASKQUEUE_H_
+#define _THRIFT_CONCURRENCY_TASKQUEUE_H_ 1
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <thrift/concurrency/Mutex.h>
+#include <thrift/concurrency/Thread.h>
+
+namespace apache {
+namespace thrift {
+namespace concurrency {
+
+/**
+ * How a task given to ThreadManager::add() is scheduled: its priority class
+ * and the tenant, e.g. the calling service, it is run on behalf of.  Only
+ * queues that schedule by class, such as FairTaskQueue, look at it.
+ */
+struct TaskClass {
+  explicit TaskClass(int priority = 0, const std::string& tenant = std::string())
+    : priority(priority), tenant(tenant) {}
+
+  /// Higher priorities run first
+  int priority;
+
+  /// Tasks of different tenants within a priority share workers fairly
+  std::string tenant;
+};
+
+/**
+ * The queue of pending tasks in a ThreadManager, which decides the order in
+ * which they run.  All methods are called with the ThreadManager's lock
+ * held, so implementations need no locking of their own unless they offer
+ * other methods.
+ */
+class TaskQueue {
+public:
+  typedef std::function<bool(const std::shared_ptr<Runnable>&)> Predicate;
+
+  virtual ~TaskQueue() = default;
+
+  virtual void push(std::shared_ptr<Runnable> task, const TaskClass& taskClass) = 0;
+
+  /**
+   * Remove the task that should run next.
+   *
+   * @return the task, or an empty pointer if the queue is empty.
+   */
+  virtual std::shared_ptr<Runnable> pop() = 0;
+
+  /**
+   * Remove pending tasks matching \p predicate.
+   *
+   * @param justOne stop after the first match.
+   * @return the removed tasks.
+   */
+  virtual std::vector<std::shared_ptr<Runnable> > removeIf(const Predicate& predicate,
+                                                           bool justOne) = 0;
+
+  virtual size_t size() const = 0;
+
+  bool empty() const { return size() == 0; }
+};
+
+/**
+ * Runs tasks in the order they were added, regardless of their class.  This
+ * is the default.
+ */
+class FifoTaskQueue : public TaskQueue {
+public:
+  void push(std::shared_ptr<Runnable> task, const TaskClass& taskClass) override;
+  std::shared_ptr<Runnable> pop() override;
+  std::vector<std::shared_ptr<Runnable> > removeIf(const Predicate& predicate,
+                                                   bool justOne) override;
+  size_t size() const override { return tasks_.size(); }
+
+private:
+  std::deque<std::shared_ptr<Runnable> > tasks_;
+};
+
+/**
+ * Queue statistics of one priority class of a FairTaskQueue.
+ */
+struct TaskClassStats {
+  TaskClassStats() : depth(0), dequeued(0), totalWait(0), maxWait(0) {}
+
+  /// Tasks waiting
+  size_t depth;
+
+  /// Tasks taken off the queue to run
+  uint64_t dequeued;
+
+  /// Time the dequeued tasks spent waiting, in total and at most
+  std::chrono::nanoseconds totalWait;
+  std::chrono::nanoseconds maxWait;
+};
+
+/**
+ * Schedules tasks by priority class, and fairly among tenants within a
+ * class.
+ *
+ * A task runs only once no task of a higher priority is waiting, so health
+ * checks and other urgent calls overtake bulk work.  Within a priority, each
+ * tenant has its own queue and the queues are served by deficit round robin:
+ * in each round a tenant may run as many tasks as its weight, so a burst
+ * from one tenant only delays the others by their share of the workers.
+ *
+ * Strict priority can starve lower classes; reserve the higher ones for
+ * cheap calls.
+ */
+class FairTaskQueue : public TaskQueue {
+public:
+  FairTaskQueue();
+
+  /**
+   * Set the share of \p tenant relative to the other tenants of the same
+   * priority; the default weight is 1.
+   *
+   * @param weight tasks per round; 0 is taken as 1.
+   */
+  void setWeight(const std::string& tenant, uint32_t weight);
+
+  uint32_t getWeight(const std::string& tenant) const;
+
+  /** Statistics of one priority class. */
+  TaskClassStats getStats(int priority) const;
+
+  /** Statistics of every priority class seen so far. */
+  std::map<int, TaskClassStats> getStats() const;
+
+  void push(std::shared_ptr<Runnable> task, const TaskClass& taskClass) override;
+  std::shared_ptr<Runnable> pop() override;
+  std::vector<std::shared_ptr<Runnable> > removeIf(const Predicate& predicate,
+                                                   bool justOne) override;
+  size_t size() const override;
+
+private:
+  struct Entry {
+    std::shared_ptr<Runnable> task;
+    std::chrono::steady_clock::time_point added;
+  };
+
+  struct Tenant {
+    Tenant() : weight(1), deficit(0) {}
+    std::string name;
+    std::deque<Entry> tasks;
+    uint32_t weight;
+    uint32_t deficit;
+  };
+
+  struct Level {
+    /// Tenants with waiting tasks; only these have an entry
+    std::unordered_map<std::string, Tenant> tenants;
+    /// Round robin order of the tenants
+    std::deque<Tenant*> active;
+    TaskClassStats stats;
+  };
+
+  /// Drop \p tenant, which has no tasks left, from \p level
+  void retire(Level& level, Tenant* tenant);
+
+  mutable Mutex mutex_;
+  /// By priority, highest first
+  std::map<int, Level, std::greater<int> > levels_;
+  std::unordered_map<std::string, uint32_t> weights_;
+  size_t size_;
+};
+}
+}
+} // apache::thrift::concurrency
+
+#endif // #ifndef _THRIFT_CONCURRENCY_TASKQUEUE_H_
@@ -18,12 +18,18 @@
  */
 
 #include <thrift/concurrency/Thread.h>
+#include <thrift/concurrency/ThreadAffinity.h>
+#include <thrift/TOutput.h>
 
 namespace apache {
 namespace thrift {
 namespace concurrency {
 
 void Thread::threadMain(std::shared_ptr<Thread> thread) {
+  // Before anything runs here, so that the runnable allocates on the right node
+  if (!thread->getCpus().empty() && !ThreadAffinity::setCurrentThreadCpus(thread->getCpus())) {
+    GlobalOutput.printf("Thread: could not set the CPU affinity of a new thread");
+  }
   thread->setState(started);
   thread->runnable()->run();
 
@@ -22,6 +22,7 @@
 
 #include <memory>
 #include <thread>
+#include <vector>
 
 #include <thrift/concurrency/Monitor.h>
 
@@ -154,6 +155,17 @@ public:
    */
   Thread::id_t getId() const { return thread_.get() ? thread_->get_id() : std::thread::id(); }
 
+  /**
+   * Restricts the thread to \p cpus, or lets it run anywhere if empty (the
+   * default).  Takes effect when the thread starts, before its runnable
+   * runs.
+   *
+   * @see ThreadAffinity
+   */
+  void setCpus(const std::vector<int>& cpus) { cpus_ = cpus; }
+
+  const std::vector<int>& getCpus() const { return cpus_; }
+
   /**
    * Gets the runnable object this thread is hosting
    */
@@ -168,6 +180,7 @@ protected:
 private:
   std::shared_ptr<Runnable> _runnable;
   std::unique_ptr<std::thread> thread_;
+  std::vector<int> cpus_;
   Monitor monitor_;
   STATE state_;
   bool detached_;
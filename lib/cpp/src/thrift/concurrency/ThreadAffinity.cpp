@@ -0,0 +1,181 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <thrift/concurrency/ThreadAffinity.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace apache {
+namespace thrift {
+namespace concurrency {
+
+namespace {
+
+const char NODE_DIR[] = "/sys/devices/system/node/";
+
+// The first line of a sysfs file, empty if there is none
+std::string readLine(const std::string& path) {
+  std::ifstream in(path.c_str());
+  std::string line;
+  std::getline(in, line);
+  return line;
+}
+}
+
+ThreadAffinity ThreadAffinity::node(int node, Policy policy) {
+  return ThreadAffinity(nodeCpus(node), policy);
+}
+
+std::vector<int> ThreadAffinity::cpusFor(size_t index) const {
+  if (policy_ == ROUND_ROBIN && !cpus_.empty()) {
+    return std::vector<int>(1, cpus_[index % cpus_.size()]);
+  }
+  return cpus_;
+}
+
+std::vector<int> ThreadAffinity::numaNodes() {
+  std::vector<int> nodes = parseCpuList(readLine(std::string(NODE_DIR) + "online"));
+  if (nodes.empty()) {
+    nodes.push_back(0);
+  }
+  return nodes;
+}
+
+std::vector<int> ThreadAffinity::nodeCpus(int node) {
+  if (node < 0) {
+    return std::vector<int>();
+  }
+  return parseCpuList(readLine(std::string(NODE_DIR) + "node" + std::to_string(node) + "/cpulist"));
+}
+
+int ThreadAffinity::cpuNode(int cpu) {
+  for (int node : numaNodes()) {
+    std::vector<int> cpus = nodeCpus(node);
+    if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) {
+      return node;
+    }
+  }
+  return -1;
+}
+
+bool ThreadAffinity::setCurrentThreadCpus(const std::vector<int>& cpus) {
+#ifdef __linux__
+  std::vector<int> target = cpus;
+  if (target.empty()) {
+    // Lifting the restriction means allowing every CPU there is
+    target = parseCpuList(readLine("/sys/devices/system/cpu/possible"));
+    if (target.empty()) {
+      return false;
+    }
+  }
+  int maxCpu = *std::max_element(target.begin(), target.end());
+  if (maxCpu < 0) {
+    return false;
+  }
+  size_t setSize = CPU_ALLOC_SIZE(maxCpu + 1);
+  cpu_set_t* set = CPU_ALLOC(maxCpu + 1);
+  if (set == nullptr) {
+    return false;
+  }
+  CPU_ZERO_S(setSize, set);
+  for (int cpu : target) {
+    if (cpu >= 0) {
+      CPU_SET_S(cpu, setSize, set);
+    }
+  }
+  bool result = sched_setaffinity(0, setSize, set) == 0;
+  CPU_FREE(set);
+  return result;
+#else
+  (void)cpus;
+  return false;
+#endif
+}
+
+std::vector<int> ThreadAffinity::getCurrentThreadCpus() {
+  std::vector<int> cpus;
+#ifdef __linux__
+  // Grow the set until the kernel's mask fits
+  for (int count = 1024; count <= (1 << 20); count *= 2) {
+    size_t setSize = CPU_ALLOC_SIZE(count);
+    cpu_set_t* set = CPU_ALLOC(count);
+    if (set == nullptr) {
+      break;
+    }
+    CPU_ZERO_S(setSize, set);
+    if (sched_getaffinity(0, setSize, set) == 0) {
+      for (int cpu = 0; cpu < count; ++cpu) {
+        if (CPU_ISSET_S(cpu, setSize, set)) {
+          cpus.push_back(cpu);
+        }
+      }
+      CPU_FREE(set);
+      break;
+    }
+    CPU_FREE(set);
+  }
+#endif
+  return cpus;
+}
+
+std::vector<int> ThreadAffinity::parseCpuList(const std::string& list) {
+  std::vector<int> cpus;
+  const char* p = list.c_str();
+  while (*p != '\0' && !std::isspace(static_cast<unsigned char>(*p))) {
+    if (!std::isdigit(static_cast<unsigned char>(*p))) {
+      return std::vector<int>();
+    }
+    char* end;
+    long first = std::strtol(p, &end, 10);
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      ++p;
+      if (!std::isdigit(static_cast<unsigned char>(*p))) {
+        return std::vector<int>();
+      }
+      last = std::strtol(p, &end, 10);
+      p = end;
+    }
+    if (last < first || last > 65535) {
+      return std::vector<int>();
+    }
+    for (long cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(static_cast<int>(cpu));
+    }
+    if (*p == ',') {
+      ++p;
+    } else if (*p != '\0' && !std::isspace(static_cast<unsigned char>(*p))) {
+      return std::vector<int>();
+    }
+  }
+  return cpus;
+}
+}
+}
+} // apache::thrift::concurrency
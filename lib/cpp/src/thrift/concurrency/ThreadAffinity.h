@@ -0,0 +1,103 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_CONCURRENCY_THREADAFFINITY_H_
+#define _THRIFT_CONCURRENCY_THREADAFFINITY_H_ 1
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace concurrency {
+
+/**
+ * The CPUs that the threads of a ThreadFactory may run on.
+ *
+ * Linux puts the memory a thread touches first on the NUMA node of the CPU
+ * it runs on, so keeping a thread on the CPUs of one node also keeps what
+ * it allocates on that node.  Affinity is only supported on Linux; elsewhere
+ * threads run wherever the scheduler puts them.
+ */
+class ThreadAffinity {
+public:
+  enum Policy {
+    /// Every thread may run on any of the CPUs
+    SHARED,
+    /// Each thread is pinned to a single one of the CPUs, taking them in turn
+    ROUND_ROBIN
+  };
+
+  /// No restriction, the default
+  ThreadAffinity() : policy_(SHARED) {}
+
+  ThreadAffinity(std::vector<int> cpus, Policy policy = SHARED)
+    : cpus_(std::move(cpus)), policy_(policy) {}
+
+  /**
+   * The CPUs of NUMA node \p node.  Without a known topology, or for a node
+   * that does not exist, threads are not restricted.
+   */
+  static ThreadAffinity node(int node, Policy policy = SHARED);
+
+  /// Whether threads are restricted at all
+  bool isSet() const { return !cpus_.empty(); }
+
+  const std::vector<int>& getCpus() const { return cpus_; }
+
+  Policy getPolicy() const { return policy_; }
+
+  /// The CPUs of the \p index th thread created, empty for any
+  std::vector<int> cpusFor(size_t index) const;
+
+  /// The NUMA nodes of this host; just node 0 when the topology is unknown
+  static std::vector<int> numaNodes();
+
+  /// The CPUs of NUMA node \p node, empty when unknown
+  static std::vector<int> nodeCpus(int node);
+
+  /// The NUMA node of \p cpu, or -1 when unknown
+  static int cpuNode(int cpu);
+
+  /**
+   * Restricts the calling thread to \p cpus, or lifts any restriction if
+   * empty.  Returns false if that is not supported or fails.
+   */
+  static bool setCurrentThreadCpus(const std::vector<int>& cpus);
+
+  /// The CPUs the calling thread may run on, empty when unknown
+  static std::vector<int> getCurrentThreadCpus();
+
+  /**
+   * Parses a CPU list in the kernel's format, such as "0-3,8,10-11".
+   * Returns an empty list if \p list is malformed.
+   */
+  static std::vector<int> parseCpuList(const std::string& list);
+
+private:
+  std::vector<int> cpus_;
+  Policy policy_;
+};
+}
+}
+} // apache::thrift::concurrency
+
+#endif // #ifndef _THRIFT_CONCURRENCY_THREADAFFINITY_H_
@@ -28,6 +28,9 @@ namespace concurrency {
 
 std::shared_ptr<Thread> ThreadFactory::newThread(std::shared_ptr<Runnable> runnable) const {
   std::shared_ptr<Thread> result = std::make_shared<Thread>(isDetached(), runnable);
+  if (affinity_.isSet()) {
+    result->setCpus(affinity_.cpusFor(threadsCreated_++));
+  }
   runnable->thread(result);
   return result;
 }
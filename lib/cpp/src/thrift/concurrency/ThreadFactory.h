@@ -21,7 +21,9 @@
 #define _THRIFT_CONCURRENCY_THREADFACTORY_H_ 1
 
 #include <thrift/concurrency/Thread.h>
+#include <thrift/concurrency/ThreadAffinity.h>
 
+#include <atomic>
 #include <memory>
 namespace apache {
 namespace thrift {
@@ -41,7 +43,19 @@ public:
    *
    * By default threads are not joinable.
    */
-  ThreadFactory(bool detached = true) : detached_(detached) { }
+  ThreadFactory(bool detached = true) : detached_(detached), threadsCreated_(0) { }
+
+  ThreadFactory(const ThreadFactory& other)
+    : detached_(other.detached_),
+      affinity_(other.affinity_),
+      threadsCreated_(other.threadsCreated_.load()) {}
+
+  ThreadFactory& operator=(const ThreadFactory& other) {
+    detached_ = other.detached_;
+    affinity_ = other.affinity_;
+    threadsCreated_ = other.threadsCreated_.load();
+    return *this;
+  }
 
   virtual ~ThreadFactory() = default;
 
@@ -55,6 +69,15 @@ public:
    */
   void setDetached(bool detached) { detached_ = detached; }
 
+  /**
+   * Sets the CPUs that newly created threads run on, for instance those of
+   * one NUMA node with ThreadAffinity::node().  With the ROUND_ROBIN policy
+   * each thread is pinned to the next CPU in turn.
+   */
+  void setAffinity(const ThreadAffinity& affinity) { affinity_ = affinity; }
+
+  const ThreadAffinity& getAffinity() const { return affinity_; }
+
   /**
    * Create a new thread.
    */
@@ -67,6 +90,8 @@ public:
 
 private:
   bool detached_;
+  ThreadAffinity affinity_;
+  mutable std::atomic<size_t> threadsCreated_;
 };
 
 }
@@ -60,6 +60,7 @@ public:
       pendingTaskCountMax_(0),
       expiredCount_(0),
       state_(ThreadManager::UNINITIALIZED),
+      tasks_(std::make_shared<FifoTaskQueue>()),
       monitor_(&mutex_),
       maxMonitor_(&mutex_),
       workerMonitor_(&mutex_) {}
@@ -84,6 +85,22 @@ public:
     threadFactory_ = value;
   }
 
+  shared_ptr<TaskQueue> taskQueue() const override {
+    Guard g(mutex_);
+    return tasks_;
+  }
+
+  void taskQueue(shared_ptr<TaskQueue> value) override {
+    if (!value) {
+      throw InvalidArgumentException();
+    }
+    Guard g(mutex_);
+    if (!tasks_->empty()) {
+      throw IllegalStateException("ThreadManager::Impl::taskQueue tasks are pending");
+    }
+    tasks_ = value;
+  }
+
   void addWorker(size_t value) override;
 
   void removeWorker(size_t value) override;
@@ -97,12 +114,12 @@ public:
 
   size_t pendingTaskCount() const override {
     Guard g(mutex_);
-    return tasks_.size();
+    return tasks_->size();
   }
 
   size_t totalTaskCount() const override {
     Guard g(mutex_);
-    return tasks_.size() + workerCount_ - idleCount_;
+    return tasks_->size() + workerCount_ - idleCount_;
   }
 
   size_t pendingTaskCountMax() const override {
@@ -120,7 +137,14 @@ public:
     pendingTaskCountMax_ = value;
   }
 
-  void add(shared_ptr<Runnable> value, int64_t timeout, int64_t expiration) override;
+  void add(shared_ptr<Runnable> value, int64_t timeout, int64_t expiration) override {
+    add(value, TaskClass(), timeout, expiration);
+  }
+
+  void add(shared_ptr<Runnable> value,
+           const TaskClass& taskClass,
+           int64_t timeout,
+           int64_t expiration) override;
 
   void remove(shared_ptr<Runnable> task) override;
 
@@ -162,8 +186,8 @@ private:
   shared_ptr<ThreadFactory> threadFactory_;
 
   friend class ThreadManager::Task;
-  typedef std::deque<shared_ptr<Task> > TaskQueue;
-  TaskQueue tasks_;
+  // Holds ThreadManager::Task objects only
+  shared_ptr<TaskQueue> tasks_;
   Mutex mutex_;
   Monitor monitor_;
   Monitor maxMonitor_;
@@ -219,7 +243,7 @@ public:
 private:
   bool isActive() const {
     return (manager_->workerCount_ <= manager_->workerMaxCount_)
-           || (manager_->state_ == JOINING && !manager_->tasks_.empty());
+           || (manager_->state_ == JOINING && !manager_->tasks_->empty());
   }
 
 public:
@@ -266,7 +290,7 @@ public:
         */
       active = isActive();
 
-      while (active && manager_->tasks_.empty()) {
+      while (active && manager_->tasks_->empty()) {
         manager_->idleCount_++;
         manager_->monitor_.wait();
         active = isActive();
@@ -276,9 +300,8 @@ public:
       shared_ptr<ThreadManager::Task> task;
 
       if (active) {
-        if (!manager_->tasks_.empty()) {
-          task = manager_->tasks_.front();
-          manager_->tasks_.pop_front();
+        task = std::static_pointer_cast<ThreadManager::Task>(manager_->tasks_->pop());
+        if (task) {
           if (task->state_ == ThreadManager::Task::WAITING) {
             // If the state is changed to anything other than EXECUTING or TIMEDOUT here
             // then the execution loop needs to be changed below.
@@ -292,7 +315,7 @@ public:
         /* If we have a pending task max and we just dropped below it, wakeup any
             thread that might be blocked on add. */
         if (manager_->pendingTaskCountMax_ != 0
-            && manager_->tasks_.size() <= manager_->pendingTaskCountMax_ - 1) {
+            && manager_->tasks_->size() <= manager_->pendingTaskCountMax_ - 1) {
           manager_->maxMonitor_.notify();
         }
       }
@@ -450,7 +473,10 @@ bool ThreadManager::Impl::canSleep() const {
   return idMap_.find(id) == idMap_.end();
 }
 
-void ThreadManager::Impl::add(shared_ptr<Runnable> value, int64_t timeout, int64_t expiration) {
+void ThreadManager::Impl::add(shared_ptr<Runnable> value,
+                              const TaskClass& taskClass,
+                              int64_t timeout,
+                              int64_t expiration) {
   Guard g(mutex_, timeout);
 
   if (!g) {
@@ -464,13 +490,13 @@ void ThreadManager::Impl::add(shared_ptr<Runnable> value, int64_t timeout, int64
   }
 
   // if we're at a limit, remove an expired task to see if the limit clears
-  if (pendingTaskCountMax_ > 0 && (tasks_.size() >= pendingTaskCountMax_)) {
+  if (pendingTaskCountMax_ > 0 && (tasks_->size() >= pendingTaskCountMax_)) {
     removeExpired(true);
   }
 
-  if (pendingTaskCountMax_ > 0 && (tasks_.size() >= pendingTaskCountMax_)) {
+  if (pendingTaskCountMax_ > 0 && (tasks_->size() >= pendingTaskCountMax_)) {
     if (canSleep() && timeout >= 0) {
-      while (pendingTaskCountMax_ > 0 && tasks_.size() >= pendingTaskCountMax_) {
+      while (pendingTaskCountMax_ > 0 && tasks_->size() >= pendingTaskCountMax_) {
         // This is thread safe because the mutex is shared between monitors.
         maxMonitor_.wait(timeout);
       }
@@ -479,7 +505,7 @@ void ThreadManager::Impl::add(shared_ptr<Runnable> value, int64_t timeout, int64
     }
   }
 
-  tasks_.push_back(std::make_shared<ThreadManager::Task>(value, expiration));
+  tasks_->push(std::make_shared<ThreadManager::Task>(value, expiration), taskClass);
 
   // If idle thread is available notify it, otherwise all worker threads are
   // running and will get around to this task in time.
@@ -496,14 +522,11 @@ void ThreadManager::Impl::remove(shared_ptr<Runnable> task) {
         "started");
   }
 
-  for (auto it = tasks_.begin(); it != tasks_.end(); ++it)
-  {
-    if ((*it)->getRunnable() == task)
-    {
-      tasks_.erase(it);
-      return;
-    }
-  }
+  tasks_->removeIf(
+      [&task](const shared_ptr<Runnable>& pending) {
+        return static_cast<ThreadManager::Task*>(pending.get())->getRunnable() == task;
+      },
+      true);
 }
 
 std::shared_ptr<Runnable> ThreadManager::Impl::removeNextPending() {
@@ -514,39 +537,33 @@ std::shared_ptr<Runnable> ThreadManager::Impl::removeNextPending() {
         "ThreadManager not started");
   }
 
-  if (tasks_.empty()) {
+  shared_ptr<Runnable> task = tasks_->pop();
+  if (!task) {
     return std::shared_ptr<Runnable>();
   }
 
-  shared_ptr<ThreadManager::Task> task = tasks_.front();
-  tasks_.pop_front();
-
-  return task->getRunnable();
+  return static_cast<ThreadManager::Task*>(task.get())->getRunnable();
 }
 
 void ThreadManager::Impl::removeExpired(bool justOne) {
   // this is always called under a lock
-  if (tasks_.empty()) {
+  if (tasks_->empty()) {
     return;
   }
   auto now = std::chrono::steady_clock::now();
 
-  for (auto it = tasks_.begin(); it != tasks_.end(); )
-  {
-    if ((*it)->getExpireTime() && *((*it)->getExpireTime()) < now) {
-      if (expireCallback_) {
-        expireCallback_((*it)->getRunnable());
-      }
-      it = tasks_.erase(it);
-      ++expiredCount_;
-      if (justOne) {
-        return;
-      }
-    }
-    else
-    {
-      ++it;
+  std::vector<shared_ptr<Runnable> > expired = tasks_->removeIf(
+      [now](const shared_ptr<Runnable>& pending) {
+        const auto& expireTime = static_cast<ThreadManager::Task*>(pending.get())->getExpireTime();
+        return expireTime && *expireTime < now;
+      },
+      justOne);
+
+  for (const auto& task : expired) {
+    if (expireCallback_) {
+      expireCallback_(static_cast<ThreadManager::Task*>(task.get())->getRunnable());
     }
+    ++expiredCount_;
   }
 }
 
@@ -22,6 +22,7 @@
 
 #include <functional>
 #include <memory>
+#include <thrift/concurrency/TaskQueue.h>
 #include <thrift/concurrency/ThreadFactory.h>
 
 namespace apache {
@@ -96,6 +97,20 @@ public:
    */
   virtual void threadFactory(std::shared_ptr<ThreadFactory> value) = 0;
 
+  /**
+   * \returns the queue of pending tasks
+   */
+  virtual std::shared_ptr<TaskQueue> taskQueue() const = 0;
+
+  /**
+   * Set the queue that orders pending tasks, e.g. a FairTaskQueue to
+   * schedule tasks by their TaskClass.  The default runs tasks in the order
+   * they were added.
+   * \throws InvalidArgumentException if value is empty
+   * \throws IllegalStateException if tasks are pending
+   */
+  virtual void taskQueue(std::shared_ptr<TaskQueue> value) = 0;
+
   /**
    * Adds worker thread(s).
    */
@@ -165,6 +180,15 @@ public:
                    int64_t timeout = 0LL,
                    int64_t expiration = 0LL) = 0;
 
+  /**
+   * Adds a task of the given class; see taskQueue().  Otherwise the same as
+   * add() above, which uses the default TaskClass.
+   */
+  virtual void add(std::shared_ptr<Runnable> task,
+                   const TaskClass& taskClass,
+                   int64_t timeout = 0LL,
+                   int64_t expiration = 0LL) = 0;
+
   /**
    * Removes a pending task
    */
@@ -0,0 +1,140 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/processor/TAllocTrackingEventHandler.h>
+
+using apache::thrift::concurrency::Guard;
+
+namespace apache {
+namespace thrift {
+namespace processor {
+
+/**
+ * Per-call context.  It is allocated in getContext() and released in
+ * freeContext(), both outside of the measured phases.
+ */
+struct TAllocTrackingEventHandler::Call {
+  Call() : phase(T_ALLOC_PHASES) {}
+
+  void begin(TAllocPhase next) {
+    end();
+    phase = next;
+    mark = TAllocTracker::current();
+  }
+
+  void end() {
+    if (phase != T_ALLOC_PHASES) {
+      phases[phase] += TAllocTracker::current() - mark;
+      phase = T_ALLOC_PHASES;
+    }
+  }
+
+  TAllocPhase phase;
+  TAllocCounts mark;
+  TAllocCounts phases[T_ALLOC_PHASES];
+};
+
+void TAllocTrackingEventHandler::setBudget(const std::string& method, uint64_t maxAllocations) {
+  Guard g(mutex_);
+  budgets_[method] = maxAllocations;
+}
+
+void TAllocTrackingEventHandler::setBudgetCallback(const BudgetCallback& callback) {
+  Guard g(mutex_);
+  budgetCallback_ = callback;
+}
+
+TAllocTrackingEventHandler::stats_t TAllocTrackingEventHandler::getStats() const {
+  Guard g(mutex_);
+  return stats_;
+}
+
+void TAllocTrackingEventHandler::reset() {
+  Guard g(mutex_);
+  stats_.clear();
+}
+
+void* TAllocTrackingEventHandler::getContext(const char*, void*) {
+  return new Call();
+}
+
+void TAllocTrackingEventHandler::freeContext(void* ctx, const char* fn_name) {
+  Call* call = static_cast<Call*>(ctx);
+  if (call == nullptr) {
+    return;
+  }
+  call->end();
+
+  TAllocCounts perCall;
+  for (int i = 0; i < T_ALLOC_PHASES; ++i) {
+    perCall += call->phases[i];
+  }
+
+  BudgetCallback callback;
+  {
+    Guard g(mutex_);
+    TAllocMethodStats& stats = stats_[fn_name];
+    ++stats.calls;
+    for (int i = 0; i < T_ALLOC_PHASES; ++i) {
+      stats.phases[i] += call->phases[i];
+    }
+
+    auto budget = budgets_.find(fn_name);
+    if (budget == budgets_.end()) {
+      budget = budgets_.find(std::string());
+    }
+    if (budget != budgets_.end() && perCall.allocations > budget->second) {
+      ++stats.overBudget;
+      callback = budgetCallback_;
+    }
+  }
+  delete call;
+
+  if (callback) {
+    callback(fn_name, perCall);
+  }
+}
+
+void TAllocTrackingEventHandler::preRead(void* ctx, const char*) {
+  static_cast<Call*>(ctx)->begin(T_ALLOC_READ);
+}
+
+void TAllocTrackingEventHandler::postRead(void* ctx, const char*, uint32_t) {
+  static_cast<Call*>(ctx)->begin(T_ALLOC_DISPATCH);
+}
+
+void TAllocTrackingEventHandler::preWrite(void* ctx, const char*) {
+  static_cast<Call*>(ctx)->begin(T_ALLOC_WRITE);
+}
+
+void TAllocTrackingEventHandler::postWrite(void* ctx, const char*, uint32_t) {
+  static_cast<Call*>(ctx)->end();
+}
+
+void TAllocTrackingEventHandler::asyncComplete(void* ctx, const char*) {
+  static_cast<Call*>(ctx)->end();
+}
+
+void TAllocTrackingEventHandler::handlerError(void* ctx, const char*) {
+  // The exception reply that follows is written without preWrite()
+  static_cast<Call*>(ctx)->begin(T_ALLOC_WRITE);
+}
+}
+}
+} // apache::thrift::processor
@@ -0,0 +1,125 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROCESSOR_TALLOCTRACKINGEVENTHANDLER_H_
+#define _THRIFT_PROCESSOR_TALLOCTRACKINGEVENTHANDLER_H_ 1
+
+#include <functional>
+#include <map>
+#include <string>
+#include <thrift/TAllocTracker.h>
+#include <thrift/TProcessor.h>
+#include <thrift/concurrency/Mutex.h>
+
+namespace apache {
+namespace thrift {
+namespace processor {
+
+/**
+ * The phases of a call that allocations are attributed to.
+ */
+enum TAllocPhase {
+  T_ALLOC_READ = 0,     // preRead() .. postRead(): argument deserialization
+  T_ALLOC_DISPATCH = 1, // postRead() .. preWrite(): the handler
+  T_ALLOC_WRITE = 2,    // preWrite() .. postWrite(): result serialization
+  T_ALLOC_PHASES = 3
+};
+
+/**
+ * Aggregated allocations of one method.
+ */
+struct TAllocMethodStats {
+  TAllocMethodStats() : calls(0), overBudget(0) {}
+
+  TAllocCounts total() const {
+    TAllocCounts sum;
+    for (int i = 0; i < T_ALLOC_PHASES; ++i) {
+      sum += phases[i];
+    }
+    return sum;
+  }
+
+  uint64_t calls;
+  // Calls that made more allocations than the method's budget
+  uint64_t overBudget;
+  TAllocCounts phases[T_ALLOC_PHASES];
+};
+
+/**
+ * Processor event handler that attributes heap allocations to the read,
+ * dispatch and write phase of every method, using TAllocTracker's
+ * per-thread counters.  Install it with TProcessor::setEventHandler().
+ *
+ * Counts are only non-zero when the library is built with
+ * THRIFT_ALLOC_TRACKING and the program includes <thrift/TAllocTrackerNew.h>;
+ * see TAllocTracker.  Calls whose phases run on
+ * different threads (asynchronous processors) are not attributed correctly.
+ *
+ * Allocation budgets can be set per method (or as a default for all
+ * methods); calls exceeding their budget are counted in
+ * TAllocMethodStats::overBudget and reported to the budget callback, which
+ * makes it possible to fail CI benchmarks on allocation regressions.
+ */
+class TAllocTrackingEventHandler : public TProcessorEventHandler {
+public:
+  typedef std::map<std::string, TAllocMethodStats> stats_t;
+  typedef std::function<void(const std::string& method, const TAllocCounts& perCall)>
+      BudgetCallback;
+
+  TAllocTrackingEventHandler() = default;
+
+  /**
+   * Limit the allocations of a single call of \p method (named
+   * "Service.method", as passed to the event handler).  An empty name sets
+   * the default for methods without a budget of their own.
+   */
+  void setBudget(const std::string& method, uint64_t maxAllocations);
+
+  /**
+   * Called, outside of any lock, for every call that exceeds its budget.
+   */
+  void setBudgetCallback(const BudgetCallback& callback);
+
+  /** Snapshot of the statistics collected so far, keyed by method. */
+  stats_t getStats() const;
+
+  void reset();
+
+  void* getContext(const char* fn_name, void* serverContext) override;
+  void freeContext(void* ctx, const char* fn_name) override;
+  void preRead(void* ctx, const char* fn_name) override;
+  void postRead(void* ctx, const char* fn_name, uint32_t bytes) override;
+  void preWrite(void* ctx, const char* fn_name) override;
+  void postWrite(void* ctx, const char* fn_name, uint32_t bytes) override;
+  void asyncComplete(void* ctx, const char* fn_name) override;
+  void handlerError(void* ctx, const char* fn_name) override;
+
+private:
+  struct Call;
+
+  mutable concurrency::Mutex mutex_;
+  stats_t stats_;
+  std::map<std::string, uint64_t> budgets_;
+  BudgetCallback budgetCallback_;
+};
+}
+}
+} // apache::thrift::processor
+
+#endif // #ifndef _THRIFT_PROCESSOR_TALLOCTRACKINGEVENTHANDLER_H_
@@ -0,0 +1,113 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROCESSOR_TCONCURRENCYLIMITPROCESSOR_H_
+#define _THRIFT_PROCESSOR_TCONCURRENCYLIMITPROCESSOR_H_ 1
+
+#include <chrono>
+#include <memory>
+#include <thrift/TDeadline.h>
+#include <thrift/TDispatchProcessor.h>
+#include <thrift/processor/TMultiplexedProcessor.h>
+#include <thrift/server/TConcurrencyLimiter.h>
+
+namespace apache {
+namespace thrift {
+namespace processor {
+
+/**
+ * Wraps a processor so that calls beyond the limit of a TConcurrencyLimiter
+ * are rejected with a TApplicationException rather than dispatched, and
+ * feeds the handler latency of admitted calls back into the limiter.
+ *
+ * The limiter is typically shared by all connections of a server; see
+ * TServerFramework::setConcurrencyLimiter().
+ */
+class TConcurrencyLimitProcessor : public TProcessor {
+public:
+  TConcurrencyLimitProcessor(std::shared_ptr<TProcessor> processor,
+                             std::shared_ptr<server::TConcurrencyLimiter> limiter)
+    : processor_(processor), limiter_(limiter) {}
+
+  bool process(std::shared_ptr<protocol::TProtocol> in,
+               std::shared_ptr<protocol::TProtocol> out,
+               void* connectionContext) override {
+    TDeadlineScope deadlineScope;
+
+    std::string fname;
+    protocol::TMessageType mtype;
+    int32_t seqid;
+    in->readMessageBegin(fname, mtype, seqid);
+    return dispatchMessage(in, out, fname, mtype, seqid, connectionContext);
+  }
+
+  bool canDispatchMessage() const override {
+    return typeid(*this) == typeid(TConcurrencyLimitProcessor);
+  }
+
+  bool dispatchMessage(std::shared_ptr<protocol::TProtocol> in,
+                       std::shared_ptr<protocol::TProtocol> out,
+                       const std::string& fname,
+                       protocol::TMessageType mtype,
+                       int32_t seqid,
+                       void* connectionContext) override {
+    if (!limiter_->tryAcquire()) {
+      rejectCall(in.get(),
+                 out.get(),
+                 fname,
+                 mtype,
+                 seqid,
+                 "Server overloaded, rejected call to " + fname);
+      return true;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool result;
+    try {
+      if (processor_->canDispatchMessage()) {
+        result = processor_->dispatchMessage(in, out, fname, mtype, seqid, connectionContext);
+      } else {
+        result = processor_->process(std::make_shared<protocol::StoredMessageProtocol>(in,
+                                                                                      fname,
+                                                                                      mtype,
+                                                                                      seqid),
+                                     out,
+                                     connectionContext);
+      }
+    } catch (...) {
+      limiter_->release(std::chrono::steady_clock::now() - start, true);
+      throw;
+    }
+    limiter_->release(std::chrono::steady_clock::now() - start);
+    return result;
+  }
+
+  std::shared_ptr<TProcessor> getProcessor() const { return processor_; }
+
+  std::shared_ptr<server::TConcurrencyLimiter> getLimiter() const { return limiter_; }
+
+private:
+  std::shared_ptr<TProcessor> processor_;
+  std::shared_ptr<server::TConcurrencyLimiter> limiter_;
+};
+}
+}
+} // apache::thrift::processor
+
+#endif // #ifndef _THRIFT_PROCESSOR_TCONCURRENCYLIMITPROCESSOR_H_
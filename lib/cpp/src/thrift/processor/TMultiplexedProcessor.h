@@ -22,8 +22,10 @@
 
 #include <thrift/protocol/TProtocolDecorator.h>
 #include <thrift/TApplicationException.h>
+#include <thrift/TDeadline.h>
 #include <thrift/TProcessor.h>
-#include <boost/tokenizer.hpp>
+#include <string>
+#include <unordered_map>
 
 namespace apache {
 namespace thrift {
@@ -51,6 +53,25 @@ public:
     return 0; // (Normal TProtocol read functions return number of bytes read)
   }
 
+  /**
+   * Re-targets this instance at the next message so that one decorator can
+   * be reused rather than allocated per call.
+   */
+  void reset(std::shared_ptr<protocol::TProtocol> _protocol,
+             const std::string& _name,
+             const TMessageType _type,
+             const int32_t _seqid) {
+    setProtocol(std::move(_protocol));
+    name = _name;
+    type = _type;
+    seqid = _seqid;
+  }
+
+  /**
+   * Drops the reference to the wrapped protocol between messages.
+   */
+  void release() { setProtocol(std::shared_ptr<protocol::TProtocol>()); }
+
   std::string name;
   TMessageType type;
   int32_t seqid;
@@ -85,7 +106,7 @@ public:
  */
 class TMultiplexedProcessor : public TProcessor {
 public:
-  typedef std::map<std::string, std::shared_ptr<TProcessor> > services_t;
+  typedef std::unordered_map<std::string, std::shared_ptr<TProcessor> > services_t;
 
   /**
     * 'Register' a service with this <code>TMultiplexedProcessor</code>.  This
@@ -139,7 +160,9 @@ public:
    *     <li>Read the beginning of the message.</li>
    *     <li>Extract the service name from the message.</li>
    *     <li>Using the service name to locate the appropriate processor.</li>
-   *     <li>Dispatch to the processor, with a decorated instance of TProtocol
+   *     <li>Dispatch to the processor.  Processors that support
+   *         dispatchMessage() (all generated ones do) are handed the parsed
+   *         header directly; others get a decorated instance of TProtocol
    *         that allows readMessageBegin() to return the original TMessage.</li>
    * </ol>
    *
@@ -150,6 +173,9 @@ public:
   bool process(std::shared_ptr<protocol::TProtocol> in,
                std::shared_ptr<protocol::TProtocol> out,
                void* connectionContext) override {
+    // The deadline read with the message only applies to this call
+    TDeadlineScope deadlineScope;
+
     std::string name;
     protocol::TMessageType type;
     int32_t seqid;
@@ -164,41 +190,57 @@ public:
       throw protocol_error(in, out, name, seqid, "Unexpected message type");
     }
 
-    // Extract the service name
-    boost::tokenizer<boost::char_separator<char> > tok(name, boost::char_separator<char>(":"));
-
-    std::vector<std::string> tokens;
-    std::copy(tok.begin(), tok.end(), std::back_inserter(tokens));
+    // Extract the service name.  Like a tokenizer splitting on ':', empty
+    // tokens are skipped; only the positions of the first two are kept so
+    // that nothing is allocated.
+    std::string::size_type begin[2] = {0, 0};
+    std::string::size_type end[2] = {0, 0};
+    size_t tokens = 0;
+    for (std::string::size_type pos = 0; pos < name.size();) {
+      if (name[pos] == ':') {
+        ++pos;
+        continue;
+      }
+      std::string::size_type stop = name.find(':', pos);
+      if (stop == std::string::npos) {
+        stop = name.size();
+      }
+      if (tokens < 2) {
+        begin[tokens] = pos;
+        end[tokens] = stop;
+      }
+      ++tokens;
+      pos = stop;
+    }
 
     // A valid message should consist of two tokens: the service
     // name and the name of the method to call.
-    if (tokens.size() == 2) {
-      // Search for a processor associated with this service name.
-      auto it = services.find(tokens[0]);
+    if (tokens == 2) {
+      // Search for a processor associated with this service name.  The key
+      // buffer is per thread, so lookups stop allocating once it has grown
+      // to fit the longest service name.
+      std::string& key = scratch().key;
+      key.assign(name, begin[0], end[0] - begin[0]);
+      auto it = services.find(key);
 
       if (it != services.end()) {
-        std::shared_ptr<TProcessor> processor = it->second;
         // Let the processor registered for this service name
         // process the message.
-        return processor
-            ->process(std::shared_ptr<protocol::TProtocol>(
-                          new protocol::StoredMessageProtocol(in, tokens[1], type, seqid)),
-                      out,
-                      connectionContext);
+        name.resize(end[1]);
+        name.erase(0, begin[1]);
+        return dispatch(it->second, in, out, name, type, seqid, connectionContext);
       } else {
         // Unknown service.
         throw protocol_error(in, out, name, seqid, 
-            "Unknown service: " + tokens[0] +
+            "Unknown service: " + key +
 				". Did you forget to call registerProcessor()?");
       }
-    } else if (tokens.size() == 1) {
+    } else if (tokens == 1) {
 	  if (defaultProcessor) {
         // non-multiplexed client forwards to default processor
-        return defaultProcessor            
-            ->process(std::shared_ptr<protocol::TProtocol>(
-                          new protocol::StoredMessageProtocol(in, tokens[0], type, seqid)),
-                      out,
-                      connectionContext);
+        name.resize(end[0]);
+        name.erase(0, begin[0]);
+        return dispatch(defaultProcessor, in, out, name, type, seqid, connectionContext);
 	  } else {
 		throw protocol_error(in, out, name, seqid,
 			"Non-multiplexed client request dropped. "
@@ -211,6 +253,54 @@ public:
   }
 
 private:
+  /**
+   * Per-thread state reused across messages: the service name lookup key
+   * and a StoredMessageProtocol for processors without dispatchMessage().
+   */
+  struct Scratch {
+    std::string key;
+    std::shared_ptr<protocol::StoredMessageProtocol> stored;
+  };
+
+  static Scratch& scratch() {
+    static thread_local Scratch s;
+    return s;
+  }
+
+  static bool dispatch(const std::shared_ptr<TProcessor>& processor,
+                       const std::shared_ptr<protocol::TProtocol>& in,
+                       const std::shared_ptr<protocol::TProtocol>& out,
+                       const std::string& name,
+                       protocol::TMessageType type,
+                       int32_t seqid,
+                       void* connectionContext) {
+    if (processor->canDispatchMessage()) {
+      return processor->dispatchMessage(in, out, name, type, seqid, connectionContext);
+    }
+
+    // Reuse this thread's decorator unless someone else still holds it,
+    // e.g. a nested TMultiplexedProcessor or a processor that kept it.
+    std::shared_ptr<protocol::StoredMessageProtocol> stored = scratch().stored;
+    if (stored && stored.use_count() == 2) {
+      stored->reset(in, name, type, seqid);
+    } else {
+      stored = std::make_shared<protocol::StoredMessageProtocol>(in, name, type, seqid);
+      scratch().stored = stored;
+    }
+
+    // Don't keep the connection's protocol alive once the call is done.
+    struct Releaser {
+      std::shared_ptr<protocol::StoredMessageProtocol>& stored;
+      ~Releaser() {
+        if (stored.use_count() == 2) {
+          stored->release();
+        }
+      }
+    } releaser{stored};
+
+    return processor->process(stored, out, connectionContext);
+  }
+
   /** Map of service processor objects, indexed by service names. */
   services_t services;
   
@@ -38,6 +38,30 @@ void base64_encode(const uint8_t* in, uint32_t len, uint8_t* buf);
 // len is number of bytes to consume from input (must be 2, 3, or 4)
 // no '=' padding should be included in the input
 void base64_decode(uint8_t* buf, uint32_t len);
+
+// Number of characters base64_encode_buffer() produces for len input bytes
+inline uint32_t base64_encoded_size(uint32_t len) {
+  return (len / 3) * 4 + (len % 3 == 0 ? 0 : len % 3 + 1);
+}
+
+// Whole-buffer versions of the functions above, for large values.  They use
+// SSSE3 or AVX2 when the CPU has them, chosen at runtime, and otherwise the
+// same tables as base64_encode() and base64_decode().
+
+// encodes all len bytes of in, which may be any length, into out
+// out must have room for base64_encoded_size(len) bytes and may not overlap in
+// the output is not padded with '='; the caller can do this if desired
+// returns the number of bytes written to out, base64_encoded_size(len)
+uint32_t base64_encode_buffer(const uint8_t* in, uint32_t len, uint8_t* out);
+
+// out must have room for len * 3 / 4 bytes; it may be the same buffer as in
+// (decoding in place) but may not otherwise overlap it
+// no '=' padding should be included in the input; a single leftover
+// character, which cannot encode a whole byte, is ignored
+// as with base64_decode(), characters outside the base64 alphabet are not
+// rejected, and decode to the same garbage they would there
+// returns the number of bytes written to out
+uint32_t base64_decode_buffer(const uint8_t* in, uint32_t len, uint8_t* out);
 }
 }
 } // apache::thrift::protocol
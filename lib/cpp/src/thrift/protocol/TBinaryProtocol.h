@@ -22,6 +22,7 @@
 
 #include <thrift/protocol/TProtocol.h>
 #include <thrift/protocol/TVirtualProtocol.h>
+#include <thrift/protocol/TSerializedSize.h>
 
 #include <memory>
 
@@ -119,6 +120,8 @@ public:
 
   inline uint32_t writeBinary(const std::string& str);
 
+  inline uint32_t writeBinary(const TInlineString& str);
+
   inline uint32_t writeUUID(const TUuid& uuid);
 
   /**
@@ -168,8 +171,22 @@ public:
 
   inline uint32_t readBinary(std::string& str);
 
+  inline uint32_t readBinary(TInlineString& str);
+
   inline uint32_t readUUID(TUuid& uuid);
 
+  /*
+   * Strings and binaries share an encoding, so TInlineString values are
+   * handled by the same templates as std::string.
+   */
+  uint32_t writeInlineString_virt(const TInlineString& str) override { return writeString(str); }
+
+  uint32_t writeInlineBinary_virt(const TInlineString& str) override { return writeString(str); }
+
+  uint32_t readInlineString_virt(TInlineString& str) override { return readString(str); }
+
+  uint32_t readInlineBinary_virt(TInlineString& str) override { return readString(str); }
+
   int getMinSerializedSize(TType type) override;
 
   void checkReadBytesAvailable(TSet& set) override
@@ -263,6 +280,11 @@ private:
 
 typedef TBinaryProtocolFactoryT<TTransport> TBinaryProtocolFactory;
 typedef TBinaryProtocolFactoryT<TTransport, TNetworkLittleEndian> TLEBinaryProtocolFactory;
+
+template <class Transport_, class ByteOrder_>
+struct TSerializedSizeTraits<TBinaryProtocolT<Transport_, ByteOrder_> > {
+  typedef TBinaryProtocolT<transport::TNullTransport, ByteOrder_> type;
+};
 }
 }
 } // apache::thrift::protocol
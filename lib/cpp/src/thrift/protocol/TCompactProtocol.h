@@ -21,6 +21,7 @@
 #define _THRIFT_PROTOCOL_TCOMPACTPROTOCOL_H_ 1
 
 #include <thrift/protocol/TVirtualProtocol.h>
+#include <thrift/protocol/TSerializedSize.h>
 
 #include <stack>
 #include <memory>
@@ -140,6 +141,10 @@ public:
 
   uint32_t writeBinary(const std::string& str);
 
+  uint32_t writeString(const TInlineString& str);
+
+  uint32_t writeBinary(const TInlineString& str);
+
   uint32_t writeUUID(const TUuid& str);
 
   int getMinSerializedSize(TType type) override;
@@ -176,6 +181,8 @@ protected:
                                   const int16_t fieldId,
                                   int8_t typeOverride);
   uint32_t writeCollectionBegin(const TType elemType, int32_t size);
+  template <typename StrType>
+  uint32_t writeBinaryBody(const StrType& str);
   uint32_t writeVarint32(uint32_t n);
   uint32_t writeVarint64(uint64_t n);
   uint64_t i64ToZigzag(const int64_t l);
@@ -215,8 +222,20 @@ public:
 
   uint32_t readBinary(std::string& str);
 
+  uint32_t readString(TInlineString& str);
+
+  uint32_t readBinary(TInlineString& str);
+
   uint32_t readUUID(TUuid& str);
 
+  uint32_t writeInlineString_virt(const TInlineString& str) override { return writeBinary(str); }
+
+  uint32_t writeInlineBinary_virt(const TInlineString& str) override { return writeBinary(str); }
+
+  uint32_t readInlineString_virt(TInlineString& str) override { return readBinary(str); }
+
+  uint32_t readInlineBinary_virt(TInlineString& str) override { return readBinary(str); }
+
   /*
    *These methods are here for the struct to call, but don't have any wire
    * encoding.
@@ -228,6 +247,9 @@ public:
   uint32_t readSetEnd() { return 0; }
 
 protected:
+  template <typename StrType>
+  uint32_t readBinaryBody(StrType& str);
+
   uint32_t readVarint32(int32_t& i32);
   uint32_t readVarint64(int64_t& i64);
   int32_t zigzagToI32(uint32_t n);
@@ -279,6 +301,11 @@ private:
 };
 
 typedef TCompactProtocolFactoryT<TTransport> TCompactProtocolFactory;
+
+template <class Transport_>
+struct TSerializedSizeTraits<TCompactProtocolT<Transport_> > {
+  typedef TCompactProtocolT<transport::TNullTransport> type;
+};
 }
 }
 } // apache::thrift::protocol
@@ -23,6 +23,7 @@
 #include <cstdlib>
 
 #include "thrift/config.h"
+#include <thrift/TAllocTracker.h>
 
 /*
  * TCompactProtocol::i*ToZigzag depend on the fact that the right shift
@@ -275,6 +276,22 @@ uint32_t TCompactProtocolT<Transport_>::writeString(const std::string& str) {
 
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::writeBinary(const std::string& str) {
+  return writeBinaryBody(str);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeString(const TInlineString& str) {
+  return writeBinaryBody(str);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeBinary(const TInlineString& str) {
+  return writeBinaryBody(str);
+}
+
+template <class Transport_>
+template <typename StrType>
+uint32_t TCompactProtocolT<Transport_>::writeBinaryBody(const StrType& str) {
   if(str.size() > (std::numeric_limits<uint32_t>::max)())
     throw TProtocolException(TProtocolException::SIZE_LIMIT);
   auto ssize = static_cast<uint32_t>(str.size());
@@ -694,6 +711,22 @@ uint32_t TCompactProtocolT<Transport_>::readString(std::string& str) {
  */
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::readBinary(std::string& str) {
+  return readBinaryBody(str);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readString(TInlineString& str) {
+  return readBinaryBody(str);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readBinary(TInlineString& str) {
+  return readBinaryBody(str);
+}
+
+template <class Transport_>
+template <typename StrType>
+uint32_t TCompactProtocolT<Transport_>::readBinaryBody(StrType& str) {
   int32_t rsize = 0;
   int32_t size;
 
@@ -712,11 +745,21 @@ uint32_t TCompactProtocolT<Transport_>::readBinary(std::string& str) {
     throw TProtocolException(TProtocolException::SIZE_LIMIT);
   }
 
+  // Try to borrow first, which avoids the copy through string_buf_
+  uint32_t got = static_cast<uint32_t>(size);
+  const uint8_t* borrow_buf = trans_->borrow(nullptr, &got);
+  if (borrow_buf) {
+    str.assign(reinterpret_cast<const char*>(borrow_buf), size);
+    trans_->consume(size);
+    return rsize + static_cast<uint32_t>(size);
+  }
+
   // Check against MaxMessageSize before alloc
   trans_->checkReadBytesAvailable(static_cast<uint32_t>(size));
 
   // Use the heap here to prevent stack overflow for v. large strings
   if (size > string_buf_size_ || string_buf_ == nullptr) {
+    TAllocTracker::recordMalloc(static_cast<uint32_t>(size));
     void* new_string_buf = std::realloc(string_buf_, static_cast<uint32_t>(size));
     if (new_string_buf == nullptr) {
       throw std::bad_alloc();
@@ -730,7 +773,6 @@ uint32_t TCompactProtocolT<Transport_>::readBinary(std::string& str) {
   return rsize + static_cast<uint32_t>(size);
 }
 
-
 /**
  * Read a TUuid from the wire.
  */
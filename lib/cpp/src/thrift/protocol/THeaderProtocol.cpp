@@ -23,7 +23,9 @@
 #include <thrift/protocol/TCompactProtocol.h>
 #include <thrift/protocol/TBinaryProtocol.h>
 #include <thrift/TApplicationException.h>
+#include <thrift/TDeadline.h>
 
+#include <cstdlib>
 #include <limits>
 
 #include <memory>
@@ -59,6 +61,14 @@ uint32_t THeaderProtocol::writeMessageBegin(const std::string& name,
                                             const int32_t seqId) {
   resetProtocol(); // Reset in case we changed protocols
   trans_->setSequenceNumber(seqId);
+
+  // Pass the deadline of the current call on to the server
+  if ((messageType == T_CALL || messageType == T_ONEWAY) && TDeadline::isSet()) {
+    THeaderTransport::StringToStringMap& headers = trans_->getWriteHeaders();
+    if (headers.find(TDeadline::HEADER) == headers.end()) {
+      headers[TDeadline::HEADER] = std::to_string(TDeadline::remaining().count());
+    }
+  }
   return proto_->writeMessageBegin(name, messageType, seqId);
 }
 
@@ -172,7 +182,27 @@ uint32_t THeaderProtocol::readMessageBegin(std::string& name,
     // connection pooling is used.
     throw ex;
   }
-  return proto_->readMessageBegin(name, messageType, seqId);
+  uint32_t result = proto_->readMessageBegin(name, messageType, seqId);
+
+  // Adopt the caller's deadline; it counts from when the request was received
+  if (messageType == T_CALL || messageType == T_ONEWAY) {
+    const THeaderTransport::StringToStringMap& headers = trans_->getHeaders();
+    if (!headers.empty()) {
+      auto it = headers.find(TDeadline::HEADER);
+      if (it != headers.end()) {
+        char* end;
+        long long timeout = std::strtoll(it->second.c_str(), &end, 10);
+        if (end != it->second.c_str() && *end == '\0') {
+          TDeadline::clock::time_point deadline
+              = TDeadline::after(TDeadline::received(), std::chrono::milliseconds(timeout));
+          if (deadline < TDeadline::get()) {
+            TDeadline::set(deadline);
+          }
+        }
+      }
+    }
+  }
+  return result;
 }
 
 uint32_t THeaderProtocol::readMessageEnd() {
@@ -185,6 +185,18 @@ public:
 
   uint32_t readUUID(TUuid& uuid);
 
+  uint32_t writeInlineString_virt(const TInlineString& str) override {
+    return proto_->writeString(str);
+  }
+
+  uint32_t writeInlineBinary_virt(const TInlineString& str) override {
+    return proto_->writeBinary(str);
+  }
+
+  uint32_t readInlineString_virt(TInlineString& str) override { return proto_->readString(str); }
+
+  uint32_t readInlineBinary_virt(TInlineString& str) override { return proto_->readBinary(str); }
+
 protected:
   std::shared_ptr<THeaderTransport> trans_;
 
@@ -21,12 +21,19 @@
 
 #include <boost/locale.hpp>
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <limits>
 #include <locale>
 #include <sstream>
 #include <stdexcept>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define THRIFT_JSON_SSE2 1
+#endif
+
 #include <thrift/protocol/TBase64Utils.h>
 #include <thrift/transport/TTransportException.h>
 #include <thrift/TToString.h>
@@ -49,8 +56,6 @@ static const uint8_t kJSONBackslash = '\\';
 static const uint8_t kJSONStringDelimiter = '"';
 static const uint8_t kJSONEscapeChar = 'u';
 
-static const std::string kJSONEscapePrefix("\\u00");
-
 static const uint32_t kThriftVersion1 = 1;
 
 static const std::string kThriftNan("NaN");
@@ -300,227 +305,249 @@ static bool isLowSurrogate(uint16_t val) {
   return val >= 0xDC00 && val <= 0xDFFF;
 }
 
-/**
- * Class to serve as base JSON context and as base class for other context
- * implementations
- */
-class TJSONContext {
-
-public:
-  TJSONContext() = default;
-
-  virtual ~TJSONContext() = default;
-
-  /**
-   * Write context data to the transport. Default is to do nothing.
-   */
-  virtual uint32_t write(TTransport& trans) {
-    (void)trans;
-    return 0;
-  };
-
-  /**
-   * Read context data from the transport. Default is to do nothing.
-   */
-  virtual uint32_t read(TJSONProtocol::LookaheadReader& reader) {
-    (void)reader;
-    return 0;
-  };
-
-  /**
-   * Return true if numbers need to be escaped as strings in this context.
-   * Default behavior is to return false.
-   */
-  virtual bool escapeNum() { return false; }
-};
-
-// Context class for object member key-value pairs
-class JSONPairContext : public TJSONContext {
-
-public:
-  JSONPairContext() : first_(true), colon_(true) {}
-
-  uint32_t write(TTransport& trans) override {
-    if (first_) {
-      first_ = false;
-      colon_ = true;
-      return 0;
-    } else {
-      trans.write(colon_ ? &kJSONPairSeparator : &kJSONElemSeparator, 1);
-      colon_ = !colon_;
-      return 1;
+// Return the length of the leading run of p that can go into a JSON string
+// as is, ie. that has no control characters, quotes or backslashes.  Most
+// strings are plain text, so whole blocks are checked at once and single
+// characters only looked at in a block that has something special in it.
+static uint32_t plainRunLength(const uint8_t* p, uint32_t len) {
+  uint32_t i = 0;
+#ifdef THRIFT_JSON_SSE2
+  const __m128i quote = _mm_set1_epi8(static_cast<char>(kJSONStringDelimiter));
+  const __m128i backslash = _mm_set1_epi8(static_cast<char>(kJSONBackslash));
+  const __m128i maxControl = _mm_set1_epi8(0x1f);
+  for (; i + 16 <= len; i += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    // max(c, 0x1f) == 0x1f exactly when c <= 0x1f, unsigned
+    __m128i special = _mm_cmpeq_epi8(_mm_max_epu8(block, maxControl), maxControl);
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(block, quote));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(block, backslash));
+    if (_mm_movemask_epi8(special) != 0) {
+      break;
     }
   }
-
-  uint32_t read(TJSONProtocol::LookaheadReader& reader) override {
-    if (first_) {
-      first_ = false;
-      colon_ = true;
-      return 0;
-    } else {
-      uint8_t ch = (colon_ ? kJSONPairSeparator : kJSONElemSeparator);
-      colon_ = !colon_;
-      return readSyntaxChar(reader, ch);
+#else
+  // Eight characters at a time, using the usual "has a byte less than n"
+  // bit trick on a 64-bit word
+  const uint64_t ones = 0x0101010101010101ULL;
+  const uint64_t highs = 0x8080808080808080ULL;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t block;
+    std::memcpy(&block, p + i, sizeof(block));
+    uint64_t quotes = block ^ (ones * kJSONStringDelimiter);
+    uint64_t backslashes = block ^ (ones * kJSONBackslash);
+    uint64_t special = ((block - ones * 0x20) & ~block) | ((quotes - ones) & ~quotes)
+                       | ((backslashes - ones) & ~backslashes);
+    if ((special & highs) != 0) {
+      break;
     }
   }
-
-  // Numbers must be turned into strings if they are the key part of a pair
-  bool escapeNum() override { return colon_; }
-
-private:
-  bool first_;
-  bool colon_;
-};
-
-// Context class for lists
-class JSONListContext : public TJSONContext {
-
-public:
-  JSONListContext() : first_(true) {}
-
-  uint32_t write(TTransport& trans) override {
-    if (first_) {
-      first_ = false;
-      return 0;
-    } else {
-      trans.write(&kJSONElemSeparator, 1);
-      return 1;
+#endif
+  for (; i < len; ++i) {
+    uint8_t ch = p[i];
+    if (ch < 0x20 || ch == kJSONStringDelimiter || ch == kJSONBackslash) {
+      break;
     }
   }
-
-  uint32_t read(TJSONProtocol::LookaheadReader& reader) override {
-    if (first_) {
-      first_ = false;
-      return 0;
-    } else {
-      return readSyntaxChar(reader, kJSONElemSeparator);
-    }
+  return i;
+}
+
+// Format num in decimal into buf, which must have room for 20 characters,
+// and return the number of characters written.
+static uint32_t formatJSONInteger(int64_t num, char* buf) {
+  char digits[20];
+  uint32_t n = 0;
+  uint64_t magnitude = num < 0 ? 0 - static_cast<uint64_t>(num) : static_cast<uint64_t>(num);
+  do {
+    digits[n++] = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+  uint32_t len = 0;
+  if (num < 0) {
+    buf[len++] = '-';
+  }
+  while (n > 0) {
+    buf[len++] = digits[--n];
   }
+  return len;
+}
 
-private:
-  bool first_;
-};
+uint8_t TJSONProtocol::JSONContext::next() {
+  if (kind == BASE) {
+    return 0;
+  }
+  if (first) {
+    first = false;
+    colon = true;
+    return 0;
+  }
+  if (kind == LIST) {
+    return kJSONElemSeparator;
+  }
+  uint8_t separator = colon ? kJSONPairSeparator : kJSONElemSeparator;
+  colon = !colon;
+  return separator;
+}
 
 TJSONProtocol::TJSONProtocol(std::shared_ptr<TTransport> ptrans)
   : TVirtualProtocol<TJSONProtocol>(ptrans),
     trans_(ptrans.get()),
-    context_(new TJSONContext()),
     reader_(*ptrans) {
+  // Deep enough for most messages without ever reallocating
+  contexts_.reserve(16);
+  contexts_.push_back(JSONContext(JSONContext::BASE));
 }
 
 TJSONProtocol::~TJSONProtocol() = default;
 
-void TJSONProtocol::pushContext(std::shared_ptr<TJSONContext> c) {
-  contexts_.push(context_);
-  context_ = c;
+void TJSONProtocol::pushContext(JSONContext::Kind kind) {
+  contexts_.push_back(JSONContext(kind));
 }
 
 void TJSONProtocol::popContext() {
-  context_ = contexts_.top();
-  contexts_.pop();
+  if (contexts_.size() <= 1) {
+    throw TProtocolException(TProtocolException::INVALID_DATA, "Unbalanced JSON nesting");
+  }
+  contexts_.pop_back();
+}
+
+// Read the separator that precedes the next value in the current context
+uint32_t TJSONProtocol::readJSONContext() {
+  uint8_t separator = context().next();
+  return separator == 0 ? 0 : readSyntaxChar(reader_, separator);
+}
+
+// Numbers must be turned into strings if they are the key part of a pair
+bool TJSONProtocol::escapeNum() const {
+  const JSONContext& c = contexts_.back();
+  return c.kind == JSONContext::PAIR && c.colon;
 }
 
-// Write the character ch as a JSON escape sequence ("\u00xx")
+// Write the character ch, preceded by the context's separator if one is due
+uint32_t TJSONProtocol::writeJSONSyntaxChar(uint8_t ch) {
+  uint8_t buf[2];
+  uint32_t len = 0;
+  uint8_t separator = context().next();
+  if (separator != 0) {
+    buf[len++] = separator;
+  }
+  buf[len++] = ch;
+  trans_->write(buf, len);
+  return len;
+}
+
+// Write the character ch as a JSON escape sequence, either "\x" for the
+// characters that have one or "\u00xx"
 uint32_t TJSONProtocol::writeJSONEscapeChar(uint8_t ch) {
-  trans_->write((const uint8_t*)kJSONEscapePrefix.c_str(),
-                static_cast<uint32_t>(kJSONEscapePrefix.length()));
-  uint8_t outCh = hexChar(ch >> 4);
-  trans_->write(&outCh, 1);
-  outCh = hexChar(ch);
-  trans_->write(&outCh, 1);
-  return 6;
-}
-
-// Write the character ch as part of a JSON string, escaping as appropriate.
-uint32_t TJSONProtocol::writeJSONChar(uint8_t ch) {
-  if (ch >= 0x30) {
-    if (ch == kJSONBackslash) { // Only special character >= 0x30 is '\'
-      trans_->write(&kJSONBackslash, 1);
-      trans_->write(&kJSONBackslash, 1);
-      return 2;
-    } else {
-      trans_->write(&ch, 1);
-      return 1;
-    }
+  uint8_t buf[6];
+  uint32_t len = 2;
+  buf[0] = kJSONBackslash;
+  if (ch == kJSONBackslash) {
+    buf[1] = kJSONBackslash;
+  } else if (ch < 0x30 && kJSONCharTable[ch] > 1) {
+    buf[1] = kJSONCharTable[ch];
   } else {
-    uint8_t outCh = kJSONCharTable[ch];
-    // Check if regular character, backslash escaped, or JSON escaped
-    if (outCh == 1) {
-      trans_->write(&ch, 1);
-      return 1;
-    } else if (outCh > 1) {
-      trans_->write(&kJSONBackslash, 1);
-      trans_->write(&outCh, 1);
-      return 2;
-    } else {
-      return writeJSONEscapeChar(ch);
-    }
+    buf[1] = kJSONEscapeChar;
+    buf[2] = '0';
+    buf[3] = '0';
+    buf[4] = hexChar(ch >> 4);
+    buf[5] = hexChar(ch);
+    len = 6;
   }
+  trans_->write(buf, len);
+  return len;
 }
 
 // Write out the contents of the string str as a JSON string, escaping
-// characters as appropriate.
+// characters as appropriate.  Runs of characters that need no escaping go
+// to the transport in one write.
 uint32_t TJSONProtocol::writeJSONString(const std::string& str) {
-  uint32_t result = context_->write(*trans_);
-  result += 2; // For quotes
-  trans_->write(&kJSONStringDelimiter, 1);
-  std::string::const_iterator iter(str.begin());
-  std::string::const_iterator end(str.end());
-  while (iter != end) {
-    result += writeJSONChar(*iter++);
+  if (str.length() > (std::numeric_limits<uint32_t>::max)())
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  uint32_t result = writeJSONSyntaxChar(kJSONStringDelimiter);
+  const auto* p = (const uint8_t*)str.data();
+  auto len = static_cast<uint32_t>(str.length());
+  while (len > 0) {
+    uint32_t run = plainRunLength(p, len);
+    if (run > 0) {
+      trans_->write(p, run);
+      result += run;
+      p += run;
+      len -= run;
+    }
+    if (len > 0) {
+      result += writeJSONEscapeChar(*p);
+      ++p;
+      --len;
+    }
   }
   trans_->write(&kJSONStringDelimiter, 1);
-  return result;
+  return result + 1;
 }
 
 // Write out the contents of the string as JSON string, base64-encoding
 // the string's contents, and escaping as appropriate
 uint32_t TJSONProtocol::writeJSONBase64(const std::string& str) {
-  uint32_t result = context_->write(*trans_);
-  result += 2; // For quotes
-  trans_->write(&kJSONStringDelimiter, 1);
-  uint8_t b[4];
+  uint32_t result = writeJSONSyntaxChar(kJSONStringDelimiter);
+  // Encode a buffer full at a time; the chunk size is a multiple of 3 so
+  // only the last chunk can end in a partial group
+  uint8_t b[4096];
+  const uint32_t chunkSize = sizeof(b) / 4 * 3;
   const auto* bytes = (const uint8_t*)str.c_str();
   if (str.length() > (std::numeric_limits<uint32_t>::max)())
     throw TProtocolException(TProtocolException::SIZE_LIMIT);
   auto len = static_cast<uint32_t>(str.length());
-  while (len >= 3) {
-    // Encode 3 bytes at a time
-    base64_encode(bytes, 3, b);
-    trans_->write(b, 4);
-    result += 4;
-    bytes += 3;
-    len -= 3;
-  }
-  if (len) { // Handle remainder
-    base64_encode(bytes, len, b);
-    trans_->write(b, len + 1);
-    result += len + 1;
+  while (len > 0) {
+    uint32_t chunk = (std::min)(len, chunkSize);
+    uint32_t n = base64_encode_buffer(bytes, chunk, b);
+    trans_->write(b, n);
+    result += n;
+    bytes += chunk;
+    len -= chunk;
   }
   trans_->write(&kJSONStringDelimiter, 1);
-  return result;
+  return result + 1;
+}
+
+// Write a number, preceded by the context's separator and in quotes if
+// quoted is set or the context requires it (eg: key in a map pair), in a
+// single write.
+uint32_t TJSONProtocol::writeJSONNumber(const char* val, uint32_t len, bool quoted) {
+  uint8_t separator = context().next();
+  quoted = quoted || escapeNum();
+  uint8_t buf[64];
+  uint32_t n = 0;
+  uint32_t result = 0;
+  if (separator != 0) {
+    buf[n++] = separator;
+  }
+  if (quoted) {
+    buf[n++] = kJSONStringDelimiter;
+  }
+  if (len < sizeof(buf) - n) {
+    std::memcpy(buf + n, val, len);
+    n += len;
+  } else {
+    trans_->write(buf, n);
+    trans_->write((const uint8_t*)val, len);
+    result = n + len;
+    n = 0;
+  }
+  if (quoted) {
+    buf[n++] = kJSONStringDelimiter;
+  }
+  if (n > 0) {
+    trans_->write(buf, n);
+  }
+  return result + n;
 }
 
 // Convert the given integer type to a JSON number, or a string
 // if the context requires it (eg: key in a map pair).
 template <typename NumberType>
 uint32_t TJSONProtocol::writeJSONInteger(NumberType num) {
-  uint32_t result = context_->write(*trans_);
-  std::string val(to_string(num));
-  bool escapeNum = context_->escapeNum();
-  if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
-  }
-  if (val.length() > (std::numeric_limits<uint32_t>::max)())
-    throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  trans_->write((const uint8_t*)val.c_str(), static_cast<uint32_t>(val.length()));
-  result += static_cast<uint32_t>(val.length());
-  if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
-  }
-  return result;
+  char val[20];
+  uint32_t len = formatJSONInteger(static_cast<int64_t>(num), val);
+  return writeJSONNumber(val, len, false);
 }
 
 namespace {
@@ -537,7 +564,6 @@ std::string doubleToString(double d) {
 // Convert the given double to a JSON string, which is either the number,
 // "NaN" or "Infinity" or "-Infinity".
 uint32_t TJSONProtocol::writeJSONDouble(double num) {
-  uint32_t result = context_->write(*trans_);
   std::string val;
 
   bool special = false;
@@ -559,27 +585,15 @@ uint32_t TJSONProtocol::writeJSONDouble(double num) {
     break;
   }
 
-  bool escapeNum = special || context_->escapeNum();
-  if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
-  }
   if (val.length() > (std::numeric_limits<uint32_t>::max)())
     throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  trans_->write((const uint8_t*)val.c_str(), static_cast<uint32_t>(val.length()));
-  result += static_cast<uint32_t>(val.length());
-  if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
-  }
-  return result;
+  return writeJSONNumber(val.c_str(), static_cast<uint32_t>(val.length()), special);
 }
 
 uint32_t TJSONProtocol::writeJSONObjectStart() {
-  uint32_t result = context_->write(*trans_);
-  trans_->write(&kJSONObjectStart, 1);
-  pushContext(std::shared_ptr<TJSONContext>(new JSONPairContext()));
-  return result + 1;
+  uint32_t result = writeJSONSyntaxChar(kJSONObjectStart);
+  pushContext(JSONContext::PAIR);
+  return result;
 }
 
 uint32_t TJSONProtocol::writeJSONObjectEnd() {
@@ -589,10 +603,9 @@ uint32_t TJSONProtocol::writeJSONObjectEnd() {
 }
 
 uint32_t TJSONProtocol::writeJSONArrayStart() {
-  uint32_t result = context_->write(*trans_);
-  trans_->write(&kJSONArrayStart, 1);
-  pushContext(std::shared_ptr<TJSONContext>(new JSONListContext()));
-  return result + 1;
+  uint32_t result = writeJSONSyntaxChar(kJSONArrayStart);
+  pushContext(JSONContext::LIST);
+  return result;
 }
 
 uint32_t TJSONProtocol::writeJSONArrayEnd() {
@@ -746,12 +759,30 @@ uint32_t TJSONProtocol::readJSONEscapeChar(uint16_t* out) {
 
 // Decodes a JSON string, including unescaping, and returns the string via str
 uint32_t TJSONProtocol::readJSONString(std::string& str, bool skipContext) {
-  uint32_t result = (skipContext ? 0 : context_->read(reader_));
+  uint32_t result = (skipContext ? 0 : readJSONContext());
   result += readJSONSyntaxChar(kJSONStringDelimiter);
   std::vector<uint16_t> codeunits;
   uint8_t ch;
   str.clear();
   while (true) {
+    // Copy plain characters straight out of the transport's buffer when it
+    // will lend it, leaving quotes and escapes to the loop below
+    uint32_t len;
+    const uint8_t* buf = reader_.borrow(len);
+    if (buf != nullptr) {
+      uint32_t run = plainRunLength(buf, len);
+      if (run > 0) {
+        if (!codeunits.empty()) {
+          throw TProtocolException(TProtocolException::INVALID_DATA,
+                                   "Missing UTF-16 low surrogate pair.");
+        }
+        reader_.append(str, run);
+        result += run;
+      }
+      if (run == len) {
+        continue;
+      }
+    }
     ch = reader_.read();
     ++result;
     if (ch == kJSONStringDelimiter) {
@@ -803,31 +834,21 @@ uint32_t TJSONProtocol::readJSONString(std::string& str, bool skipContext) {
 
 // Reads a block of base64 characters, decoding it, and returns via str
 uint32_t TJSONProtocol::readJSONBase64(std::string& str) {
-  std::string tmp;
-  uint32_t result = readJSONString(tmp);
-  auto* b = (uint8_t*)tmp.c_str();
-  if (tmp.length() > (std::numeric_limits<uint32_t>::max)())
+  uint32_t result = readJSONString(str);
+  if (str.length() > (std::numeric_limits<uint32_t>::max)())
     throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  auto len = static_cast<uint32_t>(tmp.length());
-  str.clear();
+  auto len = static_cast<uint32_t>(str.length());
   // Ignore padding
   uint32_t padding_count = 0;
-  while (len > 0 && b[len - 1] == '=' && padding_count < 2) {
+  while (len > 0 && str[len - 1] == '=' && padding_count < 2) {
     --len;
     ++padding_count;
   }
-  while (len >= 4) {
-    base64_decode(b, 4);
-    str.append((const char*)b, 3);
-    b += 4;
-    len -= 4;
-  }
-  // Don't decode if we hit the end or got a single leftover byte (invalid
-  // base64 but legal for skip of regular string type)
-  if (len > 1) {
-    base64_decode(b, len);
-    str.append((const char*)b, len - 1);
-  }
+  // Decode in place, since the output is shorter than the input.  A single
+  // leftover byte (invalid base64 but legal for skip of regular string type)
+  // is dropped.
+  auto* b = (uint8_t*)&str[0];
+  str.resize(base64_decode_buffer(b, len, b));
   return result;
 }
 
@@ -837,6 +858,20 @@ uint32_t TJSONProtocol::readJSONNumericChars(std::string& str) {
   uint32_t result = 0;
   str.clear();
   while (true) {
+    uint32_t len;
+    const uint8_t* buf = reader_.borrow(len);
+    if (buf != nullptr) {
+      uint32_t run = 0;
+      while (run < len && isJSONNumeric(buf[run])) {
+        ++run;
+      }
+      reader_.append(str, run);
+      result += run;
+      if (run < len) {
+        break;
+      }
+      continue;
+    }
     uint8_t ch = reader_.peek();
     if (!isJSONNumeric(ch)) {
       break;
@@ -859,25 +894,65 @@ T fromString(const std::string& s) {
     throw std::runtime_error(s);
   return t;
 }
+
+// Parse a plain decimal integer that fits in NumberType without going
+// through a stream.  Anything else (signs, overflow, stray characters) is
+// left to fromString(), so unusual input is treated exactly as before.
+template <typename NumberType>
+bool parseInteger(const std::string& s, NumberType& num) {
+  size_t i = 0;
+  bool negative = false;
+  if (!s.empty() && s[0] == '-') {
+    negative = true;
+    i = 1;
+  }
+  if (i == s.size() || s.size() - i > 18) {
+    return false;
+  }
+  int64_t value = 0;
+  for (; i < s.size(); ++i) {
+    char ch = s[i];
+    if (ch < '0' || ch > '9') {
+      return false;
+    }
+    value = value * 10 + (ch - '0');
+  }
+  if (negative) {
+    value = -value;
+  }
+  if (value < 0) {
+    if (!std::numeric_limits<NumberType>::is_signed
+        || value < static_cast<int64_t>((std::numeric_limits<NumberType>::min)())) {
+      return false;
+    }
+  } else if (static_cast<uint64_t>(value)
+             > static_cast<uint64_t>((std::numeric_limits<NumberType>::max)())) {
+    return false;
+  }
+  num = static_cast<NumberType>(value);
+  return true;
+}
 }
 
 // Reads a sequence of characters and assembles them into a number,
 // returning them via num
 template <typename NumberType>
 uint32_t TJSONProtocol::readJSONInteger(NumberType& num) {
-  uint32_t result = context_->read(reader_);
-  if (context_->escapeNum()) {
+  uint32_t result = readJSONContext();
+  if (escapeNum()) {
     result += readJSONSyntaxChar(kJSONStringDelimiter);
   }
   std::string str;
   result += readJSONNumericChars(str);
   try {
-    num = fromString<NumberType>(str);
+    if (!parseInteger(str, num)) {
+      num = fromString<NumberType>(str);
+    }
   } catch (const std::runtime_error&) {
     throw TProtocolException(TProtocolException::INVALID_DATA,
                              "Expected numeric value; got \"" + str + "\"");
   }
-  if (context_->escapeNum()) {
+  if (escapeNum()) {
     result += readJSONSyntaxChar(kJSONStringDelimiter);
   }
   return result;
@@ -885,7 +960,7 @@ uint32_t TJSONProtocol::readJSONInteger(NumberType& num) {
 
 // Reads a JSON number or string and interprets it as a double.
 uint32_t TJSONProtocol::readJSONDouble(double& num) {
-  uint32_t result = context_->read(reader_);
+  uint32_t result = readJSONContext();
   std::string str;
   if (reader_.peek() == kJSONStringDelimiter) {
     result += readJSONString(str, true);
@@ -897,7 +972,7 @@ uint32_t TJSONProtocol::readJSONDouble(double& num) {
     } else if (str == kThriftNegativeInfinity) {
       num = -HUGE_VAL;
     } else {
-      if (!context_->escapeNum()) {
+      if (!escapeNum()) {
         // Throw exception -- we should not be in a string in this case
         throw TProtocolException(TProtocolException::INVALID_DATA,
                                      "Numeric data unexpectedly quoted");
@@ -910,7 +985,7 @@ uint32_t TJSONProtocol::readJSONDouble(double& num) {
       }
     }
   } else {
-    if (context_->escapeNum()) {
+    if (escapeNum()) {
       // This will throw - we should have had a quote if escapeNum == true
       readJSONSyntaxChar(kJSONStringDelimiter);
     }
@@ -926,9 +1001,9 @@ uint32_t TJSONProtocol::readJSONDouble(double& num) {
 }
 
 uint32_t TJSONProtocol::readJSONObjectStart() {
-  uint32_t result = context_->read(reader_);
+  uint32_t result = readJSONContext();
   result += readJSONSyntaxChar(kJSONObjectStart);
-  pushContext(std::shared_ptr<TJSONContext>(new JSONPairContext()));
+  pushContext(JSONContext::PAIR);
   return result;
 }
 
@@ -939,9 +1014,9 @@ uint32_t TJSONProtocol::readJSONObjectEnd() {
 }
 
 uint32_t TJSONProtocol::readJSONArrayStart() {
-  uint32_t result = context_->read(reader_);
+  uint32_t result = readJSONContext();
   result += readJSONSyntaxChar(kJSONArrayStart);
-  pushContext(std::shared_ptr<TJSONContext>(new JSONListContext()));
+  pushContext(JSONContext::LIST);
   return result;
 }
 
@@ -22,15 +22,12 @@
 
 #include <thrift/protocol/TVirtualProtocol.h>
 
-#include <stack>
+#include <vector>
 
 namespace apache {
 namespace thrift {
 namespace protocol {
 
-// Forward declaration
-class TJSONContext;
-
 /**
  * JSON protocol for Thrift.
  *
@@ -101,13 +98,39 @@ public:
   ~TJSONProtocol() override;
 
 private:
-  void pushContext(std::shared_ptr<TJSONContext> c);
+  /**
+   * Separator state for the JSON object or array being read or written.
+   * Contexts are kept by value on a stack that is reused from one message to
+   * the next, so nesting does not allocate.
+   */
+  struct JSONContext {
+    enum Kind { BASE, PAIR, LIST };
+
+    explicit JSONContext(Kind k) : kind(k), first(true), colon(true) {}
+
+    // Moves past one value and returns the separator that precedes it, or 0
+    uint8_t next();
+
+    Kind kind;
+    bool first;
+    bool colon;
+  };
+
+  void pushContext(JSONContext::Kind kind);
 
   void popContext();
 
+  JSONContext& context() { return contexts_.back(); }
+
+  uint32_t readJSONContext();
+
+  bool escapeNum() const;
+
+  uint32_t writeJSONSyntaxChar(uint8_t ch);
+
   uint32_t writeJSONEscapeChar(uint8_t ch);
 
-  uint32_t writeJSONChar(uint8_t ch);
+  uint32_t writeJSONNumber(const char* val, uint32_t len, bool quoted);
 
   uint32_t writeJSONString(const std::string& str);
 
@@ -289,6 +312,31 @@ public:
       return data_;
     }
 
+    /**
+     * Returns the input the transport already has buffered, without
+     * consuming it, or nullptr if the transport cannot lend its buffer or a
+     * byte has been peeked.  Callers scan the window and take what they
+     * used with append(), falling back to read() otherwise.
+     */
+    const uint8_t* borrow(uint32_t& len) {
+      if (hasData_) {
+        return nullptr;
+      }
+      len = 1;
+      return trans_->borrow(nullptr, &len);
+    }
+
+    /**
+     * Appends the next len bytes of input to str.  This goes through
+     * readAll() rather than consume() so that message size accounting is
+     * the same as reading a byte at a time.
+     */
+    void append(std::string& str, uint32_t len) {
+      size_t size = str.size();
+      str.resize(size + len);
+      trans_->readAll(reinterpret_cast<uint8_t*>(&str[size]), len);
+    }
+
   private:
     TTransport* trans_;
     bool hasData_;
@@ -298,8 +346,8 @@ public:
 private:
   TTransport* trans_;
 
-  std::stack<std::shared_ptr<TJSONContext> > contexts_;
-  std::shared_ptr<TJSONContext> context_;
+  // The innermost context is at the back; the base context is never popped
+  std::vector<JSONContext> contexts_;
   LookaheadReader reader_;
 };
 
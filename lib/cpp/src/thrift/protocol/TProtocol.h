@@ -50,6 +50,7 @@
 #include <thrift/protocol/TSet.h>
 #include <thrift/protocol/TMap.h>
 #include <thrift/TUuid.h>
+#include <thrift/TInlineString.h>
 
 #include <memory>
 
@@ -278,6 +279,16 @@ public:
 
   virtual uint32_t writeUUID_virt(const TUuid& uuid) = 0;
 
+  // Protocols that can encode a TInlineString in place override these; the
+  // defaults go through a temporary std::string.
+  virtual uint32_t writeInlineString_virt(const TInlineString& str) {
+    return writeString_virt(str.str());
+  }
+
+  virtual uint32_t writeInlineBinary_virt(const TInlineString& str) {
+    return writeBinary_virt(str.str());
+  }
+
   uint32_t writeMessageBegin(const std::string& name,
                              const TMessageType messageType,
                              const int32_t seqid) {
@@ -390,6 +401,16 @@ public:
     return writeUUID_virt(uuid);
   }
 
+  uint32_t writeString(const TInlineString& str) {
+    T_VIRTUAL_CALL();
+    return writeInlineString_virt(str);
+  }
+
+  uint32_t writeBinary(const TInlineString& str) {
+    T_VIRTUAL_CALL();
+    return writeInlineBinary_virt(str);
+  }
+
   /**
    * Reading functions
    */
@@ -440,6 +461,22 @@ public:
 
   virtual uint32_t readUUID_virt(TUuid& uuid) = 0;
 
+  // Protocols that can decode straight into a TInlineString override these;
+  // the defaults go through a temporary std::string.
+  virtual uint32_t readInlineString_virt(TInlineString& str) {
+    std::string tmp;
+    uint32_t result = readString_virt(tmp);
+    str.assign(tmp.data(), tmp.size());
+    return result;
+  }
+
+  virtual uint32_t readInlineBinary_virt(TInlineString& str) {
+    std::string tmp;
+    uint32_t result = readBinary_virt(tmp);
+    str.assign(tmp.data(), tmp.size());
+    return result;
+  }
+
   uint32_t readMessageBegin(std::string& name, TMessageType& messageType, int32_t& seqid) {
     T_VIRTUAL_CALL();
     return readMessageBegin_virt(name, messageType, seqid);
@@ -545,6 +582,16 @@ public:
     return readUUID_virt(uuid);
   }
 
+  uint32_t readString(TInlineString& str) {
+    T_VIRTUAL_CALL();
+    return readInlineString_virt(str);
+  }
+
+  uint32_t readBinary(TInlineString& str) {
+    T_VIRTUAL_CALL();
+    return readInlineBinary_virt(str);
+  }
+
   /*
    * std::vector is specialized for bool, and its elements are individual bits
    * rather than bools.   We need to define a different version of readBool()
@@ -93,6 +93,12 @@ public:
   uint32_t writeString_virt(const std::string& str) override { return protocol->writeString(str); }
   uint32_t writeBinary_virt(const std::string& str) override { return protocol->writeBinary(str); }
   uint32_t writeUUID_virt(const TUuid& uuid) override { return protocol->writeUUID(uuid); }
+  uint32_t writeInlineString_virt(const TInlineString& str) override {
+    return protocol->writeString(str);
+  }
+  uint32_t writeInlineBinary_virt(const TInlineString& str) override {
+    return protocol->writeBinary(str);
+  }
 
   uint32_t readMessageBegin_virt(std::string& name,
                                          TMessageType& messageType,
@@ -142,6 +148,16 @@ public:
   uint32_t readString_virt(std::string& str) override { return protocol->readString(str); }
   uint32_t readBinary_virt(std::string& str) override { return protocol->readBinary(str); }
   uint32_t readUUID_virt(TUuid& uuid) override { return protocol->readUUID(uuid); }
+  uint32_t readInlineString_virt(TInlineString& str) override { return protocol->readString(str); }
+  uint32_t readInlineBinary_virt(TInlineString& str) override { return protocol->readBinary(str); }
+
+protected:
+  // Re-point the decorator at another protocol so that it can be reused
+  // across messages; a null protocol releases the current one.
+  void setProtocol(shared_ptr<TProtocol> proto) {
+    ptrans_ = proto ? proto->getTransport() : shared_ptr<transport::TTransport>();
+    protocol = std::move(proto);
+  }
 
 private:
   shared_ptr<TProtocol> protocol;
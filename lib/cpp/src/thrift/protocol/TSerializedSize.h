@@ -0,0 +1,69 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TSERIALIZEDSIZE_H_
+#define _THRIFT_PROTOCOL_TSERIALIZEDSIZE_H_ 1
+
+#include <memory>
+
+#include <thrift/protocol/TProtocol.h>
+#include <thrift/transport/TNullTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+/**
+ * Maps a protocol to the protocol used to measure how many bytes it would
+ * write.  Protocols that support size computation specialize this with a
+ * nested typedef "type", normally the same protocol instantiated over a
+ * TNullTransport so that every write returns its exact length and discards
+ * the data.
+ */
+template <class Protocol_>
+struct TSerializedSizeTraits;
+
+/**
+ * Shared sink for size computations.  TNullTransport keeps no state, so a
+ * single instance can serve every thread.
+ */
+inline std::shared_ptr<transport::TNullTransport> serializedSizeTransport() {
+  static std::shared_ptr<transport::TNullTransport> trans(new transport::TNullTransport());
+  return trans;
+}
+
+/**
+ * Number of bytes obj would take when written with Protocol_, without
+ * encoding anything.  Generated structs expose this as
+ * serializedSize<Protocol_>(), which lets writers presize a buffer:
+ *
+ *   TMemoryBuffer buffer(obj.serializedSize<TBinaryProtocol>());
+ *
+ * The result is exact for the binary and compact protocols.
+ */
+template <class Protocol_, class Struct_>
+uint32_t serializedSize(const Struct_& obj) {
+  typename TSerializedSizeTraits<Protocol_>::type sizer(serializedSizeTransport());
+  return obj.write(&sizer);
+}
+}
+}
+} // apache::thrift::protocol
+
+#endif // #define _THRIFT_PROTOCOL_TSERIALIZEDSIZE_H_ 1
@@ -0,0 +1,205 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/protocol/TTableSerializer.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+namespace {
+
+template <typename T>
+inline T& member(void* obj, std::ptrdiff_t offset) {
+  return *reinterpret_cast<T*>(static_cast<char*>(obj) + offset);
+}
+
+template <typename T>
+inline const T& member(const void* obj, std::ptrdiff_t offset) {
+  return *reinterpret_cast<const T*>(static_cast<const char*>(obj) + offset);
+}
+
+inline bool fieldIdLess(const TFieldDescriptor& field, int16_t fid) {
+  return field.id < fid;
+}
+}
+
+const TFieldDescriptor* TTableSerializer::findField(const TStructDescriptor& desc,
+                                                    int16_t fid,
+                                                    uint32_t& hint) {
+  // Writers emit fields in id order, so the field after the previous match
+  // is almost always the one we want.
+  if (hint < desc.numFields && desc.fields[hint].id == fid) {
+    return &desc.fields[hint++];
+  }
+
+  const TFieldDescriptor* end = desc.fields + desc.numFields;
+  const TFieldDescriptor* it = std::lower_bound(desc.fields, end, fid, fieldIdLess);
+  if (it == end || it->id != fid) {
+    return nullptr;
+  }
+  hint = static_cast<uint32_t>(it - desc.fields) + 1;
+  return it;
+}
+
+uint32_t TTableSerializer::readField(TProtocol* iprot,
+                                     const TFieldDescriptor& field,
+                                     void* obj) {
+  switch (field.kind) {
+  case T_FIELD_BOOL:
+    return iprot->readBool(member<bool>(obj, field.offset));
+  case T_FIELD_BYTE:
+    return iprot->readByte(member<int8_t>(obj, field.offset));
+  case T_FIELD_I16:
+    return iprot->readI16(member<int16_t>(obj, field.offset));
+  case T_FIELD_I32:
+    return iprot->readI32(member<int32_t>(obj, field.offset));
+  case T_FIELD_I64:
+    return iprot->readI64(member<int64_t>(obj, field.offset));
+  case T_FIELD_DOUBLE:
+    return iprot->readDouble(member<double>(obj, field.offset));
+  case T_FIELD_STRING:
+    return iprot->readString(member<std::string>(obj, field.offset));
+  case T_FIELD_BINARY:
+    return iprot->readBinary(member<std::string>(obj, field.offset));
+  case T_FIELD_CUSTOM:
+    return field.read(iprot, obj);
+  }
+  throw TProtocolException(TProtocolException::INVALID_DATA,
+                           "unknown field kind in descriptor table");
+}
+
+uint32_t TTableSerializer::writeField(TProtocol* oprot,
+                                      const TFieldDescriptor& field,
+                                      const void* obj) {
+  switch (field.kind) {
+  case T_FIELD_BOOL:
+    return oprot->writeBool(member<bool>(obj, field.offset));
+  case T_FIELD_BYTE:
+    return oprot->writeByte(member<int8_t>(obj, field.offset));
+  case T_FIELD_I16:
+    return oprot->writeI16(member<int16_t>(obj, field.offset));
+  case T_FIELD_I32:
+    return oprot->writeI32(member<int32_t>(obj, field.offset));
+  case T_FIELD_I64:
+    return oprot->writeI64(member<int64_t>(obj, field.offset));
+  case T_FIELD_DOUBLE:
+    return oprot->writeDouble(member<double>(obj, field.offset));
+  case T_FIELD_STRING:
+    return oprot->writeString(member<std::string>(obj, field.offset));
+  case T_FIELD_BINARY:
+    return oprot->writeBinary(member<std::string>(obj, field.offset));
+  case T_FIELD_CUSTOM:
+    return field.write(oprot, obj);
+  }
+  throw TProtocolException(TProtocolException::INVALID_DATA,
+                           "unknown field kind in descriptor table");
+}
+
+uint32_t TTableSerializer::read(TProtocol* iprot, const TStructDescriptor& desc, void* obj) {
+  TInputRecursionTracker tracker(*iprot);
+  uint32_t xfer = 0;
+  std::string fname;
+  TType ftype;
+  int16_t fid;
+
+  // Required fields are not tracked in __isset, so remember which ones we
+  // have seen by their index in the table.
+  uint64_t seenSmall = 0;
+  std::vector<bool> seenLarge;
+  if (desc.numFields > 64) {
+    seenLarge.resize(desc.numFields);
+  }
+
+  uint32_t hint = 0;
+
+  xfer += iprot->readStructBegin(fname);
+
+  while (true) {
+    xfer += iprot->readFieldBegin(fname, ftype, fid);
+    if (ftype == T_STOP) {
+      break;
+    }
+
+    const TFieldDescriptor* field = findField(desc, fid, hint);
+    if (field == nullptr || field->type != ftype) {
+      xfer += iprot->skip(ftype);
+    } else {
+      xfer += readField(iprot, *field, obj);
+      if (field->issetOffset >= 0) {
+        member<bool>(obj, field->issetOffset) = true;
+      } else {
+        uint32_t index = static_cast<uint32_t>(field - desc.fields);
+        if (seenLarge.empty()) {
+          seenSmall |= (uint64_t)1 << index;
+        } else {
+          seenLarge[index] = true;
+        }
+      }
+    }
+
+    xfer += iprot->readFieldEnd();
+  }
+
+  xfer += iprot->readStructEnd();
+
+  // Throw if any required fields are missing, after reading the struct end
+  // so that there might possibly be a chance of continuing.
+  for (uint32_t i = 0; i < desc.numFields; ++i) {
+    if (desc.fields[i].requiredness != T_FIELD_REQUIRED) {
+      continue;
+    }
+    bool seen = seenLarge.empty() ? ((seenSmall >> i) & 1) != 0 : seenLarge[i];
+    if (!seen) {
+      throw TProtocolException(TProtocolException::INVALID_DATA);
+    }
+  }
+
+  return xfer;
+}
+
+uint32_t TTableSerializer::write(TProtocol* oprot,
+                                 const TStructDescriptor& desc,
+                                 const void* obj) {
+  TOutputRecursionTracker tracker(*oprot);
+  uint32_t xfer = 0;
+
+  xfer += oprot->writeStructBegin(desc.name);
+
+  for (uint32_t i = 0; i < desc.numFields; ++i) {
+    const TFieldDescriptor& field = desc.fields[i];
+    if (field.writeIfSet && !member<bool>(obj, field.issetOffset)) {
+      continue;
+    }
+    xfer += oprot->writeFieldBegin(field.name, field.type, field.id);
+    xfer += writeField(oprot, field, obj);
+    xfer += oprot->writeFieldEnd();
+  }
+
+  xfer += oprot->writeFieldStop();
+  xfer += oprot->writeStructEnd();
+  return xfer;
+}
+}
+}
+} // apache::thrift::protocol
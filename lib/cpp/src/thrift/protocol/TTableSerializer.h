@@ -0,0 +1,143 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TTABLESERIALIZER_H_
+#define _THRIFT_PROTOCOL_TTABLESERIALIZER_H_ 1
+
+#include <cstddef>
+#include <thrift/protocol/TProtocol.h>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+/**
+ * How the table-driven serializer accesses a field.  Scalar and string kinds
+ * are read and written directly at TFieldDescriptor::offset; everything else
+ * (nested structs, containers, enums, uuids, cpp.ref fields, custom cpp.type
+ * types) goes through the per-field read/write functions emitted by the
+ * generator.
+ */
+enum TFieldKind {
+  T_FIELD_BOOL = 0,
+  T_FIELD_BYTE = 1,
+  T_FIELD_I16 = 2,
+  T_FIELD_I32 = 3,
+  T_FIELD_I64 = 4,
+  T_FIELD_DOUBLE = 5,
+  T_FIELD_STRING = 6,
+  T_FIELD_BINARY = 7,
+  T_FIELD_CUSTOM = 8
+};
+
+/**
+ * Field requiredness, as declared in the IDL.
+ */
+enum TFieldRequiredness {
+  T_FIELD_DEFAULT = 0,
+  T_FIELD_OPTIONAL = 1,
+  T_FIELD_REQUIRED = 2
+};
+
+typedef uint32_t (*TFieldReader)(TProtocol* iprot, void* obj);
+typedef uint32_t (*TFieldWriter)(TProtocol* oprot, const void* obj);
+
+/**
+ * Describes one field of a generated struct.  Generated code emits one
+ * static array of these per struct, sorted by field id.
+ */
+struct TFieldDescriptor {
+  const char* name;
+  int16_t id;
+  TType type;
+  TFieldKind kind;
+  TFieldRequiredness requiredness;
+  // Only write the field when its __isset flag is set
+  bool writeIfSet;
+  // Byte offset of the member within the struct, unused for T_FIELD_CUSTOM
+  std::ptrdiff_t offset;
+  // Byte offset of the member's __isset flag, or -1 for required fields
+  std::ptrdiff_t issetOffset;
+  // Per-field (de)serializers for T_FIELD_CUSTOM, called with the struct
+  TFieldReader read;
+  TFieldWriter write;
+};
+
+/**
+ * Describes a generated struct as a whole.
+ */
+struct TStructDescriptor {
+  const char* name;
+  const TFieldDescriptor* fields;
+  uint32_t numFields;
+};
+
+/**
+ * Single shared encoder/decoder for structs generated with the
+ * "cpp:table_driven" option.  Instead of every struct carrying its own
+ * unrolled read() and write(), generated code forwards to these functions
+ * with a pointer to its descriptor table, which keeps code size flat as the
+ * number of IDL types grows.
+ */
+class TTableSerializer {
+public:
+  static uint32_t read(TProtocol* iprot, const TStructDescriptor& desc, void* obj);
+  static uint32_t write(TProtocol* oprot, const TStructDescriptor& desc, const void* obj);
+
+  /**
+   * Byte offset of a data member, for building descriptor tables.  Generated
+   * structs are not standard-layout (they have a virtual base), so offsetof
+   * cannot be used portably; the offset is measured on a real instance
+   * instead.
+   */
+  template <class Struct_, class Member_>
+  static std::ptrdiff_t fieldOffset(Member_ Struct_::*member) {
+    const Struct_& base = prototype<Struct_>();
+    return reinterpret_cast<const char*>(&(base.*member))
+           - reinterpret_cast<const char*>(&base);
+  }
+
+  /**
+   * Byte offset of one flag within a struct's __isset member, given the
+   * flag's offsetof() within the isset struct.
+   */
+  template <class Struct_, class Isset_>
+  static std::ptrdiff_t issetOffset(Isset_ Struct_::*isset, std::size_t flagOffset) {
+    return fieldOffset(isset) + static_cast<std::ptrdiff_t>(flagOffset);
+  }
+
+private:
+  // A default-constructed Struct_ to measure member offsets on
+  template <class Struct_>
+  static const Struct_& prototype() {
+    static Struct_ instance;
+    return instance;
+  }
+
+  static const TFieldDescriptor* findField(const TStructDescriptor& desc,
+                                           int16_t fid,
+                                           uint32_t& hint);
+  static uint32_t readField(TProtocol* iprot, const TFieldDescriptor& field, void* obj);
+  static uint32_t writeField(TProtocol* oprot, const TFieldDescriptor& field, const void* obj);
+};
+}
+}
+} // apache::thrift::protocol
+
+#endif // #define _THRIFT_PROTOCOL_TTABLESERIALIZER_H_ 1
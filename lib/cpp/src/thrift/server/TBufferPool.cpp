@@ -0,0 +1,177 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/server/TBufferPool.h>
+
+#include <cstdlib>
+#include <new>
+
+using apache::thrift::concurrency::Guard;
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+TBufferPool::TBufferPool(size_t memoryLimit,
+                         size_t maxPooledBytes,
+                         uint32_t minBufferSize,
+                         uint32_t maxBufferSize)
+  : memoryLimit_(memoryLimit),
+    maxPooledBytes_(maxPooledBytes),
+    minBufferSize_(1),
+    maxBufferSize_(0),
+    pooledBytes_(0),
+    outstandingBytes_(0),
+    reuseCount_(0),
+    deferredCount_(0) {
+  while (minBufferSize_ < minBufferSize && minBufferSize_ < (1u << 31)) {
+    minBufferSize_ <<= 1;
+  }
+  // One free list per power of two from minBufferSize_ up to maxBufferSize
+  for (uint64_t size = minBufferSize_; size <= maxBufferSize; size <<= 1) {
+    maxBufferSize_ = static_cast<uint32_t>(size);
+    freeLists_.emplace_back();
+  }
+}
+
+TBufferPool::~TBufferPool() {
+  trim();
+}
+
+size_t TBufferPool::classFor(uint32_t size) const {
+  size_t index = 0;
+  uint64_t classSize = minBufferSize_;
+  while (classSize < size && index < freeLists_.size()) {
+    classSize <<= 1;
+    ++index;
+  }
+  return index;
+}
+
+uint8_t* TBufferPool::borrow(uint32_t size, uint32_t* capacity, bool mayDefer) {
+  size_t index = classFor(size);
+  // Sizes above the largest class are allocated exactly
+  uint32_t classSize = index < freeLists_.size() ? minBufferSize_ << index : size;
+
+  {
+    Guard g(mutex_);
+    if (mayDefer && memoryLimit_ > 0 && outstandingBytes_ > 0
+        && outstandingBytes_ + classSize > memoryLimit_) {
+      ++deferredCount_;
+      return nullptr;
+    }
+    outstandingBytes_ += classSize;
+    if (index < freeLists_.size() && !freeLists_[index].empty()) {
+      uint8_t* buffer = freeLists_[index].back();
+      freeLists_[index].pop_back();
+      pooledBytes_ -= classSize;
+      ++reuseCount_;
+      *capacity = classSize;
+      return buffer;
+    }
+  }
+
+  auto* buffer = static_cast<uint8_t*>(std::malloc(classSize));
+  if (buffer == nullptr) {
+    Guard g(mutex_);
+    outstandingBytes_ -= classSize;
+    throw std::bad_alloc();
+  }
+  *capacity = classSize;
+  return buffer;
+}
+
+void TBufferPool::giveBack(uint8_t* buffer, uint32_t borrowed, uint32_t capacity) {
+  if (buffer == nullptr) {
+    return;
+  }
+
+  // Pool the buffer in the largest class it can hold
+  size_t index = freeLists_.size();
+  if (capacity >= minBufferSize_ && capacity <= maxBufferSize_) {
+    index = classFor(capacity);
+    if ((minBufferSize_ << index) > capacity) {
+      --index;
+    }
+  }
+
+  {
+    Guard g(mutex_);
+    outstandingBytes_ -= borrowed < outstandingBytes_ ? borrowed : outstandingBytes_;
+    if (index < freeLists_.size()) {
+      uint32_t classSize = minBufferSize_ << index;
+      if (pooledBytes_ + classSize <= maxPooledBytes_) {
+        freeLists_[index].push_back(buffer);
+        pooledBytes_ += classSize;
+        return;
+      }
+    }
+  }
+  std::free(buffer);
+}
+
+void TBufferPool::trim() {
+  std::vector<std::vector<uint8_t*> > idle;
+  {
+    Guard g(mutex_);
+    idle.resize(freeLists_.size());
+    for (size_t i = 0; i < freeLists_.size(); ++i) {
+      idle[i].swap(freeLists_[i]);
+    }
+    pooledBytes_ = 0;
+  }
+  for (auto& list : idle) {
+    for (uint8_t* buffer : list) {
+      std::free(buffer);
+    }
+  }
+}
+
+size_t TBufferPool::getMemoryLimit() const {
+  Guard g(mutex_);
+  return memoryLimit_;
+}
+
+void TBufferPool::setMemoryLimit(size_t limit) {
+  Guard g(mutex_);
+  memoryLimit_ = limit;
+}
+
+size_t TBufferPool::getPooledBytes() const {
+  Guard g(mutex_);
+  return pooledBytes_;
+}
+
+size_t TBufferPool::getOutstandingBytes() const {
+  Guard g(mutex_);
+  return outstandingBytes_;
+}
+
+uint64_t TBufferPool::getReuseCount() const {
+  Guard g(mutex_);
+  return reuseCount_;
+}
+
+uint64_t TBufferPool::getDeferredCount() const {
+  Guard g(mutex_);
+  return deferredCount_;
+}
+}
+}
+} // apache::thrift::server
@@ -0,0 +1,129 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_SERVER_TBUFFERPOOL_H_
+#define _THRIFT_SERVER_TBUFFERPOOL_H_ 1
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+#include <thrift/concurrency/Mutex.h>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+/**
+ * A thread-safe pool of I/O buffers shared by the connections of a server.
+ *
+ * Buffers are handed out in power-of-two size classes and are ordinary
+ * malloc() blocks, so a borrowed buffer can be given to a TMemoryBuffer with
+ * TAKE_OWNERSHIP and grown by it.  Connections borrow buffers only while a
+ * frame is in flight, so idle connections hold no buffer memory at all.
+ *
+ * The pool also enforces a memory budget: once the bytes lent out reach the
+ * limit, borrow() requests that may be deferred fail, and the server stops
+ * reading from the affected connections until buffers are given back.
+ */
+class TBufferPool {
+public:
+  static const uint32_t DEFAULT_MIN_BUFFER_SIZE = 256;
+  static const uint32_t DEFAULT_MAX_BUFFER_SIZE = 1024 * 1024;
+  static const size_t DEFAULT_MAX_POOLED_BYTES = 64 * 1024 * 1024;
+
+  /**
+   * @param memoryLimit bytes that may be lent out before deferrable borrows
+   *        fail; 0 disables the budget.
+   * @param maxPooledBytes bytes of idle buffers kept for reuse; buffers given
+   *        back beyond this are freed.
+   * @param minBufferSize the smallest size class.
+   * @param maxBufferSize the largest size class; larger buffers are
+   *        allocated on demand and freed when given back.
+   */
+  TBufferPool(size_t memoryLimit = 0,
+              size_t maxPooledBytes = DEFAULT_MAX_POOLED_BYTES,
+              uint32_t minBufferSize = DEFAULT_MIN_BUFFER_SIZE,
+              uint32_t maxBufferSize = DEFAULT_MAX_BUFFER_SIZE);
+
+  ~TBufferPool();
+
+  /**
+   * Borrow a buffer of at least \p size bytes.
+   *
+   * @param size bytes needed.
+   * @param capacity set to the actual size of the returned buffer.
+   * @param mayDefer if true and the memory budget would be exceeded, return
+   *        nullptr instead.  A borrow is never deferred while nothing is lent
+   *        out, so a single frame larger than the budget still makes progress.
+   * @return the buffer, or nullptr if deferred.
+   * @throws std::bad_alloc if the allocation fails.
+   */
+  uint8_t* borrow(uint32_t size, uint32_t* capacity, bool mayDefer = false);
+
+  /**
+   * Give back a buffer obtained from borrow().
+   *
+   * @param buffer the buffer; nullptr is ignored.
+   * @param borrowed the capacity borrow() returned for it.
+   * @param capacity its current size, which differs from \p borrowed if the
+   *        buffer was resized with realloc() in the meantime.
+   */
+  void giveBack(uint8_t* buffer, uint32_t borrowed, uint32_t capacity);
+
+  /** Free all idle buffers. */
+  void trim();
+
+  size_t getMemoryLimit() const;
+  void setMemoryLimit(size_t limit);
+
+  /** Bytes of idle buffers held for reuse. */
+  size_t getPooledBytes() const;
+
+  /** Bytes currently lent out to connections. */
+  size_t getOutstandingBytes() const;
+
+  /** Number of borrows satisfied from an idle buffer. */
+  uint64_t getReuseCount() const;
+
+  /** Number of borrows that were deferred because of the memory budget. */
+  uint64_t getDeferredCount() const;
+
+private:
+  TBufferPool(const TBufferPool&) = delete;
+  TBufferPool& operator=(const TBufferPool&) = delete;
+
+  /// Index of the smallest class that holds \p size bytes
+  size_t classFor(uint32_t size) const;
+
+  mutable concurrency::Mutex mutex_;
+  size_t memoryLimit_;
+  size_t maxPooledBytes_;
+  uint32_t minBufferSize_;
+  uint32_t maxBufferSize_;
+  size_t pooledBytes_;
+  size_t outstandingBytes_;
+  uint64_t reuseCount_;
+  uint64_t deferredCount_;
+  std::vector<std::vector<uint8_t*> > freeLists_;
+};
+}
+}
+} // apache::thrift::server
+
+#endif // #ifndef _THRIFT_SERVER_TBUFFERPOOL_H_
@@ -0,0 +1,177 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/server/TConcurrencyLimiter.h>
+
+#include <algorithm>
+#include <cmath>
+#include <thrift/TDeadline.h>
+#include <thrift/TDispatchProcessor.h>
+
+using apache::thrift::concurrency::Guard;
+using apache::thrift::protocol::TMessageType;
+using apache::thrift::protocol::TProtocol;
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+namespace {
+// Share of each new GRADIENT estimate in the limit
+const double SMOOTHING = 0.2;
+// Bounds of the GRADIENT scaling factor
+const double MIN_GRADIENT = 0.5;
+const double MAX_GRADIENT = 1.0;
+}
+
+TConcurrencyLimiter::TConcurrencyLimiter(Algorithm algorithm,
+                                         uint32_t initialLimit,
+                                         uint32_t minLimit,
+                                         uint32_t maxLimit)
+  : algorithm_(algorithm),
+    minLimit_(std::max<uint32_t>(minLimit, 1)),
+    maxLimit_(std::max(maxLimit, std::max<uint32_t>(minLimit, 1))),
+    limit_(std::min(std::max(initialLimit, minLimit_), maxLimit_)),
+    inFlight_(0),
+    rejected_(0),
+    windowSize_(DEFAULT_WINDOW_SIZE),
+    tolerance_(1.5),
+    latencyThreshold_(0),
+    backoffRatio_(0.9),
+    estimate_(limit_.load()),
+    baseline_(0),
+    samples_(0),
+    latencySamples_(0),
+    latencySum_(0),
+    maxInFlight_(0),
+    congested_(false) {
+}
+
+bool TConcurrencyLimiter::tryAcquire() {
+  uint32_t current = inFlight_.load(std::memory_order_relaxed);
+  do {
+    if (current >= limit_.load(std::memory_order_relaxed)) {
+      rejected_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  } while (!inFlight_.compare_exchange_weak(current, current + 1, std::memory_order_relaxed));
+  return true;
+}
+
+void TConcurrencyLimiter::release(std::chrono::nanoseconds latency, bool dropped) {
+  uint32_t inFlight = inFlight_.fetch_sub(1, std::memory_order_relaxed);
+
+  Guard g(mutex_);
+  maxInFlight_ = std::max(maxInFlight_, inFlight);
+  if (dropped) {
+    congested_ = true;
+  } else {
+    latencySum_ += static_cast<double>(latency.count());
+    ++latencySamples_;
+    if (latencyThreshold_.count() > 0 && latency > latencyThreshold_) {
+      congested_ = true;
+    }
+  }
+  if (++samples_ < windowSize_) {
+    return;
+  }
+
+  double limit = estimate_;
+  double next = limit;
+  if (algorithm_ == GRADIENT) {
+    if (latencySamples_ > 0) {
+      next = updateGradient(limit, latencySum_ / latencySamples_);
+    }
+  } else {
+    next = updateAimd(limit, congested_);
+  }
+
+  // Don't raise a limit that the load doesn't reach
+  if (next > limit && maxInFlight_ < limit / 2) {
+    next = limit;
+  }
+  estimate_ = std::min(std::max(next, static_cast<double>(minLimit_)),
+                       static_cast<double>(maxLimit_));
+  limit_.store(static_cast<uint32_t>(std::lround(estimate_)), std::memory_order_relaxed);
+
+  samples_ = 0;
+  latencySamples_ = 0;
+  latencySum_ = 0;
+  maxInFlight_ = 0;
+  congested_ = false;
+}
+
+double TConcurrencyLimiter::updateGradient(double limit, double latency) {
+  if (baseline_ <= 0 || latency < baseline_) {
+    baseline_ = latency;
+  }
+
+  // Latency above the baseline means calls are queueing: shrink the limit in
+  // proportion, and leave room for sqrt(limit) more calls to probe for spare
+  // capacity.
+  double gradient = std::min(std::max(tolerance_ * baseline_ / latency, MIN_GRADIENT),
+                             MAX_GRADIENT);
+  double next = limit * gradient + std::sqrt(limit);
+  if (gradient == MIN_GRADIENT
+      && (std::lround(next) >= std::lround(limit) || limit <= minLimit_)) {
+    // The limit is too small to shrink any further, yet calls still take far
+    // longer than the baseline: the handler itself has become slower, so
+    // start over from the current latency.
+    baseline_ = latency;
+  }
+  return limit * (1 - SMOOTHING) + next * SMOOTHING;
+}
+
+double TConcurrencyLimiter::updateAimd(double limit, bool congested) const {
+  return congested ? limit * backoffRatio_ : limit + 1;
+}
+
+void TConcurrencyLimiter::setWindowSize(uint32_t samples) {
+  Guard g(mutex_);
+  windowSize_ = std::max<uint32_t>(samples, 1);
+}
+
+void TConcurrencyLimiter::setTolerance(double tolerance) {
+  Guard g(mutex_);
+  tolerance_ = std::max(tolerance, 1.0);
+}
+
+void TConcurrencyLimiter::setLatencyThreshold(std::chrono::nanoseconds threshold) {
+  Guard g(mutex_);
+  latencyThreshold_ = threshold;
+}
+
+void TConcurrencyLimiter::setBackoffRatio(double ratio) {
+  Guard g(mutex_);
+  backoffRatio_ = std::min(std::max(ratio, 0.1), 1.0);
+}
+
+void TConcurrencyLimiter::reject(TProtocol* in, TProtocol* out) {
+  // THeaderProtocol sets the call's deadline while reading the header
+  TDeadlineScope deadlineScope;
+
+  std::string fname;
+  TMessageType mtype;
+  int32_t seqid;
+  in->readMessageBegin(fname, mtype, seqid);
+  rejectCall(in, out, fname, mtype, seqid, "Server overloaded, rejected call to " + fname);
+}
+}
+}
+} // apache::thrift::server
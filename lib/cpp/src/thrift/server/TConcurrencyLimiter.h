@@ -0,0 +1,162 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_SERVER_TCONCURRENCYLIMITER_H_
+#define _THRIFT_SERVER_TCONCURRENCYLIMITER_H_ 1
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <thrift/concurrency/Mutex.h>
+#include <thrift/protocol/TProtocol.h>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+/**
+ * Limits the number of calls a server works on at once, adjusting the limit
+ * from the latency the calls see.
+ *
+ * Instead of a fixed number of worker threads or a fixed queue length, the
+ * limit follows the capacity of the handler: while latency stays flat the
+ * limit grows, and once calls start to queue up behind each other the limit
+ * shrinks again.  Calls beyond the limit are rejected immediately with a
+ * TApplicationException, which is cheap for the server and lets the client
+ * retry elsewhere rather than wait in a queue.
+ *
+ * Two algorithms are provided:
+ *  - GRADIENT compares the average latency of the most recent window with
+ *    the lowest latency seen, like the base RTT of TCP Vegas, and scales the
+ *    limit by their ratio; a headroom of sqrt(limit) lets it probe for more
+ *    capacity.
+ *  - AIMD adds one to the limit after every window without congestion and
+ *    multiplies it by the backoff ratio after a window in which a call was
+ *    dropped or took longer than the latency threshold.
+ *
+ * The limit only grows while the server is actually using at least half of
+ * it, so a lightly loaded server does not drift up to the maximum.
+ */
+class TConcurrencyLimiter {
+public:
+  enum Algorithm { AIMD, GRADIENT };
+
+  static const uint32_t DEFAULT_INITIAL_LIMIT = 20;
+  static const uint32_t DEFAULT_MIN_LIMIT = 1;
+  static const uint32_t DEFAULT_MAX_LIMIT = 1000;
+  static const uint32_t DEFAULT_WINDOW_SIZE = 16;
+
+  TConcurrencyLimiter(Algorithm algorithm = GRADIENT,
+                      uint32_t initialLimit = DEFAULT_INITIAL_LIMIT,
+                      uint32_t minLimit = DEFAULT_MIN_LIMIT,
+                      uint32_t maxLimit = DEFAULT_MAX_LIMIT);
+
+  /**
+   * Admit a call if fewer than getLimit() calls are in flight.  Every
+   * successful tryAcquire() must be followed by a release().
+   *
+   * @return false if the call should be rejected.
+   */
+  bool tryAcquire();
+
+  /**
+   * Finish a call admitted by tryAcquire().
+   *
+   * @param latency how long the call took, including any time it spent
+   *        queued for a worker thread.
+   * @param dropped true if the call failed, e.g. timed out or was dropped
+   *        by the server; counts as congestion for AIMD and carries no
+   *        latency sample.
+   */
+  void release(std::chrono::nanoseconds latency, bool dropped = false);
+
+  Algorithm getAlgorithm() const { return algorithm_; }
+
+  /** The current limit on calls in flight. */
+  uint32_t getLimit() const { return limit_.load(std::memory_order_relaxed); }
+
+  /** Calls admitted and not yet released. */
+  uint32_t getInFlight() const { return inFlight_.load(std::memory_order_relaxed); }
+
+  /** Calls refused by tryAcquire(). */
+  uint64_t getRejectedCount() const { return rejected_.load(std::memory_order_relaxed); }
+
+  /** Number of calls between limit updates. */
+  void setWindowSize(uint32_t samples);
+
+  /**
+   * GRADIENT: how much the average latency of a window may exceed the lowest
+   * latency seen before the limit is reduced.  Defaults to 1.5.
+   */
+  void setTolerance(double tolerance);
+
+  /**
+   * AIMD: calls slower than this count as congestion.  Zero, the default,
+   * only counts dropped calls.
+   */
+  void setLatencyThreshold(std::chrono::nanoseconds threshold);
+
+  /** AIMD: factor applied to the limit after a congested window. */
+  void setBackoffRatio(double ratio);
+
+  /**
+   * Read the message header of the next call from \p in and reject it,
+   * replying with a TApplicationException unless the call is oneway.
+   */
+  static void reject(protocol::TProtocol* in, protocol::TProtocol* out);
+
+private:
+  TConcurrencyLimiter(const TConcurrencyLimiter&) = delete;
+  TConcurrencyLimiter& operator=(const TConcurrencyLimiter&) = delete;
+
+  /// Compute the next limit at the end of a window; called with mutex_ held
+  double updateGradient(double limit, double latency);
+  double updateAimd(double limit, bool congested) const;
+
+  const Algorithm algorithm_;
+  const uint32_t minLimit_;
+  const uint32_t maxLimit_;
+
+  std::atomic<uint32_t> limit_;
+  std::atomic<uint32_t> inFlight_;
+  std::atomic<uint64_t> rejected_;
+
+  concurrency::Mutex mutex_;
+  uint32_t windowSize_;
+  double tolerance_;
+  std::chrono::nanoseconds latencyThreshold_;
+  double backoffRatio_;
+
+  /// Fractional limit; limit_ is this rounded
+  double estimate_;
+  /// Latency in nanoseconds of an uncongested call, 0 until the first window
+  double baseline_;
+
+  // Current window
+  uint32_t samples_;
+  uint32_t latencySamples_;
+  double latencySum_;
+  uint32_t maxInFlight_;
+  bool congested_;
+};
+}
+}
+} // apache::thrift::server
+
+#endif // #ifndef _THRIFT_SERVER_TCONCURRENCYLIMITER_H_
@@ -18,14 +18,17 @@
  */
 
 #include <thrift/server/TConnectedClient.h>
+#include <thrift/transport/TSocket.h>
 
 namespace apache {
 namespace thrift {
 namespace server {
 
 using apache::thrift::TProcessor;
+using apache::thrift::concurrency::Guard;
 using apache::thrift::protocol::TProtocol;
 using apache::thrift::server::TServerEventHandler;
+using apache::thrift::transport::TSocket;
 using apache::thrift::transport::TTransport;
 using apache::thrift::transport::TTransportException;
 using std::shared_ptr;
@@ -42,7 +45,10 @@ TConnectedClient::TConnectedClient(const shared_ptr<TProcessor>& processor,
     outputProtocol_(outputProtocol),
     eventHandler_(eventHandler),
     client_(client),
-    opaqueContext_(nullptr) {
+    opaqueContext_(nullptr),
+    draining_(false),
+    served_(false),
+    closed_(false) {
 }
 
 TConnectedClient::~TConnectedClient() = default;
@@ -61,6 +67,11 @@ void TConnectedClient::run() {
       if (!processor_->process(inputProtocol_, outputProtocol_, opaqueContext_)) {
         break;
       }
+      // Pairs with drain(): one of the two sees the other's store
+      served_ = true;
+      if (draining_) {
+        break;
+      }
     } catch (const TTransportException& ttx) {
       switch (ttx.getType()) {
         case TTransportException::END_OF_FILE:
@@ -91,11 +102,29 @@ void TConnectedClient::run() {
   cleanup();
 }
 
+void TConnectedClient::drain() {
+  draining_ = true;
+  if (!served_) {
+    // The first call may be on its way; run() stops after it
+    return;
+  }
+  // Between calls, or in one: ending input wakes a read that waits for the
+  // next call, and leaves the response to a call in progress alone
+  Guard g(mutex_);
+  shared_ptr<TSocket> socket = std::dynamic_pointer_cast<TSocket>(client_);
+  if (socket && !closed_) {
+    socket->shutdownInput();
+  }
+}
+
 void TConnectedClient::cleanup() {
   if (eventHandler_) {
     eventHandler_->deleteContext(opaqueContext_, inputProtocol_, outputProtocol_);
   }
 
+  Guard g(mutex_);
+  closed_ = true;
+
   try {
     inputProtocol_->getTransport()->close();
   } catch (const TTransportException& ttx) {
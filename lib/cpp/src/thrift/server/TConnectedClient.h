@@ -20,8 +20,10 @@
 #ifndef _THRIFT_SERVER_TCONNECTEDCLIENT_H_
 #define _THRIFT_SERVER_TCONNECTEDCLIENT_H_ 1
 
+#include <atomic>
 #include <memory>
 #include <thrift/TProcessor.h>
+#include <thrift/concurrency/Mutex.h>
 #include <thrift/protocol/TProtocol.h>
 #include <thrift/server/TServer.h>
 #include <thrift/transport/TTransport.h>
@@ -78,6 +80,15 @@ public:
    */
   void run() override /* override */;
 
+  /**
+   * Finish with the client, because the server is draining.  The call in
+   * progress, if any, completes and run() returns after it.  A client that
+   * has made calls before and is waiting for the next one is disconnected
+   * right away if it is a TSocket; a client that has not made its first
+   * call yet may still make one.  Can be called from any thread.
+   */
+  void drain();
+
 protected:
   /**
    * Cleanup after a client.  This happens if the client disconnects,
@@ -102,6 +113,15 @@ private:
    * Context acquired from the eventHandler_ if one exists.
    */
   void* opaqueContext_;
+
+  std::atomic<bool> draining_;
+  std::atomic<bool> served_;
+
+  /**
+   * Keeps drain() from touching the client as cleanup() closes it.
+   */
+  apache::thrift::concurrency::Mutex mutex_;
+  bool closed_;
 };
 }
 }
@@ -0,0 +1,368 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/server/THttp2Server.h>
+
+#include <thrift/transport/TBufferTransports.h>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+using apache::thrift::concurrency::IllegalStateException;
+using apache::thrift::concurrency::Runnable;
+using apache::thrift::concurrency::Synchronized;
+using apache::thrift::concurrency::ThreadManager;
+using apache::thrift::concurrency::TimedOutException;
+using apache::thrift::concurrency::TooManyPendingTasksException;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::protocol::TProtocolFactory;
+using apache::thrift::transport::THttp2Headers;
+using apache::thrift::transport::THttp2Session;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TServerTransport;
+using apache::thrift::transport::TTransport;
+using apache::thrift::transport::TTransportException;
+using apache::thrift::transport::TTransportFactory;
+using std::shared_ptr;
+using std::string;
+
+namespace {
+
+// How long a full thread manager queue may hold up reading a connection
+const int64_t ADD_TIMEOUT_MS = 5;
+}
+
+/**
+ * The server end of one connection.  Complete requests are handed to the
+ * thread manager, and answered from its threads.
+ */
+class THttp2Server::Session : public THttp2Session,
+                              public std::enable_shared_from_this<Session> {
+public:
+  Session(THttp2Server* server,
+          const shared_ptr<TTransport>& client,
+          const shared_ptr<TProcessor>& processor,
+          void* connectionContext)
+    : THttp2Session(client, true),
+      server_(server),
+      processor_(processor),
+      connectionContext_(connectionContext),
+      calls_(0) {}
+
+  void process(int32_t streamId, const string& method, string& request);
+
+  /// Wait for the calls in flight to finish
+  void drain() {
+    Synchronized s(callMon_);
+    while (calls_ > 0) {
+      callMon_.wait();
+    }
+  }
+
+  void callDone() {
+    Synchronized s(callMon_);
+    if (--calls_ == 0) {
+      callMon_.notifyAll();
+    }
+  }
+
+protected:
+  void onMessage(int32_t streamId, THttp2Headers& headers, string& body) override;
+
+  void onReset(int32_t, uint32_t) override {
+    // A call in flight finds out when it answers
+  }
+
+private:
+  THttp2Server* server_;
+  shared_ptr<TProcessor> processor_;
+  void* connectionContext_;
+
+  concurrency::Monitor callMon_;
+  int64_t calls_;
+};
+
+class THttp2Server::CallTask : public Runnable {
+public:
+  CallTask(const shared_ptr<Session>& session, int32_t streamId, string& method, string& request)
+    : session_(session), streamId_(streamId) {
+    method_.swap(method);
+    request_.swap(request);
+  }
+
+  ~CallTask() override { session_->callDone(); }
+
+  void run() override { session_->process(streamId_, method_, request_); }
+
+private:
+  shared_ptr<Session> session_;
+  int32_t streamId_;
+  string method_;
+  string request_;
+};
+
+class THttp2Server::ConnectionTask : public Runnable {
+public:
+  ConnectionTask(THttp2Server* server, const shared_ptr<TTransport>& client)
+    : server_(server), client_(client) {}
+
+  void run() override { server_->serveConnection(client_); }
+
+private:
+  THttp2Server* server_;
+  shared_ptr<TTransport> client_;
+};
+
+void THttp2Server::Session::onMessage(int32_t streamId, THttp2Headers& headers, string& body) {
+  string method;
+  for (auto& field : headers) {
+    if (field.first == ":method") {
+      method.swap(field.second);
+      break;
+    }
+  }
+
+  {
+    Synchronized s(callMon_);
+    ++calls_;
+  }
+  // The task counts the call done when it goes away, run or not
+  shared_ptr<CallTask> task(new CallTask(shared_from_this(), streamId, method, body));
+
+  // This thread must not wait long for room: the calls that would make
+  // room may themselves be waiting for it to read a WINDOW_UPDATE
+  ThreadManager& threadManager = *server_->threadManager_;
+  size_t pendingMax = threadManager.pendingTaskCountMax();
+  try {
+    if (pendingMax > 0 && threadManager.pendingTaskCount() >= pendingMax) {
+      throw TooManyPendingTasksException();
+    }
+    threadManager.add(task, pendingMax > 0 ? ADD_TIMEOUT_MS : 0);
+  } catch (const TooManyPendingTasksException&) {
+    sendReset(streamId, H2_REFUSED_STREAM);
+  } catch (const TimedOutException&) {
+    sendReset(streamId, H2_REFUSED_STREAM);
+  } catch (const IllegalStateException&) {
+    // Stopping
+    sendReset(streamId, H2_REFUSED_STREAM);
+  }
+}
+
+void THttp2Server::Session::process(int32_t streamId, const string& method, string& request) {
+  try {
+    if (method != "POST") {
+      THttp2Headers headers{{":status", "405"}, {"allow", "POST"}};
+      sendMessage(streamId, headers, nullptr, 0);
+      return;
+    }
+    if (isClosed()) {
+      return;
+    }
+
+    shared_ptr<TMemoryBuffer> input(
+        new TMemoryBuffer(reinterpret_cast<uint8_t*>(&request[0]),
+                          static_cast<uint32_t>(request.size())));
+    shared_ptr<TMemoryBuffer> output(new TMemoryBuffer());
+    shared_ptr<TProtocol> inputProtocol;
+    shared_ptr<TProtocol> outputProtocol;
+    if (!server_->outputProtocolFactory_) {
+      inputProtocol = server_->inputProtocolFactory_->getProtocol(input, output);
+      outputProtocol = inputProtocol;
+    } else {
+      inputProtocol = server_->inputProtocolFactory_->getProtocol(input);
+      outputProtocol = server_->outputProtocolFactory_->getProtocol(output);
+    }
+
+    if (server_->eventHandler_) {
+      server_->eventHandler_->processContext(connectionContext_, getTransport());
+    }
+    try {
+      processor_->process(inputProtocol, outputProtocol, connectionContext_);
+    } catch (const TException& tx) {
+      string errStr = string("THttp2Server call failed: ") + tx.what();
+      GlobalOutput(errStr.c_str());
+      sendReset(streamId, H2_INTERNAL_ERROR);
+      return;
+    }
+
+    uint8_t* buf;
+    uint32_t len;
+    output->getBuffer(&buf, &len);
+    THttp2Headers headers{{":status", "200"}, {"content-type", "application/x-thrift"}};
+    sendMessage(streamId, headers, buf, len);
+  } catch (const TTransportException&) {
+    // The connection is gone; its thread reports why
+  }
+}
+
+THttp2Server::THttp2Server(const shared_ptr<TProcessorFactory>& processorFactory,
+                           const shared_ptr<TServerTransport>& serverTransport,
+                           const shared_ptr<TProtocolFactory>& protocolFactory,
+                           const shared_ptr<ThreadManager>& threadManager)
+  : TServer(processorFactory,
+            serverTransport,
+            std::make_shared<TTransportFactory>(),
+            protocolFactory),
+    threadManager_(threadManager),
+    threadFactory_(true),
+    maxConcurrentStreams_(THttp2Session::DEFAULT_MAX_CONCURRENT_STREAMS),
+    connections_(0) {
+}
+
+THttp2Server::THttp2Server(const shared_ptr<TProcessor>& processor,
+                           const shared_ptr<TServerTransport>& serverTransport,
+                           const shared_ptr<TProtocolFactory>& protocolFactory,
+                           const shared_ptr<ThreadManager>& threadManager)
+  : TServer(processor, serverTransport, std::make_shared<TTransportFactory>(), protocolFactory),
+    threadManager_(threadManager),
+    threadFactory_(true),
+    maxConcurrentStreams_(THttp2Session::DEFAULT_MAX_CONCURRENT_STREAMS),
+    connections_(0) {
+}
+
+THttp2Server::~THttp2Server() = default;
+
+void THttp2Server::serve() {
+  serverTransport_->listen();
+
+  // Run the preServe event to indicate server is now listening
+  // and that it is safe to connect.
+  if (eventHandler_) {
+    eventHandler_->preServe();
+  }
+
+  for (;;) {
+    shared_ptr<TTransport> client;
+    try {
+      client = serverTransport_->accept();
+      {
+        Synchronized s(mon_);
+        ++connections_;
+      }
+      try {
+        threadFactory_.newThread(std::make_shared<ConnectionTask>(this, client))->start();
+      } catch (...) {
+        Synchronized s(mon_);
+        --connections_;
+        throw;
+      }
+    } catch (TTransportException& ttx) {
+      if (client) {
+        client->close();
+      }
+      if (ttx.getType() == TTransportException::TIMED_OUT
+          || ttx.getType() == TTransportException::CLIENT_DISCONNECT) {
+        continue;
+      } else if (ttx.getType() == TTransportException::END_OF_FILE
+                 || ttx.getType() == TTransportException::INTERRUPTED) {
+        // Server was interrupted.  This only happens when stopping.
+        break;
+      } else {
+        string errStr = string("TServerTransport died: ") + ttx.what();
+        GlobalOutput(errStr.c_str());
+        break;
+      }
+    }
+  }
+
+  try {
+    serverTransport_->close();
+  } catch (const TTransportException& ttx) {
+    string errStr = string("THttp2Server serverTransport close failed: ") + ttx.what();
+    GlobalOutput(errStr.c_str());
+  }
+
+  {
+    Synchronized s(mon_);
+    while (connections_ > 0) {
+      mon_.wait();
+    }
+  }
+  threadManager_->stop();
+}
+
+void THttp2Server::stop() {
+  // Closing the connections ends their sessions
+  serverTransport_->interruptChildren();
+  serverTransport_->interrupt();
+}
+
+void THttp2Server::serveConnection(shared_ptr<TTransport> client) {
+  shared_ptr<TProtocol> inputProtocol;
+  shared_ptr<TProtocol> outputProtocol;
+  if (!outputProtocolFactory_) {
+    inputProtocol = inputProtocolFactory_->getProtocol(client, client);
+    outputProtocol = inputProtocol;
+  } else {
+    inputProtocol = inputProtocolFactory_->getProtocol(client);
+    outputProtocol = outputProtocolFactory_->getProtocol(client);
+  }
+
+  void* context = nullptr;
+  shared_ptr<Session> session;
+  try {
+    shared_ptr<TProcessor> processor = getProcessor(inputProtocol, outputProtocol, client);
+    if (eventHandler_) {
+      context = eventHandler_->createContext(inputProtocol, outputProtocol);
+    }
+    session = std::make_shared<Session>(this, client, processor, context);
+    session->setMaxConcurrentStreams(maxConcurrentStreams_);
+    session->start();
+    while (session->readFrame()) {
+    }
+  } catch (const TTransportException& ttx) {
+    switch (ttx.getType()) {
+    case TTransportException::END_OF_FILE:
+    case TTransportException::INTERRUPTED:
+    case TTransportException::NOT_OPEN:
+    case TTransportException::TIMED_OUT:
+      break;
+    default: {
+      string errStr = string("THttp2Server client died: ") + ttx.what();
+      GlobalOutput(errStr.c_str());
+    }
+    }
+  } catch (const std::exception& x) {
+    GlobalOutput.printf("THttp2Server connection failed: %s", x.what());
+  }
+
+  if (session) {
+    session->close();
+    session->drain();
+    session.reset();
+  }
+  if (eventHandler_) {
+    eventHandler_->deleteContext(context, inputProtocol, outputProtocol);
+  }
+  try {
+    client->close();
+  } catch (const TTransportException& ttx) {
+    string errStr = string("THttp2Server client close failed: ") + ttx.what();
+    GlobalOutput(errStr.c_str());
+  }
+
+  Synchronized s(mon_);
+  if (--connections_ == 0) {
+    mon_.notifyAll();
+  }
+}
+}
+}
+} // apache::thrift::server
@@ -0,0 +1,95 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_SERVER_THTTP2SERVER_H_
+#define _THRIFT_SERVER_THTTP2SERVER_H_ 1
+
+#include <thrift/concurrency/Monitor.h>
+#include <thrift/concurrency/ThreadFactory.h>
+#include <thrift/concurrency/ThreadManager.h>
+#include <thrift/server/TServer.h>
+#include <thrift/transport/THttp2Session.h>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+/**
+ * Serves Thrift over h2c: HTTP/2 without TLS, with prior knowledge, as
+ * used by THttp2Client.  Every call is a POST on a stream of its own, so a
+ * client may have many calls in flight on one connection, answered in any
+ * order.
+ *
+ * Each connection has a thread that reads it; calls are run by the
+ * ThreadManager, which must be started by the caller and is stopped when
+ * serve() returns.  A call that the manager has no room for, or that
+ * exceeds the streams allowed per connection, is refused with
+ * REFUSED_STREAM, which tells the client it is safe to retry.
+ */
+class THttp2Server : public TServer {
+public:
+  THttp2Server(
+      const std::shared_ptr<apache::thrift::TProcessorFactory>& processorFactory,
+      const std::shared_ptr<apache::thrift::transport::TServerTransport>& serverTransport,
+      const std::shared_ptr<apache::thrift::protocol::TProtocolFactory>& protocolFactory,
+      const std::shared_ptr<apache::thrift::concurrency::ThreadManager>& threadManager);
+
+  THttp2Server(
+      const std::shared_ptr<apache::thrift::TProcessor>& processor,
+      const std::shared_ptr<apache::thrift::transport::TServerTransport>& serverTransport,
+      const std::shared_ptr<apache::thrift::protocol::TProtocolFactory>& protocolFactory,
+      const std::shared_ptr<apache::thrift::concurrency::ThreadManager>& threadManager);
+
+  ~THttp2Server() override;
+
+  /**
+   * Post-conditions (return guarantees):
+   *   There will be no clients connected.
+   */
+  void serve() override;
+
+  void stop() override;
+
+  /// Calls a connection may have in flight
+  void setMaxConcurrentStreams(uint32_t streams) { maxConcurrentStreams_ = streams; }
+  uint32_t getMaxConcurrentStreams() const { return maxConcurrentStreams_; }
+
+  std::shared_ptr<apache::thrift::concurrency::ThreadManager> getThreadManager() const {
+    return threadManager_;
+  }
+
+private:
+  class Session;
+  class CallTask;
+  class ConnectionTask;
+
+  void serveConnection(std::shared_ptr<apache::thrift::transport::TTransport> client);
+
+  std::shared_ptr<apache::thrift::concurrency::ThreadManager> threadManager_;
+  apache::thrift::concurrency::ThreadFactory threadFactory_;
+  uint32_t maxConcurrentStreams_;
+
+  apache::thrift::concurrency::Monitor mon_;
+  int64_t connections_;
+};
+}
+}
+} // apache::thrift::server
+
+#endif // #ifndef _THRIFT_SERVER_THTTP2SERVER_H_
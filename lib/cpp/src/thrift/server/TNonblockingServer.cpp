@@ -20,12 +20,15 @@
 #include <thrift/thrift-config.h>
 
 #include <thrift/server/TNonblockingServer.h>
+#include <thrift/TDeadline.h>
 #include <thrift/concurrency/Exception.h>
 #include <thrift/transport/TSocket.h>
+#include <thrift/concurrency/ThreadAffinity.h>
 #include <thrift/concurrency/ThreadFactory.h>
 #include <thrift/transport/PlatformSocket.h>
 
 #include <algorithm>
+#include <chrono>
 #include <iostream>
 
 #ifdef HAVE_POLL_H
@@ -86,20 +89,24 @@ using apache::thrift::transport::TSocket;
 using apache::thrift::transport::TTransportException;
 using std::shared_ptr;
 
-/// Three states for sockets: recv frame size, recv data, and send mode
-enum TSocketState { SOCKET_RECV_FRAMING, SOCKET_RECV, SOCKET_SEND };
+/// Four states for sockets: handshake, recv frame size, recv data, and send mode
+enum TSocketState { SOCKET_HANDSHAKE, SOCKET_RECV_FRAMING, SOCKET_RECV, SOCKET_SEND };
 
 /**
- * Five states for the nonblocking server:
- *  1) initialize
- *  2) read 4 byte frame size
- *  3) read frame of data
- *  4) send back data (if any)
- *  5) force immediate connection close
+ * Six states for the nonblocking server:
+ *  1) handshake (e.g. TLS), possibly on the handshake thread pool
+ *  2) initialize
+ *  3) read 4 byte frame size
+ *  4) read frame of data
+ *  5) send back data (if any)
+ *  6) force immediate connection close
  */
 enum TAppState {
+  APP_HANDSHAKE,
+  APP_WAIT_HANDSHAKE,
   APP_INIT,
   APP_READ_FRAME_SIZE,
+  APP_WAIT_BUFFER,
   APP_READ_REQUEST,
   APP_WAIT_TASK,
   APP_SEND_RESULT,
@@ -115,6 +122,9 @@ private:
   /// Server IO Thread handling this connection
   TNonblockingIOThread* ioThread_;
 
+  /// NUMA node of ioThread_, kept after close() to pick the idle stack
+  int numaNode_;
+
   /// Server handle
   TNonblockingServer* server_;
 
@@ -163,6 +173,36 @@ private:
   /// Count of the number of calls for use with getResizeBufferEveryN().
   int32_t callsForResize_;
 
+  /// Server buffer pool the read and write buffers are borrowed from, if any
+  TBufferPool* bufferPool_;
+
+  /// Capacity of the write buffer borrowed from bufferPool_, 0 if none
+  uint32_t writeBufferBorrowed_;
+
+  /// Timer that retries borrowing a read buffer while over the memory limit
+  struct event retryEvent_;
+
+  /// Is retryEvent_ pending?
+  bool retryPending_;
+
+  /// Server concurrency limiter, if any
+  TConcurrencyLimiter* limiter_;
+
+  /// Does the current call hold a slot of limiter_?
+  bool limiterAcquired_;
+
+  /// Has a call been answered on this connection?
+  bool servedCall_;
+
+  /// When the current call was admitted by limiter_
+  std::chrono::steady_clock::time_point limiterStart_;
+
+  /// Outcome of the last handshake step
+  TSocket::HandshakeStatus handshakeStatus_;
+
+  /// Why the last handshake step failed on the handshake pool, if it did
+  std::string handshakeError_;
+
   /// Transport to read from
   std::shared_ptr<TMemoryBuffer> inputTransport_;
 
@@ -209,8 +249,57 @@ private:
    */
   void workSocket();
 
+  /**
+   * Make readBuffer_ large enough for readWant_ bytes.
+   *
+   * @return false if the buffer pool deferred the request.
+   */
+  bool allocateReadBuffer();
+
+  /// Give borrowed buffers back to the buffer pool
+  void releaseReadBuffer();
+  void releaseWriteBuffer();
+
+  /**
+   * Decide the TaskClass of the call just read with the server's task
+   * classifier.
+   */
+  TaskClass classifyTask();
+
+  /**
+   * Ask limiter_, if any, to admit the call just read.
+   *
+   * @return false if the call is over the limit and must be rejected.
+   */
+  bool admitCall();
+
+  /// Report the end of the current call to limiter_, if it was admitted
+  void releaseLimit(bool dropped);
+
+  /**
+   * Advance the socket's handshake, on the server's handshake pool if it
+   * has one.  Never blocks the IO thread.
+   */
+  void handshake();
+
+  /// Wait for what the handshake needs next, or start reading once it is done
+  void handshakeStepped();
+
+  /// Libevent callback for retryEvent_
+  static void retryHandler(evutil_socket_t, short, void* v) {
+    auto* connection = static_cast<TConnection*>(v);
+    connection->retryPending_ = false;
+    connection->transition();
+    // As in workSocket(), data may already sit in the socket's own buffers
+    if (connection->appState_ == APP_READ_REQUEST
+        && connection->tSocket_->hasPendingDataToRead()) {
+      connection->workSocket();
+    }
+  }
+
 public:
   class Task;
+  class HandshakeTask;
 
   /// Constructor
   TConnection(std::shared_ptr<TSocket> socket,
@@ -222,10 +311,14 @@ public:
     server_ = ioThread->getServer();
 
     // Allocate input and output transports these only need to be allocated
-    // once per TConnection (they don't need to be reallocated on init() call)
+    // once per TConnection (they don't need to be reallocated on init() call).
+    // With a buffer pool the output buffer is only attached while in use, and
+    // with NUMA placement it is left to grow on the connection's own node.
     inputTransport_.reset(new TMemoryBuffer(readBuffer_, readBufferSize_));
-    outputTransport_.reset(
-        new TMemoryBuffer(static_cast<uint32_t>(server_->getWriteBufferDefaultSize())));
+    outputTransport_.reset(new TMemoryBuffer(
+        server_->getBufferPool() || server_->getNumaPlacement()
+            ? 0
+            : static_cast<uint32_t>(server_->getWriteBufferDefaultSize())));
 
     tSocket_ =  socket;
 
@@ -304,6 +397,27 @@ public:
   /// get state of connection.
   TAppState getState() const { return appState_; }
 
+  /// return the IO thread handling this connection, if open
+  TNonblockingIOThread* getIOThread() const { return ioThread_; }
+
+  /// return the NUMA node of the IO thread this connection was last on
+  int getNumaNode() const { return numaNode_; }
+
+  /**
+   * Has this connection answered a call and received nothing of the next
+   * one?  A draining server closes it then.
+   */
+  bool isIdle() {
+    if (!servedCall_ || appState_ != APP_READ_FRAME_SIZE || readBufferPos_ != 0) {
+      return false;
+    }
+    try {
+      return !tSocket_->hasPendingDataToRead();
+    } catch (const TTransportException&) {
+      return true;
+    }
+  }
+
   /// return the TSocket transport wrapping this network connection
   std::shared_ptr<TSocket> getTSocket() const { return tSocket_; }
 
@@ -325,9 +439,14 @@ public:
       output_(output),
       connection_(connection),
       serverEventHandler_(connection_->getServerEventHandler()),
-      connectionContext_(connection_->getConnectionContext()) {}
+      connectionContext_(connection_->getConnectionContext()),
+      received_(TDeadline::clock::now()) {}
 
   void run() override {
+    // Deadlines sent with the request also cover its time in the task queue
+    TDeadlineScope deadlineScope;
+    TDeadline::setReceived(received_);
+
     try {
       for (;;) {
         if (serverEventHandler_) {
@@ -369,12 +488,43 @@ private:
   TConnection* connection_;
   std::shared_ptr<TServerEventHandler> serverEventHandler_;
   void* connectionContext_;
+  TDeadline::clock::time_point received_;
+};
+
+/// Runs one handshake step on the server's handshake thread pool
+class TNonblockingServer::TConnection::HandshakeTask : public Runnable {
+public:
+  explicit HandshakeTask(TConnection* connection) : connection_(connection) {}
+
+  void run() override {
+    // The connection is idle meanwhile, so the IO thread leaves the socket alone
+    connection_->handshakeError_.clear();
+    try {
+      connection_->handshakeStatus_ = connection_->tSocket_->handshakeStep();
+    } catch (const std::exception& x) {
+      connection_->handshakeError_ = x.what();
+      if (connection_->handshakeError_.empty()) {
+        connection_->handshakeError_ = "handshake failed";
+      }
+    }
+
+    // Hand the connection back to its IO thread
+    if (!connection_->notifyIOThread()) {
+      GlobalOutput.printf("TNonblockingServer: failed to notifyIOThread, closing.");
+      connection_->close();
+      throw TException("TNonblockingServer::HandshakeTask::run: failed write on notify pipe");
+    }
+  }
+
+private:
+  TConnection* connection_;
 };
 
 void TNonblockingServer::TConnection::init(TNonblockingIOThread* ioThread) {
   ioThread_ = ioThread;
+  numaNode_ = ioThread->getNumaNode();
   server_ = ioThread->getServer();
-  appState_ = APP_INIT;
+  appState_ = APP_HANDSHAKE;
   eventFlags_ = 0;
 
   readBufferPos_ = 0;
@@ -385,9 +535,17 @@ void TNonblockingServer::TConnection::init(TNonblockingIOThread* ioThread) {
   writeBufferPos_ = 0;
   largestWriteBufferSize_ = 0;
 
-  socketState_ = SOCKET_RECV_FRAMING;
+  socketState_ = SOCKET_HANDSHAKE;
   callsForResize_ = 0;
 
+  bufferPool_ = server_->getBufferPool().get();
+  writeBufferBorrowed_ = 0;
+  retryPending_ = false;
+
+  limiter_ = server_->getConcurrencyLimiter().get();
+  limiterAcquired_ = false;
+  servedCall_ = false;
+
   // get input/transports
   factoryInputTransport_ = server_->getInputTransportFactory()->getTransport(inputTransport_);
   factoryOutputTransport_ = server_->getOutputTransportFactory()->getTransport(outputTransport_);
@@ -424,6 +582,15 @@ void TNonblockingServer::TConnection::workSocket() {
     uint32_t fetch = 0;
 
     switch (socketState_) {
+    case SOCKET_HANDSHAKE:
+      handshake();
+      // The client's first frame may have arrived along with the end of the
+      // handshake, in which case it already sits in the socket's buffers
+      if (socketState_ == SOCKET_RECV_FRAMING && tSocket_->hasPendingDataToRead()) {
+        continue;
+      }
+      return;
+
     case SOCKET_RECV_FRAMING:
       union {
         uint8_t buf[sizeof(uint32_t)];
@@ -483,8 +650,9 @@ void TNonblockingServer::TConnection::workSocket() {
       // readiness, which will in turn call workSocket(). However, some socket types (such as TSSLSocket) may have the
       // data sitting in their internal buffers and from libevent's perspective, there is no further data available. In
       // that case, not trying another processing cycle here would result in a hang as we will never get to work the socket,
-      // despite having more data.
-      if (tSocket_->hasPendingDataToRead())
+      // despite having more data.  A connection waiting for a buffer from the
+      // pool is not reading.
+      if (socketState_ == SOCKET_RECV && tSocket_->hasPendingDataToRead())
       {
           continue;
       }
@@ -597,9 +765,33 @@ void TNonblockingServer::TConnection::transition() {
   // Switch upon the state that we are currently in and move to a new state
   switch (appState_) {
 
+  case APP_HANDSHAKE:
+    // A new connection: handshake before the first frame
+    handshake();
+    return;
+
+  case APP_WAIT_HANDSHAKE:
+    // The handshake pool has finished a step
+    if (!handshakeError_.empty()) {
+      GlobalOutput.printf("TConnection::transition(): %s", handshakeError_.c_str());
+      close();
+      return;
+    }
+    handshakeStepped();
+    // As in workSocket()
+    if (socketState_ == SOCKET_RECV_FRAMING && tSocket_->hasPendingDataToRead()) {
+      workSocket();
+    }
+    return;
+
   case APP_READ_REQUEST:
     // We are done reading the request, package the read buffer into transport
     // and get back some data from the dispatch function
+    if (bufferPool_) {
+      uint8_t* buffer = bufferPool_->borrow(
+          static_cast<uint32_t>(server_->getWriteBufferDefaultSize()), &writeBufferBorrowed_);
+      outputTransport_->adoptBuffer(buffer, writeBufferBorrowed_);
+    }
     if (server_->getHeaderTransport()) {
       inputTransport_->resetBuffer(readBuffer_, readBufferPos_);
       outputTransport_->resetBuffer();
@@ -617,7 +809,19 @@ void TNonblockingServer::TConnection::transition() {
 
     server_->incrementActiveProcessors();
 
-    if (server_->isThreadPoolProcessing()) {
+    if (!admitCall()) {
+      // Over the limit: answer right here instead of queueing the call
+      try {
+        TConcurrencyLimiter::reject(inputProtocol_.get(), outputProtocol_.get());
+      } catch (const std::exception& x) {
+        GlobalOutput.printf("TNonblockingServer: rejecting call failed: %s: %s",
+                            typeid(x).name(),
+                            x.what());
+        server_->decrementActiveProcessors();
+        close();
+        return;
+      }
+    } else if (server_->isThreadPoolProcessing()) {
       // We are setting up a Task to do this work and we will wait on it
 
       // Create task and dispatch to the thread manager
@@ -632,7 +836,7 @@ void TNonblockingServer::TConnection::transition() {
       setIdle();
 
       try {
-        server_->addTask(task);
+        server_->addTask(task, classifyTask(), numaNode_);
       } catch (IllegalStateException& ise) {
         // The ThreadManager is not ready to handle any more tasks (it's probably shutting down).
         GlobalOutput.printf("IllegalStateException: Server::process() %s", ise.what());
@@ -685,6 +889,10 @@ void TNonblockingServer::TConnection::transition() {
     // the writeBuffer_ for actual writing by the libevent thread
 
     server_->decrementActiveProcessors();
+    releaseLimit(false);
+    servedCall_ = true;
+    // The request has been consumed
+    releaseReadBuffer();
     // Get the result of the operation
     outputTransport_->getBuffer(&writeBuffer_, &writeBufferSize_);
 
@@ -731,6 +939,7 @@ void TNonblockingServer::TConnection::transition() {
   case APP_INIT:
 
     // Clear write buffer variables
+    releaseWriteBuffer();
     writeBuffer_ = nullptr;
     writeBufferPos_ = 0;
     writeBufferSize_ = 0;
@@ -741,6 +950,11 @@ void TNonblockingServer::TConnection::transition() {
 
     readBufferPos_ = 0;
 
+    if (ioThread_->isDraining() && isIdle()) {
+      close();
+      return;
+    }
+
     // Register read event
     setRead();
 
@@ -748,25 +962,27 @@ void TNonblockingServer::TConnection::transition() {
 
   case APP_READ_FRAME_SIZE:
     readWant_ += 4;
+    // fallthrough
 
+  case APP_WAIT_BUFFER:
     // We just read the request length
-    // Double the buffer size until it is big enough
-    if (readWant_ > readBufferSize_) {
-      if (readBufferSize_ == 0) {
-        readBufferSize_ = 1;
-      }
-      uint32_t newSize = readBufferSize_;
-      while (readWant_ > newSize) {
-        newSize *= 2;
-      }
-
-      auto* newBuffer = (uint8_t*)std::realloc(readBuffer_, newSize);
-      if (newBuffer == nullptr) {
-        // nothing else to be done...
-        throw std::bad_alloc();
+    if (!allocateReadBuffer()) {
+      // The server is over its memory limit: stop reading from this client
+      // and try again shortly, once other connections have given back their
+      // buffers
+      appState_ = APP_WAIT_BUFFER;
+      setIdle();
+      struct timeval retry = {0, BUFFER_RETRY_INTERVAL_USEC};
+      evtimer_set(&retryEvent_, TConnection::retryHandler, this);
+      event_base_set(ioThread_->getEventBase(), &retryEvent_);
+      if (evtimer_add(&retryEvent_, &retry) == -1) {
+        GlobalOutput.perror("TConnection::transition(): could not evtimer_add",
+                            THRIFT_GET_SOCKET_ERROR);
+        close();
+        return;
       }
-      readBuffer_ = newBuffer;
-      readBufferSize_ = newSize;
+      retryPending_ = true;
+      return;
     }
 
     readBufferPos_ = 4;
@@ -776,6 +992,9 @@ void TNonblockingServer::TConnection::transition() {
     socketState_ = SOCKET_RECV;
     appState_ = APP_READ_REQUEST;
 
+    // Resume reading if we were waiting for a buffer
+    setRead();
+
     return;
 
   case APP_CLOSE_CONNECTION:
@@ -789,6 +1008,141 @@ void TNonblockingServer::TConnection::transition() {
   }
 }
 
+bool TNonblockingServer::TConnection::allocateReadBuffer() {
+  if (bufferPool_) {
+    if (readBuffer_ == nullptr) {
+      readBuffer_ = bufferPool_->borrow(readWant_, &readBufferSize_, true);
+    }
+    return readBuffer_ != nullptr;
+  }
+
+  // Double the buffer size until it is big enough
+  if (readWant_ > readBufferSize_) {
+    if (readBufferSize_ == 0) {
+      readBufferSize_ = 1;
+    }
+    uint32_t newSize = readBufferSize_;
+    while (readWant_ > newSize) {
+      newSize *= 2;
+    }
+
+    auto* newBuffer = (uint8_t*)std::realloc(readBuffer_, newSize);
+    if (newBuffer == nullptr) {
+      // nothing else to be done...
+      throw std::bad_alloc();
+    }
+    readBuffer_ = newBuffer;
+    readBufferSize_ = newSize;
+  }
+  return true;
+}
+
+void TNonblockingServer::TConnection::releaseReadBuffer() {
+  if (bufferPool_ && readBuffer_) {
+    bufferPool_->giveBack(readBuffer_, readBufferSize_, readBufferSize_);
+    readBuffer_ = nullptr;
+    readBufferSize_ = 0;
+  }
+}
+
+void TNonblockingServer::TConnection::releaseWriteBuffer() {
+  if (bufferPool_ && writeBufferBorrowed_) {
+    uint32_t capacity;
+    uint8_t* buffer = outputTransport_->releaseBuffer(&capacity);
+    bufferPool_->giveBack(buffer, writeBufferBorrowed_, capacity);
+    writeBufferBorrowed_ = 0;
+  }
+}
+
+TaskClass TNonblockingServer::TConnection::classifyTask() {
+  const TaskClassifier& classifier = server_->getTaskClassifier();
+  if (!classifier) {
+    return TaskClass();
+  }
+
+  // Read the message header from a separate view of the request, leaving
+  // inputTransport_ untouched for the processor
+  TDeadlineScope deadlineScope;
+  try {
+    uint32_t offset = server_->getHeaderTransport() ? 0 : 4;
+    std::shared_ptr<TMemoryBuffer> frame(
+        new TMemoryBuffer(readBuffer_ + offset, readBufferPos_ - offset, TMemoryBuffer::OBSERVE));
+    std::shared_ptr<TProtocol> protocol = server_->getInputProtocolFactory()->getProtocol(
+        server_->getInputTransportFactory()->getTransport(frame));
+    std::string fname;
+    TMessageType mtype;
+    int32_t seqid;
+    protocol->readMessageBegin(fname, mtype, seqid);
+    return classifier(fname, *protocol);
+  } catch (const std::exception& x) {
+    // The processor reports malformed requests when it reads them
+    GlobalOutput.printf("TNonblockingServer: cannot classify task: %s", x.what());
+    return TaskClass();
+  }
+}
+
+bool TNonblockingServer::TConnection::admitCall() {
+  if (!limiter_) {
+    return true;
+  }
+  if (!limiter_->tryAcquire()) {
+    return false;
+  }
+  limiterAcquired_ = true;
+  limiterStart_ = std::chrono::steady_clock::now();
+  return true;
+}
+
+void TNonblockingServer::TConnection::releaseLimit(bool dropped) {
+  if (limiterAcquired_) {
+    limiterAcquired_ = false;
+    limiter_->release(std::chrono::steady_clock::now() - limiterStart_, dropped);
+  }
+}
+
+void TNonblockingServer::TConnection::handshake() {
+  std::shared_ptr<ThreadManager> handshakeThreadManager = server_->getHandshakeThreadManager();
+  if (handshakeThreadManager) {
+    appState_ = APP_WAIT_HANDSHAKE;
+    setIdle();
+    try {
+      // Never wait for room in the pool's queue on the IO thread
+      handshakeThreadManager->add(std::make_shared<HandshakeTask>(this), -1LL);
+    } catch (const TException& x) {
+      GlobalOutput.printf("TConnection::handshake(): %s", x.what());
+      close();
+    }
+    return;
+  }
+
+  try {
+    handshakeStatus_ = tSocket_->handshakeStep();
+  } catch (const TTransportException& te) {
+    GlobalOutput.printf("TConnection::handshake(): %s", te.what());
+    close();
+    return;
+  }
+  handshakeStepped();
+}
+
+void TNonblockingServer::TConnection::handshakeStepped() {
+  switch (handshakeStatus_) {
+  case TSocket::HANDSHAKE_WANT_READ:
+    appState_ = APP_HANDSHAKE;
+    setRead();
+    return;
+
+  case TSocket::HANDSHAKE_WANT_WRITE:
+    appState_ = APP_HANDSHAKE;
+    setWrite();
+    return;
+
+  default:
+    appState_ = APP_INIT;
+    transition();
+  }
+}
+
 void TNonblockingServer::TConnection::setFlags(short eventFlags) {
   // Catch the do nothing case
   if (eventFlags_ == eventFlags) {
@@ -851,9 +1205,18 @@ void TNonblockingServer::TConnection::setFlags(short eventFlags) {
 void TNonblockingServer::TConnection::close() {
   setIdle();
 
+  if (retryPending_) {
+    evtimer_del(&retryEvent_);
+    retryPending_ = false;
+  }
+  releaseReadBuffer();
+  releaseWriteBuffer();
+  releaseLimit(true);
+
   if (serverEventHandler_) {
     serverEventHandler_->deleteContext(connectionContext_, inputProtocol_, outputProtocol_);
   }
+  TNonblockingIOThread* ioThread = ioThread_;
   ioThread_ = nullptr;
 
   // Close the socket
@@ -868,9 +1231,17 @@ void TNonblockingServer::TConnection::close() {
 
   // Give this object back to the server that owns it
   server_->returnConnection(this);
+  if (ioThread) {
+    ioThread->connectionClosed();
+  }
 }
 
 void TNonblockingServer::TConnection::checkIdleBufferMemLimit(size_t readLimit, size_t writeLimit) {
+  if (bufferPool_) {
+    // Pooled buffers are not kept while idle
+    return;
+  }
+
   if (readLimit > 0 && readBufferSize_ > readLimit) {
     free(readBuffer_);
     readBuffer_ = nullptr;
@@ -889,11 +1260,13 @@ TNonblockingServer::~TNonblockingServer() {
   while (!activeConnections_.empty()) {
     (*activeConnections_.begin())->close();
   }
-  // Clean up unused TConnection objects in connectionStack_
-  while (!connectionStack_.empty()) {
-    TConnection* connection = connectionStack_.top();
-    connectionStack_.pop();
-    delete connection;
+  // Clean up unused TConnection objects in connectionStacks_
+  for (auto& connectionStack : connectionStacks_) {
+    while (!connectionStack.empty()) {
+      TConnection* connection = connectionStack.top();
+      connectionStack.pop();
+      delete connection;
+    }
   }
   // The TNonblockingIOThread objects have shared_ptrs to the Thread
   // objects and the Thread objects have shared_ptrs to the TNonblockingIOThread
@@ -920,19 +1293,22 @@ TNonblockingServer::TConnection* TNonblockingServer::createConnection(std::share
 
   TNonblockingIOThread* ioThread = ioThreads_[selectedThreadIdx].get();
 
-  // Check the connection stack to see if we can re-use
+  // Check the connection stack of the thread's node to see if we can re-use
+  std::stack<TConnection*>& connectionStack = connectionStacks_[std::max(ioThread->getNumaNode(), 0)];
   TConnection* result = nullptr;
-  if (connectionStack_.empty()) {
+  if (connectionStack.empty()) {
     result = new TConnection(socket, ioThread);
     ++numTConnections_;
   } else {
-    result = connectionStack_.top();
-    connectionStack_.pop();
+    result = connectionStack.top();
+    connectionStack.pop();
+    --numIdleConnections_;
     result->setSocket(socket);
     result->init(ioThread);
   }
 
   activeConnections_.insert(result);
+  ioThread->connectionOpened();
   return result;
 }
 
@@ -943,12 +1319,13 @@ void TNonblockingServer::returnConnection(TConnection* connection) {
   Guard g(connMutex_);
 
   activeConnections_.erase(connection);
-  if (connectionStackLimit_ && (connectionStack_.size() >= connectionStackLimit_)) {
+  if (connectionStackLimit_ && (numIdleConnections_ >= connectionStackLimit_)) {
     delete connection;
     --numTConnections_;
   } else {
     connection->checkIdleBufferMemLimit(idleReadBufferLimit_, idleWriteBufferLimit_);
-    connectionStack_.push(connection);
+    connectionStacks_[std::max(connection->getNumaNode(), 0)].push(connection);
+    ++numIdleConnections_;
   }
 }
 
@@ -964,7 +1341,15 @@ void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
   // Going to accept a new client socket
   std::shared_ptr<TSocket> clientSocket;
 
-  clientSocket = serverTransport_->accept();
+  try {
+    clientSocket = serverTransport_->accept();
+  } catch (const TTransportException& ttx) {
+    if (ttx.getType() == TTransportException::TIMED_OUT) {
+      // Another process sharing the socket took the connection
+      return;
+    }
+    throw;
+  }
   if (clientSocket) {
     // If we're overloaded, take action here
     if (overloadAction_ != T_OVERLOAD_NO_ACTION && serverOverloaded()) {
@@ -1034,12 +1419,39 @@ void TNonblockingServer::setThreadManager(std::shared_ptr<ThreadManager> threadM
                                      std::placeholders::_1));
     threadPoolProcessing_ = true;
   } else {
-    threadPoolProcessing_ = false;
+    threadPoolProcessing_ = !nodeThreadManagers_.empty();
+  }
+}
+
+void TNonblockingServer::setNodeThreadManager(int node, std::shared_ptr<ThreadManager> threadManager) {
+  if (node < 0) {
+    throw TException("TNonblockingServer::setNodeThreadManager: negative node");
+  }
+  if (nodeThreadManagers_.size() <= static_cast<size_t>(node)) {
+    nodeThreadManagers_.resize(node + 1);
+  }
+  nodeThreadManagers_[node] = threadManager;
+  if (threadManager) {
+    threadManager->setExpireCallback(
+        std::bind(&TNonblockingServer::expireClose, this, std::placeholders::_1));
+  }
+
+  // Forget about nodes left without one
+  while (!nodeThreadManagers_.empty() && !nodeThreadManagers_.back()) {
+    nodeThreadManagers_.pop_back();
+  }
+  threadPoolProcessing_ = threadManager_ || !nodeThreadManagers_.empty();
+}
+
+std::shared_ptr<ThreadManager> TNonblockingServer::getNodeThreadManager(int node) const {
+  if (node < 0 || static_cast<size_t>(node) >= nodeThreadManagers_.size()) {
+    return std::shared_ptr<ThreadManager>();
   }
+  return nodeThreadManagers_[node];
 }
 
 bool TNonblockingServer::serverOverloaded() {
-  size_t activeConnections = numTConnections_ - connectionStack_.size();
+  size_t activeConnections = numTConnections_ - numIdleConnections_;
   if (numActiveProcessors_ > maxActiveProcessors_ || activeConnections > maxConnections_) {
     if (!overloaded_) {
       GlobalOutput.printf("TNonblockingServer: overload condition begun.");
@@ -1062,8 +1474,13 @@ bool TNonblockingServer::serverOverloaded() {
 }
 
 bool TNonblockingServer::drainPendingTask() {
-  if (threadManager_) {
-    std::shared_ptr<Runnable> task = threadManager_->removeNextPending();
+  std::vector<std::shared_ptr<ThreadManager> > threadManagers(nodeThreadManagers_);
+  threadManagers.push_back(threadManager_);
+  for (const auto& threadManager : threadManagers) {
+    if (!threadManager) {
+      continue;
+    }
+    std::shared_ptr<Runnable> task = threadManager->removeNextPending();
     if (task) {
       TConnection* connection = static_cast<TConnection::Task*>(task.get())->getTConnection();
       assert(connection && connection->getServer() && connection->getState() == APP_WAIT_TASK);
@@ -1087,6 +1504,30 @@ void TNonblockingServer::stop() {
   }
 }
 
+void TNonblockingServer::drain(int64_t timeoutMs) {
+  for (auto & ioThread : ioThreads_) {
+    ioThread->drain(timeoutMs);
+  }
+}
+
+void TNonblockingServer::closeIdleConnections(TNonblockingIOThread* ioThread) {
+  std::vector<TConnection*> connections;
+  {
+    Guard g(connMutex_);
+    for (TConnection* connection : activeConnections_) {
+      if (connection->getIOThread() == ioThread) {
+        connections.push_back(connection);
+      }
+    }
+  }
+  // Only ioThread changes or closes these
+  for (TConnection* connection : connections) {
+    if (connection->isIdle()) {
+      connection->close();
+    }
+  }
+}
+
 void TNonblockingServer::registerEvents(event_base* user_event_base) {
   userEventBase_ = user_event_base;
 
@@ -1102,12 +1543,27 @@ void TNonblockingServer::registerEvents(event_base* user_event_base) {
   // User-provided event-base doesn't works for multi-threaded servers
   assert(numIOThreads_ == 1 || !userEventBase_);
 
+  std::vector<int> nodes;
+  if (numaPlacement_) {
+    nodes = ThreadAffinity::numaNodes();
+  }
+  connectionStacks_.resize(nodes.empty() ? 1 : *std::max_element(nodes.begin(), nodes.end()) + 1);
+
   for (uint32_t id = 0; id < numIOThreads_; ++id) {
     // the first IO thread also does the listening on server socket
     THRIFT_SOCKET listenFd = (id == 0 ? serverSocket_ : THRIFT_INVALID_SOCKET);
 
     shared_ptr<TNonblockingIOThread> thread(
         new TNonblockingIOThread(this, id, listenFd, useHighPriorityIOThreads_));
+    if (!nodes.empty()) {
+      int node = nodes[id % nodes.size()];
+      thread->setNumaNode(node, ThreadAffinity::nodeCpus(node));
+    }
+    if (threadPoolProcessing_ && !threadManager_ && !getNodeThreadManager(thread->getNumaNode())) {
+      ioThreads_.clear();
+      throw TException("TNonblockingServer: no thread manager for the calls of IO thread #"
+                       + std::to_string(id));
+    }
     ioThreads_.push_back(thread);
   }
 
@@ -1173,10 +1629,17 @@ TNonblockingIOThread::TNonblockingIOThread(TNonblockingServer* server,
     threadId_{},
     listenSocket_(listenSocket),
     useHighPriority_(useHighPriority),
+    numaNode_(-1),
     eventBase_(nullptr),
     ownEventBase_(false),
     serverEvent_{},
-    notificationEvent_{} {
+    notificationEvent_{},
+    drainRequested_(false),
+    drainTimeoutMs_(0),
+    draining_(false),
+    drainTimer_{},
+    drainTimerPending_(false),
+    numConnections_(0) {
   notificationPipeFDs_[0] = -1;
   notificationPipeFDs_[1] = -1;
 }
@@ -1190,12 +1653,9 @@ TNonblockingIOThread::~TNonblockingIOThread() {
     ownEventBase_ = false;
   }
 
-  if (listenSocket_ != THRIFT_INVALID_SOCKET) {
-    if (0 != ::THRIFT_CLOSESOCKET(listenSocket_)) {
-      GlobalOutput.perror("TNonblockingIOThread listenSocket_ close(): ", THRIFT_GET_SOCKET_ERROR);
-    }
-    listenSocket_ = THRIFT_INVALID_SOCKET;
-  }
+  // The listen socket belongs to the server transport, which closes it (or
+  // leaves it open for the process it was handed to)
+  listenSocket_ = THRIFT_INVALID_SOCKET;
 
   for (auto notificationPipeFD : notificationPipeFDs_) {
     if (notificationPipeFD >= 0) {
@@ -1389,6 +1849,11 @@ void TNonblockingIOThread::notifyHandler(evutil_socket_t fd, short which, void*
     long nBytes = recv(fd, cast_sockopt(&connection), kSize, 0);
     if (nBytes == kSize) {
       if (connection == nullptr) {
+        if (ioThread->drainRequested_.exchange(false)) {
+          // this is the command to drain, from drain()
+          ioThread->beginDrain();
+          continue;
+        }
         // this is the command to stop our thread, exit the handler!
         ioThread->breakLoop(false);
         return;
@@ -1438,6 +1903,67 @@ void TNonblockingIOThread::breakLoop(bool error) {
   }
 }
 
+void TNonblockingIOThread::drain(int64_t timeoutMs) {
+  drainTimeoutMs_ = timeoutMs;
+  if (Thread::is_current(threadId_)) {
+    beginDrain();
+  } else {
+    drainRequested_ = true;
+    notify(nullptr);
+  }
+}
+
+void TNonblockingIOThread::beginDrain() {
+  if (draining_) {
+    return;
+  }
+  draining_ = true;
+
+  // Stop accepting; the socket itself stays open, as another process may
+  // be accepting on it by now
+  if (listenSocket_ != THRIFT_INVALID_SOCKET) {
+    if (event_del(&serverEvent_) == -1) {
+      GlobalOutput.perror("TNonblockingIOThread::beginDrain() event_del: ",
+                          THRIFT_GET_SOCKET_ERROR);
+    }
+  }
+
+  int64_t timeoutMs = drainTimeoutMs_;
+  struct timeval timeout;
+  timeout.tv_sec = static_cast<long>(timeoutMs / 1000);
+  timeout.tv_usec = static_cast<long>((timeoutMs % 1000) * 1000);
+  evtimer_set(&drainTimer_, TNonblockingIOThread::drainTimeoutHandler, this);
+  event_base_set(eventBase_, &drainTimer_);
+  if (evtimer_add(&drainTimer_, &timeout) == -1) {
+    GlobalOutput.perror("TNonblockingIOThread::beginDrain() evtimer_add: ",
+                        THRIFT_GET_SOCKET_ERROR);
+    breakLoop(false);
+    return;
+  }
+  drainTimerPending_ = true;
+
+  server_->closeIdleConnections(this);
+  if (numConnections_ == 0) {
+    breakLoop(false);
+  }
+}
+
+/* static */
+void TNonblockingIOThread::drainTimeoutHandler(evutil_socket_t fd, short which, void* v) {
+  (void)fd;
+  (void)which;
+  auto* ioThread = static_cast<TNonblockingIOThread*>(v);
+  ioThread->drainTimerPending_ = false;
+  GlobalOutput.printf("TNonblockingServer: IO thread #%d drain timed out.", ioThread->number_);
+  ioThread->breakLoop(false);
+}
+
+void TNonblockingIOThread::connectionClosed() {
+  if (--numConnections_ == 0 && draining_) {
+    breakLoop(false);
+  }
+}
+
 void TNonblockingIOThread::setCurrentThreadHighPriority(bool value) {
 #ifdef HAVE_SCHED_H
   // Start out with a standard, low-priority setup for the sched params.
@@ -1468,6 +1994,20 @@ void TNonblockingIOThread::setCurrentThreadHighPriority(bool value) {
 }
 
 void TNonblockingIOThread::run() {
+  // Pinned first, so that the secondary IO threads allocate their event base
+  // on their node too.  The first IO thread runs in serve()'s caller, which
+  // gets its CPUs back at the end.
+  std::vector<int> callerCpus;
+  if (!cpus_.empty()) {
+    callerCpus = ThreadAffinity::getCurrentThreadCpus();
+    if (ThreadAffinity::setCurrentThreadCpus(cpus_)) {
+      GlobalOutput.printf("TNonblocking: IO Thread #%d running on NUMA node %d", number_, numaNode_);
+    } else {
+      GlobalOutput.printf("TNonblocking: IO Thread #%d could not be pinned to NUMA node %d",
+                          number_,
+                          numaNode_);
+    }
+  }
   if (eventBase_ == nullptr) {
     registerEvents();
   }
@@ -1489,6 +2029,10 @@ void TNonblockingIOThread::run() {
     cleanupEvents();
   }
 
+  if (!callerCpus.empty()) {
+    ThreadAffinity::setCurrentThreadCpus(callerCpus);
+  }
+
   GlobalOutput.printf("TNonblockingServer: IO thread #%d run() done!", number_);
 }
 
@@ -1501,6 +2045,11 @@ void TNonblockingIOThread::cleanupEvents() {
   }
 
   event_del(&notificationEvent_);
+
+  if (drainTimerPending_) {
+    evtimer_del(&drainTimer_);
+    drainTimerPending_ = false;
+  }
 }
 
 void TNonblockingIOThread::stop() {
@@ -21,8 +21,11 @@
 #define _THRIFT_SERVER_TNONBLOCKINGSERVER_H_ 1
 
 #include <thrift/Thrift.h>
+#include <atomic>
 #include <memory>
 #include <thrift/server/TServer.h>
+#include <thrift/server/TBufferPool.h>
+#include <thrift/server/TConcurrencyLimiter.h>
 #include <thrift/transport/PlatformSocket.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TSocket.h>
@@ -111,6 +114,14 @@ enum TOverloadAction {
 class TNonblockingIOThread;
 
 class TNonblockingServer : public TServer {
+public:
+  /**
+   * Decides the TaskClass of a call from its method name and the protocol
+   * its message header was read with; see setTaskClassifier().
+   */
+  typedef std::function<concurrency::TaskClass(const std::string& fname,
+                                               protocol::TProtocol& protocol)> TaskClassifier;
+
 private:
   class TConnection;
 
@@ -144,6 +155,9 @@ private:
   /// # of calls before resizing oversized buffers (0 = check only on close)
   static const int RESIZE_BUFFER_EVERY_N = 512;
 
+  /// Delay before retrying a read buffer deferred by the buffer pool (usec)
+  static const int BUFFER_RETRY_INTERVAL_USEC = 1000;
+
   /// # of IO threads to use by default
   static const int DEFAULT_IO_THREADS = 1;
 
@@ -153,6 +167,9 @@ private:
   /// Whether to set high scheduling priority for IO threads
   bool useHighPriorityIOThreads_;
 
+  /// Whether to spread the IO threads over the NUMA nodes, see setNumaPlacement()
+  bool numaPlacement_;
+
   /// Server socket file descriptor
   THRIFT_SOCKET serverSocket_;
 
@@ -162,9 +179,15 @@ private:
   /// For processing via thread pool, may be nullptr
   std::shared_ptr<ThreadManager> threadManager_;
 
+  /// Thread pools for the calls read on each NUMA node, by node; may be nullptr
+  std::vector<std::shared_ptr<ThreadManager> > nodeThreadManagers_;
+
   /// Is thread pool processing?
   bool threadPoolProcessing_;
 
+  /// Runs connection handshakes off the IO threads, may be nullptr
+  std::shared_ptr<ThreadManager> handshakeThreadManager_;
+
   // Factory to create the IO threads
   std::shared_ptr<ThreadFactory> ioThreadFactory_;
 
@@ -198,6 +221,9 @@ private:
   /// Time in milliseconds before an unperformed task expires (0 == infinite).
   int64_t taskExpireTime_;
 
+  /// Decides the class of queued calls; empty for the default class
+  TaskClassifier taskClassifier_;
+
   /**
    * Hysteresis for overload state.  This is the fraction of the overload
    * value that needs to be reached before the overload state is cleared;
@@ -237,6 +263,12 @@ private:
    */
   int32_t resizeBufferEveryN_;
 
+  /// Shared buffers for all connections, or nullptr if each owns its own
+  std::shared_ptr<TBufferPool> bufferPool_;
+
+  /// Adaptive limit on calls in flight, or nullptr for no limit
+  std::shared_ptr<TConcurrencyLimiter> concurrencyLimiter_;
+
   /// Set if we are currently in an overloaded state.
   bool overloaded_;
 
@@ -247,12 +279,17 @@ private:
   uint64_t nTotalConnectionsDropped_;
 
   /**
-   * This is a stack of all the objects that have been created but that
-   * are NOT currently in use. When we close a connection, we place it on this
+   * These are stacks of all the objects that have been created but that
+   * are NOT currently in use. When we close a connection, we place it on a
    * stack so that the object can be reused later, rather than freeing the
-   * memory and reallocating a new object later.
+   * memory and reallocating a new object later.  There is one stack per
+   * NUMA node with setNumaPlacement(), so that buffers stay on their node,
+   * and a single one otherwise.
    */
-  std::stack<TConnection*> connectionStack_;
+  std::vector<std::stack<TConnection*> > connectionStacks_;
+
+  /// Number of objects on connectionStacks_
+  size_t numIdleConnections_;
 
   /**
    * This container holds pointers to all active connections. This container
@@ -280,9 +317,11 @@ private:
     numIOThreads_ = DEFAULT_IO_THREADS;
     nextIOThread_ = 0;
     useHighPriorityIOThreads_ = false;
+    numaPlacement_ = false;
     userEventBase_ = nullptr;
     threadPoolProcessing_ = false;
     numTConnections_ = 0;
+    numIdleConnections_ = 0;
     numActiveProcessors_ = 0;
     connectionStackLimit_ = CONNECTION_STACK_LIMIT;
     maxActiveProcessors_ = MAX_ACTIVE_PROCESSORS;
@@ -384,6 +423,22 @@ public:
 
   std::shared_ptr<ThreadManager> getThreadManager() { return threadManager_; }
 
+  /**
+   * Run the steps of connection handshakes, such as the TLS key exchange,
+   * on a separate thread pool rather than on the IO threads, so that the
+   * CPU they take does not delay other connections.  Only worth it for TLS
+   * servers: each step costs a trip through the pool.  Must be called
+   * before serve().
+   *
+   * @param threadManager the pool, or nullptr to handshake on the IO
+   *        threads (the default).
+   */
+  void setHandshakeThreadManager(std::shared_ptr<ThreadManager> threadManager) {
+    handshakeThreadManager_ = threadManager;
+  }
+
+  std::shared_ptr<ThreadManager> getHandshakeThreadManager() { return handshakeThreadManager_; }
+
   /**
    * Sets the number of IO threads used by this server. Can only be used before
    * the call to serve() and has no effect afterwards.
@@ -400,6 +455,33 @@ public:
   /** Set whether the IO threads will get high scheduling priority. */
   void setUseHighPriorityIOThreads(bool val) { useHighPriorityIOThreads_ = val; }
 
+  /**
+   * Spreads the IO threads over the NUMA nodes of the host, taking the nodes
+   * in turn, and keeps each on the CPUs of its node.  Memory a thread
+   * allocates then comes from its node: connections start without buffers
+   * and get them once on their node, and idle connections are kept per
+   * node for reuse there.  Give each node a thread manager of its own with
+   * setNodeThreadManager() to also run the calls there; a shared
+   * TBufferPool hands out buffers from any node.
+   *
+   * Only has an effect on Linux, and must be set before serve().
+   */
+  void setNumaPlacement(bool val) { numaPlacement_ = val; }
+
+  bool getNumaPlacement() const { return numaPlacement_; }
+
+  /**
+   * Runs the calls read by the IO threads of NUMA node \p node on
+   * \p threadManager rather than on the server's thread manager.  Its thread
+   * factory should keep the workers on the same node, with
+   * ThreadFactory::setAffinity(ThreadAffinity::node(node)).  Nodes without
+   * one use the server's thread manager.  Must be called before serve().
+   */
+  void setNodeThreadManager(int node, std::shared_ptr<ThreadManager> threadManager);
+
+  /// The thread manager of NUMA node \p node, nullptr if it has none
+  std::shared_ptr<ThreadManager> getNodeThreadManager(int node) const;
+
   /** Return the number of IO threads used by this server. */
   size_t getNumIOThreads() const { return numIOThreads_; }
 
@@ -423,6 +505,16 @@ public:
     threadManager_->add(task, 0LL, taskExpireTime_);
   }
 
+  void addTask(std::shared_ptr<Runnable> task, const concurrency::TaskClass& taskClass) {
+    threadManager_->add(task, taskClass, 0LL, taskExpireTime_);
+  }
+
+  /// Adds \p task to the thread manager of NUMA node \p node, if it has one
+  void addTask(std::shared_ptr<Runnable> task, const concurrency::TaskClass& taskClass, int node) {
+    std::shared_ptr<ThreadManager> threadManager = getNodeThreadManager(node);
+    (threadManager ? threadManager : threadManager_)->add(task, taskClass, 0LL, taskExpireTime_);
+  }
+
   /**
    * Return the count of sockets currently connected to.
    *
@@ -442,7 +534,7 @@ public:
    *
    * @return count of idle connection objects.
    */
-  size_t getNumIdleConnections() const { return connectionStack_.size(); }
+  size_t getNumIdleConnections() const { return numIdleConnections_; }
 
   /**
    * Return count of number of connections which are currently processing.
@@ -562,6 +654,22 @@ public:
    */
   void setTaskExpireTime(int64_t taskExpireTime) { taskExpireTime_ = taskExpireTime; }
 
+  const TaskClassifier& getTaskClassifier() const { return taskClassifier_; }
+
+  /**
+   * Set the function that decides the TaskClass of each call handed to the
+   * thread manager, so that a FairTaskQueue (see ThreadManager::taskQueue())
+   * can schedule calls by priority and tenant.  It is called on the I/O
+   * thread with the method name and the protocol the message header was
+   * read with; with THeaderProtocol the request's headers are available
+   * from it, e.g. through getReadHeaders().  The call itself is read again
+   * by the processor.  Must be called before serve().
+   *
+   * @param classifier the function, or an empty one to queue all calls in
+   *        the default class.
+   */
+  void setTaskClassifier(const TaskClassifier& classifier) { taskClassifier_ = classifier; }
+
   /**
    * Determine if the server is currently overloaded.
    * This function checks the maximums for open connections and connections
@@ -665,6 +773,48 @@ public:
    */
   void setResizeBufferEveryN(int32_t count) { resizeBufferEveryN_ = count; }
 
+  /**
+   * Get the buffer pool connections borrow their buffers from, if any.
+   *
+   * @return the pool, or nullptr if each connection owns its buffers.
+   */
+  std::shared_ptr<TBufferPool> getBufferPool() const { return bufferPool_; }
+
+  /**
+   * Share read and write buffers between connections through a pool.
+   * Connections then hold buffers only while a frame is in flight, instead
+   * of keeping buffers sized to their largest frame while idle; the idle
+   * buffer limits and resizeBufferEveryN do not apply.  If the pool has a
+   * memory limit, connections stop reading new frames while it is exceeded.
+   * Must be called before serve().
+   *
+   * @param pool the pool, which may be shared with other servers, or
+   *        nullptr for per-connection buffers (the default).
+   */
+  void setBufferPool(const std::shared_ptr<TBufferPool>& pool) { bufferPool_ = pool; }
+
+  /**
+   * Get the limiter applied to calls, if any.
+   *
+   * @return the limiter, or nullptr.
+   */
+  std::shared_ptr<TConcurrencyLimiter> getConcurrencyLimiter() const {
+    return concurrencyLimiter_;
+  }
+
+  /**
+   * Limit the number of calls being processed or waiting for a worker
+   * thread.  Calls beyond the limiter's current limit are answered with a
+   * TApplicationException on the I/O thread instead of being queued, and
+   * the time admitted calls spend queued and in the handler drives the
+   * limit.  Must be called before serve().
+   *
+   * @param limiter the limiter, or nullptr for no limit (the default).
+   */
+  void setConcurrencyLimiter(const std::shared_ptr<TConcurrencyLimiter>& limiter) {
+    concurrencyLimiter_ = limiter;
+  }
+
   /**
    * Main workhorse function, starts up the server listening on a port and
    * loops over the libevent handler.
@@ -676,6 +826,19 @@ public:
    */
   void stop() override;
 
+  /**
+   * Stops accepting connections, closes each connection once it has
+   * answered its calls and no other call has started arriving, and lets
+   * serve() return when none are left, or after timeoutMs milliseconds at
+   * the latest.  A connection that has not sent its first call yet gets to
+   * make it.  Returns at once; can be called from any thread.
+   *
+   * A client that sends its next call on a persistent connection just as
+   * the server closes it sees the connection drop; only clients that
+   * connect for each call, or retry, never fail.
+   */
+  void drain(int64_t timeoutMs) override;
+
   /// Creates a socket to listen on and binds it to the local port.
   void createAndListenOnSocket();
 
@@ -729,6 +892,9 @@ private:
    * @param connection the TConection being returned.
    */
   void returnConnection(TConnection* connection);
+
+  /// Closes the idle connections of ioThread, on that thread, for drain()
+  void closeIdleConnections(TNonblockingIOThread* ioThread);
 };
 
 class TNonblockingIOThread : public Runnable {
@@ -752,6 +918,16 @@ public:
   // Returns the number of this IO thread.
   int getThreadNumber() const { return number_; }
 
+  // Makes this the IO thread of NUMA node, running on cpus; see
+  // TNonblockingServer::setNumaPlacement().  Must be called before run().
+  void setNumaNode(int node, const std::vector<int>& cpus) {
+    numaNode_ = node;
+    cpus_ = cpus;
+  }
+
+  // Returns the NUMA node of this IO thread, or -1 without NUMA placement.
+  int getNumaNode() const { return numaNode_; }
+
   // Returns the thread id associated with this object.  This should
   // only be called after the thread has been started.
   Thread::id_t getThreadId() const { return threadId_; }
@@ -777,6 +953,17 @@ public:
   // Exits the event loop as soon as possible.
   void stop();
 
+  // Exits the event loop once this thread's connections are closed, or
+  // after timeoutMs milliseconds; see TNonblockingServer::drain().
+  void drain(int64_t timeoutMs);
+
+  // Whether drain() has taken effect on this thread.
+  bool isDraining() const { return draining_; }
+
+  // Used by the server to count the connections this thread handles.
+  void connectionOpened() { ++numConnections_; }
+  void connectionClosed();
+
   // Ensures that the event-loop thread is fully finished and shut down.
   void join();
 
@@ -809,6 +996,12 @@ private:
   /// Exits the loop ASAP in case of shutdown or error.
   void breakLoop(bool error);
 
+  /// Does what drain() asked for, on this thread.
+  void beginDrain();
+
+  /// C-callable handler for drainTimer_.
+  static void drainTimeoutHandler(evutil_socket_t fd, short which, void* v);
+
   /// Create the pipe used to notify I/O process of task completion.
   void createNotificationPipe();
 
@@ -834,6 +1027,12 @@ private:
   /// Sets a high scheduling priority when running
   bool useHighPriority_;
 
+  /// NUMA node of this thread, -1 for none
+  int numaNode_;
+
+  /// CPUs to run on, empty for any
+  std::vector<int> cpus_;
+
   /// pointer to eventbase to be used for looping
   event_base* eventBase_;
 
@@ -852,6 +1051,20 @@ private:
 
   /// Actual IO Thread
   std::shared_ptr<Thread> thread_;
+
+  /// Set by drain() until this thread acts on it
+  std::atomic<bool> drainRequested_;
+  std::atomic<int64_t> drainTimeoutMs_;
+
+  /// Set once this thread has stopped accepting and closes idle connections
+  std::atomic<bool> draining_;
+
+  /// Ends the loop when a drain runs out of time
+  struct event drainTimer_;
+  bool drainTimerPending_;
+
+  /// Open connections assigned to this thread
+  std::atomic<size_t> numConnections_;
 };
 }
 }
@@ -104,6 +104,18 @@ public:
 
   virtual void stop() {}
 
+  /**
+   * Stops accepting connections and lets serve() return once the ones
+   * already accepted have finished their calls, or after timeoutMs
+   * milliseconds at the latest.  With the listening socket handed to a new
+   * process first, this restarts a server without failing any call.
+   * Servers that cannot drain just stop().
+   */
+  virtual void drain(int64_t timeoutMs) {
+    THRIFT_UNUSED_VARIABLE(timeoutMs);
+    stop();
+  }
+
   // Allows running the server as a Runnable thread
   void run() override { serve(); }
 
@@ -21,6 +21,7 @@
 #include <functional>
 #include <stdexcept>
 #include <stdint.h>
+#include <thrift/processor/TConcurrencyLimitProcessor.h>
 #include <thrift/server/TServerFramework.h>
 
 namespace apache {
@@ -45,7 +46,8 @@ TServerFramework::TServerFramework(const shared_ptr<TProcessorFactory>& processo
   : TServer(processorFactory, serverTransport, transportFactory, protocolFactory),
     clients_(0),
     hwm_(0),
-    limit_(INT64_MAX) {
+    limit_(INT64_MAX),
+    draining_(false) {
 }
 
 TServerFramework::TServerFramework(const shared_ptr<TProcessor>& processor,
@@ -55,7 +57,8 @@ TServerFramework::TServerFramework(const shared_ptr<TProcessor>& processor,
   : TServer(processor, serverTransport, transportFactory, protocolFactory),
     clients_(0),
     hwm_(0),
-    limit_(INT64_MAX) {
+    limit_(INT64_MAX),
+    draining_(false) {
 }
 
 TServerFramework::TServerFramework(const shared_ptr<TProcessorFactory>& processorFactory,
@@ -72,7 +75,8 @@ TServerFramework::TServerFramework(const shared_ptr<TProcessorFactory>& processo
             outputProtocolFactory),
     clients_(0),
     hwm_(0),
-    limit_(INT64_MAX) {
+    limit_(INT64_MAX),
+    draining_(false) {
 }
 
 TServerFramework::TServerFramework(const shared_ptr<TProcessor>& processor,
@@ -89,7 +93,8 @@ TServerFramework::TServerFramework(const shared_ptr<TProcessor>& processor,
             outputProtocolFactory),
     clients_(0),
     hwm_(0),
-    limit_(INT64_MAX) {
+    limit_(INT64_MAX),
+    draining_(false) {
 }
 
 TServerFramework::~TServerFramework() = default;
@@ -138,9 +143,12 @@ void TServerFramework::serve() {
       // accepting another.
       {
         Synchronized sync(mon_);
-        while (clients_ >= limit_) {
+        while (clients_ >= limit_ && !draining_) {
           mon_.wait();
         }
+        if (draining_) {
+          break;
+        }
       }
 
       client = serverTransport_->accept();
@@ -155,8 +163,14 @@ void TServerFramework::serve() {
         outputProtocol = outputProtocolFactory_->getProtocol(outputTransport);
       }
 
+      shared_ptr<TProcessor> processor = getProcessor(inputProtocol, outputProtocol, client);
+      shared_ptr<TConcurrencyLimiter> limiter = getConcurrencyLimiter();
+      if (limiter) {
+        processor.reset(new processor::TConcurrencyLimitProcessor(processor, limiter));
+      }
+
       newlyConnectedClient(shared_ptr<TConnectedClient>(
-          new TConnectedClient(getProcessor(inputProtocol, outputProtocol, client),
+          new TConnectedClient(processor,
                                inputProtocol,
                                outputProtocol,
                                eventHandler_,
@@ -185,6 +199,20 @@ void TServerFramework::serve() {
     }
   }
 
+  // Closing the server transport interrupts the clients, so a drain waits
+  // for them first
+  bool interrupt = false;
+  {
+    Synchronized sync(mon_);
+    while (draining_ && clients_ > 0 && std::chrono::steady_clock::now() < drainDeadline_) {
+      mon_.waitForTime(drainDeadline_);
+    }
+    interrupt = draining_ && clients_ > 0;
+  }
+  if (interrupt) {
+    serverTransport_->interruptChildren();
+  }
+
   releaseOneDescriptor("serverTransport", serverTransport_);
 }
 
@@ -214,6 +242,16 @@ void TServerFramework::setConcurrentClientLimit(int64_t newLimit) {
   }
 }
 
+shared_ptr<TConcurrencyLimiter> TServerFramework::getConcurrencyLimiter() const {
+  Synchronized sync(mon_);
+  return concurrencyLimiter_;
+}
+
+void TServerFramework::setConcurrencyLimiter(shared_ptr<TConcurrencyLimiter> limiter) {
+  Synchronized sync(mon_);
+  concurrencyLimiter_ = limiter;
+}
+
 void TServerFramework::stop() {
   // Order is important because serve() releases serverTransport_ when it is
   // interrupted, which closes the socket that interruptChildren uses.
@@ -221,17 +259,41 @@ void TServerFramework::stop() {
   serverTransport_->interrupt();
 }
 
+void TServerFramework::drain(int64_t timeoutMs) {
+  {
+    Synchronized sync(mon_);
+    if (!draining_) {
+      draining_ = true;
+      drainDeadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+      for (TConnectedClient* pClient : connectedClients_) {
+        pClient->drain();
+      }
+      mon_.notifyAll();
+    }
+  }
+  serverTransport_->interrupt();
+}
+
 void TServerFramework::newlyConnectedClient(const shared_ptr<TConnectedClient>& pClient) {
   {
     Synchronized sync(mon_);
     ++clients_;
     hwm_ = (std::max)(hwm_, clients_);
+    connectedClients_.insert(pClient.get());
+    if (draining_) {
+      // Accepted just as the drain began
+      pClient->drain();
+    }
   }
 
   onClientConnected(pClient);
 }
 
 void TServerFramework::disposeConnectedClient(TConnectedClient* pClient) {
+  {
+    Synchronized sync(mon_);
+    connectedClients_.erase(pClient);
+  }
   onClientDisconnected(pClient);
   delete pClient;
 
@@ -20,10 +20,13 @@
 #ifndef _THRIFT_SERVER_TSERVERFRAMEWORK_H_
 #define _THRIFT_SERVER_TSERVERFRAMEWORK_H_ 1
 
+#include <chrono>
 #include <memory>
 #include <stdint.h>
+#include <unordered_set>
 #include <thrift/TProcessor.h>
 #include <thrift/concurrency/Monitor.h>
+#include <thrift/server/TConcurrencyLimiter.h>
 #include <thrift/server/TConnectedClient.h>
 #include <thrift/server/TServer.h>
 #include <thrift/transport/TServerTransport.h>
@@ -91,6 +94,19 @@ public:
    */
   void stop() override;
 
+  /**
+   * Stop accepting clients and let serve() return once the connected ones
+   * are done, interrupting any left after timeoutMs milliseconds (see
+   * TConnectedClient::drain()).  Returns at once.
+   *
+   * A client that sends its next call on a persistent connection just as
+   * the server closes it sees the connection drop; only clients that
+   * connect for each call, or retry, never fail.  TSimpleServer serves its
+   * one client on the serve() thread, so it only applies the deadline
+   * after that client is done.
+   */
+  void drain(int64_t timeoutMs) override;
+
   /**
    * Get the concurrent client limit.
    * \returns the concurrent client limit
@@ -121,6 +137,21 @@ public:
    */
   virtual void setConcurrentClientLimit(int64_t newLimit);
 
+  /**
+   * Get the limiter applied to calls, if any.
+   * \returns the limiter, or an empty pointer
+   */
+  std::shared_ptr<TConcurrencyLimiter> getConcurrencyLimiter() const;
+
+  /**
+   * Limit the number of calls processed at once across all clients.  Calls
+   * beyond the limiter's current limit are answered with a
+   * TApplicationException instead of being dispatched.  Only applies to
+   * clients that connect afterwards, so set it before clients connect.
+   * \param[in]  limiter  the limiter; an empty pointer removes it
+   */
+  void setConcurrencyLimiter(std::shared_ptr<TConcurrencyLimiter> limiter);
+
 protected:
   /**
    * A client has connected.  The implementation is responsible for managing the
@@ -176,6 +207,22 @@ private:
    * The limit on the number of concurrent clients.
    */
   int64_t limit_;
+
+  /**
+   * Adaptive limit on calls in flight, shared by all clients.
+   */
+  std::shared_ptr<TConcurrencyLimiter> concurrencyLimiter_;
+
+  /**
+   * The connected clients, for drain().
+   */
+  std::unordered_set<TConnectedClient*> connectedClients_;
+
+  /**
+   * Set by drain(), along with when to give up waiting for clients.
+   */
+  bool draining_;
+  std::chrono::steady_clock::time_point drainDeadline_;
 };
 }
 }
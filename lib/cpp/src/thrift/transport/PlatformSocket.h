@@ -75,6 +75,7 @@
 #  define THRIFT_POLLIN  POLLIN
 #  define THRIFT_POLLOUT POLLOUT
 #  define THRIFT_SHUT_RDWR SD_BOTH
+#  define THRIFT_SHUT_RD SD_RECEIVE
 #  if !defined(AI_ADDRCONFIG)
 #    define AI_ADDRCONFIG 0x00000400
 #  endif
@@ -123,6 +124,7 @@
 #  define THRIFT_POLLIN  POLLIN
 #  define THRIFT_POLLOUT POLLOUT
 #  define THRIFT_SHUT_RDWR SHUT_RDWR
+#  define THRIFT_SHUT_RD SHUT_RD
 #endif
 
 #endif // _THRIFT_TRANSPORT_PLATFORM_SOCKET_H_
@@ -376,7 +376,32 @@ void TMemoryBuffer::ensureCanWrite(uint32_t len) {
   // Unless the power of two exceeds maxBufferSize_:
   const uint64_t new_size = static_cast<uint64_t>((std::min)(suggested_buffer_size, static_cast<double>(maxBufferSize_)));
 
+  resize(new_size);
+}
+
+void TMemoryBuffer::reserve(uint32_t len) {
+  uint32_t avail = available_write();
+  if (len <= avail) {
+    return;
+  }
+
+  if (!owner_) {
+    throw TTransportException("Insufficient space in external MemoryBuffer");
+  }
+
+  // Use uint64_t to avoid overflow.
+  const uint64_t required_buffer_size = static_cast<uint64_t>(len) + (bufferSize_ - avail);
+  if (required_buffer_size > maxBufferSize_) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "Internal buffer size overflow when requesting a buffer of size " + std::to_string(required_buffer_size));
+  }
+
+  resize(required_buffer_size);
+}
+
+void TMemoryBuffer::resize(uint64_t new_size) {
   // Allocate into a new pointer so we don't bork ours if it fails.
+  TAllocTracker::recordMalloc(static_cast<std::size_t>(new_size));
   auto* new_buffer = static_cast<uint8_t*>(std::realloc(buffer_, static_cast<std::size_t>(new_size)));
   if (new_buffer == nullptr) {
     throw std::bad_alloc();
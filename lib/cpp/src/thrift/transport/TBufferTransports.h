@@ -24,6 +24,7 @@
 #include <cstring>
 #include <limits>
 
+#include <thrift/TAllocTracker.h>
 #include <thrift/transport/TTransport.h>
 #include <thrift/transport/TVirtualTransport.h>
 
@@ -468,6 +469,7 @@ private:
 
     if (buf == nullptr && size != 0) {
       assert(owner);
+      TAllocTracker::recordMalloc(size);
       buf = static_cast<uint8_t*>(std::malloc(size));
       if (buf == nullptr) {
 	throw std::bad_alloc();
@@ -647,6 +649,41 @@ public:
     // Our old self gets destroyed.
   }
 
+  /**
+   * Take ownership of buf (allocated with malloc) as an empty buffer of sz
+   * bytes.  Unlike resetBuffer(), this never allocates.
+   */
+  void adoptBuffer(uint8_t* buf, uint32_t sz) {
+    if (owner_) {
+      std::free(buffer_);
+    }
+    buffer_ = buf;
+    bufferSize_ = sz;
+    rBase_ = rBound_ = wBase_ = buffer_;
+    wBound_ = buffer_ + bufferSize_;
+    owner_ = true;
+  }
+
+  /**
+   * Give up the owned buffer, which the caller must free(), and leave this
+   * transport empty; it allocates again on the next write.
+   *
+   * @param sz set to the size of the returned buffer.
+   * @return the buffer, or nullptr if this transport does not own its buffer.
+   */
+  uint8_t* releaseBuffer(uint32_t* sz) {
+    if (!owner_) {
+      *sz = 0;
+      return nullptr;
+    }
+    uint8_t* buf = buffer_;
+    *sz = bufferSize_;
+    buffer_ = nullptr;
+    bufferSize_ = 0;
+    rBase_ = rBound_ = wBase_ = wBound_ = nullptr;
+    return buf;
+  }
+
   std::string readAsString(uint32_t len) {
     std::string str;
     (void)readAppendToString(str, len);
@@ -693,6 +730,12 @@ public:
   // that had been provided by getWritePtr().
   void wroteBytes(uint32_t len);
 
+  // Makes room for at least 'len' more bytes of writes with a single
+  // allocation of exactly the required size, instead of the power-of-two
+  // growth used when writes overflow the buffer.  Pair it with a generated
+  // struct's serializedSize() to write large objects without reallocating.
+  void reserve(uint32_t len);
+
   /*
    * TVirtualTransport provides a default implementation of readAll().
    * We want to use the TBufferBase version instead.
@@ -739,6 +782,9 @@ protected:
   // Make sure there's at least 'len' bytes available for writing.
   void ensureCanWrite(uint32_t len);
 
+  // Reallocates the buffer to newSize bytes, keeping its contents.
+  void resize(uint64_t new_size);
+
   // Compute the position and available data for reading.
   void computeRead(uint32_t len, uint8_t** out_start, uint32_t* out_give);
 
@@ -0,0 +1,240 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <thrift/transport/TCompressedTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+TCompressedTransport::TCompressedTransport(std::shared_ptr<TTransport> transport,
+                                           std::shared_ptr<TCompressionCodec> codec,
+                                           uint32_t rbufSize,
+                                           uint32_t wbufSize,
+                                           std::shared_ptr<TConfiguration> config)
+  : TVirtualTransport(config),
+    transport_(transport),
+    codec_(codec),
+    rbufSize_(rbufSize),
+    wbufSize_(wbufSize),
+    crpos_(0),
+    crlen_(0),
+    urpos_(0),
+    urlen_(0),
+    uwpos_(0),
+    cwpos_(0),
+    codecFull_(false),
+    inputEnded_(false),
+    outputFinished_(false) {
+  if (rbufSize_ == 0 || wbufSize_ < MIN_DIRECT_COMPRESS_SIZE) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "TCompressedTransport: buffers must be at least "
+                              + std::to_string(MIN_DIRECT_COMPRESS_SIZE) + " bytes.");
+  }
+
+  uint8_t* buffer = codec_->buffer(2 * static_cast<size_t>(rbufSize_) + 2 * wbufSize_);
+  crbuf_ = buffer;
+  urbuf_ = crbuf_ + rbufSize_;
+  uwbuf_ = urbuf_ + rbufSize_;
+  cwbuf_ = uwbuf_ + wbufSize_;
+}
+
+bool TCompressedTransport::isOpen() const {
+  return readAvail() > 0 || decompressPending() || transport_->isOpen();
+}
+
+bool TCompressedTransport::peek() {
+  return readAvail() > 0 || decompressPending() || transport_->peek();
+}
+
+// READING STRATEGY
+//
+// As in TZlibTransport: copy out of urbuf_ what the caller wants, and when it
+// runs dry decompress more from crbuf_, refilling crbuf_ from the underlying
+// transport once the codec has consumed it all.  A codec that filled urbuf_
+// may hold more output, so crbuf_ being empty is not enough to read again.
+
+uint32_t TCompressedTransport::read(uint8_t* buf, uint32_t len) {
+  checkReadBytesAvailable(len);
+  uint32_t need = len;
+
+  while (true) {
+    uint32_t give = (std::min)(readAvail(), need);
+    memcpy(buf, urbuf_ + urpos_, give);
+    need -= give;
+    buf += give;
+    urpos_ += give;
+
+    if (need == 0) {
+      return len;
+    }
+
+    // Reading from the underlying transport may block, and read() is only
+    // allowed to block when no data is available.
+    if (need < len && !decompressPending()) {
+      return len - need;
+    }
+
+    if (inputEnded_) {
+      return len - need;
+    }
+
+    // urbuf_ is empty
+    urpos_ = 0;
+    urlen_ = 0;
+
+    if (!readFromCodec()) {
+      // no data available from underlying transport
+      return len - need;
+    }
+  }
+}
+
+bool TCompressedTransport::readFromCodec() {
+  if (!decompressPending()) {
+    uint32_t got = transport_->read(crbuf_, rbufSize_);
+    if (got == 0) {
+      return false;
+    }
+    crpos_ = 0;
+    crlen_ = got;
+  }
+
+  const uint8_t* in = crbuf_ + crpos_;
+  size_t inLen = crlen_ - crpos_;
+  uint8_t* out = urbuf_ + urlen_;
+  size_t outLen = rbufSize_ - urlen_;
+  inputEnded_ = codec_->decompress(&in, &inLen, &out, &outLen);
+  crpos_ = crlen_ - static_cast<uint32_t>(inLen);
+  urlen_ = rbufSize_ - static_cast<uint32_t>(outLen);
+  codecFull_ = outLen == 0;
+  return true;
+}
+
+// WRITING STRATEGY
+//
+// Small writes are buffered up in uwbuf_ before going to the codec, big ones
+// go straight to it.  The codec compresses into cwbuf_, which is written to
+// the underlying transport whenever it fills up, and on flush().
+
+void TCompressedTransport::write(const uint8_t* buf, uint32_t len) {
+  if (outputFinished_) {
+    throw TTransportException(TTransportException::BAD_ARGS, "write() called after finish()");
+  }
+
+  if (len > MIN_DIRECT_COMPRESS_SIZE) {
+    compressToBuffer(uwbuf_, uwpos_, TCompressionCodec::FLUSH_NONE);
+    uwpos_ = 0;
+    compressToBuffer(buf, len, TCompressionCodec::FLUSH_NONE);
+  } else if (len > 0) {
+    if (wbufSize_ - uwpos_ < len) {
+      compressToBuffer(uwbuf_, uwpos_, TCompressionCodec::FLUSH_NONE);
+      uwpos_ = 0;
+    }
+    memcpy(uwbuf_ + uwpos_, buf, len);
+    uwpos_ += len;
+  }
+}
+
+void TCompressedTransport::flush() {
+  if (outputFinished_) {
+    throw TTransportException(TTransportException::BAD_ARGS, "flush() called after finish()");
+  }
+
+  compressToBuffer(uwbuf_, uwpos_, TCompressionCodec::FLUSH_SYNC);
+  uwpos_ = 0;
+  writeCompressed();
+  transport_->flush();
+  resetConsumedMessageSize();
+}
+
+void TCompressedTransport::finish() {
+  if (outputFinished_) {
+    throw TTransportException(TTransportException::BAD_ARGS, "finish() called more than once");
+  }
+
+  compressToBuffer(uwbuf_, uwpos_, TCompressionCodec::FLUSH_END);
+  uwpos_ = 0;
+  outputFinished_ = true;
+  writeCompressed();
+  transport_->flush();
+}
+
+void TCompressedTransport::compressToBuffer(const uint8_t* buf,
+                                            uint32_t len,
+                                            TCompressionCodec::FlushMode mode) {
+  const uint8_t* in = buf;
+  size_t inLen = len;
+  while (true) {
+    uint8_t* out = cwbuf_ + cwpos_;
+    size_t outLen = wbufSize_ - cwpos_;
+    bool done = codec_->compress(&in, &inLen, &out, &outLen, mode);
+    cwpos_ = wbufSize_ - static_cast<uint32_t>(outLen);
+    if (done) {
+      return;
+    }
+    // The codec needs more room
+    writeCompressed();
+  }
+}
+
+void TCompressedTransport::writeCompressed() {
+  if (cwpos_ > 0) {
+    transport_->write(cwbuf_, cwpos_);
+    cwpos_ = 0;
+  }
+}
+
+const uint8_t* TCompressedTransport::borrow(uint8_t* buf, uint32_t* len) {
+  (void)buf;
+  // Don't try to be clever with shifting buffers.
+  if (readAvail() >= *len) {
+    *len = readAvail();
+    return urbuf_ + urpos_;
+  }
+  return nullptr;
+}
+
+void TCompressedTransport::consume(uint32_t len) {
+  countConsumedMessageBytes(len);
+  if (readAvail() >= len) {
+    urpos_ += len;
+  } else {
+    throw TTransportException(TTransportException::BAD_ARGS, "consume did not follow a borrow.");
+  }
+}
+
+TCompressedTransportFactory::TCompressedTransportFactory(
+    std::shared_ptr<TCompressionCodecPool> pool,
+    std::shared_ptr<TTransportFactory> transportFactory)
+  : pool_(pool), transportFactory_(transportFactory) {
+}
+
+std::shared_ptr<TTransport> TCompressedTransportFactory::getTransport(
+    std::shared_ptr<TTransport> trans) {
+  if (transportFactory_) {
+    trans = transportFactory_->getTransport(trans);
+  }
+  return std::shared_ptr<TTransport>(new TCompressedTransport(trans, pool_->acquire()));
+}
+}
+}
+} // apache::thrift::transport
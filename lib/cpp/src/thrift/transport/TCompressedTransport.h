@@ -0,0 +1,160 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TCOMPRESSEDTRANSPORT_H_
+#define _THRIFT_TRANSPORT_TCOMPRESSEDTRANSPORT_H_ 1
+
+#include <thrift/transport/TCompressionCodec.h>
+#include <thrift/transport/TTransport.h>
+#include <thrift/transport/TVirtualTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * This transport compresses on write and decompresses on read with a
+ * pluggable TCompressionCodec (zlib, zstd, lz4).
+ *
+ * Unlike TZlibTransport, flush() keeps the compression window, so that
+ * later messages are compressed against earlier ones, and the buffers come
+ * with the codec, so that a pooled codec brings its buffers along.
+ */
+class TCompressedTransport : public TVirtualTransport<TCompressedTransport> {
+public:
+  /**
+   * @param transport  The transport to read compressed data from
+   *                   and write compressed data to.
+   * @param codec      The codec, used by this transport only until it is
+   *                   destroyed.
+   * @param rbufSize   Size of each of the compressed and uncompressed read
+   *                   buffers.
+   * @param wbufSize   Size of each of the compressed and uncompressed write
+   *                   buffers.
+   */
+  TCompressedTransport(std::shared_ptr<TTransport> transport,
+                       std::shared_ptr<TCompressionCodec> codec,
+                       uint32_t rbufSize = DEFAULT_RBUF_SIZE,
+                       uint32_t wbufSize = DEFAULT_WBUF_SIZE,
+                       std::shared_ptr<TConfiguration> config = nullptr);
+
+  /**
+   * Warning: Destroying a TCompressedTransport object may discard any
+   * written but unflushed data.
+   */
+  ~TCompressedTransport() override = default;
+
+  bool isOpen() const override;
+  bool peek() override;
+
+  void open() override { transport_->open(); }
+
+  void close() override { transport_->close(); }
+
+  uint32_t read(uint8_t* buf, uint32_t len);
+
+  void write(const uint8_t* buf, uint32_t len);
+
+  /**
+   * Compress everything written so far and send it, keeping the stream and
+   * its window open.
+   */
+  void flush() override;
+
+  /**
+   * End the compressed stream.  No data can be written afterwards.
+   */
+  void finish();
+
+  const uint8_t* borrow(uint8_t* buf, uint32_t* len);
+
+  void consume(uint32_t len);
+
+  std::shared_ptr<TTransport> getUnderlyingTransport() const { return transport_; }
+
+  std::shared_ptr<TCompressionCodec> getCodec() const { return codec_; }
+
+  static const uint32_t DEFAULT_RBUF_SIZE = 16384;
+  static const uint32_t DEFAULT_WBUF_SIZE = 16384;
+
+protected:
+  uint32_t readAvail() const { return urlen_ - urpos_; }
+  /// Whether the codec can produce more without reading the transport
+  bool decompressPending() const { return crpos_ < crlen_ || codecFull_; }
+  bool readFromCodec();
+  void compressToBuffer(const uint8_t* buf, uint32_t len, TCompressionCodec::FlushMode mode);
+  void writeCompressed();
+
+  // Writes smaller than this are buffered up.
+  // Larger (or equal) writes are handed straight to the codec.
+  static const uint32_t MIN_DIRECT_COMPRESS_SIZE = 32;
+
+  std::shared_ptr<TTransport> transport_;
+  std::shared_ptr<TCompressionCodec> codec_;
+
+  uint32_t rbufSize_;
+  uint32_t wbufSize_;
+
+  /// Compressed and uncompressed read buffers, with their used ranges
+  uint8_t* crbuf_;
+  uint8_t* urbuf_;
+  uint32_t crpos_;
+  uint32_t crlen_;
+  uint32_t urpos_;
+  uint32_t urlen_;
+
+  /// Uncompressed and compressed write buffers, with their used lengths
+  uint8_t* uwbuf_;
+  uint8_t* cwbuf_;
+  uint32_t uwpos_;
+  uint32_t cwpos_;
+
+  /// True iff the last decompression filled urbuf_
+  bool codecFull_;
+  /// True iff the codec has reached the end of the input stream.
+  bool inputEnded_;
+  /// True iff we have finished the output stream.
+  bool outputFinished_;
+};
+
+/**
+ * Wraps a transport into a compressed one, with codecs from a pool.
+ */
+class TCompressedTransportFactory : public TTransportFactory {
+public:
+  /**
+   * @param pool              The codecs to use
+   * @param transportFactory  Wrapped first, if any
+   */
+  TCompressedTransportFactory(std::shared_ptr<TCompressionCodecPool> pool,
+                              std::shared_ptr<TTransportFactory> transportFactory = nullptr);
+
+  ~TCompressedTransportFactory() override = default;
+
+  std::shared_ptr<TTransport> getTransport(std::shared_ptr<TTransport> trans) override;
+
+protected:
+  std::shared_ptr<TCompressionCodecPool> pool_;
+  std::shared_ptr<TTransportFactory> transportFactory_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TCOMPRESSEDTRANSPORT_H_
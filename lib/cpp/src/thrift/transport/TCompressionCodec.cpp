@@ -0,0 +1,191 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/transport/TCompressionCodec.h>
+
+#include <algorithm>
+#include <climits>
+#include <zlib.h>
+
+using apache::thrift::concurrency::Guard;
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+namespace {
+
+void checkZlibRv(int status, const z_stream& stream) {
+  // Z_BUF_ERROR only means that no progress was possible
+  if (status != Z_OK && status != Z_BUF_ERROR) {
+    throw TCompressionException("zlib",
+                                std::string(stream.msg ? stream.msg : "(no message)")
+                                    + " (status = " + std::to_string(status) + ")");
+  }
+}
+
+// zlib counts in uInt
+uInt clampToUInt(size_t len) {
+  return static_cast<uInt>((std::min)(len, static_cast<size_t>(UINT_MAX)));
+}
+}
+
+TZlibCodec::TZlibCodec(int level) : rstream_(new z_stream()), wstream_(new z_stream()) {
+  int rv = inflateInit(rstream_);
+  if (rv != Z_OK) {
+    delete rstream_;
+    delete wstream_;
+    throw TCompressionException("zlib", "inflateInit failed");
+  }
+  rv = deflateInit(wstream_, level);
+  if (rv != Z_OK) {
+    inflateEnd(rstream_);
+    delete rstream_;
+    delete wstream_;
+    throw TCompressionException("zlib", "deflateInit failed");
+  }
+}
+
+TZlibCodec::~TZlibCodec() {
+  inflateEnd(rstream_);
+  // Unflushed data may be discarded
+  deflateEnd(wstream_);
+  delete rstream_;
+  delete wstream_;
+}
+
+bool TZlibCodec::compress(const uint8_t** in,
+                          size_t* inLen,
+                          uint8_t** out,
+                          size_t* outLen,
+                          FlushMode mode) {
+  int flush = Z_NO_FLUSH;
+  if (mode == FLUSH_SYNC) {
+    flush = Z_SYNC_FLUSH;
+  } else if (mode == FLUSH_END) {
+    flush = Z_FINISH;
+  }
+
+  uInt availIn = clampToUInt(*inLen);
+  uInt availOut = clampToUInt(*outLen);
+  wstream_->next_in = const_cast<Bytef*>(*in);
+  wstream_->avail_in = availIn;
+  wstream_->next_out = *out;
+  wstream_->avail_out = availOut;
+
+  int rv = deflate(wstream_, flush);
+
+  size_t consumed = availIn - wstream_->avail_in;
+  size_t produced = availOut - wstream_->avail_out;
+  *in += consumed;
+  *inLen -= consumed;
+  *out += produced;
+  *outLen -= produced;
+
+  if (rv == Z_STREAM_END) {
+    return true;
+  }
+  checkZlibRv(rv, *wstream_);
+
+  switch (mode) {
+  case FLUSH_NONE:
+    return *inLen == 0;
+  case FLUSH_SYNC:
+    // zlib has more to give only if it filled the output
+    return *inLen == 0 && wstream_->avail_out != 0;
+  default:
+    return false;
+  }
+}
+
+bool TZlibCodec::decompress(const uint8_t** in, size_t* inLen, uint8_t** out, size_t* outLen) {
+  uInt availIn = clampToUInt(*inLen);
+  uInt availOut = clampToUInt(*outLen);
+  rstream_->next_in = const_cast<Bytef*>(*in);
+  rstream_->avail_in = availIn;
+  rstream_->next_out = *out;
+  rstream_->avail_out = availOut;
+
+  int rv = inflate(rstream_, Z_SYNC_FLUSH);
+
+  size_t consumed = availIn - rstream_->avail_in;
+  size_t produced = availOut - rstream_->avail_out;
+  *in += consumed;
+  *inLen -= consumed;
+  *out += produced;
+  *outLen -= produced;
+
+  if (rv == Z_STREAM_END) {
+    return true;
+  }
+  checkZlibRv(rv, *rstream_);
+  return false;
+}
+
+void TZlibCodec::reset() {
+  checkZlibRv(inflateReset(rstream_), *rstream_);
+  checkZlibRv(deflateReset(wstream_), *wstream_);
+}
+
+TCompressionCodecPool::TCompressionCodecPool(CodecFactory factory, size_t maxIdle)
+  : factory_(factory), idle_(new Idle()) {
+  idle_->maxIdle = maxIdle;
+}
+
+std::shared_ptr<TCompressionCodec> TCompressionCodecPool::acquire() {
+  std::unique_ptr<TCompressionCodec> codec;
+  {
+    Guard g(idle_->mutex);
+    if (!idle_->codecs.empty()) {
+      codec = std::move(idle_->codecs.back());
+      idle_->codecs.pop_back();
+    }
+  }
+  if (!codec) {
+    codec = factory_();
+  }
+
+  // The pool may be gone by the time the codec is released
+  std::weak_ptr<Idle> pool = idle_;
+  return std::shared_ptr<TCompressionCodec>(codec.release(), [pool](TCompressionCodec* released) {
+    std::unique_ptr<TCompressionCodec> owned(released);
+    std::shared_ptr<Idle> idle = pool.lock();
+    if (!idle) {
+      return;
+    }
+    try {
+      owned->reset();
+    } catch (const TTransportException&) {
+      // Not worth keeping
+      return;
+    }
+    Guard g(idle->mutex);
+    if (idle->codecs.size() < idle->maxIdle) {
+      idle->codecs.push_back(std::move(owned));
+    }
+  });
+}
+
+size_t TCompressionCodecPool::idle() const {
+  Guard g(idle_->mutex);
+  return idle_->codecs.size();
+}
+}
+}
+} // apache::thrift::transport
@@ -0,0 +1,188 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TCOMPRESSIONCODEC_H_
+#define _THRIFT_TRANSPORT_TCOMPRESSIONCODEC_H_ 1
+
+#include <thrift/concurrency/Mutex.h>
+#include <thrift/transport/TTransportException.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct z_stream_s;
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Streaming compressor and decompressor used by TCompressedTransport.
+ *
+ * A codec holds one compression stream and one decompression stream, so
+ * one codec serves one connection at a time.  Codecs are expensive to
+ * create; TCompressionCodecPool keeps them for reuse across connections.
+ */
+class TCompressionCodec {
+public:
+  /// How much of the compressed stream compress() must produce
+  enum FlushMode {
+    /// As much as the codec likes; it may hold input back
+    FLUSH_NONE,
+    /// Everything, so the peer can decompress all input so far.  The
+    /// compression window is kept.
+    FLUSH_SYNC,
+    /// Everything, and end the stream
+    FLUSH_END
+  };
+
+  virtual ~TCompressionCodec() = default;
+
+  /// Name of the format, e.g. "zlib"
+  virtual const char* name() const = 0;
+
+  /**
+   * Compress from [*in, *in + *inLen) into [*out, *out + *outLen).  The
+   * pointers are advanced, and the lengths decreased, by the bytes consumed
+   * and produced.
+   *
+   * @return true once all input is consumed and all output \p mode asks for
+   *         is produced; false if the codec needs more output space.
+   */
+  virtual bool compress(const uint8_t** in,
+                        size_t* inLen,
+                        uint8_t** out,
+                        size_t* outLen,
+                        FlushMode mode) = 0;
+
+  /**
+   * Decompress from [*in, *in + *inLen) into [*out, *out + *outLen), updating
+   * the pointers and lengths as compress() does.  If the output space runs
+   * out, more output may be pending in the codec even without more input.
+   *
+   * @return true if the end of the stream was reached.
+   */
+  virtual bool decompress(const uint8_t** in, size_t* inLen, uint8_t** out, size_t* outLen) = 0;
+
+  /**
+   * Forget both streams, so that the codec can be used for a new
+   * connection.  Allocated state is kept.
+   */
+  virtual void reset() = 0;
+
+  /**
+   * Memory for the buffers of the transport using this codec, pooled along
+   * with the codec's own state.
+   *
+   * @param size the least size needed
+   */
+  uint8_t* buffer(size_t size) {
+    if (buffer_.size() < size) {
+      buffer_.resize(size);
+    }
+    return buffer_.data();
+  }
+
+private:
+  std::vector<uint8_t> buffer_;
+};
+
+/**
+ * Compression failure reported by a codec library.
+ */
+class TCompressionException : public TTransportException {
+public:
+  TCompressionException(const char* codec, const std::string& message)
+    : TTransportException(TTransportException::INTERNAL_ERROR,
+                          std::string(codec) + " error: " + message) {}
+};
+
+/**
+ * The deflate format, compatible with TZlibTransport.
+ */
+class TZlibCodec : public TCompressionCodec {
+public:
+  /**
+   * @param level  Compression level (0=none[fast], 6=default, 9=max[slow]),
+   *               -1 for the default.
+   */
+  explicit TZlibCodec(int level = -1);
+  ~TZlibCodec() override;
+
+  const char* name() const override { return "zlib"; }
+  bool compress(const uint8_t** in,
+                size_t* inLen,
+                uint8_t** out,
+                size_t* outLen,
+                FlushMode mode) override;
+  bool decompress(const uint8_t** in, size_t* inLen, uint8_t** out, size_t* outLen) override;
+  void reset() override;
+
+private:
+  struct z_stream_s* rstream_;
+  struct z_stream_s* wstream_;
+};
+
+/**
+ * Keeps idle codecs for reuse, so that connections do not each pay for
+ * setting up compression state and buffers.
+ *
+ * Thread safe.  Codecs may outlive the pool; they are then destroyed when
+ * released.
+ */
+class TCompressionCodecPool {
+public:
+  typedef std::function<std::unique_ptr<TCompressionCodec>()> CodecFactory;
+
+  /**
+   * @param factory  Creates a codec when none is idle
+   * @param maxIdle  Most idle codecs kept
+   */
+  explicit TCompressionCodecPool(CodecFactory factory, size_t maxIdle = DEFAULT_MAX_IDLE);
+
+  /**
+   * Get an idle codec, or a new one.  The codec is reset and given back to
+   * the pool when the last reference to it goes.
+   */
+  std::shared_ptr<TCompressionCodec> acquire();
+
+  /// Number of idle codecs
+  size_t idle() const;
+
+  static const size_t DEFAULT_MAX_IDLE = 64;
+
+private:
+  struct Idle {
+    concurrency::Mutex mutex;
+    std::vector<std::unique_ptr<TCompressionCodec> > codecs;
+    size_t maxIdle;
+  };
+
+  CodecFactory factory_;
+  std::shared_ptr<Idle> idle_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TCOMPRESSIONCODEC_H_
@@ -0,0 +1,488 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <string>
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+#ifdef HAVE_SYS_POLL_H
+#include <sys/poll.h>
+#endif
+
+#include <thrift/TOutput.h>
+#include <thrift/transport/PlatformSocket.h>
+#include <thrift/transport/TConnectionPool.h>
+#include <thrift/transport/TSocket.h>
+#include <thrift/transport/TTransportException.h>
+
+using std::pair;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+using concurrency::Guard;
+
+struct TConnectionPool::Endpoint {
+  Endpoint(const string& host, int port)
+    : host(host), port(port), inFlight(0), ewmaLatencyUs(0), consecutiveFailures(0) {}
+
+  const string host;
+  const int port;
+
+  /** Open connections waiting to be leased */
+  vector<shared_ptr<TTransport> > idle;
+
+  /** Connections currently leased out */
+  uint32_t inFlight;
+
+  /** Moving average of lease durations */
+  double ewmaLatencyUs;
+
+  /** Failures since the last successful lease */
+  uint32_t consecutiveFailures;
+
+  /** Out of rotation until this time */
+  Clock::time_point downUntil;
+};
+
+namespace {
+
+shared_ptr<TTransport> defaultConnectionFactory(const string& host, int port) {
+  return std::make_shared<TSocket>(host, port);
+}
+
+/**
+ * A pooled socket should have nothing to read between calls; if it is
+ * readable the server has closed it (or sent something unexpected), and
+ * either way it cannot be reused.
+ */
+bool defaultHealthCheck(TTransport& connection) {
+  if (!connection.isOpen()) {
+    return false;
+  }
+  TSocket* socket = dynamic_cast<TSocket*>(&connection);
+  if (socket == nullptr) {
+    return true;
+  }
+  struct THRIFT_POLLFD fds[1];
+  std::memset(fds, 0, sizeof(fds));
+  fds[0].fd = socket->getSocketFD();
+  fds[0].events = THRIFT_POLLIN;
+  int ret = THRIFT_POLL(fds, 1, 0);
+  return ret == 0;
+}
+
+void closeQuietly(const shared_ptr<TTransport>& connection) {
+  try {
+    connection->close();
+  } catch (const TException& te) {
+    GlobalOutput.printf("TConnectionPool: error closing connection: %s", te.what());
+  }
+}
+
+void closeAll(const vector<shared_ptr<TTransport> >& connections) {
+  for (const auto& connection : connections) {
+    closeQuietly(connection);
+  }
+}
+}
+
+TConnectionPool::Lease::Lease() : pool_(nullptr) {
+}
+
+TConnectionPool::Lease::Lease(TConnectionPool* pool,
+                              const shared_ptr<Endpoint>& endpoint,
+                              const shared_ptr<TTransport>& transport)
+  : pool_(pool), endpoint_(endpoint), transport_(transport), start_(Clock::now()) {
+}
+
+TConnectionPool::Lease::Lease(Lease&& other) noexcept
+  : pool_(other.pool_),
+    endpoint_(std::move(other.endpoint_)),
+    transport_(std::move(other.transport_)),
+    start_(other.start_) {
+  other.pool_ = nullptr;
+}
+
+TConnectionPool::Lease& TConnectionPool::Lease::operator=(Lease&& other) noexcept {
+  if (this != &other) {
+    release();
+    pool_ = other.pool_;
+    endpoint_ = std::move(other.endpoint_);
+    transport_ = std::move(other.transport_);
+    start_ = other.start_;
+    other.pool_ = nullptr;
+  }
+  return *this;
+}
+
+TConnectionPool::Lease::~Lease() {
+  release();
+}
+
+const string& TConnectionPool::Lease::host() const {
+  static const string empty;
+  return endpoint_ ? endpoint_->host : empty;
+}
+
+int TConnectionPool::Lease::port() const {
+  return endpoint_ ? endpoint_->port : 0;
+}
+
+void TConnectionPool::Lease::release() {
+  if (pool_ != nullptr && transport_) {
+    pool_->release(*this, true);
+  }
+}
+
+void TConnectionPool::Lease::markFailed() {
+  if (pool_ != nullptr && transport_) {
+    pool_->release(*this, false);
+  }
+}
+
+TConnectionPool::TConnectionPool(uint32_t connectionsPerEndpoint, ConnectionFactory factory)
+  : factory_(factory ? factory : ConnectionFactory(defaultConnectionFactory)),
+    healthCheck_(defaultHealthCheck),
+    connectionsPerEndpoint_(connectionsPerEndpoint),
+    selection_(POWER_OF_TWO_CHOICES),
+    maxConsecutiveFailures_(1),
+    initialBackoff_(100),
+    maxBackoff_(30000),
+    latencyWeight_(0.2),
+    rng_(std::random_device{}()) {
+}
+
+TConnectionPool::TConnectionPool(const vector<pair<string, int> >& servers,
+                                 uint32_t connectionsPerEndpoint,
+                                 ConnectionFactory factory)
+  : TConnectionPool(connectionsPerEndpoint, factory) {
+  for (const auto& server : servers) {
+    addServer(server.first, server.second);
+  }
+}
+
+TConnectionPool::~TConnectionPool() {
+  for (const auto& endpoint : endpoints_) {
+    closeAll(endpoint->idle);
+  }
+}
+
+void TConnectionPool::addServer(const string& host, int port) {
+  Guard g(mutex_);
+  endpoints_.push_back(std::make_shared<Endpoint>(host, port));
+}
+
+void TConnectionPool::setSelection(Selection selection) {
+  Guard g(mutex_);
+  selection_ = selection;
+}
+
+void TConnectionPool::setHealthCheck(HealthCheck check) {
+  Guard g(mutex_);
+  healthCheck_ = check;
+}
+
+void TConnectionPool::setMaxConsecutiveFailures(uint32_t maxConsecutiveFailures) {
+  Guard g(mutex_);
+  maxConsecutiveFailures_ = std::max<uint32_t>(maxConsecutiveFailures, 1);
+}
+
+void TConnectionPool::setRetryBackoff(int initialMs, int maxMs) {
+  Guard g(mutex_);
+  initialBackoff_ = std::chrono::milliseconds(initialMs);
+  maxBackoff_ = std::chrono::milliseconds(std::max(initialMs, maxMs));
+}
+
+void TConnectionPool::setLatencyWeight(double weight) {
+  Guard g(mutex_);
+  latencyWeight_ = std::min(std::max(weight, 0.0), 1.0);
+}
+
+double TConnectionPool::load(const Endpoint& endpoint) const {
+  // Endpoints with no latency history yet count as fast, so that they are
+  // tried and get some.
+  return (endpoint.inFlight + 1) * std::max(endpoint.ewmaLatencyUs, 1.0);
+}
+
+shared_ptr<TConnectionPool::Endpoint> TConnectionPool::selectEndpoint(Clock::time_point now) {
+  vector<Endpoint*> candidates;
+  candidates.reserve(endpoints_.size());
+  for (const auto& endpoint : endpoints_) {
+    if (endpoint->downUntil <= now) {
+      candidates.push_back(endpoint.get());
+    }
+  }
+
+  const Endpoint* chosen = nullptr;
+  if (candidates.empty()) {
+    // Everything is backing off; rather than fail outright, try the
+    // endpoint that is due back soonest.
+    for (const auto& endpoint : endpoints_) {
+      if (chosen == nullptr || endpoint->downUntil < chosen->downUntil) {
+        chosen = endpoint.get();
+      }
+    }
+  } else if (selection_ == POWER_OF_TWO_CHOICES && candidates.size() > 2) {
+    std::uniform_int_distribution<size_t> dist(0, candidates.size() - 1);
+    size_t first = dist(rng_);
+    size_t second = dist(rng_);
+    while (second == first) {
+      second = dist(rng_);
+    }
+    chosen = load(*candidates[first]) <= load(*candidates[second]) ? candidates[first]
+                                                                     : candidates[second];
+  } else {
+    double best = std::numeric_limits<double>::max();
+    for (const Endpoint* endpoint : candidates) {
+      double l = load(*endpoint);
+      if (l < best) {
+        best = l;
+        chosen = endpoint;
+      }
+    }
+  }
+
+  for (const auto& endpoint : endpoints_) {
+    if (endpoint.get() == chosen) {
+      return endpoint;
+    }
+  }
+  return shared_ptr<Endpoint>();
+}
+
+shared_ptr<TTransport> TConnectionPool::connect(Endpoint& endpoint) {
+  shared_ptr<TTransport> connection = factory_(endpoint.host, endpoint.port);
+  connection->open();
+  return connection;
+}
+
+void TConnectionPool::recordFailure(Endpoint& endpoint,
+                                    Clock::time_point now,
+                                    vector<shared_ptr<TTransport> >& toClose) {
+  endpoint.consecutiveFailures++;
+  if (endpoint.consecutiveFailures < maxConsecutiveFailures_) {
+    return;
+  }
+
+  uint32_t doublings = std::min<uint32_t>(endpoint.consecutiveFailures - maxConsecutiveFailures_,
+                                          30);
+  std::chrono::milliseconds backoff = initialBackoff_ * (int64_t(1) << doublings);
+  endpoint.downUntil = now + std::min(backoff, maxBackoff_);
+
+  // Connections to a failing server are suspect too
+  toClose.insert(toClose.end(), endpoint.idle.begin(), endpoint.idle.end());
+  endpoint.idle.clear();
+}
+
+TConnectionPool::Lease TConnectionPool::lease() {
+  vector<shared_ptr<TTransport> > toClose;
+  vector<const Endpoint*> tried;
+  string lastError = "no servers in pool";
+
+  size_t numEndpoints;
+  {
+    Guard g(mutex_);
+    numEndpoints = endpoints_.size();
+  }
+
+  while (tried.size() < numEndpoints) {
+    shared_ptr<Endpoint> endpoint;
+    shared_ptr<TTransport> connection;
+    {
+      Guard g(mutex_);
+      endpoint = selectEndpoint(Clock::now());
+      if (std::find(tried.begin(), tried.end(), endpoint.get()) != tried.end()) {
+        // The best choice has already failed this time round; fall back to
+        // any endpoint we have not tried yet.
+        for (const auto& candidate : endpoints_) {
+          if (std::find(tried.begin(), tried.end(), candidate.get()) == tried.end()) {
+            endpoint = candidate;
+            break;
+          }
+        }
+      }
+      tried.push_back(endpoint.get());
+
+      // Reuse an idle connection, dropping any that have gone bad
+      while (!endpoint->idle.empty() && !connection) {
+        connection = endpoint->idle.back();
+        endpoint->idle.pop_back();
+        if (!healthCheck_(*connection)) {
+          toClose.push_back(connection);
+          connection.reset();
+        }
+      }
+
+      // Count a new connection as in flight while it is being opened, so
+      // that concurrent callers see the load
+      endpoint->inFlight++;
+    }
+
+    closeAll(toClose);
+    toClose.clear();
+
+    if (!connection) {
+      try {
+        connection = connect(*endpoint);
+      } catch (const TException& te) {
+        lastError = te.what();
+        GlobalOutput.printf("TConnectionPool::lease() connect to %s:%d failed: %s",
+                            endpoint->host.c_str(),
+                            endpoint->port,
+                            te.what());
+      }
+    }
+
+    if (connection) {
+      return Lease(this, endpoint, connection);
+    }
+
+    Guard g(mutex_);
+    endpoint->inFlight--;
+    recordFailure(*endpoint, Clock::now(), toClose);
+  }
+
+  closeAll(toClose);
+  throw TTransportException(TTransportException::NOT_OPEN,
+                            "TConnectionPool::lease() failed: " + lastError);
+}
+
+void TConnectionPool::release(Lease& lease, bool healthy) {
+  shared_ptr<Endpoint> endpoint = std::move(lease.endpoint_);
+  shared_ptr<TTransport> connection = std::move(lease.transport_);
+  lease.pool_ = nullptr;
+
+  vector<shared_ptr<TTransport> > toClose;
+  if (!healthy) {
+    toClose.push_back(connection);
+  }
+
+  Clock::time_point now = Clock::now();
+  {
+    Guard g(mutex_);
+    endpoint->inFlight--;
+    if (healthy) {
+      double sample
+          = std::chrono::duration<double, std::micro>(now - lease.start_).count();
+      endpoint->ewmaLatencyUs = endpoint->ewmaLatencyUs == 0
+                                    ? sample
+                                    : latencyWeight_ * sample
+                                          + (1 - latencyWeight_) * endpoint->ewmaLatencyUs;
+      endpoint->consecutiveFailures = 0;
+      endpoint->downUntil = Clock::time_point();
+      if (endpoint->idle.size() < connectionsPerEndpoint_) {
+        endpoint->idle.push_back(connection);
+      } else {
+        toClose.push_back(connection);
+      }
+    } else {
+      recordFailure(*endpoint, now, toClose);
+    }
+  }
+
+  closeAll(toClose);
+}
+
+void TConnectionPool::maintain() {
+  vector<shared_ptr<TTransport> > toClose;
+  vector<shared_ptr<Endpoint> > toFill;
+  vector<uint32_t> missing;
+  {
+    Guard g(mutex_);
+    Clock::time_point now = Clock::now();
+    for (const auto& endpoint : endpoints_) {
+      vector<shared_ptr<TTransport> >& idle = endpoint->idle;
+      for (auto it = idle.begin(); it != idle.end();) {
+        if (healthCheck_(**it)) {
+          ++it;
+        } else {
+          toClose.push_back(*it);
+          it = idle.erase(it);
+        }
+      }
+      if (endpoint->downUntil <= now && idle.size() < connectionsPerEndpoint_) {
+        toFill.push_back(endpoint);
+        missing.push_back(connectionsPerEndpoint_ - static_cast<uint32_t>(idle.size()));
+      }
+    }
+  }
+
+  closeAll(toClose);
+  toClose.clear();
+
+  for (size_t i = 0; i < toFill.size(); ++i) {
+    Endpoint& endpoint = *toFill[i];
+    for (uint32_t n = 0; n < missing[i]; ++n) {
+      shared_ptr<TTransport> connection;
+      try {
+        connection = connect(endpoint);
+      } catch (const TException& te) {
+        GlobalOutput.printf("TConnectionPool::maintain() connect to %s:%d failed: %s",
+                            endpoint.host.c_str(),
+                            endpoint.port,
+                            te.what());
+      }
+
+      Guard g(mutex_);
+      if (!connection) {
+        recordFailure(endpoint, Clock::now(), toClose);
+        break;
+      }
+      if (endpoint.idle.size() < connectionsPerEndpoint_) {
+        endpoint.idle.push_back(connection);
+      } else {
+        toClose.push_back(connection);
+      }
+    }
+  }
+
+  closeAll(toClose);
+}
+
+vector<TConnectionPoolStats> TConnectionPool::getStats() const {
+  Guard g(mutex_);
+  Clock::time_point now = Clock::now();
+  vector<TConnectionPoolStats> stats;
+  stats.reserve(endpoints_.size());
+  for (const auto& endpoint : endpoints_) {
+    TConnectionPoolStats s;
+    s.host = endpoint->host;
+    s.port = endpoint->port;
+    s.inFlight = endpoint->inFlight;
+    s.idle = static_cast<uint32_t>(endpoint->idle.size());
+    s.ewmaLatencyUs = endpoint->ewmaLatencyUs;
+    s.consecutiveFailures = endpoint->consecutiveFailures;
+    s.down = endpoint->downUntil > now;
+    stats.push_back(s);
+  }
+  return stats;
+}
+}
+}
+} // apache::thrift::transport
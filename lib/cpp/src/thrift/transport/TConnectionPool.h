@@ -0,0 +1,266 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TCONNECTIONPOOL_H_
+#define _THRIFT_TRANSPORT_TCONNECTIONPOOL_H_ 1
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <thrift/concurrency/Mutex.h>
+#include <thrift/transport/TTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Snapshot of one endpoint's state in a TConnectionPool.
+ */
+struct TConnectionPoolStats {
+  std::string host;
+  int port;
+  // Connections currently leased out
+  uint32_t inFlight;
+  // Open connections waiting to be leased
+  uint32_t idle;
+  // Moving average of lease durations, in microseconds
+  double ewmaLatencyUs;
+  // Failures since the last successful lease
+  uint32_t consecutiveFailures;
+  // Whether the endpoint is backing off after failures
+  bool down;
+};
+
+/**
+ * Thread-safe pool of persistent client connections to a set of equivalent
+ * servers.
+ *
+ * Unlike TSocketPool, which is a single socket that picks a server when it
+ * is opened, TConnectionPool keeps up to N open connections per endpoint and
+ * leases them to callers, so many client threads share a small set of warm
+ * connections.  Each lease picks the endpoint with the lowest load, where
+ * load is the number of in-flight leases weighted by the endpoint's moving
+ * average latency; by default two random endpoints are compared ("power of
+ * two choices") rather than scanning all of them.
+ *
+ * Endpoints that fail to connect, or whose leases are reported as failed,
+ * are taken out of rotation with exponential backoff.  Idle connections are
+ * checked before they are handed out, and connections the server has closed
+ * are replaced transparently.
+ *
+ * Typical use, with one lease per request:
+ *
+ *   TConnectionPool::Lease lease = pool.lease();
+ *   MyServiceClient client(std::make_shared<TBinaryProtocol>(lease.transport()));
+ *   try {
+ *     client.doSomething();
+ *   } catch (const TTransportException&) {
+ *     lease.markFailed();
+ *     throw;
+ *   }
+ *   // the connection returns to the pool when the lease goes out of scope
+ *
+ * Leases must not outlive the pool they came from.
+ */
+class TConnectionPool {
+  struct Endpoint;
+
+public:
+  /**
+   * Creates an unopened transport for host:port.  The pool opens it.
+   */
+  typedef std::function<std::shared_ptr<TTransport>(const std::string& host, int port)>
+      ConnectionFactory;
+
+  /**
+   * Returns whether an idle, open connection can still be used.
+   */
+  typedef std::function<bool(TTransport& connection)> HealthCheck;
+
+  enum Selection {
+    // Compare two random endpoints and take the less loaded one
+    POWER_OF_TWO_CHOICES,
+    // Scan all endpoints for the least loaded one
+    LEAST_LOADED
+  };
+
+  /**
+   * A connection on loan from the pool.  Movable but not copyable; the
+   * connection goes back to the pool when the lease is released or
+   * destroyed.
+   */
+  class Lease {
+  public:
+    Lease();
+    Lease(Lease&& other) noexcept;
+    Lease& operator=(Lease&& other) noexcept;
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+    ~Lease();
+
+    /**
+     * Whether this lease holds a connection.
+     */
+    bool valid() const { return transport_ != nullptr; }
+
+    const std::shared_ptr<TTransport>& transport() const { return transport_; }
+
+    const std::string& host() const;
+
+    int port() const;
+
+    /**
+     * Returns the connection to the pool for reuse.
+     */
+    void release();
+
+    /**
+     * Closes the connection instead of returning it, and counts a failure
+     * against its endpoint.  Use this when a call on the connection fails
+     * with a transport error.
+     */
+    void markFailed();
+
+  private:
+    friend class TConnectionPool;
+
+    Lease(TConnectionPool* pool,
+          const std::shared_ptr<Endpoint>& endpoint,
+          const std::shared_ptr<TTransport>& transport);
+
+    TConnectionPool* pool_;
+    std::shared_ptr<Endpoint> endpoint_;
+    std::shared_ptr<TTransport> transport_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  /**
+   * Connection pool constructor
+   *
+   * @param connectionsPerEndpoint number of idle connections to keep open
+   *                               for each endpoint
+   * @param factory creates connections, TSocket by default
+   */
+  explicit TConnectionPool(uint32_t connectionsPerEndpoint = 4,
+                           ConnectionFactory factory = ConnectionFactory());
+
+  /**
+   * Connection pool constructor
+   *
+   * @param servers list of pairs of host name and port
+   * @param connectionsPerEndpoint number of idle connections to keep open
+   *                               for each endpoint
+   * @param factory creates connections, TSocket by default
+   */
+  TConnectionPool(const std::vector<std::pair<std::string, int> >& servers,
+                  uint32_t connectionsPerEndpoint = 4,
+                  ConnectionFactory factory = ConnectionFactory());
+
+  /**
+   * Closes all idle connections.
+   */
+  ~TConnectionPool();
+
+  /**
+   * Add a server to the pool
+   */
+  void addServer(const std::string& host, int port);
+
+  /**
+   * Sets how endpoints are chosen for a lease.
+   */
+  void setSelection(Selection selection);
+
+  /**
+   * Sets the check applied to idle connections before they are leased.
+   * The default accepts open connections that have nothing to read, which
+   * for sockets rules out connections the server has closed.
+   */
+  void setHealthCheck(HealthCheck check);
+
+  /**
+   * Sets how many consecutive failures take an endpoint out of rotation.
+   */
+  void setMaxConsecutiveFailures(uint32_t maxConsecutiveFailures);
+
+  /**
+   * Sets the backoff, in milliseconds, applied to a failing endpoint.  The
+   * delay starts at initialMs and doubles with each further failure, up to
+   * maxMs.
+   */
+  void setRetryBackoff(int initialMs, int maxMs);
+
+  /**
+   * Sets the weight given to each new latency sample in the moving average,
+   * between 0 and 1.
+   */
+  void setLatencyWeight(double weight);
+
+  /**
+   * Leases a connection, opening one if no idle connection is available.
+   * Throws TTransportException(NOT_OPEN) if no endpoint can be connected to.
+   */
+  Lease lease();
+
+  /**
+   * Drops idle connections that fail the health check and opens new ones
+   * until every available endpoint has its full complement.  Call it once
+   * to warm the pool up, and periodically to keep it warm.
+   */
+  void maintain();
+
+  /**
+   * Get a snapshot of each endpoint's state
+   */
+  std::vector<TConnectionPoolStats> getStats() const;
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  std::shared_ptr<Endpoint> selectEndpoint(Clock::time_point now);
+  double load(const Endpoint& endpoint) const;
+  std::shared_ptr<TTransport> connect(Endpoint& endpoint);
+  void recordFailure(Endpoint& endpoint,
+                     Clock::time_point now,
+                     std::vector<std::shared_ptr<TTransport> >& toClose);
+  void release(Lease& lease, bool healthy);
+
+  ConnectionFactory factory_;
+  HealthCheck healthCheck_;
+  uint32_t connectionsPerEndpoint_;
+  Selection selection_;
+  uint32_t maxConsecutiveFailures_;
+  std::chrono::milliseconds initialBackoff_;
+  std::chrono::milliseconds maxBackoff_;
+  double latencyWeight_;
+
+  std::vector<std::shared_ptr<Endpoint> > endpoints_;
+  std::mt19937 rng_;
+  mutable concurrency::Mutex mutex_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TCONNECTIONPOOL_H_
@@ -0,0 +1,488 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/transport/THpack.h>
+
+#include <algorithm>
+#include <thrift/transport/TTransportException.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+namespace {
+
+struct StaticEntry {
+  const char* name;
+  const char* value;
+};
+
+// RFC 7541 Appendix A
+const StaticEntry kStaticTable[] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+const size_t kStaticTableSize = sizeof(kStaticTable) / sizeof(kStaticTable[0]);
+
+// RFC 7541 Appendix B, by symbol
+const uint32_t kHuffmanCodes[256] = {
+    0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5,
+    0xfffffe6, 0xfffffe7, 0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9,
+    0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec, 0xfffffed, 0xfffffee,
+    0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+    0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9,
+    0xffffffa, 0xffffffb, 0x14, 0x3f8, 0x3f9, 0xffa,
+    0x1ff9, 0x15, 0xf8, 0x7fa, 0x3fa, 0x3fb,
+    0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+    0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b,
+    0x1c, 0x1d, 0x1e, 0x1f, 0x5c, 0xfb,
+    0x7ffc, 0x20, 0xffb, 0x3fc, 0x1ffa, 0x21,
+    0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+    0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e,
+    0x6f, 0x70, 0x71, 0x72, 0xfc, 0x73,
+    0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+    0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5,
+    0x25, 0x26, 0x27, 0x6, 0x74, 0x75,
+    0x28, 0x29, 0x2a, 0x7, 0x2b, 0x76,
+    0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+    0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd,
+    0x1ffd, 0xffffffc, 0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8,
+    0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9, 0x3fffd6, 0x7fffda,
+    0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+    0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1,
+    0x7fffe2, 0x7fffe3, 0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5,
+    0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef, 0x3fffda, 0x1fffdd,
+    0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+    0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf,
+    0x7fffeb, 0x7fffec, 0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2,
+    0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef, 0xfffea, 0x3fffe2,
+    0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+    0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2,
+    0x3fffe8, 0x1ffffec, 0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde,
+    0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed, 0x7fff2, 0x1fffe3,
+    0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+    0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3,
+    0x7ffffe4, 0x7ffffe5, 0xfffec, 0xfffff3, 0xfffed, 0x1fffe6,
+    0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3, 0x3fffea, 0x3fffeb,
+    0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+    0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8,
+    0x7ffffe9, 0x7ffffea, 0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed,
+    0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+};
+
+const uint8_t kHuffmanCodeLengths[256] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+};
+
+const uint32_t kHuffmanEos = 0x3fffffff;
+const uint8_t kHuffmanEosLength = 30;
+
+/**
+ * The Huffman code as a binary tree, decoded a bit at a time.  Header
+ * blocks are small, and most of their strings end up indexed anyway.
+ */
+class HuffmanTree {
+public:
+  static const int16_t EOS = 256;
+
+  struct Node {
+    int16_t child[2];
+    int16_t symbol; // -1 for inner nodes
+  };
+
+  HuffmanTree() {
+    nodes_.push_back(Node{{0, 0}, -1});
+    for (int sym = 0; sym < 256; ++sym) {
+      insert(kHuffmanCodes[sym], kHuffmanCodeLengths[sym], static_cast<int16_t>(sym));
+    }
+    insert(kHuffmanEos, kHuffmanEosLength, EOS);
+  }
+
+  const Node& node(int16_t i) const { return nodes_[static_cast<size_t>(i)]; }
+
+private:
+  void insert(uint32_t code, uint8_t length, int16_t symbol) {
+    int16_t at = 0;
+    for (int bit = length - 1; bit >= 0; --bit) {
+      int b = (code >> bit) & 1;
+      if (nodes_[static_cast<size_t>(at)].child[b] == 0) {
+        nodes_[static_cast<size_t>(at)].child[b] = static_cast<int16_t>(nodes_.size());
+        nodes_.push_back(Node{{0, 0}, -1});
+      }
+      at = nodes_[static_cast<size_t>(at)].child[b];
+    }
+    nodes_[static_cast<size_t>(at)].symbol = symbol;
+  }
+
+  std::vector<Node> nodes_;
+};
+
+const HuffmanTree& huffmanTree() {
+  static const HuffmanTree tree;
+  return tree;
+}
+
+[[noreturn]] void corrupt(const char* what) {
+  throw TTransportException(TTransportException::CORRUPTED_DATA, std::string("HPACK: ") + what);
+}
+
+uint64_t decodeInteger(const uint8_t*& p, const uint8_t* end, int prefixBits) {
+  uint64_t max = (1u << prefixBits) - 1;
+  uint64_t value = *p++ & max;
+  if (value < max) {
+    return value;
+  }
+  for (int shift = 0;; shift += 7) {
+    // No header needs anything near 2^32
+    if (p == end || shift > 28) {
+      corrupt("bad integer");
+    }
+    uint8_t b = *p++;
+    value += static_cast<uint64_t>(b & 0x7f) << shift;
+    if ((b & 0x80) == 0) {
+      return value;
+    }
+  }
+}
+
+void decodeString(const uint8_t*& p, const uint8_t* end, std::string& out) {
+  if (p == end) {
+    corrupt("truncated string");
+  }
+  bool huffman = (*p & 0x80) != 0;
+  uint64_t len = decodeInteger(p, end, 7);
+  if (len > static_cast<uint64_t>(end - p)) {
+    corrupt("truncated string");
+  }
+  out.clear();
+  if (huffman) {
+    hpackHuffmanDecode(p, static_cast<size_t>(len), out);
+  } else {
+    out.assign(reinterpret_cast<const char*>(p), static_cast<size_t>(len));
+  }
+  p += len;
+}
+
+size_t huffmanLength(const std::string& s) {
+  size_t bits = 0;
+  for (unsigned char c : s) {
+    bits += kHuffmanCodeLengths[c];
+  }
+  return (bits + 7) / 8;
+}
+
+void encodeString(const std::string& s, std::string& out) {
+  size_t huffLen = huffmanLength(s);
+  if (huffLen < s.size()) {
+    hpackEncodeInteger(huffLen, 7, 0x80, out);
+    hpackHuffmanEncode(reinterpret_cast<const uint8_t*>(s.data()), s.size(), out);
+  } else {
+    hpackEncodeInteger(s.size(), 7, 0, out);
+    out += s;
+  }
+}
+}
+
+void hpackEncodeInteger(uint64_t value, int prefixBits, uint8_t flags, std::string& out) {
+  uint64_t max = (1u << prefixBits) - 1;
+  if (value < max) {
+    out += static_cast<char>(flags | value);
+    return;
+  }
+  out += static_cast<char>(flags | max);
+  value -= max;
+  while (value >= 0x80) {
+    out += static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+void hpackHuffmanDecode(const uint8_t* in, size_t len, std::string& out) {
+  const HuffmanTree& tree = huffmanTree();
+  int16_t at = 0;
+  // Bits read since the last symbol, and whether they were all ones
+  int pending = 0;
+  bool allOnes = true;
+  for (size_t i = 0; i < len; ++i) {
+    for (int bit = 7; bit >= 0; --bit) {
+      int b = (in[i] >> bit) & 1;
+      at = tree.node(at).child[b];
+      if (at == 0) {
+        corrupt("bad Huffman code");
+      }
+      ++pending;
+      allOnes = allOnes && b == 1;
+      int16_t symbol = tree.node(at).symbol;
+      if (symbol >= 0) {
+        if (symbol == HuffmanTree::EOS) {
+          corrupt("EOS in Huffman string");
+        }
+        out += static_cast<char>(symbol);
+        at = 0;
+        pending = 0;
+        allOnes = true;
+      }
+    }
+  }
+  // Padding is the most significant bits of EOS, so under a byte of ones
+  if (pending > 7 || !allOnes) {
+    corrupt("bad Huffman padding");
+  }
+}
+
+void hpackHuffmanEncode(const uint8_t* in, size_t len, std::string& out) {
+  uint64_t bits = 0;
+  int count = 0;
+  for (size_t i = 0; i < len; ++i) {
+    bits = (bits << kHuffmanCodeLengths[in[i]]) | kHuffmanCodes[in[i]];
+    count += kHuffmanCodeLengths[in[i]];
+    while (count >= 8) {
+      count -= 8;
+      out += static_cast<char>(bits >> count);
+    }
+  }
+  if (count > 0) {
+    // Pad with the start of EOS
+    out += static_cast<char>((bits << (8 - count)) | (0xff >> count));
+  }
+}
+
+void THpackTable::add(const std::string& name, const std::string& value) {
+  size_t size = name.size() + value.size() + ENTRY_OVERHEAD;
+  if (size > maxSize_) {
+    // Not an error: the table just ends up empty
+    entries_.clear();
+    size_ = 0;
+    return;
+  }
+  evict(size);
+  entries_.emplace_front(name, value);
+  size_ += size;
+}
+
+void THpackTable::setMaxSize(size_t maxSize) {
+  maxSize_ = maxSize;
+  evict(0);
+}
+
+void THpackTable::evict(size_t room) {
+  while (!entries_.empty() && size_ + room > maxSize_) {
+    const std::pair<std::string, std::string>& oldest = entries_.back();
+    size_ -= oldest.first.size() + oldest.second.size() + ENTRY_OVERHEAD;
+    entries_.pop_back();
+  }
+}
+
+void THpackEncoder::setPeerMaxTableSize(size_t size) {
+  size_t maxSize = (std::min)(size, static_cast<size_t>(THpackTable::DEFAULT_SIZE));
+  if (maxSize != table_.maxSize()) {
+    table_.setMaxSize(maxSize);
+    pendingSizeUpdate_ = true;
+  }
+}
+
+size_t THpackEncoder::find(const std::string& name, const std::string& value, bool* exact) const {
+  size_t nameMatch = 0;
+  for (size_t i = 0; i < kStaticTableSize; ++i) {
+    if (name == kStaticTable[i].name) {
+      if (value == kStaticTable[i].value) {
+        *exact = true;
+        return i + 1;
+      }
+      if (nameMatch == 0) {
+        nameMatch = i + 1;
+      }
+    }
+  }
+  for (size_t i = 0; i < table_.entries(); ++i) {
+    const std::pair<std::string, std::string>& entry = table_.at(i);
+    if (entry.first == name) {
+      if (entry.second == value) {
+        *exact = true;
+        return kStaticTableSize + i + 1;
+      }
+      if (nameMatch == 0) {
+        nameMatch = kStaticTableSize + i + 1;
+      }
+    }
+  }
+  *exact = false;
+  return nameMatch;
+}
+
+void THpackEncoder::encode(const THttp2Headers& headers, std::string& out) {
+  if (pendingSizeUpdate_) {
+    hpackEncodeInteger(table_.maxSize(), 5, 0x20, out);
+    pendingSizeUpdate_ = false;
+  }
+  for (const auto& header : headers) {
+    bool exact;
+    size_t index = find(header.first, header.second, &exact);
+    if (exact) {
+      hpackEncodeInteger(index, 7, 0x80, out);
+      continue;
+    }
+    // Literal with incremental indexing
+    hpackEncodeInteger(index, 6, 0x40, out);
+    if (index == 0) {
+      encodeString(header.first, out);
+    }
+    encodeString(header.second, out);
+    table_.add(header.first, header.second);
+  }
+}
+
+const std::pair<std::string, std::string>& THpackDecoder::lookup(uint64_t index) const {
+  // Static entries are looked up by the callers
+  if (index <= kStaticTableSize || index > kStaticTableSize + table_.entries()) {
+    corrupt("bad table index");
+  }
+  return table_.at(static_cast<size_t>(index - kStaticTableSize - 1));
+}
+
+void THpackDecoder::decode(const uint8_t* block, size_t len, THttp2Headers& headers) {
+  const uint8_t* p = block;
+  const uint8_t* end = block + len;
+  std::string name;
+  std::string value;
+  bool fieldSeen = false;
+
+  while (p < end) {
+    uint8_t b = *p;
+    if (b & 0x80) {
+      // Indexed field
+      uint64_t index = decodeInteger(p, end, 7);
+      if (index >= 1 && index <= kStaticTableSize) {
+        headers.emplace_back(kStaticTable[index - 1].name, kStaticTable[index - 1].value);
+      } else {
+        headers.push_back(lookup(index));
+      }
+      fieldSeen = true;
+      continue;
+    }
+
+    if ((b & 0xe0) == 0x20) {
+      // Dynamic table size update, only allowed ahead of the fields
+      uint64_t size = decodeInteger(p, end, 5);
+      if (fieldSeen || size > maxTableSize_) {
+        corrupt("bad table size update");
+      }
+      table_.setMaxSize(static_cast<size_t>(size));
+      continue;
+    }
+
+    // A literal: with incremental indexing (01), or without (0000) or
+    // never (0001)
+    bool indexing = (b & 0xc0) == 0x40;
+    uint64_t index = decodeInteger(p, end, indexing ? 6 : 4);
+    if (index == 0) {
+      decodeString(p, end, name);
+    } else if (index <= kStaticTableSize) {
+      name = kStaticTable[index - 1].name;
+    } else {
+      name = lookup(index).first;
+    }
+    decodeString(p, end, value);
+    if (indexing) {
+      table_.add(name, value);
+    }
+    headers.emplace_back(name, value);
+    fieldSeen = true;
+  }
+}
+}
+}
+} // apache::thrift::transport
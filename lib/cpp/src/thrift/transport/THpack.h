@@ -0,0 +1,124 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_THPACK_H_
+#define _THRIFT_TRANSPORT_THPACK_H_ 1
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/// Header fields in the order they were sent
+typedef std::vector<std::pair<std::string, std::string> > THttp2Headers;
+
+/**
+ * The HPACK dynamic table (RFC 7541 section 2.3.2).  The encoder and the
+ * decoder each keep one, and must evict in step with the peer's.
+ */
+class THpackTable {
+public:
+  /// Entries are charged their name and value plus this (RFC 7541 4.1)
+  static const size_t ENTRY_OVERHEAD = 32;
+
+  /// The table size both sides start with
+  static const size_t DEFAULT_SIZE = 4096;
+
+  explicit THpackTable(size_t maxSize = DEFAULT_SIZE) : size_(0), maxSize_(maxSize) {}
+
+  void add(const std::string& name, const std::string& value);
+  void setMaxSize(size_t maxSize);
+
+  size_t maxSize() const { return maxSize_; }
+  size_t entries() const { return entries_.size(); }
+
+  /// Entry by 0-based position, newest first
+  const std::pair<std::string, std::string>& at(size_t i) const { return entries_[i]; }
+
+private:
+  void evict(size_t room);
+
+  std::deque<std::pair<std::string, std::string> > entries_;
+  size_t size_;
+  size_t maxSize_;
+};
+
+/**
+ * Encodes header lists.  Fields are added to the dynamic table, so that
+ * the ones repeated on every call, like :path and content-type, shrink to
+ * one byte after the first request.  Strings are Huffman coded when that
+ * makes them shorter.
+ */
+class THpackEncoder {
+public:
+  THpackEncoder() : table_(), pendingSizeUpdate_(false) {}
+
+  /// Appends the header block for headers to out
+  void encode(const THttp2Headers& headers, std::string& out);
+
+  /// The peer's SETTINGS_HEADER_TABLE_SIZE.  We use at most the default.
+  void setPeerMaxTableSize(size_t size);
+
+private:
+  size_t find(const std::string& name, const std::string& value, bool* exact) const;
+
+  THpackTable table_;
+  bool pendingSizeUpdate_;
+};
+
+/**
+ * Decodes header blocks, Huffman coded strings included.  Malformed
+ * input throws TTransportException(CORRUPTED_DATA); per RFC 7540 it is a
+ * connection error (COMPRESSION_ERROR), since the tables are then out of
+ * step.
+ */
+class THpackDecoder {
+public:
+  explicit THpackDecoder(size_t maxTableSize = THpackTable::DEFAULT_SIZE)
+    : table_(maxTableSize), maxTableSize_(maxTableSize) {}
+
+  /// Decodes [block, block + len) and appends its fields to headers
+  void decode(const uint8_t* block, size_t len, THttp2Headers& headers);
+
+private:
+  const std::pair<std::string, std::string>& lookup(uint64_t index) const;
+
+  THpackTable table_;
+  size_t maxTableSize_;
+};
+
+/// HPACK integer (RFC 7541 5.1) with an N bit prefix, or'ed into flags
+void hpackEncodeInteger(uint64_t value, int prefixBits, uint8_t flags, std::string& out);
+
+/// Huffman decodes [in, in + len) and appends the result to out
+void hpackHuffmanDecode(const uint8_t* in, size_t len, std::string& out);
+
+/// Huffman encodes [in, in + len) and appends the result to out
+void hpackHuffmanEncode(const uint8_t* in, size_t len, std::string& out);
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_THPACK_H_
@@ -0,0 +1,258 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/transport/THttp2Client.h>
+
+#include <thrift/concurrency/ThreadFactory.h>
+#include <thrift/transport/PlatformSocket.h>
+#include <thrift/transport/TSocket.h>
+
+using std::shared_ptr;
+using std::string;
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+using concurrency::Guard;
+using concurrency::Synchronized;
+
+namespace {
+
+class ConnectionReader : public concurrency::Runnable {
+public:
+  explicit ConnectionReader(THttp2Session* session) : session_(session) {}
+
+  void run() override {
+    try {
+      while (session_->readFrame()) {
+      }
+    } catch (const TTransportException&) {
+      // The session is over either way
+    }
+    session_->close();
+  }
+
+private:
+  // The connection joins this thread before it goes away
+  THttp2Session* session_;
+};
+}
+
+THttp2Connection::THttp2Connection(shared_ptr<TTransport> transport, string authority)
+  : THttp2Session(transport, false),
+    authority_(authority),
+    recvTimeout_(0),
+    started_(false),
+    sessionClosed_(false) {
+}
+
+THttp2Connection::~THttp2Connection() {
+  try {
+    close();
+  } catch (...) {
+    // no-op
+  }
+}
+
+void THttp2Connection::open() {
+  Guard g(openMutex_);
+  {
+    Synchronized s(responseMon_);
+    if (started_) {
+      return;
+    }
+  }
+  if (!getTransport()->isOpen()) {
+    getTransport()->open();
+  }
+  start();
+  concurrency::ThreadFactory factory(false);
+  reader_ = factory.newThread(std::make_shared<ConnectionReader>(this));
+  reader_->start();
+  Synchronized s(responseMon_);
+  started_ = true;
+}
+
+bool THttp2Connection::isOpen() const {
+  Synchronized s(responseMon_);
+  return started_ && !sessionClosed_;
+}
+
+void THttp2Connection::close() {
+  Guard g(openMutex_);
+  THttp2Session::close();
+  if (getTransport()->isOpen()) {
+    getTransport()->close();
+  }
+  if (reader_) {
+    reader_->join();
+    reader_.reset();
+  }
+}
+
+int32_t THttp2Connection::sendRequest(const string& path, const uint8_t* body, uint32_t len) {
+  THttp2Headers headers;
+  headers.reserve(5);
+  headers.emplace_back(":method", "POST");
+  headers.emplace_back(":scheme", "http");
+  headers.emplace_back(":path", path);
+  headers.emplace_back(":authority", authority_);
+  headers.emplace_back("content-type", "application/x-thrift");
+  return sendMessage(0, headers, body, len);
+}
+
+void THttp2Connection::receiveResponse(int32_t streamId, string& body) {
+  Synchronized s(responseMon_);
+  auto it = responses_.find(streamId);
+  while (it == responses_.end() || !it->second.done) {
+    if (sessionClosed_) {
+      throw TTransportException(TTransportException::END_OF_FILE, "HTTP/2 connection closed");
+    }
+    if (recvTimeout_ == 0) {
+      responseMon_.waitForever();
+    } else if (responseMon_.waitForTimeRelative(recvTimeout_) == THRIFT_ETIMEDOUT) {
+      abandoned_.insert(streamId);
+      throw TTransportException(TTransportException::TIMED_OUT, "HTTP/2 response timed out");
+    }
+    it = responses_.find(streamId);
+  }
+
+  Response response;
+  std::swap(response, it->second);
+  responses_.erase(it);
+  if (response.error != 0) {
+    throw TTransportException("HTTP/2 stream reset, error " + std::to_string(response.error));
+  }
+  if (response.status != "200") {
+    throw TTransportException(string("Bad Status: ") + response.status);
+  }
+  body.swap(response.body);
+}
+
+void THttp2Connection::abandon(int32_t streamId) {
+  Synchronized s(responseMon_);
+  if (responses_.erase(streamId) == 0 && !sessionClosed_) {
+    abandoned_.insert(streamId);
+  }
+}
+
+void THttp2Connection::onMessage(int32_t streamId, THttp2Headers& headers, string& body) {
+  Synchronized s(responseMon_);
+  if (abandoned_.erase(streamId) != 0) {
+    return;
+  }
+  Response& response = responses_[streamId];
+  for (auto& field : headers) {
+    if (field.first == ":status") {
+      response.status.swap(field.second);
+      break;
+    }
+  }
+  response.body.swap(body);
+  response.done = true;
+  responseMon_.notifyAll();
+}
+
+void THttp2Connection::onReset(int32_t streamId, uint32_t error) {
+  Synchronized s(responseMon_);
+  if (abandoned_.erase(streamId) != 0) {
+    return;
+  }
+  Response& response = responses_[streamId];
+  response.error = error == H2_NO_ERROR ? static_cast<uint32_t>(H2_INTERNAL_ERROR) : error;
+  response.done = true;
+  responseMon_.notifyAll();
+}
+
+void THttp2Connection::onClosed() {
+  Synchronized s(responseMon_);
+  sessionClosed_ = true;
+  abandoned_.clear();
+  responseMon_.notifyAll();
+}
+
+THttp2Client::THttp2Client(shared_ptr<THttp2Connection> connection,
+                           string path,
+                           shared_ptr<TConfiguration> config)
+  : TVirtualTransport(config),
+    connection_(connection),
+    ownsConnection_(false),
+    path_(path),
+    pending_(0) {
+}
+
+THttp2Client::THttp2Client(string host, int port, string path, shared_ptr<TConfiguration> config)
+  : TVirtualTransport(config),
+    connection_(std::make_shared<THttp2Connection>(std::make_shared<TSocket>(host, port),
+                                                   host + ":" + std::to_string(port))),
+    ownsConnection_(true),
+    path_(path),
+    pending_(0) {
+}
+
+THttp2Client::~THttp2Client() {
+  if (pending_ != 0) {
+    connection_->abandon(pending_);
+  }
+}
+
+void THttp2Client::close() {
+  if (pending_ != 0) {
+    connection_->abandon(pending_);
+    pending_ = 0;
+  }
+  if (ownsConnection_) {
+    connection_->close();
+  }
+}
+
+uint32_t THttp2Client::read(uint8_t* buf, uint32_t len) {
+  if (readBuffer_.available_read() == 0 && pending_ != 0) {
+    int32_t streamId = pending_;
+    pending_ = 0;
+    connection_->receiveResponse(streamId, body_);
+    readBuffer_.resetBuffer(reinterpret_cast<uint8_t*>(&body_[0]),
+                            static_cast<uint32_t>(body_.size()));
+  }
+  return readBuffer_.read(buf, len);
+}
+
+void THttp2Client::write(const uint8_t* buf, uint32_t len) {
+  writeBuffer_.write(buf, len);
+}
+
+void THttp2Client::flush() {
+  resetConsumedMessageSize();
+
+  // A response never read, as for oneway calls, is dropped
+  if (pending_ != 0) {
+    connection_->abandon(pending_);
+    pending_ = 0;
+  }
+  uint8_t* buf;
+  uint32_t len;
+  writeBuffer_.getBuffer(&buf, &len);
+  // Reset first, so that a failed call does not leave its request behind
+  writeBuffer_.resetBuffer();
+  pending_ = connection_->sendRequest(path_, buf, len);
+}
+}
+}
+} // apache::thrift::transport
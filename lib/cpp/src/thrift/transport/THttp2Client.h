@@ -0,0 +1,161 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_THTTP2CLIENT_H_
+#define _THRIFT_TRANSPORT_THTTP2CLIENT_H_ 1
+
+#include <map>
+#include <set>
+
+#include <thrift/concurrency/Thread.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/THttp2Session.h>
+#include <thrift/transport/TVirtualTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * The client end of an h2c connection.  One connection carries the calls
+ * of any number of THttp2Client transports, on any number of threads, each
+ * call on its own stream; a thread of its own reads the responses.
+ */
+class THttp2Connection : public THttp2Session {
+public:
+  /**
+   * @param transport  The connection, e.g. a TSocket
+   * @param authority  Sent as :authority, like the HTTP/1.1 Host header
+   */
+  THttp2Connection(std::shared_ptr<TTransport> transport, std::string authority = "localhost");
+
+  ~THttp2Connection() override;
+
+  /// Connect if needed, and start the session and its reading thread
+  void open();
+
+  bool isOpen() const;
+
+  /// Stop the session, close the transport and wait for the reading thread
+  void close();
+
+  /**
+   * Start a call.
+   *
+   * @return the stream to pass to receiveResponse() or abandon()
+   */
+  int32_t sendRequest(const std::string& path, const uint8_t* body, uint32_t len);
+
+  /**
+   * Wait for the response to a call.
+   *
+   * @throws TTransportException if the stream was reset, the status is not
+   *         200, the connection failed, or the receive timeout passed
+   */
+  void receiveResponse(int32_t streamId, std::string& body);
+
+  /// The response to a call will not be read, e.g. because it is oneway
+  void abandon(int32_t streamId);
+
+  /// Milliseconds receiveResponse() waits, 0 for no limit
+  void setRecvTimeout(uint32_t ms) { recvTimeout_ = ms; }
+
+protected:
+  void onMessage(int32_t streamId, THttp2Headers& headers, std::string& body) override;
+  void onReset(int32_t streamId, uint32_t error) override;
+  void onClosed() override;
+
+private:
+  struct Response {
+    Response() : done(false), error(0) {}
+
+    bool done;
+    uint32_t error;
+    std::string status;
+    std::string body;
+  };
+
+  std::string authority_;
+  uint32_t recvTimeout_;
+
+  concurrency::Mutex openMutex_;
+  std::shared_ptr<concurrency::Thread> reader_;
+
+  // Guarded by responseMon_
+  concurrency::Monitor responseMon_;
+  std::map<int32_t, Response> responses_;
+  std::set<int32_t> abandoned_;
+  bool started_;
+  bool sessionClosed_;
+};
+
+/**
+ * Client transport for Thrift over h2c, HTTP/2 without TLS, as a
+ * replacement for THttpClient.  Each flush() is one request on a new
+ * stream of the connection; reading waits for its response.
+ *
+ * The connection may be shared, so that many clients, e.g. one per
+ * thread, make their calls concurrently over one socket.
+ */
+class THttp2Client : public TVirtualTransport<THttp2Client> {
+public:
+  THttp2Client(std::shared_ptr<THttp2Connection> connection,
+               std::string path = "/",
+               std::shared_ptr<TConfiguration> config = nullptr);
+
+  /// Uses a connection of its own, to host:port
+  THttp2Client(std::string host,
+               int port,
+               std::string path = "/",
+               std::shared_ptr<TConfiguration> config = nullptr);
+
+  ~THttp2Client() override;
+
+  void open() override { connection_->open(); }
+
+  bool isOpen() const override { return connection_->isOpen(); }
+
+  bool peek() override { return readBuffer_.available_read() > 0; }
+
+  /// Closes the connection only if it is not shared
+  void close() override;
+
+  uint32_t read(uint8_t* buf, uint32_t len);
+
+  void write(const uint8_t* buf, uint32_t len);
+
+  void flush() override;
+
+  std::shared_ptr<THttp2Connection> getConnection() const { return connection_; }
+
+private:
+  std::shared_ptr<THttp2Connection> connection_;
+  bool ownsConnection_;
+  std::string path_;
+  int32_t pending_;
+
+  TMemoryBuffer writeBuffer_;
+  TMemoryBuffer readBuffer_;
+  std::string body_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_THTTP2CLIENT_H_
@@ -0,0 +1,893 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/transport/THttp2Session.h>
+
+#include <algorithm>
+#include <cstring>
+#include <thrift/TConfiguration.h>
+#include <thrift/transport/TTransportException.h>
+
+using std::shared_ptr;
+using std::string;
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+using concurrency::Guard;
+using concurrency::Synchronized;
+
+namespace {
+
+const char PREFACE[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+const size_t PREFACE_SIZE = sizeof(PREFACE) - 1;
+
+const uint32_t FRAME_HEADER_SIZE = 9;
+
+// We neither send nor accept larger frames; the peer may not refuse these
+const uint32_t MAX_FRAME_SIZE = 16384;
+
+// The flow control window both sides start with (RFC 7540 6.9.2)
+const int64_t DEFAULT_WINDOW = 65535;
+const int64_t MAX_WINDOW = 0x7fffffff;
+
+// Header blocks larger than this are not worth decoding
+const size_t MAX_HEADER_BLOCK = 256 * 1024;
+
+const uint8_t FLAG_END_STREAM = 0x1;
+const uint8_t FLAG_ACK = 0x1;
+const uint8_t FLAG_END_HEADERS = 0x4;
+const uint8_t FLAG_PADDED = 0x8;
+const uint8_t FLAG_PRIORITY = 0x20;
+
+enum Setting {
+  SETTINGS_HEADER_TABLE_SIZE = 0x1,
+  SETTINGS_ENABLE_PUSH = 0x2,
+  SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+  SETTINGS_INITIAL_WINDOW_SIZE = 0x4,
+  SETTINGS_MAX_FRAME_SIZE = 0x5
+};
+
+uint32_t get32(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+         | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+void put32(string& out, uint32_t value) {
+  char b[4] = {static_cast<char>(value >> 24), static_cast<char>(value >> 16),
+               static_cast<char>(value >> 8), static_cast<char>(value)};
+  out.append(b, 4);
+}
+
+void putSetting(string& out, uint16_t id, uint32_t value) {
+  out += static_cast<char>(id >> 8);
+  out += static_cast<char>(id);
+  put32(out, value);
+}
+}
+
+THttp2Session::THttp2Session(shared_ptr<TTransport> transport, bool server)
+  : transport_(transport),
+    server_(server),
+    maxConcurrentStreams_(DEFAULT_MAX_CONCURRENT_STREAMS),
+    streamWindowSize_(DEFAULT_STREAM_WINDOW_SIZE),
+    connectionWindowSize_(DEFAULT_CONNECTION_WINDOW_SIZE),
+    maxMessageSize_(TConfiguration::DEFAULT_MAX_MESSAGE_SIZE),
+    readBuf_(4 * (FRAME_HEADER_SIZE + MAX_FRAME_SIZE)),
+    readPos_(0),
+    readLen_(0),
+    prefaceRead_(!server),
+    continuationStream_(0),
+    continuationEndStream_(false),
+    connRecvUnacked_(0),
+    nextStreamId_(server ? 2 : 1),
+    connSendWindow_(DEFAULT_WINDOW),
+    peerInitialWindow_(DEFAULT_WINDOW),
+    peerMaxConcurrentStreams_(0xffffffff),
+    openingStreams_(0),
+    peerTableSize_(THpackTable::DEFAULT_SIZE),
+    peerTableSizeChanged_(false),
+    lastRemoteStream_(0),
+    goAwayStream_(-1),
+    goAwaySent_(false),
+    closed_(false) {
+}
+
+THttp2Session::~THttp2Session() = default;
+
+void THttp2Session::start() {
+  string out;
+  if (!server_) {
+    out.append(PREFACE, PREFACE_SIZE);
+  }
+  string settings;
+  if (server_) {
+    if (maxConcurrentStreams_ != 0) {
+      putSetting(settings, SETTINGS_MAX_CONCURRENT_STREAMS, maxConcurrentStreams_);
+    }
+  } else {
+    putSetting(settings, SETTINGS_ENABLE_PUSH, 0);
+  }
+  putSetting(settings, SETTINGS_INITIAL_WINDOW_SIZE, streamWindowSize_);
+  appendFrameHeader(out, static_cast<uint32_t>(settings.size()), FRAME_SETTINGS, 0, 0);
+  out += settings;
+  if (connectionWindowSize_ > DEFAULT_WINDOW) {
+    appendFrameHeader(out, 4, FRAME_WINDOW_UPDATE, 0, 0);
+    put32(out, static_cast<uint32_t>(connectionWindowSize_ - DEFAULT_WINDOW));
+  }
+
+  lockWrite();
+  try {
+    writeOut(out);
+  } catch (...) {
+    unlockWrite();
+    throw;
+  }
+  unlockWrite();
+}
+
+bool THttp2Session::fill(size_t need) {
+  if (readLen_ - readPos_ >= need) {
+    return true;
+  }
+  if (readPos_ > 0) {
+    std::memmove(&readBuf_[0], &readBuf_[readPos_], readLen_ - readPos_);
+    readLen_ -= readPos_;
+    readPos_ = 0;
+  }
+  while (readLen_ < need) {
+    uint32_t got = transport_->read(&readBuf_[readLen_],
+                                    static_cast<uint32_t>(readBuf_.size() - readLen_));
+    if (got == 0) {
+      if (readLen_ == 0) {
+        return false;
+      }
+      throw TTransportException(TTransportException::END_OF_FILE,
+                                "HTTP/2 connection closed in the middle of a frame");
+    }
+    readLen_ += got;
+  }
+  return true;
+}
+
+bool THttp2Session::readFrame() {
+  if (!prefaceRead_) {
+    if (!fill(PREFACE_SIZE)) {
+      return false;
+    }
+    if (std::memcmp(&readBuf_[readPos_], PREFACE, PREFACE_SIZE) != 0) {
+      connectionError(H2_PROTOCOL_ERROR, "bad connection preface");
+    }
+    readPos_ += PREFACE_SIZE;
+    prefaceRead_ = true;
+  }
+
+  if (!fill(FRAME_HEADER_SIZE)) {
+    return false;
+  }
+  const uint8_t* header = &readBuf_[readPos_];
+  uint32_t len = (static_cast<uint32_t>(header[0]) << 16) | (static_cast<uint32_t>(header[1]) << 8)
+                 | header[2];
+  uint8_t type = header[3];
+  uint8_t flags = header[4];
+  auto streamId = static_cast<int32_t>(get32(header + 5) & 0x7fffffff);
+  if (len > MAX_FRAME_SIZE) {
+    connectionError(H2_FRAME_SIZE_ERROR, "frame too large");
+  }
+  fill(FRAME_HEADER_SIZE + len);
+  const uint8_t* payload = &readBuf_[readPos_ + FRAME_HEADER_SIZE];
+  readPos_ += FRAME_HEADER_SIZE + len;
+
+  if (continuationStream_ != 0 && (type != FRAME_CONTINUATION || streamId != continuationStream_)) {
+    connectionError(H2_PROTOCOL_ERROR, "expected CONTINUATION");
+  }
+
+  switch (type) {
+  case FRAME_DATA:
+    handleData(streamId, flags, payload, len);
+    break;
+  case FRAME_HEADERS:
+    handleHeaders(streamId, flags, payload, len);
+    break;
+  case FRAME_CONTINUATION:
+    if (continuationStream_ == 0) {
+      connectionError(H2_PROTOCOL_ERROR, "unexpected CONTINUATION");
+    }
+    if (headerBlock_.size() + len > MAX_HEADER_BLOCK) {
+      connectionError(H2_ENHANCE_YOUR_CALM, "header block too large");
+    }
+    headerBlock_.append(reinterpret_cast<const char*>(payload), len);
+    if (flags & FLAG_END_HEADERS) {
+      continuationStream_ = 0;
+      handleHeaderBlock(streamId, continuationEndStream_);
+    }
+    break;
+  case FRAME_PRIORITY:
+    if (streamId == 0) {
+      connectionError(H2_PROTOCOL_ERROR, "PRIORITY on stream 0");
+    }
+    if (len != 5) {
+      connectionError(H2_FRAME_SIZE_ERROR, "bad PRIORITY frame");
+    }
+    break;
+  case FRAME_RST_STREAM:
+    handleRstStream(streamId, payload, len);
+    break;
+  case FRAME_SETTINGS:
+    if (streamId != 0) {
+      connectionError(H2_PROTOCOL_ERROR, "SETTINGS on a stream");
+    }
+    handleSettings(flags, payload, len);
+    break;
+  case FRAME_PUSH_PROMISE:
+    connectionError(H2_PROTOCOL_ERROR, "push is disabled");
+  case FRAME_PING:
+    if (streamId != 0) {
+      connectionError(H2_PROTOCOL_ERROR, "PING on a stream");
+    }
+    if (len != 8) {
+      connectionError(H2_FRAME_SIZE_ERROR, "bad PING frame");
+    }
+    if (!(flags & FLAG_ACK)) {
+      string ack;
+      appendFrameHeader(ack, 8, FRAME_PING, FLAG_ACK, 0);
+      ack.append(reinterpret_cast<const char*>(payload), 8);
+      queueControl(ack);
+      flushControl();
+    }
+    break;
+  case FRAME_GOAWAY:
+    if (streamId != 0) {
+      connectionError(H2_PROTOCOL_ERROR, "GOAWAY on a stream");
+    }
+    handleGoAway(payload, len);
+    break;
+  case FRAME_WINDOW_UPDATE:
+    handleWindowUpdate(streamId, payload, len);
+    break;
+  default:
+    // Unknown frame types are ignored (RFC 7540 4.1)
+    break;
+  }
+  return true;
+}
+
+void THttp2Session::handleData(int32_t streamId,
+                               uint8_t flags,
+                               const uint8_t* payload,
+                               uint32_t len) {
+  if (streamId == 0) {
+    connectionError(H2_PROTOCOL_ERROR, "DATA on stream 0");
+  }
+  // Padding counts against the windows too
+  uint32_t flowLen = len;
+  if (flags & FLAG_PADDED) {
+    if (len < 1 || payload[0] >= len) {
+      connectionError(H2_PROTOCOL_ERROR, "bad padding");
+    }
+    len -= 1 + payload[0];
+    ++payload;
+  }
+
+  connRecvUnacked_ += flowLen;
+  if (connRecvUnacked_ >= connectionWindowSize_ / 2) {
+    string update;
+    appendFrameHeader(update, 4, FRAME_WINDOW_UPDATE, 0, 0);
+    put32(update, connRecvUnacked_);
+    queueControl(update);
+    connRecvUnacked_ = 0;
+  }
+
+  shared_ptr<Stream> stream = findStream(streamId);
+  if (!stream || stream->remoteEnded) {
+    // Most likely a stream we reset or refused; its data is dropped
+    flushControl();
+    return;
+  }
+  if (!stream->headersDone) {
+    connectionError(H2_PROTOCOL_ERROR, "DATA before HEADERS");
+  }
+
+  if (stream->body.size() + len > maxMessageSize_) {
+    stream->body.clear();
+    flushControl();
+    sendReset(streamId, H2_CANCEL);
+    onReset(streamId, H2_CANCEL);
+    return;
+  }
+  stream->body.append(reinterpret_cast<const char*>(payload), len);
+
+  if (flags & FLAG_END_STREAM) {
+    flushControl();
+    endRemote(streamId, stream);
+    return;
+  }
+  stream->recvUnacked += flowLen;
+  if (stream->recvUnacked >= streamWindowSize_ / 2) {
+    string update;
+    appendFrameHeader(update, 4, FRAME_WINDOW_UPDATE, 0, streamId);
+    put32(update, stream->recvUnacked);
+    queueControl(update);
+    stream->recvUnacked = 0;
+  }
+  flushControl();
+}
+
+void THttp2Session::handleHeaders(int32_t streamId,
+                                  uint8_t flags,
+                                  const uint8_t* payload,
+                                  uint32_t len) {
+  if (streamId == 0) {
+    connectionError(H2_PROTOCOL_ERROR, "HEADERS on stream 0");
+  }
+  uint32_t pad = 0;
+  if (flags & FLAG_PADDED) {
+    if (len < 1) {
+      connectionError(H2_PROTOCOL_ERROR, "bad padding");
+    }
+    pad = payload[0];
+    ++payload;
+    --len;
+  }
+  if (flags & FLAG_PRIORITY) {
+    if (len < 5) {
+      connectionError(H2_FRAME_SIZE_ERROR, "bad HEADERS frame");
+    }
+    payload += 5;
+    len -= 5;
+  }
+  if (pad > len) {
+    connectionError(H2_PROTOCOL_ERROR, "bad padding");
+  }
+  headerBlock_.assign(reinterpret_cast<const char*>(payload), len - pad);
+
+  if (flags & FLAG_END_HEADERS) {
+    handleHeaderBlock(streamId, (flags & FLAG_END_STREAM) != 0);
+  } else {
+    continuationStream_ = streamId;
+    continuationEndStream_ = (flags & FLAG_END_STREAM) != 0;
+  }
+}
+
+void THttp2Session::handleHeaderBlock(int32_t streamId, bool endStream) {
+  // Always decode, to keep the dynamic table in step with the peer's
+  THttp2Headers fields;
+  try {
+    decoder_.decode(reinterpret_cast<const uint8_t*>(headerBlock_.data()),
+                    headerBlock_.size(),
+                    fields);
+  } catch (const TTransportException& ex) {
+    connectionError(H2_COMPRESSION_ERROR, ex.what());
+  }
+
+  shared_ptr<Stream> stream = findStream(streamId);
+  if (!stream) {
+    bool peerStream = (streamId & 1) == (server_ ? 1 : 0);
+    if (!peerStream) {
+      // One of ours that is already gone
+      return;
+    }
+    if (!server_) {
+      connectionError(H2_PROTOCOL_ERROR, "server opened a stream");
+    }
+    bool refuse;
+    {
+      Synchronized s(mon_);
+      if (streamId <= lastRemoteStream_) {
+        // Closed already
+        return;
+      }
+      lastRemoteStream_ = streamId;
+      refuse = closed_ || goAwaySent_
+               || (maxConcurrentStreams_ != 0 && streams_.size() >= maxConcurrentStreams_);
+      if (!refuse) {
+        stream = std::make_shared<Stream>(peerInitialWindow_);
+        streams_[streamId] = stream;
+      }
+    }
+    if (refuse) {
+      sendReset(streamId, H2_REFUSED_STREAM);
+      return;
+    }
+  }
+
+  if (stream->remoteEnded) {
+    return;
+  }
+  if (stream->headersDone) {
+    // Trailers; nothing in them matters to Thrift
+    if (!endStream) {
+      connectionError(H2_PROTOCOL_ERROR, "trailers without END_STREAM");
+    }
+    endRemote(streamId, stream);
+    return;
+  }
+  if (!server_ && !endStream) {
+    // Informational (1xx) responses come before the real one
+    for (auto& field : fields) {
+      if (field.first == ":status") {
+        if (!field.second.empty() && field.second[0] == '1') {
+          return;
+        }
+        break;
+      }
+    }
+  }
+  stream->headers.swap(fields);
+  stream->headersDone = true;
+  if (endStream) {
+    endRemote(streamId, stream);
+  }
+}
+
+void THttp2Session::handleSettings(uint8_t flags, const uint8_t* payload, uint32_t len) {
+  if (flags & FLAG_ACK) {
+    if (len != 0) {
+      connectionError(H2_FRAME_SIZE_ERROR, "bad SETTINGS ack");
+    }
+    return;
+  }
+  if (len % 6 != 0) {
+    connectionError(H2_FRAME_SIZE_ERROR, "bad SETTINGS frame");
+  }
+
+  const char* error = nullptr;
+  ErrorCode code = H2_PROTOCOL_ERROR;
+  {
+    Synchronized s(mon_);
+    for (uint32_t i = 0; i < len && !error; i += 6) {
+      uint16_t id = static_cast<uint16_t>((payload[i] << 8) | payload[i + 1]);
+      uint32_t value = get32(payload + i + 2);
+      switch (id) {
+      case SETTINGS_HEADER_TABLE_SIZE:
+        peerTableSize_ = value;
+        peerTableSizeChanged_ = true;
+        break;
+      case SETTINGS_ENABLE_PUSH:
+        if (value > 1) {
+          error = "bad ENABLE_PUSH";
+        }
+        break;
+      case SETTINGS_MAX_CONCURRENT_STREAMS:
+        peerMaxConcurrentStreams_ = value;
+        break;
+      case SETTINGS_INITIAL_WINDOW_SIZE: {
+        if (value > MAX_WINDOW) {
+          error = "bad INITIAL_WINDOW_SIZE";
+          code = H2_FLOW_CONTROL_ERROR;
+          break;
+        }
+        // Applies to the windows of open streams too (RFC 7540 6.9.2)
+        int64_t delta = static_cast<int64_t>(value) - peerInitialWindow_;
+        for (auto& entry : streams_) {
+          entry.second->sendWindow += delta;
+        }
+        peerInitialWindow_ = value;
+        break;
+      }
+      case SETTINGS_MAX_FRAME_SIZE:
+        if (value < MAX_FRAME_SIZE || value > 0xffffff) {
+          error = "bad MAX_FRAME_SIZE";
+        }
+        break;
+      default:
+        break;
+      }
+    }
+    mon_.notifyAll();
+  }
+  if (error) {
+    connectionError(code, error);
+  }
+
+  string ack;
+  appendFrameHeader(ack, 0, FRAME_SETTINGS, FLAG_ACK, 0);
+  queueControl(ack);
+  flushControl();
+}
+
+void THttp2Session::handleWindowUpdate(int32_t streamId, const uint8_t* payload, uint32_t len) {
+  if (len != 4) {
+    connectionError(H2_FRAME_SIZE_ERROR, "bad WINDOW_UPDATE frame");
+  }
+  uint32_t increment = get32(payload) & 0x7fffffff;
+  bool overflow = false;
+  {
+    Synchronized s(mon_);
+    if (streamId == 0) {
+      connSendWindow_ += increment;
+      overflow = increment == 0 || connSendWindow_ > MAX_WINDOW;
+    } else {
+      auto it = streams_.find(streamId);
+      if (it != streams_.end()) {
+        it->second->sendWindow += increment;
+      }
+    }
+    mon_.notifyAll();
+  }
+  if (overflow) {
+    connectionError(H2_FLOW_CONTROL_ERROR, "bad connection WINDOW_UPDATE");
+  }
+}
+
+void THttp2Session::handleRstStream(int32_t streamId, const uint8_t* payload, uint32_t len) {
+  if (streamId == 0) {
+    connectionError(H2_PROTOCOL_ERROR, "RST_STREAM on stream 0");
+  }
+  if (len != 4) {
+    connectionError(H2_FRAME_SIZE_ERROR, "bad RST_STREAM frame");
+  }
+  {
+    Synchronized s(mon_);
+    auto it = streams_.find(streamId);
+    if (it == streams_.end()) {
+      return;
+    }
+    it->second->reset = true;
+    streams_.erase(it);
+    mon_.notifyAll();
+  }
+  onReset(streamId, get32(payload));
+}
+
+void THttp2Session::handleGoAway(const uint8_t* payload, uint32_t len) {
+  if (len < 8) {
+    connectionError(H2_FRAME_SIZE_ERROR, "bad GOAWAY frame");
+  }
+  auto lastStream = static_cast<int32_t>(get32(payload) & 0x7fffffff);
+
+  // Our streams after the last one the peer handles were never seen by it
+  std::vector<int32_t> refused;
+  {
+    Synchronized s(mon_);
+    goAwayStream_ = lastStream;
+    bool ours = !server_;
+    for (auto it = streams_.upper_bound(lastStream); it != streams_.end();) {
+      if (((it->first & 1) != 0) == ours) {
+        it->second->reset = true;
+        refused.push_back(it->first);
+        it = streams_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    mon_.notifyAll();
+  }
+  for (int32_t id : refused) {
+    onReset(id, H2_REFUSED_STREAM);
+  }
+}
+
+void THttp2Session::endRemote(int32_t streamId, const shared_ptr<Stream>& stream) {
+  {
+    Synchronized s(mon_);
+    stream->remoteEnded = true;
+    if (stream->localEnded) {
+      streams_.erase(streamId);
+    }
+  }
+  onMessage(streamId, stream->headers, stream->body);
+}
+
+void THttp2Session::endLocal(int32_t streamId, const shared_ptr<Stream>& stream) {
+  Synchronized s(mon_);
+  stream->localEnded = true;
+  if (stream->remoteEnded) {
+    streams_.erase(streamId);
+  }
+}
+
+shared_ptr<THttp2Session::Stream> THttp2Session::findStream(int32_t streamId) {
+  Synchronized s(mon_);
+  auto it = streams_.find(streamId);
+  return it == streams_.end() ? shared_ptr<Stream>() : it->second;
+}
+
+uint32_t THttp2Session::reserveWindow(const shared_ptr<Stream>& stream, uint32_t want, bool wait) {
+  Synchronized s(mon_);
+  for (;;) {
+    if (closed_) {
+      throw TTransportException(TTransportException::NOT_OPEN, "HTTP/2 session is closed");
+    }
+    if (stream->reset) {
+      return 0;
+    }
+    int64_t avail = (std::min)(connSendWindow_, stream->sendWindow);
+    if (avail > 0) {
+      auto n = static_cast<uint32_t>((std::min)(static_cast<int64_t>(want), avail));
+      connSendWindow_ -= n;
+      stream->sendWindow -= n;
+      return n;
+    }
+    if (!wait) {
+      return 0;
+    }
+    mon_.wait();
+  }
+}
+
+int32_t THttp2Session::sendMessage(int32_t streamId,
+                                   const THttp2Headers& headers,
+                                   const uint8_t* body,
+                                   uint32_t len) {
+  shared_ptr<Stream> stream;
+  const bool newStream = streamId == 0;
+  bool opening = newStream;
+  if (opening) {
+    Synchronized s(mon_);
+    while (!closed_ && goAwayStream_ < 0
+           && streams_.size() + openingStreams_ >= peerMaxConcurrentStreams_) {
+      mon_.wait();
+    }
+    if (closed_) {
+      throw TTransportException(TTransportException::NOT_OPEN, "HTTP/2 session is closed");
+    }
+    if (goAwayStream_ >= 0) {
+      throw TTransportException(TTransportException::NOT_OPEN, "HTTP/2 peer is going away");
+    }
+    ++openingStreams_;
+  } else {
+    stream = findStream(streamId);
+    if (!stream) {
+      return 0;
+    }
+  }
+
+  uint32_t sent = 0;
+  lockWrite();
+  try {
+    if (opening) {
+      Synchronized s(mon_);
+      --openingStreams_;
+      opening = false;
+      if (nextStreamId_ > 0x7ffffffd) {
+        goAwayStream_ = 0;
+        throw TTransportException(TTransportException::NOT_OPEN, "HTTP/2 stream ids used up");
+      }
+      streamId = nextStreamId_;
+      nextStreamId_ += 2;
+      stream = std::make_shared<Stream>(peerInitialWindow_);
+      streams_[streamId] = stream;
+    }
+
+    bool reset;
+    {
+      Synchronized s(mon_);
+      reset = stream->reset;
+      if (peerTableSizeChanged_) {
+        encoder_.setPeerMaxTableSize(peerTableSize_);
+        peerTableSizeChanged_ = false;
+      }
+    }
+    if (reset) {
+      unlockWrite();
+      return newStream ? streamId : 0;
+    }
+    encodeBuf_.clear();
+    encoder_.encode(headers, encodeBuf_);
+    writeBuf_.clear();
+    appendHeaders(writeBuf_, streamId, encodeBuf_, len == 0);
+
+    // As much of the body as the windows allow goes out with the headers
+    if (len > 0) {
+      sent = reserveWindow(stream, len, false);
+      for (uint32_t off = 0; off < sent; off += MAX_FRAME_SIZE) {
+        uint32_t n = (std::min)(sent - off, MAX_FRAME_SIZE);
+        appendFrameHeader(writeBuf_, n, FRAME_DATA, off + n == len ? FLAG_END_STREAM : 0, streamId);
+        writeBuf_.append(reinterpret_cast<const char*>(body) + off, n);
+      }
+    }
+    writeOut(writeBuf_);
+  } catch (...) {
+    if (opening) {
+      Synchronized s(mon_);
+      --openingStreams_;
+      mon_.notifyAll();
+    }
+    unlockWrite();
+    throw;
+  }
+  unlockWrite();
+
+  // The rest waits for WINDOW_UPDATEs, without holding up other senders
+  while (sent < len) {
+    uint32_t chunk = reserveWindow(stream, len - sent, true);
+    if (chunk == 0) {
+      return newStream ? streamId : 0;
+    }
+    lockWrite();
+    try {
+      writeBuf_.clear();
+      for (uint32_t off = sent; off < sent + chunk; off += MAX_FRAME_SIZE) {
+        uint32_t n = (std::min)(sent + chunk - off, MAX_FRAME_SIZE);
+        appendFrameHeader(writeBuf_, n, FRAME_DATA, off + n == len ? FLAG_END_STREAM : 0, streamId);
+        writeBuf_.append(reinterpret_cast<const char*>(body) + off, n);
+      }
+      writeOut(writeBuf_);
+    } catch (...) {
+      unlockWrite();
+      throw;
+    }
+    unlockWrite();
+    sent += chunk;
+  }
+
+  endLocal(streamId, stream);
+  return streamId;
+}
+
+void THttp2Session::sendReset(int32_t streamId, ErrorCode error) {
+  {
+    Synchronized s(mon_);
+    auto it = streams_.find(streamId);
+    if (it != streams_.end()) {
+      it->second->reset = true;
+      streams_.erase(it);
+      mon_.notifyAll();
+    }
+  }
+  string frame;
+  appendFrameHeader(frame, 4, FRAME_RST_STREAM, 0, streamId);
+  put32(frame, error);
+  queueControl(frame);
+  flushControl();
+}
+
+void THttp2Session::sendGoAway(ErrorCode error) {
+  string frame;
+  appendFrameHeader(frame, 8, FRAME_GOAWAY, 0, 0);
+  {
+    Synchronized s(mon_);
+    goAwaySent_ = true;
+    put32(frame, static_cast<uint32_t>(lastRemoteStream_));
+  }
+  put32(frame, error);
+  queueControl(frame);
+  flushControl();
+}
+
+void THttp2Session::close() {
+  {
+    Synchronized s(mon_);
+    if (closed_) {
+      return;
+    }
+    closed_ = true;
+    for (auto& entry : streams_) {
+      entry.second->reset = true;
+    }
+    mon_.notifyAll();
+  }
+  onClosed();
+}
+
+bool THttp2Session::isClosed() const {
+  Synchronized s(mon_);
+  return closed_;
+}
+
+void THttp2Session::connectionError(ErrorCode error, const string& message) {
+  try {
+    sendGoAway(error);
+  } catch (const TTransportException&) {
+    // Best effort
+  }
+  close();
+  throw TTransportException(TTransportException::CORRUPTED_DATA, "HTTP/2: " + message);
+}
+
+void THttp2Session::appendFrameHeader(string& out,
+                                      uint32_t len,
+                                      uint8_t type,
+                                      uint8_t flags,
+                                      int32_t streamId) {
+  char header[FRAME_HEADER_SIZE] = {static_cast<char>(len >> 16),
+                                    static_cast<char>(len >> 8),
+                                    static_cast<char>(len),
+                                    static_cast<char>(type),
+                                    static_cast<char>(flags),
+                                    static_cast<char>((streamId >> 24) & 0x7f),
+                                    static_cast<char>(streamId >> 16),
+                                    static_cast<char>(streamId >> 8),
+                                    static_cast<char>(streamId)};
+  out.append(header, FRAME_HEADER_SIZE);
+}
+
+void THttp2Session::appendHeaders(string& out,
+                                  int32_t streamId,
+                                  const string& block,
+                                  bool endStream) {
+  size_t off = 0;
+  uint8_t type = FRAME_HEADERS;
+  do {
+    auto n = static_cast<uint32_t>((std::min)(block.size() - off, static_cast<size_t>(MAX_FRAME_SIZE)));
+    uint8_t flags = off + n == block.size() ? FLAG_END_HEADERS : 0;
+    if (type == FRAME_HEADERS && endStream) {
+      flags |= FLAG_END_STREAM;
+    }
+    appendFrameHeader(out, n, type, flags, streamId);
+    out.append(block, off, n);
+    off += n;
+    type = FRAME_CONTINUATION;
+  } while (off < block.size());
+}
+
+void THttp2Session::lockWrite() {
+  writeMutex_.lock();
+}
+
+void THttp2Session::unlockWrite() {
+  for (;;) {
+    try {
+      drainControl();
+    } catch (const TTransportException&) {
+      // writeOut closed the session; whoever sends next finds out
+    }
+    writeMutex_.unlock();
+
+    // Frames queued after the drain, by a reader whose trylock failed,
+    // must not be left behind
+    {
+      Guard g(controlMutex_);
+      if (pendingControl_.empty()) {
+        return;
+      }
+    }
+    if (!writeMutex_.trylock()) {
+      return;
+    }
+  }
+}
+
+void THttp2Session::writeOut(string& frames) {
+  try {
+    transport_->write(reinterpret_cast<const uint8_t*>(frames.data()),
+                      static_cast<uint32_t>(frames.size()));
+    transport_->flush();
+  } catch (const TTransportException&) {
+    close();
+    throw;
+  }
+}
+
+void THttp2Session::queueControl(const string& frame) {
+  Guard g(controlMutex_);
+  pendingControl_ += frame;
+}
+
+void THttp2Session::flushControl() {
+  if (writeMutex_.trylock()) {
+    unlockWrite();
+  }
+}
+
+void THttp2Session::drainControl() {
+  string frames;
+  {
+    Guard g(controlMutex_);
+    frames.swap(pendingControl_);
+  }
+  if (!frames.empty()) {
+    writeOut(frames);
+  }
+}
+}
+}
+} // apache::thrift::transport
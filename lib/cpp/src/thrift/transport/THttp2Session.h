@@ -0,0 +1,264 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_THTTP2SESSION_H_
+#define _THRIFT_TRANSPORT_THTTP2SESSION_H_ 1
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <thrift/concurrency/Monitor.h>
+#include <thrift/concurrency/Mutex.h>
+#include <thrift/transport/THpack.h>
+#include <thrift/transport/TTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * One HTTP/2 connection (RFC 7540) over a cleartext transport, started
+ * with prior knowledge: the connection preface, SETTINGS, flow control,
+ * PING, GOAWAY and header compression.  Each Thrift call is one stream,
+ * a request message answered by a response message.  What to do with a
+ * complete message is left to subclasses: THttp2Connection on the client
+ * side, and the sessions of server::THttp2Server.
+ *
+ * One thread reads frames with readFrame(); any number of threads may
+ * send messages at once.  The reading thread never waits for a sender,
+ * so two peers that are both busy sending cannot deadlock each other.
+ */
+class THttp2Session {
+public:
+  /// RFC 7540 section 7
+  enum ErrorCode {
+    H2_NO_ERROR = 0x0,
+    H2_PROTOCOL_ERROR = 0x1,
+    H2_INTERNAL_ERROR = 0x2,
+    H2_FLOW_CONTROL_ERROR = 0x3,
+    H2_SETTINGS_TIMEOUT = 0x4,
+    H2_STREAM_CLOSED = 0x5,
+    H2_FRAME_SIZE_ERROR = 0x6,
+    H2_REFUSED_STREAM = 0x7,
+    H2_CANCEL = 0x8,
+    H2_COMPRESSION_ERROR = 0x9,
+    H2_CONNECT_ERROR = 0xa,
+    H2_ENHANCE_YOUR_CALM = 0xb
+  };
+
+  /**
+   * @param transport  The connection, e.g. a TSocket; it is read by one
+   *                   thread while others write.
+   * @param server     Whether this is the server end of the connection
+   */
+  THttp2Session(std::shared_ptr<TTransport> transport, bool server);
+
+  virtual ~THttp2Session();
+
+  /**
+   * Send the preface and our SETTINGS.  The settings below must be made
+   * before this.
+   */
+  void start();
+
+  /**
+   * Read and handle one frame.
+   *
+   * @return false if the peer closed the connection between frames
+   * @throws TTransportException on errors, after sending GOAWAY if the
+   *         peer broke the protocol
+   */
+  bool readFrame();
+
+  /**
+   * Send a message, waiting for flow control windows as needed.  Safe to
+   * call from any thread.
+   *
+   * @param streamId  Stream to answer, or 0 to open a new one
+   * @return the stream id, or 0 if the stream to answer is gone.  A new
+   *         stream that the peer resets is reported to onReset().
+   * @throws TTransportException if the session is closed
+   */
+  int32_t sendMessage(int32_t streamId,
+                      const THttp2Headers& headers,
+                      const uint8_t* body,
+                      uint32_t len);
+
+  /// Abort a stream
+  void sendReset(int32_t streamId, ErrorCode error);
+
+  /// Tell the peer that no new streams will be handled.  Best effort.
+  void sendGoAway(ErrorCode error);
+
+  /**
+   * Stop the session: waiting senders fail, and onClosed() is called.
+   * The transport is left to the caller.
+   */
+  void close();
+
+  bool isClosed() const;
+
+  std::shared_ptr<TTransport> getTransport() const { return transport_; }
+
+  /// Streams the peer may open at once (server), 0 for no limit
+  void setMaxConcurrentStreams(uint32_t streams) { maxConcurrentStreams_ = streams; }
+  uint32_t getMaxConcurrentStreams() const { return maxConcurrentStreams_; }
+
+  /// Bytes the peer may send on a stream before we ask for more
+  void setStreamWindowSize(uint32_t size) { streamWindowSize_ = size; }
+  uint32_t getStreamWindowSize() const { return streamWindowSize_; }
+
+  /// Bytes the peer may send on all streams before we ask for more
+  void setConnectionWindowSize(uint32_t size) { connectionWindowSize_ = size; }
+  uint32_t getConnectionWindowSize() const { return connectionWindowSize_; }
+
+  /// Largest message accepted; larger ones are reset with H2_CANCEL
+  void setMaxMessageSize(uint32_t size) { maxMessageSize_ = size; }
+  uint32_t getMaxMessageSize() const { return maxMessageSize_; }
+
+  static const uint32_t DEFAULT_MAX_CONCURRENT_STREAMS = 100;
+  static const uint32_t DEFAULT_STREAM_WINDOW_SIZE = 1 << 20;
+  static const uint32_t DEFAULT_CONNECTION_WINDOW_SIZE = 16 << 20;
+
+protected:
+  /**
+   * A complete message arrived on a stream.  Called on the reading thread,
+   * which should not block here.
+   */
+  virtual void onMessage(int32_t streamId, THttp2Headers& headers, std::string& body) = 0;
+
+  /**
+   * A stream ended before its message completed: the peer reset it or
+   * refused it by GOAWAY, or its message was too large.
+   */
+  virtual void onReset(int32_t streamId, uint32_t error) = 0;
+
+  /// The session stopped; nothing more will be received
+  virtual void onClosed() {}
+
+private:
+  struct Stream {
+    explicit Stream(int64_t window)
+      : sendWindow(window), recvUnacked(0), localEnded(false), remoteEnded(false),
+        headersDone(false), reset(false) {}
+
+    int64_t sendWindow;
+    uint32_t recvUnacked;
+    bool localEnded;
+    bool remoteEnded;
+    bool headersDone;
+    bool reset;
+    THttp2Headers headers;
+    std::string body;
+  };
+
+  enum FrameType {
+    FRAME_DATA = 0x0,
+    FRAME_HEADERS = 0x1,
+    FRAME_PRIORITY = 0x2,
+    FRAME_RST_STREAM = 0x3,
+    FRAME_SETTINGS = 0x4,
+    FRAME_PUSH_PROMISE = 0x5,
+    FRAME_PING = 0x6,
+    FRAME_GOAWAY = 0x7,
+    FRAME_WINDOW_UPDATE = 0x8,
+    FRAME_CONTINUATION = 0x9
+  };
+
+  bool fill(size_t need);
+  void handleData(int32_t streamId, uint8_t flags, const uint8_t* payload, uint32_t len);
+  void handleHeaders(int32_t streamId, uint8_t flags, const uint8_t* payload, uint32_t len);
+  void handleHeaderBlock(int32_t streamId, bool endStream);
+  void handleSettings(uint8_t flags, const uint8_t* payload, uint32_t len);
+  void handleWindowUpdate(int32_t streamId, const uint8_t* payload, uint32_t len);
+  void handleRstStream(int32_t streamId, const uint8_t* payload, uint32_t len);
+  void handleGoAway(const uint8_t* payload, uint32_t len);
+  void endRemote(int32_t streamId, const std::shared_ptr<Stream>& stream);
+  void endLocal(int32_t streamId, const std::shared_ptr<Stream>& stream);
+  std::shared_ptr<Stream> findStream(int32_t streamId);
+  uint32_t reserveWindow(const std::shared_ptr<Stream>& stream, uint32_t want, bool wait);
+  [[noreturn]] void connectionError(ErrorCode error, const std::string& message);
+
+  static void appendFrameHeader(std::string& out,
+                                uint32_t len,
+                                uint8_t type,
+                                uint8_t flags,
+                                int32_t streamId);
+  void appendHeaders(std::string& out, int32_t streamId, const std::string& block, bool endStream);
+
+  // Writing.  Frames from the reading thread are queued, and written by
+  // whoever holds writeMutex_, so that the reader never blocks on it.
+  void lockWrite();
+  void unlockWrite();
+  void writeOut(std::string& frames);
+  void queueControl(const std::string& frame);
+  void flushControl();
+  void drainControl();
+
+  std::shared_ptr<TTransport> transport_;
+  bool server_;
+
+  uint32_t maxConcurrentStreams_;
+  uint32_t streamWindowSize_;
+  uint32_t connectionWindowSize_;
+  uint32_t maxMessageSize_;
+
+  // Reading thread only
+  std::vector<uint8_t> readBuf_;
+  size_t readPos_;
+  size_t readLen_;
+  bool prefaceRead_;
+  THpackDecoder decoder_;
+  std::string headerBlock_;
+  int32_t continuationStream_;
+  bool continuationEndStream_;
+  uint32_t connRecvUnacked_;
+
+  // Guarded by writeMutex_
+  concurrency::Mutex writeMutex_;
+  THpackEncoder encoder_;
+  int32_t nextStreamId_;
+  std::string encodeBuf_;
+  std::string writeBuf_;
+
+  // Guarded by controlMutex_
+  concurrency::Mutex controlMutex_;
+  std::string pendingControl_;
+
+  // Guarded by mon_
+  concurrency::Monitor mon_;
+  std::map<int32_t, std::shared_ptr<Stream> > streams_;
+  int64_t connSendWindow_;
+  int64_t peerInitialWindow_;
+  uint32_t peerMaxConcurrentStreams_;
+  uint32_t openingStreams_;
+  size_t peerTableSize_;
+  bool peerTableSizeChanged_;
+  int32_t lastRemoteStream_;
+  int32_t goAwayStream_;
+  bool goAwaySent_;
+  bool closed_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_THTTP2SESSION_H_
@@ -17,7 +17,9 @@
  * under the License.
  */
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <sstream>
 #include <iostream>
 
@@ -35,8 +37,8 @@ namespace thrift {
 namespace transport {
 
 THttpServer::THttpServer(std::shared_ptr<TTransport> transport, std::shared_ptr<TConfiguration> config) 
-  : THttpTransport(transport, config) {
-
+  : THttpTransport(transport, config), keepAlive_(true), dateTime_(0) {
+  headerReserve_ = HEADER_RESERVE;
 }
 
 THttpServer::~THttpServer() = default;
@@ -51,6 +53,15 @@ THttpServer::~THttpServer() = default;
   #define THRIFT_strcasestr(haystack, needle) strcasestr(haystack, needle)
 #endif
 
+namespace {
+
+// Whether the header name of length len is exactly name, ignoring case
+template <size_t N>
+bool isHeader(const char* header, size_t len, const char (&name)[N]) {
+  return len == N - 1 && THRIFT_strncasecmp(header, name, len) == 0;
+}
+}
+
 void THttpServer::parseHeader(char* header) {
   char* colon = strchr(header, ':');
   if (colon == nullptr) {
@@ -59,14 +70,20 @@ void THttpServer::parseHeader(char* header) {
   size_t sz = colon - header;
   char* value = colon + 1;
 
-  if (THRIFT_strncasecmp(header, "Transfer-Encoding", sz) == 0) {
+  if (isHeader(header, sz, "Content-Length")) {
+    chunked_ = false;
+    contentLength_ = atoi(value);
+  } else if (isHeader(header, sz, "Transfer-Encoding")) {
     if (THRIFT_strcasestr(value, "chunked") != nullptr) {
       chunked_ = true;
     }
-  } else if (THRIFT_strncasecmp(header, "Content-length", sz) == 0) {
-    chunked_ = false;
-    contentLength_ = atoi(value);
-  } else if (strncmp(header, "X-Forwarded-For", sz) == 0) {
+  } else if (isHeader(header, sz, "Connection")) {
+    if (THRIFT_strcasestr(value, "close") != nullptr) {
+      keepAlive_ = false;
+    } else if (THRIFT_strcasestr(value, "keep-alive") != nullptr) {
+      keepAlive_ = true;
+    }
+  } else if (sz == 15 && strncmp(header, "X-Forwarded-For", sz) == 0) {
     origin_ = value;
   }
 }
@@ -89,6 +106,9 @@ bool THttpServer::parseStatusLine(char* status) {
   }
   *http = '\0';
 
+  // HTTP/1.1 connections persist unless the client says otherwise
+  keepAlive_ = strcmp(http + 1, "HTTP/1.0") != 0;
+
   if (strcmp(method, "POST") == 0) {
     // POST method ok, looking for content.
     return true;
@@ -98,6 +118,7 @@ bool THttpServer::parseStatusLine(char* status) {
     uint8_t* buf;
     uint32_t len;
     writeBuffer_.getBuffer(&buf, &len);
+    uint32_t reserved = (std::min)(len, headerReserve_);
 
     // Construct the HTTP header
     std::ostringstream h;
@@ -108,7 +129,7 @@ bool THttpServer::parseStatusLine(char* status) {
 
     // Write the header, then the data, then flush
     transport_->write((const uint8_t*)header.c_str(), static_cast<uint32_t>(header.size()));
-    transport_->write(buf, len);
+    transport_->write(buf + reserved, len - reserved);
     transport_->flush();
 
     // Reset the buffer and header variables
@@ -121,46 +142,68 @@ bool THttpServer::parseStatusLine(char* status) {
 
 void THttpServer::flush() {
   resetConsumedMessageSize();
-  // Fetch the contents of the write buffer
+  // Fetch the contents of the write buffer, behind the room left for the header
   uint8_t* buf;
   uint32_t len;
   writeBuffer_.getBuffer(&buf, &len);
+  uint32_t reserved = (std::min)(len, headerReserve_);
 
   // Construct the HTTP header
-  string header = getHeader(len);
+  string header = getHeader(len - reserved);
+  auto headerLen = static_cast<uint32_t>(header.size());
 
   // Write the header, then the data, then flush
   // cast should be fine, because none of "header" is under attacker control
-  transport_->write((const uint8_t*)header.c_str(), static_cast<uint32_t>(header.size()));
-  transport_->write(buf, len);
+  if (headerLen <= reserved) {
+    uint8_t* start = buf + reserved - headerLen;
+    memcpy(start, header.data(), headerLen);
+    transport_->write(start, headerLen + len - reserved);
+  } else {
+    transport_->write((const uint8_t*)header.c_str(), headerLen);
+    transport_->write(buf + reserved, len - reserved);
+  }
   transport_->flush();
 
   // Reset the buffer and header variables
   writeBuffer_.resetBuffer();
   readHeaders_ = true;
+
+  if (!keepAlive_) {
+    transport_->close();
+  }
 }
 
 std::string THttpServer::getHeader(uint32_t len) {
-  std::ostringstream h;
-  h << "HTTP/1.1 200 OK" << CRLF << "Date: " << getTimeRFC1123() << CRLF << "Server: Thrift/"
-    << PACKAGE_VERSION << CRLF << "Access-Control-Allow-Origin: *" << CRLF
-    << "Content-Type: application/x-thrift" << CRLF << "Content-Length: " << len << CRLF
-    << "Connection: Keep-Alive" << CRLF << CRLF;
-  return h.str();
+  string h;
+  h.reserve(HEADER_RESERVE);
+  h += "HTTP/1.1 200 OK\r\nDate: ";
+  h += getTimeRFC1123();
+  h += "\r\nServer: Thrift/" PACKAGE_VERSION
+       "\r\nAccess-Control-Allow-Origin: *"
+       "\r\nContent-Type: application/x-thrift"
+       "\r\nContent-Length: ";
+  h += std::to_string(len);
+  h += keepAlive_ ? "\r\nConnection: Keep-Alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n";
+  return h;
 }
 
 std::string THttpServer::getTimeRFC1123() {
   static const char* Days[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
   static const char* Months[]
       = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
-  char buff[128];
 
+  // Formatted at most once a second
   time_t t = time(nullptr);
+  if (t == dateTime_ && !date_.empty()) {
+    return date_;
+  }
+
+  char buff[128];
   struct tm tmb;
   THRIFT_GMTIME(tmb, t);
 
   sprintf(buff,
-          "%s, %d %s %d %d:%d:%d GMT",
+          "%s, %02d %s %d %02d:%02d:%02d GMT",
           Days[tmb.tm_wday],
           tmb.tm_mday,
           Months[tmb.tm_mon],
@@ -168,7 +211,9 @@ std::string THttpServer::getTimeRFC1123() {
           tmb.tm_hour,
           tmb.tm_min,
           tmb.tm_sec);
-  return std::string(buff);
+  date_ = buff;
+  dateTime_ = t;
+  return date_;
 }
 }
 }
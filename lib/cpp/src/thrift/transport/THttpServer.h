@@ -20,6 +20,8 @@
 #ifndef _THRIFT_TRANSPORT_THTTPSERVER_H_
 #define _THRIFT_TRANSPORT_THTTPSERVER_H_ 1
 
+#include <ctime>
+
 #include <thrift/transport/THttpTransport.h>
 
 namespace apache {
@@ -32,6 +34,10 @@ public:
 
   ~THttpServer() override;
 
+  /**
+   * Sends the response.  Unless a subclass makes getHeader() return more
+   * than HEADER_RESERVE bytes, header and body go out in a single write.
+   */
   void flush() override;
 
 protected:
@@ -40,6 +46,16 @@ protected:
   void parseHeader(char* header) override;
   bool parseStatusLine(char* status) override;
   std::string getTimeRFC1123();
+
+  /// Room for the response header kept in front of the response body
+  static const uint32_t HEADER_RESERVE = 256;
+
+  /// Whether the client wants the connection kept open after this request
+  bool keepAlive_;
+
+  /// getTimeRFC1123() for the second dateTime_
+  time_t dateTime_;
+  std::string date_;
 };
 
 /**
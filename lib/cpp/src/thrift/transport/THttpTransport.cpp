@@ -21,6 +21,11 @@
 
 #include <thrift/transport/THttpTransport.h>
 
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__SSE2__)
+#include <emmintrin.h>
+#define THRIFT_HTTP_SSE2 1
+#endif
+
 using std::string;
 
 namespace apache {
@@ -31,6 +36,38 @@ namespace transport {
 const char* THttpTransport::CRLF = "\r\n";
 const int THttpTransport::CRLF_LEN = 2;
 
+namespace {
+
+// Finds the first CRLF of the line starting at line, looking for its LF
+// from from on, and returns a pointer to its CR, or nullptr.  Unlike
+// strstr() this neither rescans what was looked at before a refill nor
+// stops at a NUL byte.
+const char* findCRLF(const char* line, const char* from, const char* end) {
+  const char* p = from;
+#ifdef THRIFT_HTTP_SSE2
+  const __m128i lf = _mm_set1_epi8('\n');
+  while (end - p >= 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, lf)));
+    while (mask != 0) {
+      const char* eol = p + __builtin_ctz(mask);
+      if (eol > line && eol[-1] == '\r') {
+        return eol - 1;
+      }
+      mask &= mask - 1;
+    }
+    p += 16;
+  }
+#endif
+  for (; p < end; ++p) {
+    if (*p == '\n' && p > line && p[-1] == '\r') {
+      return p - 1;
+    }
+  }
+  return nullptr;
+}
+}
+
 THttpTransport::THttpTransport(std::shared_ptr<TTransport> transport, std::shared_ptr<TConfiguration> config)
   : TVirtualTransport(config),
     transport_(transport),
@@ -43,7 +80,8 @@ THttpTransport::THttpTransport(std::shared_ptr<TTransport> transport, std::share
     httpBuf_(nullptr),
     httpPos_(0),
     httpBufLen_(0),
-    httpBufSize_(1024) {
+    httpBufSize_(1024),
+    headerReserve_(0) {
   init();
 }
 
@@ -167,20 +205,21 @@ uint32_t THttpTransport::readContent(uint32_t size) {
 }
 
 char* THttpTransport::readLine() {
+  // How much of the line has been searched, in case it spans refills
+  uint32_t scanned = 0;
   while (true) {
-    char* eol = nullptr;
-
-    eol = strstr(httpBuf_ + httpPos_, CRLF);
+    char* line = httpBuf_ + httpPos_;
+    char* eol = const_cast<char*>(findCRLF(line, line + scanned, httpBuf_ + httpBufLen_));
 
     // No CRLF yet?
     if (eol == nullptr) {
       // Shift whatever we have now to front and refill
+      scanned = httpBufLen_ - httpPos_;
       shift();
       refill();
     } else {
       // Return pointer to next line
       *eol = '\0';
-      char* line = httpBuf_ + httpPos_;
       httpPos_ = static_cast<uint32_t>((eol - httpBuf_) + CRLF_LEN);
       return line;
     }
@@ -201,6 +240,11 @@ void THttpTransport::shift() {
 }
 
 void THttpTransport::refill() {
+  if (!transport_->isOpen()) {
+    // e.g. the server closed it after a "Connection: close" response
+    throw TTransportException(TTransportException::END_OF_FILE, "Connection closed");
+  }
+
   uint32_t avail = httpBufSize_ - httpBufLen_;
   if (avail <= (httpBufSize_ / 4)) {
     httpBufSize_ *= 2;
@@ -256,6 +300,11 @@ void THttpTransport::readHeaders() {
 }
 
 void THttpTransport::write(const uint8_t* buf, uint32_t len) {
+  if (headerReserve_ > 0 && writeBuffer_.available_read() == 0) {
+    // flush() fills this in, so that header and body go out in one write
+    writeBuffer_.getWritePtr(headerReserve_);
+    writeBuffer_.wroteBytes(headerReserve_);
+  }
   writeBuffer_.write(buf, len);
 }
 
@@ -44,7 +44,13 @@ public:
 
   bool isOpen() const override { return transport_->isOpen(); }
 
-  bool peek() override { return transport_->peek(); }
+  /**
+   * Pipelined requests may already be buffered here, with nothing left
+   * to read from the underlying transport.
+   */
+  bool peek() override {
+    return readBuffer_.available_read() > 0 || httpPos_ < httpBufLen_ || transport_->peek();
+  }
 
   void close() override { transport_->close(); }
 
@@ -78,6 +84,9 @@ protected:
   uint32_t httpBufLen_;
   uint32_t httpBufSize_;
 
+  /// Room kept in front of written data for the message header, if any
+  uint32_t headerReserve_;
+
   virtual void init();
 
   uint32_t readMoreData();
@@ -0,0 +1,51 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TLOCALSERVERSOCKET_H_
+#define _THRIFT_TRANSPORT_TLOCALSERVERSOCKET_H_ 1
+
+#include <thrift/transport/TServerSocket.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Server socket that accepts TLocalSocket connections: a Unix domain
+ * socket of type SOCK_SEQPACKET.  Since every message arrives whole, use
+ * it with a plain TTransportFactory.  Only built on Linux.
+ */
+class TLocalServerSocket : public TServerSocket {
+public:
+  /**
+   * Constructor.
+   *
+   * @param path A file system path, or an abstract name as returned by
+   *             TLocalSocket::abstractPath()
+   */
+  TLocalServerSocket(const std::string& path);
+
+protected:
+  std::shared_ptr<TSocket> createSocket(THRIFT_SOCKET client) override;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TLOCALSERVERSOCKET_H_
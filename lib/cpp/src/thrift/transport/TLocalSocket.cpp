@@ -0,0 +1,366 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/transport/TLocalSocket.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <thrift/TOutput.h>
+#include <thrift/transport/PlatformSocket.h>
+#include <thrift/transport/SocketCommon.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+const uint32_t TLocalSocket::MAX_PACKET_SIZE;
+const size_t TLocalSocket::MAX_DESCRIPTORS;
+
+TLocalSocket::TLocalSocket(const std::string& path, std::shared_ptr<TConfiguration> config)
+  : TSocket(path, config), rPos_(0), rLen_(0) {
+}
+
+TLocalSocket::TLocalSocket(THRIFT_SOCKET socket,
+                           std::shared_ptr<THRIFT_SOCKET> interruptListener,
+                           std::shared_ptr<TConfiguration> config)
+  : TSocket(socket, interruptListener, config), rPos_(0), rLen_(0) {
+}
+
+TLocalSocket::~TLocalSocket() {
+  closeDescriptors();
+}
+
+void TLocalSocket::open() {
+  if (isOpen()) {
+    return;
+  }
+  if (path_.empty()) {
+    throw TTransportException(TTransportException::NOT_OPEN, "TLocalSocket has no path");
+  }
+
+  struct sockaddr_un address;
+  socklen_t structlen = fillUnixSocketAddr(address, path_);
+
+  THRIFT_SOCKET sock = socket(PF_UNIX, SOCK_SEQPACKET, 0);
+  if (sock == THRIFT_INVALID_SOCKET) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    GlobalOutput.perror("TLocalSocket::open() socket() " + getSocketInfo(), errno_copy);
+    throw TTransportException(TTransportException::NOT_OPEN, "socket()", errno_copy);
+  }
+  if (-1 == connect(sock, reinterpret_cast<struct sockaddr*>(&address), structlen)) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    ::THRIFT_CLOSESOCKET(sock);
+    GlobalOutput.perror("TLocalSocket::open() connect() " + getSocketInfo(), errno_copy);
+    throw TTransportException(TTransportException::NOT_OPEN, "connect() failed", errno_copy);
+  }
+  socket_ = sock;
+
+#ifdef SO_NOSIGPIPE
+  {
+    int one = 1;
+    setsockopt(socket_, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+  }
+#endif
+  if (sendTimeout_ > 0) {
+    setSendTimeout(sendTimeout_);
+  }
+  if (recvTimeout_ > 0) {
+    setRecvTimeout(recvTimeout_);
+  }
+}
+
+void TLocalSocket::close() {
+  TSocket::close();
+  rPos_ = rLen_ = 0;
+  wBuf_.clear();
+  sendFds_.clear();
+  closeDescriptors();
+}
+
+bool TLocalSocket::peek() {
+  return rPos_ < rLen_ || TSocket::peek();
+}
+
+bool TLocalSocket::hasPendingDataToRead() {
+  return rPos_ < rLen_ || TSocket::hasPendingDataToRead();
+}
+
+uint32_t TLocalSocket::read(uint8_t* buf, uint32_t len) {
+  checkReadBytesAvailable(len);
+  if (rPos_ == rLen_ && !receivePacket()) {
+    return 0;
+  }
+  uint32_t give = (std::min)(len, rLen_ - rPos_);
+  std::memcpy(buf, rBuf_.get() + rPos_, give);
+  rPos_ += give;
+  return give;
+}
+
+void TLocalSocket::write(const uint8_t* buf, uint32_t len) {
+  wBuf_.insert(wBuf_.end(), buf, buf + len);
+}
+
+void TLocalSocket::flush() {
+  if (wBuf_.empty()) {
+    if (!sendFds_.empty()) {
+      // A packet without data would look like the end of the connection
+      throw TTransportException(TTransportException::BAD_ARGS,
+                                "TLocalSocket descriptors need a message to go with");
+    }
+    return;
+  }
+
+  // Take the message first, so that a failed send does not leave it behind
+  std::vector<uint8_t> message;
+  message.swap(wBuf_);
+  const uint8_t* data = message.data();
+  size_t left = message.size();
+  bool first = true;
+  while (left > 0) {
+    auto len = static_cast<uint32_t>((std::min)(left, static_cast<size_t>(MAX_PACKET_SIZE)));
+    sendPacket(data, len, first);
+    first = false;
+    data += len;
+    left -= len;
+  }
+
+  // Keep the capacity for the next message
+  message.clear();
+  wBuf_.swap(message);
+}
+
+const uint8_t* TLocalSocket::borrow_virt(uint8_t* /* buf */, uint32_t* len) {
+  if (rLen_ - rPos_ >= *len) {
+    *len = rLen_ - rPos_;
+    return rBuf_.get() + rPos_;
+  }
+  return nullptr;
+}
+
+void TLocalSocket::consume_virt(uint32_t len) {
+  if (len > rLen_ - rPos_) {
+    throw TTransportException(TTransportException::BAD_ARGS, "consume did not follow a borrow.");
+  }
+  rPos_ += len;
+}
+
+void TLocalSocket::sendDescriptors(const std::vector<int>& fds) {
+  if (sendFds_.size() + fds.size() > MAX_DESCRIPTORS) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "TLocalSocket too many descriptors for one message");
+  }
+  sendFds_.insert(sendFds_.end(), fds.begin(), fds.end());
+}
+
+std::vector<int> TLocalSocket::takeDescriptors() {
+  std::vector<int> fds;
+  fds.swap(receivedFds_);
+  return fds;
+}
+
+TLocalSocket::PeerCredentials TLocalSocket::getPeerCredentials() const {
+  if (socket_ == THRIFT_INVALID_SOCKET) {
+    throw TTransportException(TTransportException::NOT_OPEN, "TLocalSocket not open");
+  }
+  PeerCredentials credentials;
+#ifdef __linux__
+  struct ucred cred;
+  socklen_t len = sizeof(cred);
+  if (-1 == getsockopt(socket_, SOL_SOCKET, SO_PEERCRED, &cred, &len)) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    throw TTransportException(TTransportException::UNKNOWN, "getsockopt(SO_PEERCRED)", errno_copy);
+  }
+  credentials.pid = cred.pid;
+  credentials.uid = cred.uid;
+  credentials.gid = cred.gid;
+#else
+  if (-1 == getpeereid(socket_, &credentials.uid, &credentials.gid)) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    throw TTransportException(TTransportException::UNKNOWN, "getpeereid()", errno_copy);
+  }
+  credentials.pid = 0;
+#endif
+  return credentials;
+}
+
+bool TLocalSocket::receivePacket() {
+  if (socket_ == THRIFT_INVALID_SOCKET) {
+    throw TTransportException(TTransportException::NOT_OPEN, "Called read on non-open socket");
+  }
+  if (!rBuf_) {
+    rBuf_.reset(new uint8_t[MAX_PACKET_SIZE]);
+  }
+  rPos_ = rLen_ = 0;
+
+  int retries = 0;
+  for (;;) {
+    if (interruptListener_) {
+      struct THRIFT_POLLFD fds[2];
+      std::memset(fds, 0, sizeof(fds));
+      fds[0].fd = socket_;
+      fds[0].events = THRIFT_POLLIN;
+      fds[1].fd = *(interruptListener_.get());
+      fds[1].events = THRIFT_POLLIN;
+
+      int ret = THRIFT_POLL(fds, 2, (recvTimeout_ == 0) ? -1 : recvTimeout_);
+      int errno_copy = THRIFT_GET_SOCKET_ERROR;
+      if (ret < 0) {
+        if (errno_copy == THRIFT_EINTR && (retries++ < maxRecvRetries_)) {
+          continue;
+        }
+        GlobalOutput.perror("TLocalSocket::read() THRIFT_POLL() ", errno_copy);
+        throw TTransportException(TTransportException::UNKNOWN, "Unknown", errno_copy);
+      } else if (ret == 0) {
+        throw TTransportException(TTransportException::TIMED_OUT, "THRIFT_EAGAIN (timed out)");
+      } else if (fds[1].revents & THRIFT_POLLIN) {
+        throw TTransportException(TTransportException::INTERRUPTED, "Interrupted");
+      }
+    }
+
+    struct iovec iov;
+    iov.iov_base = rBuf_.get();
+    iov.iov_len = MAX_PACKET_SIZE;
+    union {
+      struct cmsghdr align;
+      char buf[CMSG_SPACE(sizeof(int) * MAX_DESCRIPTORS)];
+    } control;
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    int flags = 0;
+#ifdef MSG_CMSG_CLOEXEC
+    flags |= MSG_CMSG_CLOEXEC;
+#endif
+    ssize_t got = recvmsg(socket_, &msg, flags);
+    if (got < 0) {
+      int errno_copy = THRIFT_GET_SOCKET_ERROR;
+      if (errno_copy == THRIFT_EINTR && retries++ < maxRecvRetries_) {
+        continue;
+      }
+      if (errno_copy == THRIFT_EAGAIN) {
+        throw TTransportException(TTransportException::TIMED_OUT, "THRIFT_EAGAIN (timed out)");
+      }
+      if (errno_copy == THRIFT_ECONNRESET) {
+        return false;
+      }
+      if (errno_copy == THRIFT_ENOTCONN) {
+        throw TTransportException(TTransportException::NOT_OPEN, "THRIFT_ENOTCONN");
+      }
+      GlobalOutput.perror("TLocalSocket::read() recvmsg() " + getSocketInfo(), errno_copy);
+      throw TTransportException(TTransportException::UNKNOWN, "Unknown", errno_copy);
+    }
+
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const auto* fds = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+        for (size_t i = 0; i < count; ++i) {
+          int fd;
+          std::memcpy(&fd, fds + i, sizeof(fd));
+          receivedFds_.push_back(fd);
+        }
+      }
+    }
+    if (msg.msg_flags & MSG_CTRUNC) {
+      GlobalOutput("TLocalSocket::read() descriptors dropped, too many with one message");
+    }
+    if (msg.msg_flags & MSG_TRUNC) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "TLocalSocket packet larger than MAX_PACKET_SIZE");
+    }
+
+    rLen_ = static_cast<uint32_t>(got);
+    return got > 0;
+  }
+}
+
+void TLocalSocket::sendPacket(const uint8_t* buf, uint32_t len, bool withDescriptors) {
+  if (socket_ == THRIFT_INVALID_SOCKET) {
+    throw TTransportException(TTransportException::NOT_OPEN, "Called write on non-open socket");
+  }
+
+  struct iovec iov;
+  iov.iov_base = const_cast<uint8_t*>(buf);
+  iov.iov_len = len;
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int) * MAX_DESCRIPTORS)];
+  } control;
+  struct msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  if (withDescriptors && !sendFds_.empty()) {
+    std::memset(&control, 0, sizeof(control));
+    msg.msg_control = control.buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * sendFds_.size());
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * sendFds_.size());
+    std::memcpy(CMSG_DATA(cmsg), sendFds_.data(), sizeof(int) * sendFds_.size());
+  }
+
+  int flags = 0;
+#ifdef MSG_NOSIGNAL
+  flags |= MSG_NOSIGNAL;
+#endif
+  for (;;) {
+    if (sendmsg(socket_, &msg, flags) >= 0) {
+      break;
+    }
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    if (errno_copy == THRIFT_EINTR) {
+      continue;
+    }
+    if (errno_copy == THRIFT_EWOULDBLOCK || errno_copy == THRIFT_EAGAIN) {
+      throw TTransportException(TTransportException::TIMED_OUT, "send timeout expired");
+    }
+    GlobalOutput.perror("TLocalSocket::flush() sendmsg() " + getSocketInfo(), errno_copy);
+    if (errno_copy == THRIFT_EPIPE || errno_copy == THRIFT_ECONNRESET
+        || errno_copy == THRIFT_ENOTCONN) {
+      throw TTransportException(TTransportException::NOT_OPEN, "write() sendmsg()", errno_copy);
+    }
+    throw TTransportException(TTransportException::UNKNOWN, "write() sendmsg()", errno_copy);
+  }
+  if (msg.msg_control != nullptr) {
+    sendFds_.clear();
+  }
+}
+
+void TLocalSocket::closeDescriptors() {
+  for (int fd : receivedFds_) {
+    ::close(fd);
+  }
+  receivedFds_.clear();
+}
+}
+}
+} // apache::thrift::transport
@@ -0,0 +1,146 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TLOCALSOCKET_H_
+#define _THRIFT_TRANSPORT_TLOCALSOCKET_H_ 1
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <thrift/transport/TSocket.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Unix domain socket of type SOCK_SEQPACKET, for calls between processes
+ * on one host.  Only built on Linux.
+ *
+ * Writes are buffered and each flush() is sent as one message, so no
+ * framing is needed: a server reads a whole request with a single receive,
+ * and can use TTransportFactory rather than TFramedTransportFactory.
+ * Messages larger than MAX_PACKET_SIZE go as several packets, which the
+ * reader sees as consecutive bytes.
+ *
+ * Open file descriptors can be sent along with a message, e.g. to hand a
+ * listening socket over to the process that replaces this one.
+ */
+class TLocalSocket : public TSocket {
+public:
+  /// Largest packet sent, and the size of the receive buffer
+  static const uint32_t MAX_PACKET_SIZE = 64 * 1024;
+
+  /// Most descriptors sent with one message
+  static const size_t MAX_DESCRIPTORS = 64;
+
+  /**
+   * Constructs a socket that connects to \p path on open().
+   *
+   * @param path A file system path, or an abstract name as returned by
+   *             abstractPath()
+   */
+  TLocalSocket(const std::string& path, std::shared_ptr<TConfiguration> config = nullptr);
+
+  /**
+   * Constructs a socket for an already connected descriptor, as accepted
+   * by TLocalServerSocket.
+   */
+  TLocalSocket(THRIFT_SOCKET socket,
+               std::shared_ptr<THRIFT_SOCKET> interruptListener = nullptr,
+               std::shared_ptr<TConfiguration> config = nullptr);
+
+  ~TLocalSocket() override;
+
+  /**
+   * The path for \p name in the abstract namespace, which has no file
+   * system entry and goes away with the last socket using it.
+   */
+  static std::string abstractPath(const std::string& name) { return std::string(1, '\0') + name; }
+
+  void open() override;
+
+  void close() override;
+
+  bool peek() override;
+
+  bool hasPendingDataToRead() override;
+
+  uint32_t read(uint8_t* buf, uint32_t len) override;
+
+  void write(const uint8_t* buf, uint32_t len) override;
+
+  /// Sends what was written since the last flush() as one message
+  void flush() override;
+
+  const uint8_t* borrow_virt(uint8_t* buf, uint32_t* len) override;
+
+  void consume_virt(uint32_t len) override;
+
+  /**
+   * Sends \p fds with the next message.  The descriptors stay open here;
+   * the peer gets duplicates of them.
+   *
+   * @throws TTransportException if there are more than MAX_DESCRIPTORS
+   */
+  void sendDescriptors(const std::vector<int>& fds);
+
+  /**
+   * Descriptors received with the messages read so far, in order.  The
+   * caller owns and must close them; any not taken are closed with the
+   * socket.
+   */
+  std::vector<int> takeDescriptors();
+
+  /// The process at the other end, as of when it connected
+  struct PeerCredentials {
+    pid_t pid; // 0 where the platform does not report it
+    uid_t uid;
+    gid_t gid;
+  };
+
+  /**
+   * @throws TTransportException if the socket is not open
+   */
+  PeerCredentials getPeerCredentials() const;
+
+private:
+  /// Receives the next packet into the read buffer; false at end of file
+  bool receivePacket();
+
+  void sendPacket(const uint8_t* buf, uint32_t len, bool withDescriptors);
+
+  void closeDescriptors();
+
+  std::unique_ptr<uint8_t[]> rBuf_;
+  uint32_t rPos_;
+  uint32_t rLen_;
+  std::vector<uint8_t> wBuf_;
+
+  std::vector<int> sendFds_;
+  std::vector<int> receivedFds_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TLOCALSOCKET_H_
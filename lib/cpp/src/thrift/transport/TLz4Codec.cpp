@@ -0,0 +1,158 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/transport/TLz4Codec.h>
+
+#include <algorithm>
+#include <cstring>
+#include <lz4frame.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+namespace {
+
+size_t checkLz4Rv(size_t rv) {
+  if (LZ4F_isError(rv)) {
+    throw TCompressionException("lz4", LZ4F_getErrorName(rv));
+  }
+  return rv;
+}
+
+// Input handed to LZ4F_compressUpdate at a time, bounding staged_
+const size_t CHUNK_SIZE = 64 * 1024;
+}
+
+TLz4Codec::TLz4Codec(int level)
+  : cctx_(nullptr),
+    dctx_(nullptr),
+    level_(level),
+    frameStarted_(false),
+    flushStaged_(false),
+    stagedPos_(0),
+    stagedLen_(0) {
+  size_t rv = LZ4F_createCompressionContext(&cctx_, LZ4F_VERSION);
+  if (!LZ4F_isError(rv)) {
+    rv = LZ4F_createDecompressionContext(&dctx_, LZ4F_VERSION);
+  }
+  if (LZ4F_isError(rv)) {
+    LZ4F_freeCompressionContext(cctx_);
+    LZ4F_freeDecompressionContext(dctx_);
+    checkLz4Rv(rv);
+  }
+}
+
+TLz4Codec::~TLz4Codec() {
+  LZ4F_freeCompressionContext(cctx_);
+  LZ4F_freeDecompressionContext(dctx_);
+}
+
+uint8_t* TLz4Codec::stage(size_t bound) {
+  if (stagedPos_ == stagedLen_) {
+    stagedPos_ = 0;
+    stagedLen_ = 0;
+  }
+  if (staged_.size() < stagedLen_ + bound) {
+    staged_.resize(stagedLen_ + bound);
+  }
+  return staged_.data() + stagedLen_;
+}
+
+bool TLz4Codec::compress(const uint8_t** in,
+                         size_t* inLen,
+                         uint8_t** out,
+                         size_t* outLen,
+                         FlushMode mode) {
+  LZ4F_preferences_t prefs;
+  memset(&prefs, 0, sizeof(prefs));
+  prefs.frameInfo.blockSizeID = LZ4F_max64KB;
+  prefs.frameInfo.blockMode = LZ4F_blockLinked;
+  prefs.compressionLevel = level_;
+
+  while (true) {
+    // Output staged earlier goes first
+    size_t give = (std::min)(stagedLen_ - stagedPos_, *outLen);
+    memcpy(*out, staged_.data() + stagedPos_, give);
+    stagedPos_ += give;
+    *out += give;
+    *outLen -= give;
+    if (stagedPos_ < stagedLen_) {
+      return false;
+    }
+
+    if (*inLen > 0 || (mode == FLUSH_END && !frameStarted_ && !flushStaged_)) {
+      if (!frameStarted_) {
+        uint8_t* dst = stage(LZ4F_HEADER_SIZE_MAX);
+        stagedLen_ += checkLz4Rv(LZ4F_compressBegin(cctx_, dst, LZ4F_HEADER_SIZE_MAX, &prefs));
+        frameStarted_ = true;
+      }
+      size_t chunk = (std::min)(*inLen, CHUNK_SIZE);
+      if (chunk > 0) {
+        size_t bound = LZ4F_compressBound(chunk, &prefs);
+        uint8_t* dst = stage(bound);
+        stagedLen_ += checkLz4Rv(LZ4F_compressUpdate(cctx_, dst, bound, *in, chunk, nullptr));
+        *in += chunk;
+        *inLen -= chunk;
+      }
+      continue;
+    }
+
+    if (mode == FLUSH_NONE || flushStaged_ || !frameStarted_) {
+      flushStaged_ = false;
+      return true;
+    }
+
+    size_t bound = LZ4F_compressBound(0, &prefs);
+    uint8_t* dst = stage(bound);
+    if (mode == FLUSH_END) {
+      stagedLen_ += checkLz4Rv(LZ4F_compressEnd(cctx_, dst, bound, nullptr));
+      frameStarted_ = false;
+    } else {
+      stagedLen_ += checkLz4Rv(LZ4F_flush(cctx_, dst, bound, nullptr));
+    }
+    flushStaged_ = true;
+  }
+}
+
+bool TLz4Codec::decompress(const uint8_t** in, size_t* inLen, uint8_t** out, size_t* outLen) {
+  size_t consumed = *inLen;
+  size_t produced = *outLen;
+  size_t hint = checkLz4Rv(LZ4F_decompress(dctx_, *out, &produced, *in, &consumed, nullptr));
+
+  *in += consumed;
+  *inLen -= consumed;
+  *out += produced;
+  *outLen -= produced;
+
+  // 0 once a frame is fully decoded
+  return hint == 0;
+}
+
+void TLz4Codec::reset() {
+  // The next compressBegin starts the compression context afresh
+  frameStarted_ = false;
+  flushStaged_ = false;
+  stagedPos_ = 0;
+  stagedLen_ = 0;
+  LZ4F_resetDecompressionContext(dctx_);
+}
+}
+}
+} // apache::thrift::transport
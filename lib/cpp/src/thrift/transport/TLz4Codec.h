@@ -0,0 +1,77 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TLZ4CODEC_H_
+#define _THRIFT_TRANSPORT_TLZ4CODEC_H_ 1
+
+#include <thrift/transport/TCompressionCodec.h>
+
+#include <vector>
+
+struct LZ4F_cctx_s;
+struct LZ4F_dctx_s;
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * The lz4 frame format, with linked blocks so that the window is kept
+ * across flushes.  Trades ratio for much cheaper compression than zlib.
+ */
+class TLz4Codec : public TCompressionCodec {
+public:
+  /**
+   * @param level  Compression level, 0 for the fast default, 3 to 12 for
+   *               the slower high compression mode.
+   */
+  explicit TLz4Codec(int level = 0);
+  ~TLz4Codec() override;
+
+  const char* name() const override { return "lz4"; }
+  bool compress(const uint8_t** in,
+                size_t* inLen,
+                uint8_t** out,
+                size_t* outLen,
+                FlushMode mode) override;
+  bool decompress(const uint8_t** in, size_t* inLen, uint8_t** out, size_t* outLen) override;
+  void reset() override;
+
+private:
+  /// Room for \p bound more bytes of staged output
+  uint8_t* stage(size_t bound);
+
+  struct LZ4F_cctx_s* cctx_;
+  struct LZ4F_dctx_s* dctx_;
+  int level_;
+  /// Whether a frame has been begun and not ended
+  bool frameStarted_;
+  /// Whether the flush compress() was asked for has been staged
+  bool flushStaged_;
+  /// lz4 only compresses into room for the worst case, so output is
+  /// staged here and copied out
+  std::vector<uint8_t> staged_;
+  size_t stagedPos_;
+  size_t stagedLen_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TLZ4CODEC_H_
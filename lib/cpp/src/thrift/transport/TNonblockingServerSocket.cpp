@@ -19,6 +19,7 @@
 
 #include <thrift/thrift-config.h>
 
+#include <cstddef>
 #include <cstring>
 #include <memory>
 #include <stdexcept>
@@ -97,7 +98,9 @@ TNonblockingServerSocket::TNonblockingServerSocket(int port)
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
-    listening_(false) {
+    listening_(false),
+    boundSocketType_(SocketType::NONE),
+    handedOff_(false) {
 }
 
 TNonblockingServerSocket::TNonblockingServerSocket(int port, int sendTimeout, int recvTimeout)
@@ -112,7 +115,9 @@ TNonblockingServerSocket::TNonblockingServerSocket(int port, int sendTimeout, in
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
-    listening_(false) {
+    listening_(false),
+    boundSocketType_(SocketType::NONE),
+    handedOff_(false) {
 }
 
 TNonblockingServerSocket::TNonblockingServerSocket(const string& address, int port)
@@ -128,7 +133,9 @@ TNonblockingServerSocket::TNonblockingServerSocket(const string& address, int po
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
-    listening_(false) {
+    listening_(false),
+    boundSocketType_(SocketType::NONE),
+    handedOff_(false) {
 }
 
 TNonblockingServerSocket::TNonblockingServerSocket(const string& path)
@@ -144,7 +151,26 @@ TNonblockingServerSocket::TNonblockingServerSocket(const string& path)
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
-    listening_(false) {
+    listening_(false),
+    boundSocketType_(SocketType::NONE),
+    handedOff_(false) {
+}
+
+TNonblockingServerSocket::TNonblockingServerSocket(THRIFT_SOCKET sock, SocketType socketType)
+  : port_(0),
+    listenPort_(0),
+    serverSocket_(sock),
+    acceptBacklog_(DEFAULT_BACKLOG),
+    sendTimeout_(0),
+    recvTimeout_(0),
+    retryLimit_(0),
+    retryDelay_(0),
+    tcpSendBuffer_(0),
+    tcpRecvBuffer_(0),
+    keepAlive_(false),
+    listening_(false),
+    boundSocketType_(socketType),
+    handedOff_(false) {
 }
 
 TNonblockingServerSocket::~TNonblockingServerSocket() {
@@ -356,6 +382,11 @@ void TNonblockingServerSocket::listen() {
   TWinsockSingleton::create();
 #endif // _WIN32
 
+  if (boundSocketType_ != SocketType::NONE) {
+    listenBound();
+    return;
+  }
+
 
   // Validate port number
   if (port_ < 0 || port_ > 0xFFFF) {
@@ -529,6 +560,50 @@ void TNonblockingServerSocket::listen() {
   listening_ = true;
 }
 
+void TNonblockingServerSocket::listenBound() {
+  // -- Socket is already bound and listening, and may be shared with
+  // another process: whichever loses the race for a connection must not
+  // block in accept()
+  int flags = THRIFT_FCNTL(serverSocket_, THRIFT_F_GETFL, 0);
+  if (flags == -1 || -1 == THRIFT_FCNTL(serverSocket_, THRIFT_F_SETFL, flags | THRIFT_O_NONBLOCK)) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    GlobalOutput.perror("TNonblockingServerSocket::listen() THRIFT_FCNTL() THRIFT_O_NONBLOCK ", errno_copy);
+    throw TTransportException(TTransportException::NOT_OPEN,
+                              "THRIFT_FCNTL() THRIFT_F_SETFL THRIFT_O_NONBLOCK failed",
+                              errno_copy);
+  }
+
+  struct sockaddr_storage sa;
+  socklen_t len = sizeof(sa);
+  std::memset(&sa, 0, len);
+  if (::getsockname(serverSocket_, reinterpret_cast<struct sockaddr*>(&sa), &len) < 0) {
+    GlobalOutput.perror("TNonblockingServerSocket::listen() getsockname() ", THRIFT_GET_SOCKET_ERROR);
+  } else if (sa.ss_family == AF_INET6) {
+    listenPort_ = ntohs(reinterpret_cast<const struct sockaddr_in6*>(&sa)->sin6_port);
+  } else if (sa.ss_family == AF_INET) {
+    listenPort_ = ntohs(reinterpret_cast<const struct sockaddr_in*>(&sa)->sin_port);
+#if (!defined(_WIN32) || defined(HAVE_AF_UNIX_H))
+  } else if (sa.ss_family == AF_UNIX) {
+    const auto* addr = reinterpret_cast<const struct sockaddr_un*>(&sa);
+    path_.assign(addr->sun_path, len - offsetof(struct sockaddr_un, sun_path));
+    if (!path_.empty() && path_[0] != '\0') {
+      path_ = path_.c_str();
+    }
+#endif
+  }
+
+  listening_ = true;
+}
+
+THRIFT_SOCKET TNonblockingServerSocket::handOffSocket() {
+  if (serverSocket_ == THRIFT_INVALID_SOCKET || !listening_) {
+    throw TTransportException(TTransportException::NOT_OPEN,
+                              "TNonblockingServerSocket not listening");
+  }
+  handedOff_ = true;
+  return serverSocket_;
+}
+
 int TNonblockingServerSocket::getPort() {
   return port_;
 }
@@ -558,6 +633,10 @@ shared_ptr<TSocket> TNonblockingServerSocket::acceptImpl() {
 
   if (clientSocket == THRIFT_INVALID_SOCKET) {
     int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    if (errno_copy == THRIFT_EAGAIN || errno_copy == THRIFT_EWOULDBLOCK) {
+      // Another process sharing the socket took the connection
+      throw TTransportException(TTransportException::TIMED_OUT, "accept() lost the race");
+    }
     GlobalOutput.perror("TNonblockingServerSocket::acceptImpl() ::accept() ", errno_copy);
     throw TTransportException(TTransportException::UNKNOWN, "accept()", errno_copy);
   }
@@ -609,10 +688,16 @@ shared_ptr<TSocket> TNonblockingServerSocket::createSocket(THRIFT_SOCKET clientS
 
 void TNonblockingServerSocket::close() {
   if (serverSocket_ != THRIFT_INVALID_SOCKET) {
-    shutdown(serverSocket_, THRIFT_SHUT_RDWR);
-    ::THRIFT_CLOSESOCKET(serverSocket_);
+    // Shutting down a shared socket would stop the other process listening too
+    if (boundSocketType_ == SocketType::NONE && !handedOff_) {
+      shutdown(serverSocket_, THRIFT_SHUT_RDWR);
+    }
+    if (boundSocketType_ == SocketType::NONE) {
+      ::THRIFT_CLOSESOCKET(serverSocket_);
+    }
   }
   serverSocket_ = THRIFT_INVALID_SOCKET;
+  handedOff_ = false;
   listening_ = false;
 }
 } // namespace transport
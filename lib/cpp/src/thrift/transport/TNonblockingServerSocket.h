@@ -22,6 +22,7 @@
 
 #include <thrift/transport/TNonblockingServerTransport.h>
 #include <thrift/transport/PlatformSocket.h>
+#include <thrift/transport/TServerSocket.h>
 
 namespace apache {
 namespace thrift {
@@ -71,6 +72,16 @@ public:
    */
   TNonblockingServerSocket(const std::string& path);
 
+  /**
+   * Constructor for a socket that is bound and listening already, from
+   * systemd socket activation or from a server that is restarting; see
+   * TServerSocket(THRIFT_SOCKET, SocketType).  close() leaves it open.
+   *
+   * @param sock       The listening socket
+   * @param socketType Its address family
+   */
+  TNonblockingServerSocket(THRIFT_SOCKET sock, SocketType socketType);
+
   ~TNonblockingServerSocket() override;
 
   bool isOpen() const;
@@ -110,6 +121,16 @@ public:
   bool isUnixDomainSocket() const;
 
   void listen() override;
+
+  /**
+   * Hands the listening socket over to the process that replaces this one;
+   * see TServerSocket::handOffSocket().  Drain the server here next
+   * (TNonblockingServer::drain()).
+   *
+   * \throws TTransportException if not listening
+   */
+  THRIFT_SOCKET handOffSocket();
+
   void close() override;
 
 protected:
@@ -117,6 +138,8 @@ protected:
   virtual std::shared_ptr<TSocket> createSocket(THRIFT_SOCKET client);
 
 private:
+  /// listen() for a socket that is listening already
+  void listenBound();
   void _setup_sockopts();
   void _setup_unixdomain_sockopts();
   void _setup_tcp_sockopts();
@@ -135,6 +158,8 @@ private:
   int tcpRecvBuffer_;
   bool keepAlive_;
   bool listening_;
+  SocketType boundSocketType_;
+  bool handedOff_;
 
   socket_func_t listenCallback_;
   socket_func_t acceptCallback_;
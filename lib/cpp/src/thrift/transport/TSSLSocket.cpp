@@ -49,9 +49,16 @@
 #include <openssl/engine.h>
 #endif
 #include <openssl/err.h>
+#include <openssl/hmac.h>
 #include <openssl/rand.h>
 #include <openssl/ssl.h>
 #include <openssl/x509v3.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(OPENSSL_IS_BORINGSSL) \
+    && !defined(OPENSSL_IS_AWSLC)
+// The HMAC_CTX flavour of the ticket key callback is deprecated in 3.0
+#define THRIFT_TICKET_KEY_EVP_CB 1
+#include <openssl/core_names.h>
+#endif
 #include <thrift/concurrency/Mutex.h>
 #include <thrift/transport/TSSLSocket.h>
 #include <thrift/transport/PlatformSocket.h>
@@ -178,8 +185,105 @@ static void buildErrors(string& message, int errno_copy = 0, int sslerrno = 0);
 static bool matchName(const char* host, const char* pattern, int size);
 static char uppercase(char c);
 
+// The TSSLSocket of an SSL, for the new session callback
+static int socketIndex() {
+  static int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return index;
+}
+
+// The SSLContext of an SSL_CTX, for the ticket key callback
+static int contextIndex() {
+  static int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return index;
+}
+
+static void sessionUpRef(SSL_SESSION* session) {
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L || defined(OPENSSL_IS_BORINGSSL)
+  SSL_SESSION_up_ref(session);
+#else
+  CRYPTO_add(&session->references, 1, CRYPTO_LOCK_SSL_SESSION);
+#endif
+}
+
+// Layout of a session ticket key: name, AES-256 key, HMAC-SHA256 key
+static const size_t TICKET_KEY_NAME_SIZE = 16;
+static const size_t TICKET_KEY_AES_OFFSET = 16;
+static const size_t TICKET_KEY_HMAC_OFFSET = 48;
+static const size_t TICKET_KEY_HMAC_SIZE = 32;
+
+#ifdef THRIFT_TICKET_KEY_EVP_CB
+static int ticketKeyCallback(SSL* ssl,
+                             unsigned char* name,
+                             unsigned char* iv,
+                             EVP_CIPHER_CTX* cipher,
+                             EVP_MAC_CTX* mac,
+                             int encrypt) {
+#else
+static int ticketKeyCallback(SSL* ssl,
+                             unsigned char* name,
+                             unsigned char* iv,
+                             EVP_CIPHER_CTX* cipher,
+                             HMAC_CTX* mac,
+                             int encrypt) {
+#endif
+  SSLContext* context
+      = static_cast<SSLContext*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), contextIndex()));
+  if (context == nullptr) {
+    return -1;
+  }
+  std::vector<string> keys = context->ticketKeys();
+  if (keys.empty()) {
+    return 0;
+  }
+
+  size_t found = 0;
+  if (encrypt) {
+    if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1) {
+      return -1;
+    }
+    memcpy(name, keys[0].data(), TICKET_KEY_NAME_SIZE);
+  } else {
+    while (found < keys.size()
+           && memcmp(name, keys[found].data(), TICKET_KEY_NAME_SIZE) != 0) {
+      ++found;
+    }
+    if (found == keys.size()) {
+      // Unknown or retired key: fall back to a full handshake
+      return 0;
+    }
+  }
+
+  const unsigned char* key = reinterpret_cast<const unsigned char*>(keys[found].data());
+  if (EVP_CipherInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key + TICKET_KEY_AES_OFFSET, iv,
+                        encrypt)
+      != 1) {
+    return -1;
+  }
+#ifdef THRIFT_TICKET_KEY_EVP_CB
+  OSSL_PARAM params[3];
+  params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY,
+                                                const_cast<unsigned char*>(key
+                                                                           + TICKET_KEY_HMAC_OFFSET),
+                                                TICKET_KEY_HMAC_SIZE);
+  params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                               const_cast<char*>("SHA256"), 0);
+  params[2] = OSSL_PARAM_construct_end();
+  if (EVP_MAC_CTX_set_params(mac, params) != 1) {
+    return -1;
+  }
+#else
+  if (HMAC_Init_ex(mac, key + TICKET_KEY_HMAC_OFFSET, TICKET_KEY_HMAC_SIZE, EVP_sha256(), nullptr)
+      != 1) {
+    return -1;
+  }
+#endif
+  // A ticket decrypted with an older key is renewed with the current one
+  return found == 0 ? 1 : 2;
+}
+
 // SSLContext implementation
-SSLContext::SSLContext(const SSLProtocol& protocol) {
+SSLContext::SSLContext(const SSLProtocol& protocol)
+  : ctx_(nullptr), fullHandshakes_(0), resumedHandshakes_(0) {
   if (protocol == SSLTLS) {
     ctx_ = SSL_CTX_new(SSLv23_method());
 #ifndef OPENSSL_NO_SSL3
@@ -210,6 +314,12 @@ SSLContext::SSLContext(const SSLProtocol& protocol) {
       SSL_CTX_set_options(ctx_, SSL_OP_NO_SSLv2);
       SSL_CTX_set_options(ctx_, SSL_OP_NO_SSLv3);   // THRIFT-3164
   }
+
+  // A server that verifies client certificates refuses to resume sessions
+  // unless a session id context is set.
+  static const unsigned char sessionIdContext[] = "thrift";
+  SSL_CTX_set_session_id_context(ctx_, sessionIdContext, sizeof(sessionIdContext) - 1);
+  SSL_CTX_set_ex_data(ctx_, contextIndex(), this);
 }
 
 SSLContext::~SSLContext() {
@@ -219,6 +329,36 @@ SSLContext::~SSLContext() {
   }
 }
 
+void SSLContext::ticketKeys(const std::vector<string>& keys) {
+  Guard guard(ticketKeysMutex_);
+  ticketKeys_ = keys;
+#ifdef THRIFT_TICKET_KEY_EVP_CB
+  SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx_, keys.empty() ? nullptr : ticketKeyCallback);
+#else
+  SSL_CTX_set_tlsext_ticket_key_cb(ctx_, keys.empty() ? nullptr : ticketKeyCallback);
+#endif
+}
+
+std::vector<string> SSLContext::ticketKeys() const {
+  Guard guard(ticketKeysMutex_);
+  return ticketKeys_;
+}
+
+void SSLContext::handshakeCompleted(bool resumed) {
+  if (resumed) {
+    ++resumedHandshakes_;
+  } else {
+    ++fullHandshakes_;
+  }
+}
+
+TSSLHandshakeStats SSLContext::handshakeStats() const {
+  TSSLHandshakeStats stats;
+  stats.full = fullHandshakes_;
+  stats.resumed = resumedHandshakes_;
+  return stats;
+}
+
 SSL* SSLContext::createSSL() {
   SSL* ssl = SSL_new(ctx_);
   if (ssl == nullptr) {
@@ -280,8 +420,17 @@ bool TSSLSocket::hasPendingDataToRead() {
   return SSL_pending(ssl_) > 0 || TSocket::hasPendingDataToRead();
 }
 
+TSocket::HandshakeStatus TSSLSocket::handshakeStep() {
+  initializeHandshake();
+  if (checkHandshake()) {
+    return HANDSHAKE_DONE;
+  }
+  return handshakeWantWrite_ ? HANDSHAKE_WANT_WRITE : HANDSHAKE_WANT_READ;
+}
+
 void TSSLSocket::init() {
   handshakeCompleted_ = false;
+  handshakeWantWrite_ = false;
   readRetryCount_ = 0;
   eventSafe_ = false;
 }
@@ -617,12 +766,45 @@ void TSSLSocket::initializeHandshakeParams() {
   ssl_ = ctx_->createSSL();
 
   SSL_set_fd(ssl_, static_cast<int>(socket_));
+
+  string key = sessionKey();
+  if (!key.empty()) {
+    SSL_set_ex_data(ssl_, socketIndex(), this);
+    SSL_SESSION* session = sessionCache_->get(key);
+    if (session != nullptr) {
+      SSL_set_session(ssl_, session);
+      SSL_SESSION_free(session);
+    }
+  }
 }
 
 bool TSSLSocket::checkHandshake() {
   return handshakeCompleted_;
 }
 
+bool TSSLSocket::sessionReused() const {
+  return ssl_ != nullptr && SSL_session_reused(ssl_) == 1;
+}
+
+string TSSLSocket::sessionKey() const {
+  if (!sessionCache_ || server() || getHost().empty()) {
+    return string();
+  }
+  return getHost() + ":" + std::to_string(getPort());
+}
+
+int TSSLSocket::newSessionCallback(SSL* ssl, SSL_SESSION* session) {
+  TSSLSocket* socket = static_cast<TSSLSocket*>(SSL_get_ex_data(ssl, socketIndex()));
+  if (socket != nullptr) {
+    string key = socket->sessionKey();
+    if (!key.empty()) {
+      socket->sessionCache_->put(key, session);
+    }
+  }
+  // The cache took its own reference, if any
+  return 0;
+}
+
 void TSSLSocket::initializeHandshake() {
   if (!TSocket::isOpen()) {
     throw TTransportException(TTransportException::NOT_OPEN);
@@ -654,6 +836,7 @@ void TSSLSocket::initializeHandshake() {
           case SSL_ERROR_WANT_READ:
           case SSL_ERROR_WANT_WRITE:
             if (isLibeventSafe()) {
+              handshakeWantWrite_ = error == SSL_ERROR_WANT_WRITE;
               return;
             }
             else {
@@ -687,6 +870,7 @@ void TSSLSocket::initializeHandshake() {
           case SSL_ERROR_WANT_READ:
           case SSL_ERROR_WANT_WRITE:
             if (isLibeventSafe()) {
+              handshakeWantWrite_ = error == SSL_ERROR_WANT_WRITE;
               return;
             }
             else {
@@ -704,10 +888,16 @@ void TSSLSocket::initializeHandshake() {
     string fname(server() ? "SSL_accept" : "SSL_connect");
     string errors;
     buildErrors(errors, errno_copy, error);
+    // Don't offer a session that may be what the server choked on again
+    string key = sessionKey();
+    if (!key.empty()) {
+      sessionCache_->remove(key);
+    }
     throw TSSLException(fname + ": " + errors);
   }
   authorize();
   handshakeCompleted_ = true;
+  ctx_->handshakeCompleted(sessionReused());
 }
 
 void TSSLSocket::authorize() {
@@ -877,7 +1067,71 @@ unsigned int TSSLSocket::waitForEvent(bool wantRead) {
   }
 }
 
+// TSSLSessionCache implementation
+TSSLSessionCache::TSSLSessionCache(size_t capacity) : capacity_(capacity) {
+}
+
+TSSLSessionCache::~TSSLSessionCache() {
+  clear();
+}
+
+SSL_SESSION* TSSLSessionCache::get(const string& key) {
+  Guard guard(mutex_);
+  auto found = index_.find(key);
+  if (found == index_.end()) {
+    return nullptr;
+  }
+  entries_.splice(entries_.begin(), entries_, found->second);
+  SSL_SESSION* session = found->second->second;
+  sessionUpRef(session);
+  return session;
+}
+
+void TSSLSessionCache::put(const string& key, SSL_SESSION* session) {
+  sessionUpRef(session);
+  Guard guard(mutex_);
+  auto found = index_.find(key);
+  if (found != index_.end()) {
+    SSL_SESSION_free(found->second->second);
+    found->second->second = session;
+    entries_.splice(entries_.begin(), entries_, found->second);
+    return;
+  }
+  entries_.push_front(std::make_pair(key, session));
+  index_[key] = entries_.begin();
+  if (capacity_ > 0 && entries_.size() > capacity_) {
+    SSL_SESSION_free(entries_.back().second);
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+}
+
+void TSSLSessionCache::remove(const string& key) {
+  Guard guard(mutex_);
+  auto found = index_.find(key);
+  if (found != index_.end()) {
+    SSL_SESSION_free(found->second->second);
+    entries_.erase(found->second);
+    index_.erase(found);
+  }
+}
+
+void TSSLSessionCache::clear() {
+  Guard guard(mutex_);
+  for (auto& entry : entries_) {
+    SSL_SESSION_free(entry.second);
+  }
+  entries_.clear();
+  index_.clear();
+}
+
+size_t TSSLSessionCache::size() const {
+  Guard guard(mutex_);
+  return entries_.size();
+}
+
 // TSSLSocketFactory implementation
+const size_t TSSLSocketFactory::TICKET_KEY_SIZE;
 uint64_t TSSLSocketFactory::count_ = 0;
 Mutex TSSLSocketFactory::mutex_;
 bool TSSLSocketFactory::manualOpenSSLInitialization_ = false;
@@ -951,6 +1205,67 @@ void TSSLSocketFactory::setup(std::shared_ptr<TSSLSocket> ssl) {
   if (access_ != nullptr) {
     ssl->access(access_);
   }
+  if (!server()) {
+    ssl->sessionCache(sessionCache_);
+  }
+}
+
+void TSSLSocketFactory::sessionCache(std::shared_ptr<TSSLSessionCache> cache) {
+  sessionCache_ = cache;
+  if (cache) {
+    // Sessions go to the cache through the callback; OpenSSL's own cache is
+    // never consulted by clients.
+    SSL_CTX_set_session_cache_mode(ctx_->get(),
+                                   SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx_->get(), TSSLSocket::newSessionCallback);
+  } else {
+    SSL_CTX_set_session_cache_mode(ctx_->get(), SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_new_cb(ctx_->get(), nullptr);
+  }
+}
+
+void TSSLSocketFactory::sessionCacheSize(long size) {
+  SSL_CTX_sess_set_cache_size(ctx_->get(), size);
+}
+
+void TSSLSocketFactory::sessionTimeout(long seconds) {
+  SSL_CTX_set_timeout(ctx_->get(), seconds);
+}
+
+void TSSLSocketFactory::sessionTickets(bool enable) {
+  if (enable) {
+    SSL_CTX_clear_options(ctx_->get(), SSL_OP_NO_TICKET);
+  } else {
+    SSL_CTX_set_options(ctx_->get(), SSL_OP_NO_TICKET);
+  }
+}
+
+static void checkTicketKey(const string& key) {
+  if (key.size() != TSSLSocketFactory::TICKET_KEY_SIZE) {
+    throw TSSLException("Session ticket keys must be "
+                        + std::to_string(TSSLSocketFactory::TICKET_KEY_SIZE) + " bytes");
+  }
+}
+
+void TSSLSocketFactory::ticketKeys(const std::vector<string>& keys) {
+  for (const auto& key : keys) {
+    checkTicketKey(key);
+  }
+  ctx_->ticketKeys(keys);
+}
+
+void TSSLSocketFactory::rotateTicketKey(const string& key) {
+  checkTicketKey(key);
+  std::vector<string> keys = ctx_->ticketKeys();
+  keys.insert(keys.begin(), key);
+  if (keys.size() > 2) {
+    keys.resize(2);
+  }
+  ctx_->ticketKeys(keys);
+}
+
+TSSLHandshakeStats TSSLSocketFactory::handshakeStats() const {
+  return ctx_->handshakeStats();
 }
 
 void TSSLSocketFactory::ciphers(const string& enable) {
@@ -23,8 +23,12 @@
 // Put this first to avoid WIN32 build failure
 #include <thrift/transport/TSocket.h>
 
+#include <atomic>
+#include <list>
 #include <openssl/ssl.h>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <thrift/concurrency/Mutex.h>
 
 namespace apache {
@@ -33,6 +37,7 @@ namespace transport {
 
 class AccessManager;
 class SSLContext;
+class TSSLSessionCache;
 
 enum SSLProtocol {
   SSLTLS  = 0,  // Supports SSLv2 and SSLv3 handshake but only negotiates at TLSv1_0 or later.
@@ -78,6 +83,7 @@ public:
   void open() override;
   void close() override;
   bool hasPendingDataToRead() override;
+  HandshakeStatus handshakeStep() override;
   uint32_t read(uint8_t* buf, uint32_t len) override;
   void write(const uint8_t* buf, uint32_t len) override;
   uint32_t write_partial(const uint8_t* buf, uint32_t len) override;
@@ -106,6 +112,18 @@ public:
    * Determines whether SSL Socket is libevent safe or not.
    */
   bool isLibeventSafe() const { return eventSafe_; }
+  /**
+   * Whether the handshake resumed an earlier session rather than performing
+   * a full one.
+   */
+  bool sessionReused() const;
+  /**
+   * Set the cache that a client socket resumes its session from, and stores
+   * the session it gets in, under host:port.
+   *
+   * @param cache  The cache, or nullptr to always perform full handshakes
+   */
+  void sessionCache(std::shared_ptr<TSSLSessionCache> cache) { sessionCache_ = cache; }
 
 protected:
   /**
@@ -179,10 +197,77 @@ protected:
 
 private:
   bool handshakeCompleted_;
+  /// Whether an unfinished libevent safe handshake waits to write
+  bool handshakeWantWrite_;
   int readRetryCount_;
   bool eventSafe_;
+  std::shared_ptr<TSSLSessionCache> sessionCache_;
 
   void init();
+  /**
+   * The key of this socket's sessions in its session cache, or an empty
+   * string if it has none.
+   */
+  std::string sessionKey() const;
+  static int newSessionCallback(SSL* ssl, SSL_SESSION* session);
+};
+
+/**
+ * Counts of the handshakes completed by the sockets of a TSSLSocketFactory.
+ */
+struct TSSLHandshakeStats {
+  TSSLHandshakeStats() : full(0), resumed(0) {}
+
+  /// Handshakes that performed a full key exchange
+  uint64_t full;
+
+  /// Handshakes that resumed an earlier session
+  uint64_t resumed;
+};
+
+/**
+ * Client-side cache of TLS sessions, by the host:port they were negotiated
+ * with.  A client socket with a cache offers the cached session when it
+ * connects, so that a server that still knows the session, or can decrypt
+ * its ticket, skips the full handshake.  New sessions replace old ones;
+ * once the cache is full the least recently used entry is dropped.
+ *
+ * A cache may be shared by several factories and used from any thread.
+ */
+class TSSLSessionCache {
+public:
+  /**
+   * @param capacity  Most sessions kept; 0 means no limit.
+   */
+  explicit TSSLSessionCache(size_t capacity = 1024);
+  ~TSSLSessionCache();
+
+  /**
+   * The session cached for \p key, with a reference taken for the caller,
+   * or nullptr.
+   */
+  SSL_SESSION* get(const std::string& key);
+
+  /** Cache \p session under \p key; the cache takes its own reference. */
+  void put(const std::string& key, SSL_SESSION* session);
+
+  void remove(const std::string& key);
+
+  void clear();
+
+  size_t size() const;
+
+private:
+  TSSLSessionCache(const TSSLSessionCache&) = delete;
+  TSSLSessionCache& operator=(const TSSLSessionCache&) = delete;
+
+  typedef std::list<std::pair<std::string, SSL_SESSION*> > Entries;
+
+  mutable concurrency::Mutex mutex_;
+  size_t capacity_;
+  /// Most recently used first
+  Entries entries_;
+  std::unordered_map<std::string, Entries::iterator> index_;
 };
 
 /**
@@ -204,6 +289,9 @@ private:
  */
 class TSSLSocketFactory {
 public:
+  /// Size of a session ticket key, see ticketKeys()
+  static const size_t TICKET_KEY_SIZE = 80;
+
   /**
    * Constructor/Destructor
    *
@@ -306,6 +394,54 @@ public:
    * @param manager  The AccessManager instance
    */
   virtual void access(std::shared_ptr<AccessManager> manager) { access_ = manager; }
+  /**
+   * Set the cache that client sockets created from now on resume their
+   * sessions from.  Only for client factories.
+   *
+   * @param cache  The cache, or nullptr to disable client-side resumption
+   */
+  virtual void sessionCache(std::shared_ptr<TSSLSessionCache> cache);
+  std::shared_ptr<TSSLSessionCache> sessionCache() const { return sessionCache_; }
+  /**
+   * Set the number of sessions a server keeps for resumption by session id;
+   * the OpenSSL default is 20480.  0 means no limit.
+   */
+  virtual void sessionCacheSize(long size);
+  /**
+   * Set how long, in seconds, sessions and session tickets issued by a
+   * server stay resumable.
+   */
+  virtual void sessionTimeout(long seconds);
+  /**
+   * Enable/Disable session tickets (RFC 5077), on by default.  Without them
+   * a server can only resume the sessions in its own cache.
+   */
+  virtual void sessionTickets(bool enable);
+  /**
+   * Set the keys a server encrypts session tickets with, so that servers
+   * sharing the keys resume each other's sessions and tickets survive
+   * restarts.  Without keys, OpenSSL uses random ones for each factory.
+   *
+   * Each key is TICKET_KEY_SIZE bytes: a 16 byte name, a 32 byte AES key and
+   * a 32 byte HMAC key.  New tickets are encrypted with the first key; the
+   * others are still accepted, and the tickets they decrypt are renewed with
+   * the first one.
+   *
+   * @throw TSSLException if a key has the wrong size
+   */
+  virtual void ticketKeys(const std::vector<std::string>& keys);
+  /**
+   * Make \p key the key new session tickets are encrypted with.  The key it
+   * replaces is still accepted until the next rotation, so rotating at most
+   * once per session timeout keeps every issued ticket usable.
+   *
+   * @throw TSSLException if the key has the wrong size
+   */
+  virtual void rotateTicketKey(const std::string& key);
+  /**
+   * Counts of the full and resumed handshakes of this factory's sockets.
+   */
+  TSSLHandshakeStats handshakeStats() const;
   static void setManualOpenSSLInitialization(bool manualOpenSSLInitialization) {
     manualOpenSSLInitialization_ = manualOpenSSLInitialization;
   }
@@ -325,6 +461,7 @@ protected:
 private:
   bool server_;
   std::shared_ptr<AccessManager> access_;
+  std::shared_ptr<TSSLSessionCache> sessionCache_;
   static concurrency::Mutex mutex_;
   static uint64_t count_;
   /*THRIFT_EXPORT*/ static bool manualOpenSSLInitialization_;     // questionable to export a private member
@@ -360,8 +497,24 @@ public:
   SSL* createSSL();
   SSL_CTX* get() { return ctx_; }
 
+  /**
+   * Set the session ticket keys, see TSSLSocketFactory::ticketKeys().  The
+   * keys must have the right size.
+   */
+  void ticketKeys(const std::vector<std::string>& keys);
+  std::vector<std::string> ticketKeys() const;
+
+  /** Count a completed handshake. */
+  void handshakeCompleted(bool resumed);
+
+  TSSLHandshakeStats handshakeStats() const;
+
 private:
   SSL_CTX* ctx_;
+  mutable concurrency::Mutex ticketKeysMutex_;
+  std::vector<std::string> ticketKeys_;
+  std::atomic<uint64_t> fullHandshakes_;
+  std::atomic<uint64_t> resumedHandshakes_;
 };
 
 /**
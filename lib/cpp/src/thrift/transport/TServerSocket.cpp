@@ -19,6 +19,8 @@
 
 #include <thrift/thrift-config.h>
 
+#include <cstddef>
+#include <cstdlib>
 #include <cstring>
 #include <memory>
 #include <stdexcept>
@@ -100,9 +102,23 @@ namespace apache {
 namespace thrift {
 namespace transport {
 
+/**
+ * Processes that share a listening socket race for each connection, and the
+ * loser must find nothing to accept rather than block in accept().
+ * \returns 0, or the error
+ */
+static int setSharedSocketNonblocking(THRIFT_SOCKET sock) {
+  int flags = THRIFT_FCNTL(sock, THRIFT_F_GETFL, 0);
+  if (flags == -1 || -1 == THRIFT_FCNTL(sock, THRIFT_F_SETFL, flags | THRIFT_O_NONBLOCK)) {
+    return THRIFT_GET_SOCKET_ERROR;
+  }
+  return 0;
+}
+
 
 TServerSocket::TServerSocket(int port)
   : interruptableChildren_(true),
+    unixSocketType_(SOCK_STREAM),
     port_(port),
     serverSocket_(THRIFT_INVALID_SOCKET),
     acceptBacklog_(DEFAULT_BACKLOG),
@@ -118,11 +134,13 @@ TServerSocket::TServerSocket(int port)
     interruptSockWriter_(THRIFT_INVALID_SOCKET),
     interruptSockReader_(THRIFT_INVALID_SOCKET),
     childInterruptSockWriter_(THRIFT_INVALID_SOCKET),
-    boundSocketType_(SocketType::NONE) {
+    boundSocketType_(SocketType::NONE),
+    handedOff_(false) {
 }
 
 TServerSocket::TServerSocket(int port, int sendTimeout, int recvTimeout)
   : interruptableChildren_(true),
+    unixSocketType_(SOCK_STREAM),
     port_(port),
     serverSocket_(THRIFT_INVALID_SOCKET),
     acceptBacklog_(DEFAULT_BACKLOG),
@@ -138,11 +156,13 @@ TServerSocket::TServerSocket(int port, int sendTimeout, int recvTimeout)
     interruptSockWriter_(THRIFT_INVALID_SOCKET),
     interruptSockReader_(THRIFT_INVALID_SOCKET),
     childInterruptSockWriter_(THRIFT_INVALID_SOCKET),
-    boundSocketType_(SocketType::NONE) {
+    boundSocketType_(SocketType::NONE),
+    handedOff_(false) {
 }
 
 TServerSocket::TServerSocket(const string& address, int port)
   : interruptableChildren_(true),
+    unixSocketType_(SOCK_STREAM),
     port_(port),
     address_(address),
     serverSocket_(THRIFT_INVALID_SOCKET),
@@ -159,11 +179,13 @@ TServerSocket::TServerSocket(const string& address, int port)
     interruptSockWriter_(THRIFT_INVALID_SOCKET),
     interruptSockReader_(THRIFT_INVALID_SOCKET),
     childInterruptSockWriter_(THRIFT_INVALID_SOCKET),
-    boundSocketType_(SocketType::NONE) {
+    boundSocketType_(SocketType::NONE),
+    handedOff_(false) {
 }
 
 TServerSocket::TServerSocket(const string& path)
   : interruptableChildren_(true),
+    unixSocketType_(SOCK_STREAM),
     port_(0),
     path_(path),
     serverSocket_(THRIFT_INVALID_SOCKET),
@@ -180,10 +202,12 @@ TServerSocket::TServerSocket(const string& path)
     interruptSockWriter_(THRIFT_INVALID_SOCKET),
     interruptSockReader_(THRIFT_INVALID_SOCKET),
     childInterruptSockWriter_(THRIFT_INVALID_SOCKET),
-    boundSocketType_(SocketType::NONE) {
+    boundSocketType_(SocketType::NONE),
+    handedOff_(false) {
 }
 TServerSocket::TServerSocket(THRIFT_SOCKET sock,SocketType socketType)
   : interruptableChildren_(true),
+    unixSocketType_(SOCK_STREAM),
     port_(0),
     path_(),
     serverSocket_(sock),
@@ -200,7 +224,8 @@ TServerSocket::TServerSocket(THRIFT_SOCKET sock,SocketType socketType)
     interruptSockWriter_(THRIFT_INVALID_SOCKET),
     interruptSockReader_(THRIFT_INVALID_SOCKET),
     childInterruptSockWriter_(THRIFT_INVALID_SOCKET),
-    boundSocketType_(socketType) {
+    boundSocketType_(socketType),
+    handedOff_(false) {
 }
 
 TServerSocket::~TServerSocket() {
@@ -464,7 +489,7 @@ void TServerSocket::listen() {
     // -- Unix Domain Socket -- //
 
     if (serverSocket_ == THRIFT_INVALID_SOCKET)
-      serverSocket_ = socket(PF_UNIX, SOCK_STREAM, IPPROTO_IP);
+      serverSocket_ = socket(PF_UNIX, unixSocketType_, IPPROTO_IP);
 
     if (serverSocket_ == THRIFT_INVALID_SOCKET) {
       int errno_copy = THRIFT_GET_SOCKET_ERROR;
@@ -497,7 +522,15 @@ void TServerSocket::listen() {
                               " Unix Domain socket path not supported");
 #endif
   } else if( boundSocketType_ != SocketType::NONE){
-    // -- Socket is already bound
+    // -- Socket is already bound, and may be shared with another process
+    errno_copy = setSharedSocketNonblocking(serverSocket_);
+    if (errno_copy != 0) {
+      GlobalOutput.perror("TServerSocket::listen() THRIFT_FCNTL() THRIFT_O_NONBLOCK ", errno_copy);
+      close();
+      throw TTransportException(TTransportException::NOT_OPEN,
+                                "THRIFT_FCNTL() THRIFT_F_SETFL THRIFT_O_NONBLOCK failed",
+                                errno_copy);
+    }
   } else {
     // -- TCP socket -- //
 
@@ -562,7 +595,13 @@ void TServerSocket::listen() {
         port_ = ntohs(sin->sin_port);
       } else if (sa.ss_family == AF_UNIX) {
         const auto* sin = reinterpret_cast<const struct sockaddr_un*>(&sa);
-        path_ = sin->sun_path;
+        size_t pathLen = len - offsetof(struct sockaddr_un, sun_path);
+        if (pathLen > 0 && sin->sun_path[0] != '\0') {
+          path_ = sin->sun_path;
+        } else {
+          // Abstract names start with a '\0' and are not terminated
+          path_.assign(sin->sun_path, pathLen);
+        }
       } else {
         GlobalOutput.perror("TServerSocket::getPort() getsockname() unhandled socket type",EINVAL);
       }
@@ -585,8 +624,9 @@ void TServerSocket::listen() {
 #ifdef _WIN32
       THRIFT_SNPRINTF(errbuf, sizeof(errbuf), "TServerSocket::listen() Could not bind to domain socket path %s, error %d", path_.c_str(), WSAGetLastError());
 #else
-      // Fixme: This does not currently handle abstract domain sockets:
-      THRIFT_SNPRINTF(errbuf, sizeof(errbuf), "TServerSocket::listen() Could not bind to domain socket path %s", path_.c_str());
+      // Abstract names are shown with a leading '@'
+      THRIFT_SNPRINTF(errbuf, sizeof(errbuf), "TServerSocket::listen() Could not bind to domain socket path %s%s",
+                      path_[0] == '\0' ? "@" : "", path_.c_str() + (path_[0] == '\0' ? 1 : 0));
 #endif
     } else {
       THRIFT_SNPRINTF(errbuf, sizeof(errbuf), "TServerSocket::listen() Could not bind to port %d", port_);
@@ -613,6 +653,49 @@ void TServerSocket::listen() {
   listening_ = true;
 }
 
+THRIFT_SOCKET TServerSocket::handOffSocket() {
+  concurrency::Guard g(rwMutex_);
+  if (serverSocket_ == THRIFT_INVALID_SOCKET || !listening_) {
+    throw TTransportException(TTransportException::NOT_OPEN, "TServerSocket not listening");
+  }
+  int errno_copy = setSharedSocketNonblocking(serverSocket_);
+  if (errno_copy != 0) {
+    GlobalOutput.perror("TServerSocket::handOffSocket() THRIFT_FCNTL() THRIFT_O_NONBLOCK ", errno_copy);
+    throw TTransportException(TTransportException::UNKNOWN,
+                              "THRIFT_FCNTL() THRIFT_F_SETFL THRIFT_O_NONBLOCK failed",
+                              errno_copy);
+  }
+  handedOff_ = true;
+  return serverSocket_;
+}
+
+std::vector<THRIFT_SOCKET> TServerSocket::listenSocketsFromSystemd() {
+  std::vector<THRIFT_SOCKET> sockets;
+#ifndef _WIN32
+  // See sd_listen_fds(3): the sockets follow stderr, and are meant for the
+  // process LISTEN_PID names only
+  const int listenFdsStart = 3;
+  const char* pid = getenv("LISTEN_PID");
+  const char* fds = getenv("LISTEN_FDS");
+  if (pid && fds && strtol(pid, nullptr, 10) == static_cast<long>(getpid())) {
+    long count = strtol(fds, nullptr, 10);
+    for (long i = 0; i < count && i < 1024; ++i) {
+      int fd = listenFdsStart + static_cast<int>(i);
+      int flags = fcntl(fd, F_GETFD);
+      if (flags == -1 || -1 == fcntl(fd, F_SETFD, flags | FD_CLOEXEC)) {
+        GlobalOutput.perror("TServerSocket::listenSocketsFromSystemd() fcntl() ", errno);
+        continue;
+      }
+      sockets.push_back(fd);
+    }
+  }
+  unsetenv("LISTEN_PID");
+  unsetenv("LISTEN_FDS");
+  unsetenv("LISTEN_FDNAMES");
+#endif
+  return sockets;
+}
+
 int TServerSocket::getPort() const {
   return port_;
 }
@@ -687,6 +770,10 @@ shared_ptr<TTransport> TServerSocket::acceptImpl() {
 
   if (clientSocket == THRIFT_INVALID_SOCKET) {
     int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    if (errno_copy == THRIFT_EAGAIN || errno_copy == THRIFT_EWOULDBLOCK) {
+      // Another process sharing the socket took the connection
+      throw TTransportException(TTransportException::TIMED_OUT, "accept() lost the race");
+    }
     GlobalOutput.perror("TServerSocket::acceptImpl() ::accept() ", errno_copy);
     throw TTransportException(TTransportException::UNKNOWN, "accept()", errno_copy);
   }
@@ -766,7 +853,9 @@ void TServerSocket::interruptChildren() {
 void TServerSocket::close() {
   concurrency::Guard g(rwMutex_);
   if (serverSocket_ != THRIFT_INVALID_SOCKET) {
-    shutdown(serverSocket_, THRIFT_SHUT_RDWR);
+    // Shutting down a shared socket would stop the other process listening too
+    if (boundSocketType_ == SocketType::NONE && !handedOff_)
+      shutdown(serverSocket_, THRIFT_SHUT_RDWR);
     if( boundSocketType_ == SocketType::NONE) //Do not close the server socket if it owned by systemd
       ::THRIFT_CLOSESOCKET(serverSocket_);
   }
@@ -780,6 +869,7 @@ void TServerSocket::close() {
     ::THRIFT_CLOSESOCKET(childInterruptSockWriter_);
   }
   serverSocket_ = THRIFT_INVALID_SOCKET;
+  handedOff_ = false;
   interruptSockWriter_ = THRIFT_INVALID_SOCKET;
   interruptSockReader_ = THRIFT_INVALID_SOCKET;
   childInterruptSockWriter_ = THRIFT_INVALID_SOCKET;
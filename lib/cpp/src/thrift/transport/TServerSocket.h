@@ -21,6 +21,7 @@
 #define _THRIFT_TRANSPORT_TSERVERSOCKET_H_ 1
 
 #include <functional>
+#include <vector>
 
 #include <thrift/concurrency/Mutex.h>
 #include <thrift/transport/PlatformSocket.h>
@@ -91,12 +92,23 @@ public:
 
   /**
    * Constructor used for to initialize from an already bound unix socket.
-   * Useful for socket activation on systemd.
+   * Useful for socket activation on systemd (see listenSocketsFromSystemd()),
+   * or to take over the socket of a server that is restarting (see
+   * handOffSocket()).  The socket must be listening already, and close()
+   * leaves it open.
    *
    * @param fd
    */
   TServerSocket(THRIFT_SOCKET sock,SocketType socketType);
 
+  /**
+   * The listening sockets systemd passed to this process by socket
+   * activation, in the order of the socket unit; none if it did not.
+   * Unsets LISTEN_PID, LISTEN_FDS and LISTEN_FDNAMES so that children do
+   * not pick them up, so call it once, early.  Always empty on Windows.
+   */
+  static std::vector<THRIFT_SOCKET> listenSocketsFromSystemd();
+
   ~TServerSocket() override;
 
 
@@ -149,6 +161,20 @@ public:
   bool isUnixDomainSocket() const;
 
   void listen() override;
+
+  /**
+   * Hands the listening socket over to the process that replaces this one,
+   * so that a restart refuses no connections.  Returns the descriptor to
+   * pass on, for example with TLocalSocket::sendDescriptors(); the new
+   * process listens on it with TServerSocket(sock, socketType).  Both
+   * processes may accept on it until this one stops, so drain the server
+   * here next (TServer::drain()).  From now on close() leaves the socket
+   * open for the other process.
+   *
+   * \throws TTransportException if not listening
+   */
+  THRIFT_SOCKET handOffSocket();
+
   void interrupt() override;
   void interruptChildren() override;
   void close() override;
@@ -158,6 +184,7 @@ protected:
   virtual std::shared_ptr<TSocket> createSocket(THRIFT_SOCKET client);
   bool interruptableChildren_;
   std::shared_ptr<THRIFT_SOCKET> pChildInterruptSockReader_; // if interruptableChildren_ this is shared with child TSockets
+  int unixSocketType_; // SOCK_STREAM, or SOCK_SEQPACKET for TLocalServerSocket
 
 private:
   void notify(THRIFT_SOCKET notifySock);
@@ -188,6 +215,7 @@ private:
   socket_func_t listenCallback_;
   socket_func_t acceptCallback_;
   SocketType boundSocketType_;
+  bool handedOff_;
 };
 }
 }
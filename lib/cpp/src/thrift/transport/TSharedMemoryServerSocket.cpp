@@ -0,0 +1,53 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/transport/TSharedMemoryServerSocket.h>
+
+#include <unistd.h>
+
+#include <thrift/TOutput.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+TSharedMemoryServerSocket::TSharedMemoryServerSocket(const std::string& path, uint32_t ringSize)
+  : TLocalServerSocket(path), ringSize_(static_cast<uint32_t>(sysconf(_SC_PAGESIZE))) {
+  while (ringSize_ < ringSize && ringSize_ < (1u << 30)) {
+    ringSize_ <<= 1;
+  }
+}
+
+std::shared_ptr<TTransport> TSharedMemoryServerSocket::acceptImpl() {
+  std::shared_ptr<TLocalSocket> control
+      = std::static_pointer_cast<TLocalSocket>(TLocalServerSocket::acceptImpl());
+  try {
+    return std::shared_ptr<TTransport>(
+        new TSharedMemoryTransport(control,
+                                   ringSize_,
+                                   interruptableChildren_ ? pChildInterruptSockReader_ : nullptr));
+  } catch (const TTransportException& ex) {
+    // Only this client is lost; the server keeps accepting
+    GlobalOutput.printf("TSharedMemoryServerSocket::acceptImpl() %s", ex.what());
+    throw TTransportException(TTransportException::CLIENT_DISCONNECT, ex.what());
+  }
+}
+}
+}
+} // apache::thrift::transport
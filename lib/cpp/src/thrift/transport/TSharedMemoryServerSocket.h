@@ -0,0 +1,61 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TSHAREDMEMORYSERVERSOCKET_H_
+#define _THRIFT_TRANSPORT_TSHAREDMEMORYSERVERSOCKET_H_ 1
+
+#include <thrift/transport/TLocalServerSocket.h>
+#include <thrift/transport/TSharedMemoryTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Server transport that accepts TSharedMemoryTransport connections.  It
+ * listens like a TLocalServerSocket and gives every client its own pair
+ * of rings.  Since every flush() reaches the server whole, use it with a
+ * plain TTransportFactory.  Only built on Linux.
+ */
+class TSharedMemoryServerSocket : public TLocalServerSocket {
+public:
+  /**
+   * Constructor.
+   *
+   * @param path     A file system path, or an abstract name as returned by
+   *                 TLocalSocket::abstractPath()
+   * @param ringSize Bytes in each direction of a connection, rounded up to
+   *                 a power of two no smaller than the page size
+   */
+  TSharedMemoryServerSocket(const std::string& path,
+                            uint32_t ringSize = TSharedMemoryTransport::DEFAULT_RING_SIZE);
+
+  uint32_t getRingSize() const { return ringSize_; }
+
+protected:
+  std::shared_ptr<TTransport> acceptImpl() override;
+
+private:
+  uint32_t ringSize_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TSHAREDMEMORYSERVERSOCKET_H_
@@ -0,0 +1,580 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/transport/TSharedMemoryTransport.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#include <thrift/TOutput.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared memory needs lock free 64 bit atomics");
+
+const uint32_t TSharedMemoryTransport::DEFAULT_RING_SIZE;
+
+/**
+ * Start of the shared memory, followed by the two rings.  Ring 0 carries
+ * requests and is read by the server, ring 1 carries responses.  Each
+ * counter has a cache line to itself, so the two sides never contend for
+ * one they do not both write.
+ */
+struct TSharedMemoryTransport::SharedHeader {
+  struct alignas(64) Counter {
+    std::atomic<uint64_t> value;
+  };
+
+  Counter head[2];     // per ring, stored by the side writing it
+  Counter tail[2];     // per ring, stored by the side reading it
+  Counter sleeping[2]; // per side, set while it waits for its wakeup descriptor
+};
+
+namespace {
+
+enum Side { SERVER = 0, CLIENT = 1 };
+
+/// First message on the socket, sent along with the descriptors
+struct Hello {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t ringSize;
+};
+
+const uint32_t HELLO_MAGIC = 0x5448534d; // "THSM"
+const uint32_t HELLO_VERSION = 1;
+const uint32_t MAX_RING_SIZE = 1u << 30;
+
+size_t pageSize() {
+  return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+bool isValidRingSize(uint32_t size) {
+  return size >= pageSize() && size <= MAX_RING_SIZE && (size & (size - 1)) == 0;
+}
+
+void throwErrno(const std::string& what, int errno_copy) {
+  GlobalOutput.perror("TSharedMemoryTransport " + what + " ", errno_copy);
+  throw TTransportException(TTransportException::UNKNOWN, what, errno_copy);
+}
+
+int createSharedMemory(size_t size) {
+#if defined(__linux__) && defined(MFD_ALLOW_SEALING)
+  int fd = memfd_create("thrift-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+  static std::atomic<unsigned> counter(0);
+  std::string name = "/thrift-shm-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd >= 0) {
+    shm_unlink(name.c_str());
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+#endif
+  if (fd < 0) {
+    throwErrno("memfd_create()", errno);
+  }
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    int errno_copy = errno;
+    ::close(fd);
+    throwErrno("ftruncate()", errno_copy);
+  }
+#if defined(__linux__) && defined(MFD_ALLOW_SEALING)
+  // The peer gets the descriptor too; were it able to shrink the file, our
+  // next access to the rings would raise SIGBUS
+  if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+    int errno_copy = errno;
+    ::close(fd);
+    throwErrno("fcntl(F_ADD_SEALS)", errno_copy);
+  }
+#endif
+  return fd;
+}
+
+/**
+ * A wakeup channel: fds[0] to wait on, fds[1] to signal.  An eventfd is
+ * both; elsewhere a socket pair, which unlike a pipe does not raise
+ * SIGPIPE when the peer has gone.
+ */
+void createWakeup(int fds[2]) {
+#ifdef __linux__
+  int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fd < 0) {
+    throwErrno("eventfd()", errno);
+  }
+  fds[0] = fds[1] = fd;
+#else
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    throwErrno("socketpair()", errno);
+  }
+  for (int i = 0; i < 2; ++i) {
+    fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fds[i], SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+  }
+#endif
+}
+
+void closeWakeup(int fds[2]) {
+  if (fds[1] >= 0 && fds[1] != fds[0]) {
+    ::close(fds[1]);
+  }
+  if (fds[0] >= 0) {
+    ::close(fds[0]);
+  }
+  fds[0] = fds[1] = -1;
+}
+
+void mapFixed(uint8_t* address, size_t len, int fd, size_t offset) {
+  void* mapped = mmap(address,
+                      len,
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_FIXED,
+                      fd,
+                      static_cast<off_t>(offset));
+  if (mapped != address) {
+    throwErrno("mmap()", errno);
+  }
+}
+}
+
+TSharedMemoryTransport::TSharedMemoryTransport(const std::string& path,
+                                               std::shared_ptr<TConfiguration> config)
+  : TVirtualTransport(config),
+    path_(path),
+    control_(std::make_shared<TLocalSocket>(path, config)),
+    side_(CLIENT),
+    mapping_(nullptr),
+    mappingSize_(0),
+    header_(nullptr),
+    ringSize_(0),
+    rxData_(nullptr),
+    txData_(nullptr),
+    waitFd_(-1),
+    notifyFd_(-1),
+    rxHead_(0),
+    rxTail_(0),
+    rxPublished_(0),
+    txHead_(0),
+    txPublished_(0),
+    txTail_(0),
+    peerClosed_(false),
+    recvTimeout_(0),
+    sendTimeout_(0),
+    spinCount_(0) {
+}
+
+TSharedMemoryTransport::TSharedMemoryTransport(std::shared_ptr<TLocalSocket> control,
+                                               uint32_t ringSize,
+                                               std::shared_ptr<THRIFT_SOCKET> interruptListener)
+  : TVirtualTransport(control->getConfiguration()),
+    control_(control),
+    interruptListener_(interruptListener),
+    side_(SERVER),
+    mapping_(nullptr),
+    mappingSize_(0),
+    header_(nullptr),
+    ringSize_(0),
+    rxData_(nullptr),
+    txData_(nullptr),
+    waitFd_(-1),
+    notifyFd_(-1),
+    rxHead_(0),
+    rxTail_(0),
+    rxPublished_(0),
+    txHead_(0),
+    txPublished_(0),
+    txTail_(0),
+    peerClosed_(false),
+    recvTimeout_(0),
+    sendTimeout_(0),
+    spinCount_(0) {
+  int serverWakeup[2] = {-1, -1};
+  int clientWakeup[2] = {-1, -1};
+  int fd = createSharedMemory(pageSize() + 2 * static_cast<size_t>(ringSize));
+  try {
+    map(fd, ringSize);
+    new (header_) SharedHeader();
+    createWakeup(serverWakeup);
+    createWakeup(clientWakeup);
+
+    Hello hello = {HELLO_MAGIC, HELLO_VERSION, ringSize};
+    control_->sendDescriptors({fd, clientWakeup[0], serverWakeup[1]});
+    control_->write(reinterpret_cast<const uint8_t*>(&hello), sizeof(hello));
+    control_->flush();
+  } catch (...) {
+    ::close(fd);
+    closeWakeup(serverWakeup);
+    closeWakeup(clientWakeup);
+    unmap();
+    control_->close();
+    throw;
+  }
+  ::close(fd);
+
+  // Keep our ends only
+  waitFd_ = serverWakeup[0];
+  notifyFd_ = clientWakeup[1];
+  if (serverWakeup[1] != waitFd_) {
+    ::close(serverWakeup[1]);
+  }
+  if (clientWakeup[0] != notifyFd_) {
+    ::close(clientWakeup[0]);
+  }
+}
+
+TSharedMemoryTransport::~TSharedMemoryTransport() {
+  close();
+}
+
+bool TSharedMemoryTransport::isOpen() const {
+  return header_ != nullptr;
+}
+
+bool TSharedMemoryTransport::peek() {
+  if (!isOpen()) {
+    return false;
+  }
+  return hasReadable() || waitFor(&TSharedMemoryTransport::hasReadable, recvTimeout_);
+}
+
+void TSharedMemoryTransport::open() {
+  if (isOpen()) {
+    return;
+  }
+  control_->open();
+
+  std::vector<int> fds;
+  try {
+    Hello hello;
+    control_->readAll(reinterpret_cast<uint8_t*>(&hello), sizeof(hello));
+    fds = control_->takeDescriptors();
+    if (fds.size() != 3 || hello.magic != HELLO_MAGIC || hello.version != HELLO_VERSION
+        || !isValidRingSize(hello.ringSize)) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "TSharedMemoryTransport: unexpected handshake from " + path_);
+    }
+    map(fds[0], hello.ringSize);
+  } catch (...) {
+    for (int fd : fds) {
+      ::close(fd);
+    }
+    unmap();
+    control_->close();
+    throw;
+  }
+  ::close(fds[0]);
+  waitFd_ = fds[1];
+  notifyFd_ = fds[2];
+
+  rxHead_ = rxTail_ = rxPublished_ = 0;
+  txHead_ = txPublished_ = txTail_ = 0;
+  peerClosed_ = false;
+}
+
+void TSharedMemoryTransport::close() {
+  unmap();
+  if (waitFd_ >= 0) {
+    ::close(waitFd_);
+    waitFd_ = -1;
+  }
+  if (notifyFd_ >= 0) {
+    ::close(notifyFd_);
+    notifyFd_ = -1;
+  }
+  if (control_) {
+    control_->close();
+  }
+}
+
+uint32_t TSharedMemoryTransport::read(uint8_t* buf, uint32_t len) {
+  checkOpen();
+  if (!hasReadable() && !waitFor(&TSharedMemoryTransport::hasReadable, recvTimeout_)) {
+    return 0;
+  }
+  auto got = static_cast<uint32_t>(std::min<uint64_t>(len, rxHead_ - rxTail_));
+  std::memcpy(buf, rxData_ + (rxTail_ & (ringSize_ - 1)), got);
+  consume(got);
+  return got;
+}
+
+void TSharedMemoryTransport::write(const uint8_t* buf, uint32_t len) {
+  checkOpen();
+  while (len > 0) {
+    if (!hasWritable() && !waitFor(&TSharedMemoryTransport::hasWritable, sendTimeout_)) {
+      throw TTransportException(TTransportException::NOT_OPEN, "TSharedMemoryTransport peer closed");
+    }
+    auto room = static_cast<uint32_t>(std::min<uint64_t>(len, ringSize_ - (txHead_ - txTail_)));
+    std::memcpy(txData_ + (txHead_ & (ringSize_ - 1)), buf, room);
+    txHead_ += room;
+    buf += room;
+    len -= room;
+  }
+}
+
+void TSharedMemoryTransport::flush() {
+  checkOpen();
+  if (peerClosed_) {
+    throw TTransportException(TTransportException::NOT_OPEN, "TSharedMemoryTransport peer closed");
+  }
+  if (txPublished_ != txHead_) {
+    header_->head[1 - side_].value.store(txHead_, std::memory_order_release);
+    txPublished_ = txHead_;
+    notifyPeer();
+  }
+}
+
+const uint8_t* TSharedMemoryTransport::borrow(uint8_t* buf, uint32_t* len) {
+  (void)buf;
+  if (!isOpen()) {
+    return nullptr;
+  }
+  if (rxHead_ - rxTail_ < *len) {
+    loadHead();
+    if (rxHead_ - rxTail_ < *len) {
+      return nullptr;
+    }
+  }
+  // The second mapping makes everything readable contiguous, up to a
+  // whole ring
+  *len = static_cast<uint32_t>(std::min<uint64_t>(rxHead_ - rxTail_, ringSize_));
+  return rxData_ + (rxTail_ & (ringSize_ - 1));
+}
+
+void TSharedMemoryTransport::consume(uint32_t len) {
+  if (len > rxHead_ - rxTail_) {
+    throw TTransportException(TTransportException::BAD_ARGS, "consume did not follow a borrow.");
+  }
+  rxTail_ += len;
+  // Hand space back to the writer in large steps; waitFor() hands back
+  // the rest before going to sleep
+  if (rxTail_ - rxPublished_ >= ringSize_ / 4) {
+    publishTail();
+  }
+}
+
+const std::string TSharedMemoryTransport::getOrigin() const {
+  return control_->getOrigin();
+}
+
+void TSharedMemoryTransport::map(int fd, uint32_t ringSize) {
+  size_t page = pageSize();
+  size_t ringBytes = ringSize;
+
+  // Reserve the address space first, then put the header and each ring
+  // (twice) in place
+  mappingSize_ = page + 4 * ringBytes;
+  void* reserved = mmap(nullptr, mappingSize_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (reserved == MAP_FAILED) {
+    mappingSize_ = 0;
+    throwErrno("mmap()", errno);
+  }
+  mapping_ = static_cast<uint8_t*>(reserved);
+
+  mapFixed(mapping_, page, fd, 0);
+  for (size_t ring = 0; ring < 2; ++ring) {
+    uint8_t* data = mapping_ + page + ring * 2 * ringBytes;
+    mapFixed(data, ringBytes, fd, page + ring * ringBytes);
+    mapFixed(data + ringBytes, ringBytes, fd, page + ring * ringBytes);
+  }
+
+  header_ = reinterpret_cast<SharedHeader*>(mapping_);
+  ringSize_ = ringSize;
+  rxData_ = mapping_ + page + side_ * 2 * ringBytes;
+  txData_ = mapping_ + page + (1 - side_) * 2 * ringBytes;
+}
+
+void TSharedMemoryTransport::unmap() {
+  if (mapping_ != nullptr) {
+    munmap(mapping_, mappingSize_);
+  }
+  mapping_ = nullptr;
+  mappingSize_ = 0;
+  header_ = nullptr;
+  rxData_ = txData_ = nullptr;
+}
+
+void TSharedMemoryTransport::checkOpen() const {
+  if (!isOpen()) {
+    throw TTransportException(TTransportException::NOT_OPEN, "TSharedMemoryTransport is not open");
+  }
+}
+
+bool TSharedMemoryTransport::hasReadable() {
+  if (rxHead_ == rxTail_) {
+    loadHead();
+  }
+  return rxHead_ != rxTail_;
+}
+
+bool TSharedMemoryTransport::hasWritable() {
+  if (txHead_ - txTail_ == ringSize_) {
+    loadTail();
+  }
+  return txHead_ - txTail_ < ringSize_;
+}
+
+void TSharedMemoryTransport::loadHead() {
+  uint64_t head = header_->head[side_].value.load(std::memory_order_acquire);
+  // Never trust the peer to stay within the ring, or to move forwards
+  if (head - rxTail_ > ringSize_) {
+    throw TTransportException(TTransportException::CORRUPTED_DATA,
+                              "TSharedMemoryTransport: peer wrote past the ring");
+  }
+  rxHead_ = head;
+}
+
+void TSharedMemoryTransport::loadTail() {
+  uint64_t tail = header_->tail[1 - side_].value.load(std::memory_order_acquire);
+  if (txHead_ - tail > ringSize_) {
+    throw TTransportException(TTransportException::CORRUPTED_DATA,
+                              "TSharedMemoryTransport: peer read past the ring");
+  }
+  txTail_ = tail;
+}
+
+bool TSharedMemoryTransport::waitFor(bool (TSharedMemoryTransport::*ready)(), int timeout) {
+  for (uint32_t spins = 0; spins < spinCount_; ++spins) {
+    if ((this->*ready)()) {
+      return true;
+    }
+  }
+
+  // The peer may in turn be waiting for this side, so let it see all that
+  // was written and read here before going to sleep
+  bool moved = false;
+  if (txPublished_ != txHead_) {
+    header_->head[1 - side_].value.store(txHead_, std::memory_order_release);
+    txPublished_ = txHead_;
+    moved = true;
+  }
+  if (rxPublished_ != rxTail_) {
+    header_->tail[side_].value.store(rxTail_, std::memory_order_release);
+    rxPublished_ = rxTail_;
+    moved = true;
+  }
+  if (moved) {
+    notifyPeer();
+  }
+
+  std::atomic<uint64_t>& sleeping = header_->sleeping[side_].value;
+  for (;;) {
+    if ((this->*ready)()) {
+      return true;
+    }
+    if (peerClosed_) {
+      return false;
+    }
+
+    // Announce the sleep, then look once more.  The peer publishes before
+    // it looks for the announcement, so at least one of us sees the other.
+    sleeping.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if ((this->*ready)()) {
+      sleeping.store(0, std::memory_order_relaxed);
+      return true;
+    }
+
+    struct THRIFT_POLLFD fds[3];
+    std::memset(fds, 0, sizeof(fds));
+    fds[0].fd = waitFd_;
+    fds[0].events = THRIFT_POLLIN;
+    fds[1].fd = control_->getSocketFD();
+    fds[1].events = THRIFT_POLLIN;
+    nfds_t count = 2;
+    if (interruptListener_) {
+      fds[2].fd = *(interruptListener_.get());
+      fds[2].events = THRIFT_POLLIN;
+      count = 3;
+    }
+
+    int ret = THRIFT_POLL(fds, count, (timeout == 0) ? -1 : timeout);
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    sleeping.store(0, std::memory_order_relaxed);
+    if (ret < 0) {
+      if (errno_copy == THRIFT_EINTR) {
+        continue;
+      }
+      GlobalOutput.perror("TSharedMemoryTransport::waitFor() THRIFT_POLL() ", errno_copy);
+      throw TTransportException(TTransportException::UNKNOWN, "Unknown", errno_copy);
+    } else if (ret == 0) {
+      throw TTransportException(TTransportException::TIMED_OUT, "THRIFT_EAGAIN (timed out)");
+    } else if (count == 3 && (fds[2].revents & THRIFT_POLLIN)) {
+      throw TTransportException(TTransportException::INTERRUPTED, "Interrupted");
+    }
+
+    // Nothing follows the handshake on the socket, so any event is the end
+    if (fds[1].revents != 0) {
+      peerClosed_ = true;
+    }
+    if (fds[0].revents & THRIFT_POLLIN) {
+      uint64_t signals;
+      while (::read(waitFd_, &signals, sizeof(signals)) > 0) {
+      }
+    }
+  }
+}
+
+void TSharedMemoryTransport::publishTail() {
+  header_->tail[side_].value.store(rxTail_, std::memory_order_release);
+  rxPublished_ = rxTail_;
+  notifyPeer();
+}
+
+void TSharedMemoryTransport::notifyPeer() {
+  // Pairs with the fence in waitFor(): what was just stored is visible to
+  // the peer before we check whether it is asleep
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (header_->sleeping[1 - side_].value.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  // A full counter or socket buffer means a wakeup is pending already, and
+  // a peer that has gone is noticed through the socket; nothing to handle
+  uint64_t one = 1;
+#ifdef __linux__
+  ssize_t sent = ::write(notifyFd_, &one, sizeof(one));
+#else
+  int flags = 0;
+#ifdef MSG_NOSIGNAL
+  flags |= MSG_NOSIGNAL;
+#endif
+  ssize_t sent = ::send(notifyFd_, &one, sizeof(one), flags);
+#endif
+  (void)sent;
+}
+}
+}
+} // apache::thrift::transport
@@ -0,0 +1,196 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TSHAREDMEMORYTRANSPORT_H_
+#define _THRIFT_TRANSPORT_TSHAREDMEMORYTRANSPORT_H_ 1
+
+#include <memory>
+#include <string>
+
+#include <thrift/transport/PlatformSocket.h>
+#include <thrift/transport/TLocalSocket.h>
+#include <thrift/transport/TVirtualTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+class TSharedMemoryServerSocket;
+
+/**
+ * Transport between two processes on one host through a pair of ring
+ * buffers in shared memory, one per direction.  Only built on Linux.
+ *
+ * A connection starts as a TLocalSocket to a TSharedMemoryServerSocket,
+ * which hands over the shared memory and two wakeup descriptors.  After
+ * that, calls move no data through the kernel: write() copies straight
+ * into the peer's ring and flush() publishes it.  A side that finds
+ * nothing to read (or no room to write) announces that it is going to
+ * sleep before blocking on its wakeup descriptor, and the peer signals
+ * that descriptor only when it sees the announcement, so a busy
+ * connection makes no system calls at all.  The socket stays open so
+ * that either side notices when the other goes away.
+ *
+ * Each ring is mapped twice, back to back, so that any run of readable
+ * bytes is contiguous: borrow() hands out pointers into the ring, and
+ * protocols decode strings and binaries without an intermediate copy.
+ *
+ * Every flush() is visible to the peer as a whole, so use it with a plain
+ * TTransportFactory rather than a framed or buffered one.  A transport is
+ * used by one thread at a time, like a socket.
+ */
+class TSharedMemoryTransport : public TVirtualTransport<TSharedMemoryTransport> {
+public:
+  /// Size of each ring unless TSharedMemoryServerSocket is told otherwise
+  static const uint32_t DEFAULT_RING_SIZE = 1024 * 1024;
+
+  /**
+   * Constructs a transport that connects to \p path on open().
+   *
+   * @param path Path of a TSharedMemoryServerSocket, a file system path or
+   *             an abstract name as returned by TLocalSocket::abstractPath()
+   */
+  TSharedMemoryTransport(const std::string& path, std::shared_ptr<TConfiguration> config = nullptr);
+
+  ~TSharedMemoryTransport() override;
+
+  bool isOpen() const override;
+
+  /**
+   * Waits until there is something to read.  Returns false once the peer
+   * has closed and everything it sent has been read.
+   */
+  bool peek() override;
+
+  void open() override;
+
+  void close() override;
+
+  uint32_t read(uint8_t* buf, uint32_t len);
+
+  void write(const uint8_t* buf, uint32_t len);
+
+  /// Makes what was written since the last flush() visible to the peer
+  void flush() override;
+
+  /**
+   * Returns a pointer into the ring when at least \p *len bytes are
+   * readable, setting \p *len to how many are; never waits.
+   */
+  const uint8_t* borrow(uint8_t* buf, uint32_t* len);
+
+  void consume(uint32_t len);
+
+  const std::string getOrigin() const override;
+
+  /// Milliseconds a read waits for data, 0 (the default) for no limit
+  void setRecvTimeout(int ms) { recvTimeout_ = ms; }
+
+  /// Milliseconds a write waits for room in the ring, 0 (the default) for no limit
+  void setSendTimeout(int ms) { sendTimeout_ = ms; }
+
+  /**
+   * How many times to check the ring again before going to sleep.  With
+   * spare cores, spinning briefly saves the wakeup round trip when the
+   * peer answers quickly; the default of 0 sleeps right away.
+   */
+  void setSpinCount(uint32_t count) { spinCount_ = count; }
+
+  /// Bytes each ring holds, once open
+  uint32_t getRingSize() const { return ringSize_; }
+
+private:
+  friend class TSharedMemoryServerSocket;
+
+  struct SharedHeader;
+
+  /**
+   * Server side of a connection just accepted on \p control: creates the
+   * rings and sends them to the client.
+   */
+  TSharedMemoryTransport(std::shared_ptr<TLocalSocket> control,
+                         uint32_t ringSize,
+                         std::shared_ptr<THRIFT_SOCKET> interruptListener);
+
+  /// Maps the rings of \p ringSize bytes each from the shared memory in \p fd
+  void map(int fd, uint32_t ringSize);
+
+  void unmap();
+
+  void checkOpen() const;
+
+  bool hasReadable();
+
+  bool hasWritable();
+
+  /**
+   * Reads how far the peer has written to the ring read here, or read
+   * from the one written here.
+   *
+   * @throws TTransportException if that is outside the ring
+   */
+  void loadHead();
+  void loadTail();
+
+  /**
+   * Waits until (this->*ready)() holds; false if the peer went away first.
+   *
+   * @throws TTransportException after \p timeout milliseconds, or when
+   *         interrupted
+   */
+  bool waitFor(bool (TSharedMemoryTransport::*ready)(), int timeout);
+
+  /// Stores how far this side has read, so the peer can reuse the space
+  void publishTail();
+
+  /// Wakes the peer if it is waiting
+  void notifyPeer();
+
+  std::string path_;
+  std::shared_ptr<TLocalSocket> control_;
+  std::shared_ptr<THRIFT_SOCKET> interruptListener_;
+  int side_;
+
+  uint8_t* mapping_;
+  size_t mappingSize_;
+  SharedHeader* header_;
+  uint32_t ringSize_;
+  uint8_t* rxData_;
+  uint8_t* txData_;
+  int waitFd_;
+  int notifyFd_;
+
+  // Positions count every byte ever passed through a ring
+  uint64_t rxHead_;      // written by the peer, as last seen
+  uint64_t rxTail_;      // read here
+  uint64_t rxPublished_; // read here, as the peer can see
+  uint64_t txHead_;      // written here
+  uint64_t txPublished_; // written here, as the peer can see
+  uint64_t txTail_;      // read by the peer, as last seen
+  bool peerClosed_;
+
+  int recvTimeout_;
+  int sendTimeout_;
+  uint32_t spinCount_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TSHAREDMEMORYTRANSPORT_H_
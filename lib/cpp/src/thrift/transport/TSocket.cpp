@@ -508,6 +508,15 @@ void TSocket::close() {
   socket_ = THRIFT_INVALID_SOCKET;
 }
 
+void TSocket::shutdownInput() {
+  if (socket_ != THRIFT_INVALID_SOCKET && -1 == shutdown(socket_, THRIFT_SHUT_RD)) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    if (errno_copy != THRIFT_ENOTCONN) {
+      GlobalOutput.perror("TSocket::shutdownInput() shutdown() " + getSocketInfo(), errno_copy);
+    }
+  }
+}
+
 void TSocket::setSocketFD(THRIFT_SOCKET socket) {
   if (socket_ != THRIFT_INVALID_SOCKET) {
     close();
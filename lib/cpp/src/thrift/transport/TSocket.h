@@ -103,6 +103,13 @@ public:
    */
   void close() override;
 
+  /**
+   * Stops receiving.  Reads return what had already arrived and then see end
+   * of file, including a read blocked in another thread; writes still work.
+   * Servers use this to end idle connections while draining.
+   */
+  void shutdownInput();
+
   /**
    * Determines whether there is pending data to read or not.
    *
@@ -114,6 +121,19 @@ public:
    */
   virtual bool hasPendingDataToRead();
 
+  /// What a non-blocking handshake waits for, see handshakeStep()
+  enum HandshakeStatus { HANDSHAKE_DONE, HANDSHAKE_WANT_READ, HANDSHAKE_WANT_WRITE };
+
+  /**
+   * Advances the handshake a socket performs before it carries data, such
+   * as the TLS one, as far as it can go without blocking.  Plain sockets
+   * have none.  Used by event-driven servers to handshake outside read().
+   *
+   * \throws TTransportException if the handshake failed
+   * \returns HANDSHAKE_DONE, or the readiness the handshake waits for
+   */
+  virtual HandshakeStatus handshakeStep() { return HANDSHAKE_DONE; }
+
   /**
    * Reads from the underlying socket.
    * \returns the number of bytes read or 0 indicates EOF
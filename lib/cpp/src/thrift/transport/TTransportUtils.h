@@ -25,6 +25,7 @@
 #include <string>
 #include <algorithm>
 #include <thrift/transport/TTransport.h>
+#include <thrift/transport/TNullTransport.h>
 // Include the buffered transports that used to be defined here.
 #include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TFileTransport.h>
@@ -33,26 +34,6 @@ namespace apache {
 namespace thrift {
 namespace transport {
 
-/**
- * The null transport is a dummy transport that doesn't actually do anything.
- * It's sort of an analogy to /dev/null, you can never read anything from it
- * and it will let you write anything you want to it, though it won't actually
- * go anywhere.
- *
- */
-class TNullTransport : public TVirtualTransport<TNullTransport> {
-public:
-  TNullTransport() = default;
-
-  ~TNullTransport() override = default;
-
-  bool isOpen() const override { return true; }
-
-  void open() override {}
-
-  void write(const uint8_t* /* buf */, uint32_t /* len */) { return; }
-};
-
 /**
  * TPipedTransport. This transport allows piping of a request from one
  * transport to another either when readEnd() or writeEnd(). The typical
@@ -55,6 +55,8 @@ class TWebSocketServer : public THttpServer {
 public:
   TWebSocketServer(std::shared_ptr<TTransport> transport, std::shared_ptr<TConfiguration> config = nullptr)
     : THttpServer(transport, config) {
+      // flush() writes frames, not HTTP responses
+      headerReserve_ = 0;
       resetHandshake();
   }
 
@@ -265,7 +265,8 @@ void TZlibTransport::flush() {
     wstream_->avail_out = cwbuf_size_;
   }
 
-  flushToTransport(Z_FULL_FLUSH);
+  // A sync flush, unlike a full one, keeps the window for later messages
+  flushToTransport(Z_SYNC_FLUSH);
   resetConsumedMessageSize();
 }
 
@@ -0,0 +1,107 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/transport/TZstdCodec.h>
+
+#include <new>
+#include <zstd.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+namespace {
+
+size_t checkZstdRv(size_t rv) {
+  if (ZSTD_isError(rv)) {
+    throw TCompressionException("zstd", ZSTD_getErrorName(rv));
+  }
+  return rv;
+}
+}
+
+TZstdCodec::TZstdCodec(int level) : cctx_(ZSTD_createCCtx()), dctx_(ZSTD_createDCtx()) {
+  if (cctx_ == nullptr || dctx_ == nullptr) {
+    ZSTD_freeCCtx(cctx_);
+    ZSTD_freeDCtx(dctx_);
+    throw std::bad_alloc();
+  }
+  size_t rv = ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, level);
+  if (ZSTD_isError(rv)) {
+    ZSTD_freeCCtx(cctx_);
+    ZSTD_freeDCtx(dctx_);
+    checkZstdRv(rv);
+  }
+}
+
+TZstdCodec::~TZstdCodec() {
+  ZSTD_freeCCtx(cctx_);
+  ZSTD_freeDCtx(dctx_);
+}
+
+bool TZstdCodec::compress(const uint8_t** in,
+                          size_t* inLen,
+                          uint8_t** out,
+                          size_t* outLen,
+                          FlushMode mode) {
+  ZSTD_EndDirective directive = ZSTD_e_continue;
+  if (mode == FLUSH_SYNC) {
+    // Ends the current block, but not the frame and its window
+    directive = ZSTD_e_flush;
+  } else if (mode == FLUSH_END) {
+    directive = ZSTD_e_end;
+  }
+
+  ZSTD_inBuffer input = {*in, *inLen, 0};
+  ZSTD_outBuffer output = {*out, *outLen, 0};
+  size_t remaining = checkZstdRv(ZSTD_compressStream2(cctx_, &output, &input, directive));
+
+  *in += input.pos;
+  *inLen -= input.pos;
+  *out += output.pos;
+  *outLen -= output.pos;
+
+  if (mode == FLUSH_NONE) {
+    return *inLen == 0;
+  }
+  // Flushing and ending also consume all input before returning 0
+  return remaining == 0;
+}
+
+bool TZstdCodec::decompress(const uint8_t** in, size_t* inLen, uint8_t** out, size_t* outLen) {
+  ZSTD_inBuffer input = {*in, *inLen, 0};
+  ZSTD_outBuffer output = {*out, *outLen, 0};
+  size_t hint = checkZstdRv(ZSTD_decompressStream(dctx_, &output, &input));
+
+  *in += input.pos;
+  *inLen -= input.pos;
+  *out += output.pos;
+  *outLen -= output.pos;
+
+  // 0 once a frame is fully decoded and flushed
+  return hint == 0;
+}
+
+void TZstdCodec::reset() {
+  checkZstdRv(ZSTD_CCtx_reset(cctx_, ZSTD_reset_session_only));
+  checkZstdRv(ZSTD_DCtx_reset(dctx_, ZSTD_reset_session_only));
+}
+}
+}
+} // apache::thrift::transport
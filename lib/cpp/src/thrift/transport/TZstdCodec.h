@@ -0,0 +1,64 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TZSTDCODEC_H_
+#define _THRIFT_TRANSPORT_TZSTDCODEC_H_ 1
+
+#include <thrift/transport/TCompressionCodec.h>
+
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * The zstd format.  The window is kept across flushes, which suits streams
+ * of small similar messages.
+ */
+class TZstdCodec : public TCompressionCodec {
+public:
+  /**
+   * @param level  Compression level, 1 (fast) to 19 (slow), or negative
+   *               for faster still.
+   */
+  explicit TZstdCodec(int level = DEFAULT_LEVEL);
+  ~TZstdCodec() override;
+
+  const char* name() const override { return "zstd"; }
+  bool compress(const uint8_t** in,
+                size_t* inLen,
+                uint8_t** out,
+                size_t* outLen,
+                FlushMode mode) override;
+  bool decompress(const uint8_t** in, size_t* inLen, uint8_t** out, size_t* outLen) override;
+  void reset() override;
+
+  static const int DEFAULT_LEVEL = 3;
+
+private:
+  struct ZSTD_CCtx_s* cctx_;
+  struct ZSTD_DCtx_s* dctx_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TZSTDCODEC_H_
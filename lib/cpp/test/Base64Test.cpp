@@ -19,9 +19,14 @@
 
 #include <boost/test/unit_test.hpp>
 #include <thrift/protocol/TBase64Utils.h>
+#include <cstdlib>
+#include <vector>
 
 using apache::thrift::protocol::base64_encode;
 using apache::thrift::protocol::base64_decode;
+using apache::thrift::protocol::base64_encoded_size;
+using apache::thrift::protocol::base64_encode_buffer;
+using apache::thrift::protocol::base64_decode_buffer;
 
 BOOST_AUTO_TEST_SUITE(Base64Test)
 
@@ -71,4 +76,79 @@ BOOST_AUTO_TEST_CASE(test_Base64_Encode_Decode) {
   }
 }
 
+// Reference encoding of a whole buffer, a group at a time
+std::vector<uint8_t> encodeGroups(const std::vector<uint8_t>& in) {
+  std::vector<uint8_t> out;
+  for (size_t i = 0; i < in.size(); i += 3) {
+    uint8_t group[4];
+    auto len = static_cast<uint32_t>(std::min<size_t>(3, in.size() - i));
+    base64_encode(&in[i], len, group);
+    out.insert(out.end(), group, group + len + 1);
+  }
+  return out;
+}
+
+// Reference decoding of a whole buffer, a group at a time
+std::vector<uint8_t> decodeGroups(const std::vector<uint8_t>& in) {
+  std::vector<uint8_t> out;
+  for (size_t i = 0; i < in.size(); i += 4) {
+    auto len = static_cast<uint32_t>(std::min<size_t>(4, in.size() - i));
+    if (len < 2) {
+      break;
+    }
+    uint8_t group[4];
+    std::copy(in.begin() + i, in.begin() + i + len, group);
+    base64_decode(group, len);
+    out.insert(out.end(), group, group + len - 1);
+  }
+  return out;
+}
+
+BOOST_AUTO_TEST_CASE(test_Base64_Buffer_Encode_Decode) {
+  std::srand(42);
+  for (uint32_t len = 0; len < 300; ++len) {
+    std::vector<uint8_t> data(len);
+    for (uint8_t& byte : data) {
+      byte = static_cast<uint8_t>(std::rand());
+    }
+
+    std::vector<uint8_t> expected = encodeGroups(data);
+    BOOST_CHECK_EQUAL(expected.size(), base64_encoded_size(len));
+
+    std::vector<uint8_t> encoded(base64_encoded_size(len) + 1);
+    uint32_t encodedLen = base64_encode_buffer(data.data(), len, encoded.data());
+    encoded.resize(encodedLen);
+    BOOST_CHECK(expected == encoded);
+
+    std::vector<uint8_t> decoded(len + 1);
+    uint32_t decodedLen = base64_decode_buffer(encoded.data(), encodedLen, decoded.data());
+    decoded.resize(decodedLen);
+    BOOST_CHECK(data == decoded);
+
+    // In place
+    decodedLen = base64_decode_buffer(encoded.data(), encodedLen, encoded.data());
+    encoded.resize(decodedLen);
+    BOOST_CHECK(data == encoded);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_Base64_Buffer_Decode_Invalid) {
+  // Characters outside the alphabet decode to the same garbage as with
+  // base64_decode(), wherever they fall relative to the SIMD blocks
+  const char invalid[] = {'=', '*', '-', '_', ' ', '\0', '\x80', '\xff'};
+  std::string valid = "QUJDREVGR0hJSktMTU5PUFFSU1RVVldYWVphYmNkZWZnaGlqa2xtbm9wcXJzdHV2d3h5ejAxMjM0";
+  for (char ch : invalid) {
+    for (size_t pos = 0; pos < valid.size(); ++pos) {
+      std::vector<uint8_t> in(valid.begin(), valid.end());
+      in[pos] = static_cast<uint8_t>(ch);
+      std::vector<uint8_t> expected = decodeGroups(in);
+
+      std::vector<uint8_t> decoded(in.size());
+      auto len = static_cast<uint32_t>(in.size());
+      decoded.resize(base64_decode_buffer(in.data(), len, decoded.data()));
+      BOOST_CHECK(expected == decoded);
+    }
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
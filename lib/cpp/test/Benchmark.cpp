@@ -25,6 +25,7 @@
 #include <math.h>
 #include <memory>
 #include "thrift/protocol/TBinaryProtocol.h"
+#include "thrift/protocol/TJSONProtocol.h"
 #include "thrift/transport/TBufferTransports.h"
 #include "gen-cpp/DebugProtoTest_types.h"
 
@@ -156,6 +157,72 @@ int main() {
     cout << " Read big endian: " << num / (1000 * elapsed) << " kHz" << '\n';
   }
 
+  {
+    buf->resetBuffer();
+    TJSONProtocol prot(buf);
+    double elapsed = 0.0;
+    Timer timer;
+
+    for (int i = 0; i < num; i++) {
+      ooe.write(&prot);
+    }
+    elapsed = timer.frame();
+    cout << "Write JSON: " << num / (1000 * elapsed) << " kHz" << '\n';
+  }
+
+  buf->getBuffer(&data, &datasize);
+
+  {
+    std::shared_ptr<TMemoryBuffer> buf2(new TMemoryBuffer(data, datasize));
+    TJSONProtocol prot(buf2);
+    OneOfEach ooe2;
+    double elapsed = 0.0;
+    Timer timer;
+
+    for (int i = 0; i < num; i++) {
+      ooe2.read(&prot);
+    }
+    elapsed = timer.frame();
+    cout << " Read JSON: " << num / (1000 * elapsed) << " kHz" << '\n';
+  }
+
+  // Large binary fields, which the JSON protocol base64 encodes
+  OneOfEach thumbnail(ooe);
+  thumbnail.base64.resize(200 * 1024);
+  for (size_t i = 0; i < thumbnail.base64.size(); ++i) {
+    thumbnail.base64[i] = static_cast<char>(i * 7);
+  }
+  int numThumbnails = 500;
+
+  {
+    buf->resetBuffer();
+    TJSONProtocol prot(buf);
+    double elapsed = 0.0;
+    Timer timer;
+
+    for (int i = 0; i < numThumbnails; i++) {
+      thumbnail.write(&prot);
+    }
+    elapsed = timer.frame();
+    cout << "Write JSON 200KB binary: " << numThumbnails / (1000 * elapsed) << " kHz" << '\n';
+  }
+
+  buf->getBuffer(&data, &datasize);
+
+  {
+    std::shared_ptr<TMemoryBuffer> buf2(new TMemoryBuffer(data, datasize));
+    TJSONProtocol prot(buf2);
+    OneOfEach thumbnail2;
+    double elapsed = 0.0;
+    Timer timer;
+
+    for (int i = 0; i < numThumbnails; i++) {
+      thumbnail2.read(&prot);
+    }
+    elapsed = timer.frame();
+    cout << " Read JSON 200KB binary: " << numThumbnails / (1000 * elapsed) << " kHz" << '\n';
+  }
+
 
   data = nullptr;
   datasize = 0;
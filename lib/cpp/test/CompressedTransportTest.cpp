@@ -0,0 +1,410 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/random.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/version.hpp>
+
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TCompressedTransport.h>
+#include <thrift/transport/TZlibTransport.h>
+#ifdef HAVE_ZSTD
+#include <thrift/transport/TZstdCodec.h>
+#endif
+#ifdef HAVE_LZ4
+#include <thrift/transport/TLz4Codec.h>
+#endif
+
+using namespace apache::thrift::transport;
+using std::shared_ptr;
+using std::string;
+
+boost::mt19937 rng;
+
+/*
+ * The seed is fixed so that failures reproduce; set
+ * THRIFT_TEST_SEED to try others.
+ */
+uint32_t test_seed() {
+  const char* seed = getenv("THRIFT_TEST_SEED");
+  return seed != nullptr ? static_cast<uint32_t>(strtoul(seed, nullptr, 0)) : 20240401u;
+}
+
+/*
+ * Utility code
+ */
+
+struct CodecSpec {
+  string name;
+  TCompressionCodecPool::CodecFactory factory;
+};
+
+template <typename Codec_>
+CodecSpec codecSpec(const string& name, int level) {
+  CodecSpec spec;
+  spec.name = name;
+  spec.factory = [level] { return std::unique_ptr<TCompressionCodec>(new Codec_(level)); };
+  return spec;
+}
+
+std::vector<CodecSpec> codecSpecs() {
+  std::vector<CodecSpec> specs;
+  specs.push_back(codecSpec<TZlibCodec>("zlib-1", 1));
+  specs.push_back(codecSpec<TZlibCodec>("zlib-6", 6));
+#ifdef HAVE_ZSTD
+  specs.push_back(codecSpec<TZstdCodec>("zstd-1", 1));
+  specs.push_back(codecSpec<TZstdCodec>("zstd-3", 3));
+#endif
+#ifdef HAVE_LZ4
+  specs.push_back(codecSpec<TLz4Codec>("lz4", 0));
+#endif
+  return specs;
+}
+
+// Runs of alternately increasing and decreasing bytes, as in ZlibTest
+string gen_compressible_buffer(uint32_t buf_len) {
+  string buf(buf_len, '\0');
+  boost::uniform_smallint<uint32_t> run_length_distribution(1, 64);
+  boost::uniform_smallint<uint8_t> byte_distribution(0, UINT8_MAX);
+  boost::variate_generator<boost::mt19937, boost::uniform_smallint<uint8_t> >
+      byte_generator(rng, byte_distribution);
+  boost::variate_generator<boost::mt19937, boost::uniform_smallint<uint32_t> >
+      run_len_generator(rng, run_length_distribution);
+
+  uint32_t idx = 0;
+  int8_t step = 1;
+  while (idx < buf_len) {
+    uint32_t run_length = run_len_generator();
+    uint8_t byte = byte_generator();
+    for (uint32_t n = 0; n < run_length && idx < buf_len; ++n) {
+      buf[idx++] = static_cast<char>(byte);
+      byte += step;
+    }
+    step *= -1;
+  }
+  return buf;
+}
+
+string gen_random_buffer(uint32_t buf_len) {
+  string buf(buf_len, '\0');
+  boost::uniform_smallint<uint8_t> distribution(0, UINT8_MAX);
+  boost::variate_generator<boost::mt19937, boost::uniform_smallint<uint8_t> >
+      generator(rng, distribution);
+  for (uint32_t n = 0; n < buf_len; ++n) {
+    buf[n] = static_cast<char>(generator());
+  }
+  return buf;
+}
+
+// An RPC-sized message: a few fields that vary around repeated structure
+string gen_message(uint32_t seq) {
+  std::ostringstream msg;
+  msg << "call:getUserProfile seq:" << seq << " {";
+  for (uint32_t i = 0; i < 16; ++i) {
+    msg << "\"field" << i << "\":\"value-" << (seq * 31 + i) % 97 << "\",";
+  }
+  msg << "\"tags\":[\"alpha\",\"beta\",\"gamma\"]}";
+  return msg.str();
+}
+
+const uint8_t* bytes(const string& s) {
+  return reinterpret_cast<const uint8_t*>(s.data());
+}
+
+/*
+ * Test functions
+ */
+
+void test_write_then_read(const CodecSpec& spec, const string& buf) {
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  TCompressedTransport trans(membuf, shared_ptr<TCompressionCodec>(spec.factory()));
+  trans.write(bytes(buf), static_cast<uint32_t>(buf.size()));
+  trans.finish();
+
+  string mirror(buf.size(), '\0');
+  uint32_t got = trans.readAll(reinterpret_cast<uint8_t*>(&mirror[0]),
+                               static_cast<uint32_t>(mirror.size()));
+  BOOST_REQUIRE_EQUAL(got, buf.size());
+  BOOST_CHECK(mirror == buf);
+  BOOST_CHECK_THROW(trans.write(bytes(buf), 1), TTransportException);
+}
+
+void test_read_write_mix(const CodecSpec& spec, const string& buf, uint32_t rbufSize) {
+  // Small read buffers leave output pending in the codec
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  TCompressedTransport writer(membuf, shared_ptr<TCompressionCodec>(spec.factory()));
+  TCompressedTransport reader(membuf,
+                              shared_ptr<TCompressionCodec>(spec.factory()),
+                              rbufSize);
+
+  boost::uniform_smallint<uint32_t> size_distribution(1, 4096);
+  boost::variate_generator<boost::mt19937, boost::uniform_smallint<uint32_t> >
+      size_generator(rng, size_distribution);
+
+  uint32_t written = 0;
+  uint32_t read = 0;
+  string mirror(buf.size(), '\0');
+  while (read < buf.size()) {
+    uint32_t chunk = (std::min)(size_generator(), static_cast<uint32_t>(buf.size()) - written);
+    if (chunk > 0) {
+      writer.write(bytes(buf) + written, chunk);
+      written += chunk;
+      writer.flush();
+    }
+    // Everything flushed can be read without the writer ending the stream
+    uint32_t want = written - read;
+    uint32_t got = reader.readAll(reinterpret_cast<uint8_t*>(&mirror[read]), want);
+    BOOST_REQUIRE_EQUAL(got, want);
+    read += got;
+  }
+  BOOST_CHECK(mirror == buf);
+
+  // A read may return before the tail of a sync flush is consumed; only
+  // the end of the stream drains the underlying transport
+  writer.finish();
+  uint8_t extra;
+  BOOST_CHECK_EQUAL(reader.read(&extra, 1), 0u);
+  BOOST_CHECK_EQUAL(membuf->available_read(), 0u);
+}
+
+void test_window_kept_across_flushes(const CodecSpec& spec) {
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  TCompressedTransport trans(membuf, shared_ptr<TCompressionCodec>(spec.factory()));
+  string msg = gen_message(1);
+
+  trans.write(bytes(msg), static_cast<uint32_t>(msg.size()));
+  trans.flush();
+  uint32_t first = membuf->available_read();
+  membuf->resetBuffer();
+
+  // The same message again refers back to the first one
+  trans.write(bytes(msg), static_cast<uint32_t>(msg.size()));
+  trans.flush();
+  uint32_t second = membuf->available_read();
+  BOOST_CHECK_LT(second * 2, first);
+}
+
+void test_pool(const CodecSpec& spec) {
+  shared_ptr<TCompressionCodecPool> pool(new TCompressionCodecPool(spec.factory, 1));
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  TCompressedTransportFactory factory(pool);
+  string msg = gen_message(7);
+
+  const TCompressionCodec* used;
+  {
+    // Abandoned mid-stream
+    shared_ptr<TTransport> trans = factory.getTransport(membuf);
+    used = std::static_pointer_cast<TCompressedTransport>(trans)->getCodec().get();
+    trans->write(bytes(msg), static_cast<uint32_t>(msg.size()));
+  }
+  BOOST_CHECK_EQUAL(pool->idle(), 1u);
+
+  // The codec comes back reset
+  membuf->resetBuffer();
+  shared_ptr<TCompressedTransport> writer
+      = std::static_pointer_cast<TCompressedTransport>(factory.getTransport(membuf));
+  BOOST_CHECK_EQUAL(used, writer->getCodec().get());
+  BOOST_CHECK_EQUAL(pool->idle(), 0u);
+  writer->write(bytes(msg), static_cast<uint32_t>(msg.size()));
+  writer->flush();
+
+  shared_ptr<TTransport> reader = factory.getTransport(membuf);
+  string mirror(msg.size(), '\0');
+  reader->readAll(reinterpret_cast<uint8_t*>(&mirror[0]), static_cast<uint32_t>(mirror.size()));
+  BOOST_CHECK(mirror == msg);
+
+  // Only one codec is kept idle, and codecs may outlive the pool
+  writer.reset();
+  pool.reset();
+  reader.reset();
+}
+
+void test_corrupt_input(const CodecSpec& spec) {
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  string garbage(256, '\x5a');
+  membuf->write(bytes(garbage), static_cast<uint32_t>(garbage.size()));
+  TCompressedTransport trans(membuf, shared_ptr<TCompressionCodec>(spec.factory()));
+  uint8_t buf[64];
+  BOOST_CHECK_THROW(trans.readAll(buf, sizeof(buf)), TTransportException);
+}
+
+/*
+ * Benchmark: CPU time and ratio of each codec on a stream of RPC-sized
+ * messages, each flushed, against TZlibTransport.
+ */
+
+struct Measurement {
+  double compressNsPerByte;
+  double decompressNsPerByte;
+  double ratio;
+};
+
+template <typename Transport_>
+Measurement measure(const std::function<shared_ptr<Transport_>(shared_ptr<TMemoryBuffer>)>& make,
+                    const std::vector<string>& messages) {
+  typedef std::chrono::steady_clock Clock;
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  shared_ptr<Transport_> writer = make(membuf);
+  size_t raw = 0;
+
+  Clock::time_point start = Clock::now();
+  for (const string& msg : messages) {
+    writer->write(bytes(msg), static_cast<uint32_t>(msg.size()));
+    writer->flush();
+    raw += msg.size();
+  }
+  double compressNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  uint32_t compressed = membuf->available_read();
+
+  shared_ptr<Transport_> reader = make(membuf);
+  string mirror;
+  start = Clock::now();
+  for (const string& msg : messages) {
+    mirror.resize(msg.size());
+    reader->readAll(reinterpret_cast<uint8_t*>(&mirror[0]), static_cast<uint32_t>(msg.size()));
+  }
+  double decompressNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  BOOST_CHECK(mirror == messages.back());
+
+  Measurement m;
+  m.compressNsPerByte = compressNs / raw;
+  m.decompressNsPerByte = decompressNs / raw;
+  m.ratio = static_cast<double>(raw) / compressed;
+  return m;
+}
+
+void print_measurement(const string& name, const Measurement& m) {
+  printf("%-28s ratio %6.2f  compress %7.2f ns/B  decompress %7.2f ns/B\n",
+         name.c_str(),
+         m.ratio,
+         m.compressNsPerByte,
+         m.decompressNsPerByte);
+}
+
+void test_benchmark(const std::vector<CodecSpec>& specs) {
+  std::vector<string> messages;
+  for (uint32_t seq = 0; seq < 2000; ++seq) {
+    messages.push_back(gen_message(seq));
+  }
+
+  print_measurement("TZlibTransport",
+                    measure<TZlibTransport>(
+                        [](shared_ptr<TMemoryBuffer> membuf) {
+                          return std::make_shared<TZlibTransport>(membuf);
+                        },
+                        messages));
+  for (const CodecSpec& spec : specs) {
+    TCompressionCodecPool::CodecFactory factory = spec.factory;
+    print_measurement("TCompressedTransport/" + spec.name,
+                      measure<TCompressedTransport>(
+                          [factory](shared_ptr<TMemoryBuffer> membuf) {
+                            return std::make_shared<TCompressedTransport>(
+                                membuf, shared_ptr<TCompressionCodec>(factory()));
+                          },
+                          messages));
+  }
+}
+
+/*
+ * Initialization
+ */
+
+#if (BOOST_VERSION >= 105900)
+#define ADD_TEST_CASE(suite, name, _FUNC, ...)                                                     \
+  do {                                                                                             \
+    ::std::ostringstream name_ss;                                                                  \
+    name_ss << name << "-" << BOOST_STRINGIZE(_FUNC);                                              \
+    ::std::function<void ()> test_func =                                                           \
+        ::std::bind(_FUNC, ##__VA_ARGS__);                                                         \
+    ::boost::unit_test::test_case* tc                                                              \
+        = ::boost::unit_test::make_test_case(test_func, name_ss.str(), __FILE__, __LINE__);        \
+    (suite)->add(tc);                                                                              \
+  } while (0)
+#else
+#define ADD_TEST_CASE(suite, name, _FUNC, ...)                                                     \
+  do {                                                                                             \
+    ::std::ostringstream name_ss;                                                                  \
+    name_ss << name << "-" << BOOST_STRINGIZE(_FUNC);                                              \
+    ::boost::unit_test::test_case* tc                                                              \
+        = ::boost::unit_test::make_test_case(::std::bind(_FUNC, ##__VA_ARGS__),                    \
+                                             name_ss.str());                                       \
+    (suite)->add(tc);                                                                              \
+  } while (0)
+#endif
+
+void add_tests(boost::unit_test::test_suite* suite) {
+  uint32_t buf_len = 1024 * 32;
+  string compressible = gen_compressible_buffer(buf_len);
+  string random = gen_random_buffer(buf_len);
+
+  std::vector<CodecSpec> specs = codecSpecs();
+  for (const CodecSpec& spec : specs) {
+    ADD_TEST_CASE(suite, spec.name << "-compressible", test_write_then_read, spec, compressible);
+    ADD_TEST_CASE(suite, spec.name << "-random", test_write_then_read, spec, random);
+    ADD_TEST_CASE(suite, spec.name << "-compressible", test_read_write_mix, spec, compressible, 16384u);
+    ADD_TEST_CASE(suite, spec.name << "-small-rbuf", test_read_write_mix, spec, compressible, 64u);
+    ADD_TEST_CASE(suite, spec.name << "-random", test_read_write_mix, spec, random, 64u);
+    ADD_TEST_CASE(suite, spec.name, test_window_kept_across_flushes, spec);
+    ADD_TEST_CASE(suite, spec.name, test_pool, spec);
+    ADD_TEST_CASE(suite, spec.name, test_corrupt_input, spec);
+  }
+  ADD_TEST_CASE(suite, "all", test_benchmark, specs);
+}
+
+#ifdef BOOST_TEST_DYN_LINK
+bool init_unit_test_suite() {
+  uint32_t seed = test_seed();
+  printf("seed: %u\n", seed);
+  rng.seed(seed);
+
+  boost::unit_test::test_suite* suite = &boost::unit_test::framework::master_test_suite();
+  suite->p_name.value = "CompressedTransportTest";
+  add_tests(suite);
+  return true;
+}
+
+int main( int argc, char* argv[] ) {
+  return ::boost::unit_test::unit_test_main(&init_unit_test_suite,argc,argv);
+}
+#else
+boost::unit_test::test_suite* init_unit_test_suite(int argc, char* argv[]) {
+  THRIFT_UNUSED_VARIABLE(argc);
+  THRIFT_UNUSED_VARIABLE(argv);
+  uint32_t seed = test_seed();
+  printf("seed: %u\n", seed);
+  rng.seed(seed);
+
+  boost::unit_test::test_suite* suite = &boost::unit_test::framework::master_test_suite();
+  suite->p_name.value = "CompressedTransportTest";
+  add_tests(suite);
+  return nullptr;
+}
+#endif
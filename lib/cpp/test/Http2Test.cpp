@@ -0,0 +1,397 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE Http2Test
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <thrift/concurrency/Monitor.h>
+#include <thrift/concurrency/ThreadFactory.h>
+#include <thrift/concurrency/ThreadManager.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/server/THttp2Server.h>
+#include <thrift/transport/THpack.h>
+#include <thrift/transport/THttp2Client.h>
+#include <thrift/transport/TServerSocket.h>
+#include <thrift/transport/TSocket.h>
+#include "gen-cpp/ParentService.h"
+
+using apache::thrift::concurrency::Monitor;
+using apache::thrift::concurrency::Synchronized;
+using apache::thrift::concurrency::ThreadFactory;
+using apache::thrift::concurrency::ThreadManager;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TBinaryProtocolFactory;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::server::THttp2Server;
+using apache::thrift::server::TServerEventHandler;
+using apache::thrift::test::ParentServiceClient;
+using apache::thrift::test::ParentServiceIf;
+using apache::thrift::test::ParentServiceProcessor;
+using apache::thrift::transport::THpackDecoder;
+using apache::thrift::transport::THpackEncoder;
+using apache::thrift::transport::THttp2Client;
+using apache::thrift::transport::THttp2Connection;
+using apache::thrift::transport::THttp2Headers;
+using apache::thrift::transport::TServerSocket;
+using apache::thrift::transport::TSocket;
+using apache::thrift::transport::TTransportException;
+using apache::thrift::transport::hpackHuffmanDecode;
+using apache::thrift::transport::hpackHuffmanEncode;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+
+namespace {
+
+string unhex(const string& hex) {
+  string out;
+  for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+    if (hex[i] == ' ') {
+      --i;
+      continue;
+    }
+    out += static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16));
+  }
+  return out;
+}
+
+THttp2Headers decode(THpackDecoder& decoder, const string& hex) {
+  string block = unhex(hex);
+  THttp2Headers headers;
+  decoder.decode(reinterpret_cast<const uint8_t*>(block.data()), block.size(), headers);
+  return headers;
+}
+
+class Handler : public ParentServiceIf {
+public:
+  Handler() : generation_(0), blocked_(false), released_(false) {}
+
+  int32_t incrementGeneration() override { return ++generation_; }
+
+  int32_t getGeneration() override { return generation_; }
+
+  void addString(const string& s) override {
+    Synchronized s_(mon_);
+    strings_.push_back(s);
+  }
+
+  void getStrings(std::vector<string>& _return) override {
+    Synchronized s(mon_);
+    _return = strings_;
+  }
+
+  // A negative length blocks until release()
+  void getDataWait(string& _return, const int32_t length) override {
+    if (length >= 0) {
+      _return.assign(length, 'x');
+      return;
+    }
+    Synchronized s(mon_);
+    blocked_ = true;
+    mon_.notifyAll();
+    while (!released_) {
+      mon_.wait();
+    }
+  }
+
+  void onewayWait() override { ++generation_; }
+
+  void exceptionWait(const string&) override {}
+
+  void unexpectedExceptionWait(const string&) override {}
+
+  void waitUntilBlocked() {
+    Synchronized s(mon_);
+    while (!blocked_) {
+      mon_.wait();
+    }
+  }
+
+  void release() {
+    Synchronized s(mon_);
+    released_ = true;
+    mon_.notifyAll();
+  }
+
+private:
+  std::atomic<int32_t> generation_;
+  Monitor mon_;
+  std::vector<string> strings_;
+  bool blocked_;
+  bool released_;
+};
+
+class ReadyHandler : public TServerEventHandler {
+public:
+  ReadyHandler() : ready_(false) {}
+
+  void preServe() override {
+    Synchronized s(mon_);
+    ready_ = true;
+    mon_.notifyAll();
+  }
+
+  void waitUntilReady() {
+    Synchronized s(mon_);
+    while (!ready_) {
+      mon_.wait();
+    }
+  }
+
+private:
+  Monitor mon_;
+  bool ready_;
+};
+
+struct Http2Server {
+  explicit Http2Server(size_t workers = 4, size_t pendingTaskCountMax = 0)
+    : handler(make_shared<Handler>()), socket(make_shared<TServerSocket>("localhost", 0)) {
+    shared_ptr<ThreadManager> threadManager
+        = ThreadManager::newSimpleThreadManager(workers, pendingTaskCountMax);
+    threadManager->threadFactory(make_shared<ThreadFactory>());
+    threadManager->start();
+    server = make_shared<THttp2Server>(make_shared<ParentServiceProcessor>(handler),
+                                       socket,
+                                       make_shared<TBinaryProtocolFactory>(),
+                                       threadManager);
+    auto ready = make_shared<ReadyHandler>();
+    server->setServerEventHandler(ready);
+    thread = std::thread([this] { server->serve(); });
+    ready->waitUntilReady();
+  }
+
+  ~Http2Server() {
+    server->stop();
+    thread.join();
+  }
+
+  shared_ptr<THttp2Connection> connect() {
+    auto connection = make_shared<THttp2Connection>(make_shared<TSocket>("localhost",
+                                                                         socket->getPort()));
+    connection->open();
+    return connection;
+  }
+
+  shared_ptr<Handler> handler;
+  shared_ptr<TServerSocket> socket;
+  shared_ptr<THttp2Server> server;
+  std::thread thread;
+};
+
+ParentServiceClient makeClient(const shared_ptr<THttp2Connection>& connection) {
+  return ParentServiceClient(make_shared<TBinaryProtocol>(make_shared<THttp2Client>(connection)));
+}
+}
+
+BOOST_AUTO_TEST_SUITE(Http2Test)
+
+BOOST_AUTO_TEST_CASE(test_hpack_rfc7541_examples) {
+  // RFC 7541 C.4: three requests on one connection, Huffman coded
+  THttp2Headers first{{":method", "GET"},
+                      {":scheme", "http"},
+                      {":path", "/"},
+                      {":authority", "www.example.com"}};
+  THpackEncoder encoder;
+  string block;
+  encoder.encode(first, block);
+  BOOST_CHECK(block == unhex("8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff"));
+
+  THpackDecoder decoder;
+  BOOST_CHECK(decode(decoder, "8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff") == first);
+
+  THttp2Headers second = first;
+  second.emplace_back("cache-control", "no-cache");
+  BOOST_CHECK(decode(decoder, "8286 84be 5886 a8eb 1064 9cbf") == second);
+
+  THttp2Headers third{{":method", "GET"},
+                      {":scheme", "https"},
+                      {":path", "/index.html"},
+                      {":authority", "www.example.com"},
+                      {"custom-key", "custom-value"}};
+  BOOST_CHECK(decode(decoder,
+                     "8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf")
+              == third);
+
+  // A repeated header list shrinks to its table indexes
+  string again;
+  encoder.encode(first, again);
+  BOOST_CHECK_EQUAL(again.size(), 4u);
+}
+
+BOOST_AUTO_TEST_CASE(test_hpack_huffman) {
+  string all;
+  for (int i = 0; i < 256; ++i) {
+    all += static_cast<char>(i);
+  }
+  string coded;
+  hpackHuffmanEncode(reinterpret_cast<const uint8_t*>(all.data()), all.size(), coded);
+  string decoded;
+  hpackHuffmanDecode(reinterpret_cast<const uint8_t*>(coded.data()), coded.size(), decoded);
+  BOOST_CHECK(decoded == all);
+
+  // EOS may not be coded, and padding must be shorter than a byte
+  string bad = unhex("ffffffff");
+  decoded.clear();
+  BOOST_CHECK_THROW(hpackHuffmanDecode(reinterpret_cast<const uint8_t*>(bad.data()),
+                                       bad.size(),
+                                       decoded),
+                    TTransportException);
+  bad = unhex("f1e3c2e5f23a6ba0ab90f4ffff");
+  decoded.clear();
+  BOOST_CHECK_THROW(hpackHuffmanDecode(reinterpret_cast<const uint8_t*>(bad.data()),
+                                       bad.size(),
+                                       decoded),
+                    TTransportException);
+
+  // An index past the end of the tables
+  THpackDecoder decoder;
+  BOOST_CHECK_THROW(decode(decoder, "ff00"), TTransportException);
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_calls_share_a_connection) {
+  Http2Server server;
+  shared_ptr<THttp2Connection> connection = server.connect();
+
+  const int threads = 8;
+  const int calls = 200;
+  std::vector<std::thread> clients;
+  std::atomic<int> failures(0);
+  for (int t = 0; t < threads; ++t) {
+    clients.emplace_back([&] {
+      try {
+        ParentServiceClient client = makeClient(connection);
+        for (int i = 0; i < calls; ++i) {
+          client.incrementGeneration();
+        }
+      } catch (const std::exception&) {
+        ++failures;
+      }
+    });
+  }
+  for (auto& client : clients) {
+    client.join();
+  }
+  BOOST_CHECK_EQUAL(failures, 0);
+  BOOST_CHECK_EQUAL(makeClient(connection).getGeneration(), threads * calls);
+}
+
+BOOST_AUTO_TEST_CASE(test_messages_larger_than_the_windows) {
+  Http2Server server;
+  shared_ptr<THttp2Connection> connection = server.connect();
+  ParentServiceClient client = makeClient(connection);
+
+  // Well past the 64KB initial windows and the 1MB stream windows
+  string big(3 * 1024 * 1024 + 17, 'q');
+  client.addString(big);
+  std::vector<string> strings;
+  client.getStrings(strings);
+  BOOST_REQUIRE_EQUAL(strings.size(), 1u);
+  BOOST_CHECK(strings[0] == big);
+
+  string data;
+  client.getDataWait(data, 5 * 1024 * 1024);
+  BOOST_CHECK_EQUAL(data.size(), 5u * 1024 * 1024);
+}
+
+BOOST_AUTO_TEST_CASE(test_oneway_and_own_connection) {
+  Http2Server server;
+  auto transport = make_shared<THttp2Client>("localhost", server.socket->getPort());
+  ParentServiceClient client(make_shared<TBinaryProtocol>(transport));
+  transport->open();
+
+  // The empty response to a oneway call is never read.  Streams are not
+  // ordered, so the oneway calls may still be running after the next one.
+  client.onewayWait();
+  client.onewayWait();
+  BOOST_CHECK_GE(client.incrementGeneration(), 1);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (client.getGeneration() != 3 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  BOOST_CHECK_EQUAL(client.getGeneration(), 3);
+  transport->close();
+  BOOST_CHECK(!transport->isOpen());
+}
+
+BOOST_AUTO_TEST_CASE(test_busy_server_refuses_streams) {
+  // One worker, and room for one more call in its queue
+  Http2Server server(1, 1);
+  shared_ptr<THttp2Connection> connection = server.connect();
+
+  std::thread blocked([&] {
+    string data;
+    makeClient(connection).getDataWait(data, -1);
+  });
+  server.handler->waitUntilBlocked();
+
+  std::atomic<int> refused(0);
+  std::vector<std::thread> clients;
+  for (int i = 0; i < 2; ++i) {
+    clients.emplace_back([&] {
+      try {
+        makeClient(connection).incrementGeneration();
+      } catch (const TTransportException& ex) {
+        if (string(ex.what()).find("error 7") != string::npos) {
+          ++refused;
+        }
+      }
+    });
+  }
+  // The refusal comes right away; the queued call waits for the worker
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (refused == 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  server.handler->release();
+  for (auto& client : clients) {
+    client.join();
+  }
+  blocked.join();
+  BOOST_CHECK_EQUAL(refused, 1);
+  BOOST_CHECK_EQUAL(makeClient(connection).getGeneration(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_http1_client_gets_goaway) {
+  Http2Server server;
+  TSocket socket("localhost", server.socket->getPort());
+  socket.open();
+  string request = "POST / HTTP/1.1\r\nContent-Length: 0\r\n\r\n";
+  socket.write(reinterpret_cast<const uint8_t*>(request.data()),
+               static_cast<uint32_t>(request.size()));
+
+  string received;
+  uint8_t buf[1024];
+  while (uint32_t got = socket.read(buf, sizeof(buf))) {
+    received.append(reinterpret_cast<char*>(buf), got);
+  }
+  // SETTINGS and a WINDOW_UPDATE, then GOAWAY(PROTOCOL_ERROR) and close
+  BOOST_REQUIRE_GE(received.size(), 17u);
+  string goaway = received.substr(received.size() - 17);
+  BOOST_CHECK_EQUAL(goaway[3], 0x7);
+  BOOST_CHECK_EQUAL(goaway[16], 0x1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
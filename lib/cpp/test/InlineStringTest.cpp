@@ -0,0 +1,136 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <sstream>
+#include <thrift/TToString.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/InlineStringTest_types.h"
+
+BOOST_AUTO_TEST_SUITE(InlineStringTest)
+
+using apache::thrift::TInlineString;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TMemoryBuffer;
+using thrift::test::inlinestring::InlineStrings;
+
+static InlineStrings makeInlineStrings() {
+  InlineStrings s;
+  s.key = "short";
+  s.__set_token(std::string("\0\1\2\3", 4));
+  s.tags.push_back("a");
+  s.tags.push_back(std::string(100, 'x'));
+  s.counts["one"] = 1;
+  s.counts["two"] = 2;
+  s.plain = "plain";
+  return s;
+}
+
+template <typename Protocol_>
+static void checkRoundTrip() {
+  InlineStrings in = makeInlineStrings();
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  std::shared_ptr<TProtocol> protocol(new Protocol_(buffer));
+  in.write(protocol.get());
+
+  InlineStrings out;
+  out.read(protocol.get());
+  BOOST_CHECK(out == in);
+  BOOST_CHECK(out.key.isInline());
+  BOOST_CHECK(!out.tags[1].isInline());
+  BOOST_CHECK_EQUAL(out.tags[1].size(), 100u);
+  BOOST_CHECK_EQUAL(out.token.size(), 4u);
+}
+
+BOOST_AUTO_TEST_CASE(test_inline_string) {
+  TInlineString s;
+  BOOST_CHECK(s.empty());
+  BOOST_CHECK(s.isInline());
+
+  s = "hello";
+  BOOST_CHECK(s == "hello");
+  BOOST_CHECK(s == std::string("hello"));
+  BOOST_CHECK(s.isInline());
+
+  std::string big(TInlineString::INLINE_CAPACITY + 1, 'y');
+  s = big;
+  BOOST_CHECK(!s.isInline());
+  BOOST_CHECK(s == big);
+
+  TInlineString moved(std::move(s));
+  BOOST_CHECK(moved == big);
+  BOOST_CHECK(s.empty());
+  BOOST_CHECK(s.isInline());
+
+  TInlineString copy(moved);
+  BOOST_CHECK(copy == moved);
+  copy = "abc";
+  BOOST_CHECK(copy < moved);
+  BOOST_CHECK_EQUAL(std::string(copy.c_str()), "abc");
+
+  std::ostringstream out;
+  out << copy;
+  BOOST_CHECK_EQUAL(out.str(), "abc");
+}
+
+BOOST_AUTO_TEST_CASE(test_generated_types) {
+  InlineStrings s;
+  BOOST_CHECK(s.defaulted == "default");
+  BOOST_CHECK(s.defaulted.isInline());
+  BOOST_CHECK_EQUAL(apache::thrift::to_string(makeInlineStrings().tags[0]), "a");
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_round_trip) {
+  checkRoundTrip<TBinaryProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_compact_round_trip) {
+  checkRoundTrip<TCompactProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_json_round_trip) {
+  // TJSONProtocol has no TInlineString support and uses the std::string fallback
+  checkRoundTrip<TJSONProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_wire_compatible) {
+  InlineStrings in = makeInlineStrings();
+  std::shared_ptr<TMemoryBuffer> inlineBuffer(new TMemoryBuffer());
+  TBinaryProtocol inlineProtocol(inlineBuffer);
+  in.write(&inlineProtocol);
+
+  // The same bytes come out of the std::string overloads
+  std::shared_ptr<TMemoryBuffer> stringBuffer(new TMemoryBuffer());
+  TBinaryProtocol stringProtocol(stringBuffer);
+  stringProtocol.writeString(in.key.str());
+  std::shared_ptr<TMemoryBuffer> keyBuffer(new TMemoryBuffer());
+  TBinaryProtocol keyProtocol(keyBuffer);
+  static_cast<TProtocol&>(keyProtocol).writeString(in.key);
+  BOOST_CHECK_EQUAL(stringBuffer->getBufferAsString(), keyBuffer->getBufferAsString());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,32 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+namespace cpp thrift.test.inlinestring
+
+typedef string (cpp.inline_string) ShortKey
+
+struct InlineStrings
+{
+  1: string (cpp.inline_string) key,
+  2: optional binary (cpp.inline_string) token,
+  3: list<string (cpp.inline_string)> tags,
+  4: map<ShortKey, i32> counts,
+  5: string plain,
+  6: ShortKey defaulted = "default",
+}
@@ -402,3 +402,72 @@ BOOST_AUTO_TEST_CASE(test_json_base64_padding_validation) {
   test_base64_padding("===");
   test_base64_padding("====");
 }
+
+// Strings are scanned a block at a time; put characters that need escaping
+// at every position around the block boundaries.
+BOOST_AUTO_TEST_CASE(test_json_string_escaping_blocks) {
+  const char specials[] = {'"', '\\', '\x01', '\n', '\x1f', ' ', '\x7f', '\xe9'};
+
+  for (char special : specials) {
+    for (size_t len = 1; len <= 40; ++len) {
+      for (size_t pos = 0; pos < len; ++pos) {
+        std::string value(len, 'a');
+        value[pos] = special;
+
+        std::string expected = "\"";
+        for (char ch : value) {
+          if (ch == '"' || ch == '\\') {
+            expected += '\\';
+            expected += ch;
+          } else if (ch == '\n') {
+            expected += "\\n";
+          } else if (ch == '\x01') {
+            expected += "\\u0001";
+          } else if (ch == '\x1f') {
+            expected += "\\u001f";
+          } else {
+            expected += ch;
+          }
+        }
+        expected += "\"";
+
+        std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+        std::shared_ptr<TJSONProtocol> proto(new TJSONProtocol(buffer));
+        BOOST_CHECK_EQUAL(expected.size(), proto->writeString(value));
+        BOOST_CHECK_EQUAL(expected, buffer->getBufferAsString());
+
+        std::string result;
+        BOOST_CHECK_EQUAL(expected.size(), proto->readString(result));
+        BOOST_CHECK_EQUAL(value, result);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_json_integer_limits) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  std::shared_ptr<TJSONProtocol> proto(new TJSONProtocol(buffer));
+
+  proto->writeListBegin(apache::thrift::protocol::T_I64, 4);
+  proto->writeI64((std::numeric_limits<int64_t>::min)());
+  proto->writeI64((std::numeric_limits<int64_t>::max)());
+  proto->writeI64(0);
+  proto->writeI64(-1);
+  proto->writeListEnd();
+  BOOST_CHECK_EQUAL("[\"i64\",4,-9223372036854775808,9223372036854775807,0,-1]",
+                    buffer->getBufferAsString());
+
+  apache::thrift::protocol::TType elemType;
+  uint32_t size;
+  int64_t val;
+  proto->readListBegin(elemType, size);
+  proto->readI64(val);
+  BOOST_CHECK_EQUAL((std::numeric_limits<int64_t>::min)(), val);
+  proto->readI64(val);
+  BOOST_CHECK_EQUAL((std::numeric_limits<int64_t>::max)(), val);
+  proto->readI64(val);
+  BOOST_CHECK_EQUAL(0, val);
+  proto->readI64(val);
+  BOOST_CHECK_EQUAL(-1, val);
+  proto->readListEnd();
+}
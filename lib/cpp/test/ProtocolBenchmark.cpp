@@ -0,0 +1,531 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Parameterized protocol/transport microbenchmarks.
+ *
+ * Every combination of protocol (binary, compact, json, header), transport
+ * stacked on a TMemoryBuffer (memory, framed, buffered, zlib) and payload
+ * shape is timed for both serialization and deserialization.  Each benchmark
+ * is run for a growing number of iterations until it takes at least
+ * --min_time seconds, and reports ns/op, bytes/s and heap allocations per
+ * op.  --format=json writes the same schema as Google Benchmark so that its
+ * compare tooling can be used to track regressions; --format=csv is also
+ * available.
+ */
+
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/THeaderProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TZlibTransport.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "gen-cpp/DebugProtoTest_types.h"
+#include "gen-cpp/Recursive_types.h"
+
+using namespace apache::thrift;
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::transport;
+using namespace thrift::test::debug;
+
+/*
+ * Heap allocation counting.  Replacing the global allocation functions in
+ * the executable also covers allocations made inside libthrift.
+ */
+static std::atomic<uint64_t> g_allocations(0);
+
+void* operator new(std::size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+  return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  std::free(p);
+}
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * A protocol stacked on a transport stacked on a TMemoryBuffer.
+ */
+struct Codec {
+  std::shared_ptr<TMemoryBuffer> memory;
+  std::shared_ptr<TProtocol> protocol;
+
+  Codec(const std::string& protocolName, const std::string& transportName)
+    : memory(new TMemoryBuffer()) {
+    std::shared_ptr<TTransport> transport;
+    if (transportName == "framed") {
+      transport = std::make_shared<TFramedTransport>(memory);
+    } else if (transportName == "buffered") {
+      transport = std::make_shared<TBufferedTransport>(memory);
+    } else if (transportName == "zlib") {
+      transport = std::make_shared<TZlibTransport>(memory);
+    } else {
+      transport = memory;
+    }
+
+    if (protocolName == "compact") {
+      protocol = std::make_shared<TCompactProtocol>(transport);
+    } else if (protocolName == "json") {
+      protocol = std::make_shared<TJSONProtocol>(transport);
+    } else if (protocolName == "header") {
+      protocol = std::make_shared<THeaderProtocol>(transport);
+    } else {
+      protocol = std::make_shared<TBinaryProtocol>(transport);
+    }
+  }
+
+  template <typename T>
+  void write(const T& value) {
+    memory->resetBuffer();
+    value.write(protocol.get());
+    // Flush through the whole stack, including THeaderProtocol's transport
+    protocol->getTransport()->flush();
+  }
+
+  std::string written() { return memory->getBufferAsString(); }
+
+  template <typename T>
+  void read(T& value, const std::string& bytes) {
+    memory->resetBuffer(reinterpret_cast<uint8_t*>(const_cast<char*>(bytes.data())),
+                        static_cast<uint32_t>(bytes.size()),
+                        TMemoryBuffer::OBSERVE);
+    value.read(protocol.get());
+  }
+};
+
+/**
+ * One benchmark: \c run(iterations) executes the operation that many times
+ * and \c bytes is the encoded size of one operation.
+ */
+struct Benchmark {
+  std::string name;
+  std::function<void(uint64_t)> run;
+  uint64_t bytes;
+};
+
+struct Result {
+  std::string name;
+  uint64_t iterations;
+  double nsPerOp;
+  double bytesPerSecond;
+  double allocsPerOp;
+};
+
+/**
+ * Registers write and read benchmarks of \p value for one protocol/transport
+ * combination.  Fails if the value does not survive a round trip.
+ */
+template <typename T>
+bool addBenchmarks(std::vector<Benchmark>& benchmarks,
+                   const std::string& protocolName,
+                   const std::string& transportName,
+                   const std::string& payloadName,
+                   const T& value) {
+  std::string suffix = "/" + protocolName + "/" + transportName + "/" + payloadName;
+
+  // Stateful transports (zlib, header) encode the first message of a stream
+  // differently from later ones, so keep one of each for the reader.
+  auto writer = std::make_shared<Codec>(protocolName, transportName);
+  writer->write(value);
+  auto first = std::make_shared<std::string>(writer->written());
+  writer->write(value);
+  auto steady = std::make_shared<std::string>(writer->written());
+
+  auto reader = std::make_shared<Codec>(protocolName, transportName);
+  T check;
+  reader->read(check, *first);
+  bool ok = check == value;
+  for (int i = 0; ok && i < 2; ++i) {
+    T again;
+    reader->read(again, *steady);
+    ok = again == value;
+  }
+  if (!ok) {
+    std::cerr << "round trip mismatch for" << suffix << '\n';
+    return false;
+  }
+
+  auto payload = std::make_shared<T>(value);
+  Benchmark write;
+  write.name = "BM_Write" + suffix;
+  write.bytes = steady->size();
+  write.run = [writer, payload](uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; ++i) {
+      writer->write(*payload);
+    }
+  };
+  benchmarks.push_back(write);
+
+  Benchmark read;
+  read.name = "BM_Read" + suffix;
+  read.bytes = steady->size();
+  read.run = [reader, steady](uint64_t iterations) {
+    T out;
+    for (uint64_t i = 0; i < iterations; ++i) {
+      reader->read(out, *steady);
+    }
+  };
+  benchmarks.push_back(read);
+  return true;
+}
+
+/**
+ * Grows the iteration count until one run takes at least \p minTime seconds,
+ * the way Google Benchmark does.
+ */
+Result measure(const Benchmark& benchmark, double minTime) {
+  uint64_t iterations = 1;
+  for (;;) {
+    uint64_t allocsBefore = g_allocations.load(std::memory_order_relaxed);
+    Clock::time_point start = Clock::now();
+    benchmark.run(iterations);
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    uint64_t allocs = g_allocations.load(std::memory_order_relaxed) - allocsBefore;
+
+    if (elapsed >= minTime || iterations >= 1000000000) {
+      Result result;
+      result.name = benchmark.name;
+      result.iterations = iterations;
+      result.nsPerOp = elapsed * 1e9 / iterations;
+      result.bytesPerSecond = elapsed > 0 ? benchmark.bytes * iterations / elapsed : 0;
+      result.allocsPerOp = static_cast<double>(allocs) / iterations;
+      return result;
+    }
+
+    // Aim 40% past the target, growing at most tenfold per round
+    double multiplier = elapsed > 0 ? minTime * 1.4 / elapsed : 10.0;
+    multiplier = (std::min)(10.0, (std::max)(multiplier, 2.0));
+    iterations = static_cast<uint64_t>(std::ceil(iterations * multiplier));
+  }
+}
+
+/*
+ * Payload shapes.
+ */
+
+OneOfEach makeOneOfEach() {
+  OneOfEach ooe;
+  ooe.im_true = true;
+  ooe.im_false = false;
+  ooe.a_bite = 0x7f;
+  ooe.integer16 = 27000;
+  ooe.integer32 = 1 << 24;
+  ooe.integer64 = (uint64_t)6000 * 1000 * 1000;
+  ooe.double_precision = 3.14159265358979;
+  ooe.some_characters = "JSON THIS! \"\1";
+  ooe.zomg_unicode = "\xd7\n\a\t";
+  ooe.base64 = "\1\2\3\255";
+  ooe.rfc4122_uuid = apache::thrift::TUuid{"{5e2ab188-1726-4e75-a04f-1ed9a6a89c4c}"};
+  return ooe;
+}
+
+// Many fields of every type, each collection holding a few elements
+CompactProtoTestStruct makeWide() {
+  CompactProtoTestStruct s;
+  s.a_byte = 127;
+  s.a_i16 = 32000;
+  s.a_i32 = 1000000000;
+  s.a_i64 = 0xffffffffffLL;
+  s.a_double = 5.6789;
+  s.a_string = "my string";
+  s.a_binary = std::string("\0\1\2\3\4\5\6\7\x08", 9);
+  s.true_field = true;
+  s.false_field = false;
+  for (int8_t i = 0; i < 8; ++i) {
+    s.byte_list.push_back(i);
+    s.i16_list.push_back(i * 1000);
+    s.i32_list.push_back(i * 100000);
+    s.i64_list.push_back(i * 10000000000LL);
+    s.double_list.push_back(i * 0.5);
+    s.string_list.push_back("string " + std::to_string(i));
+    s.binary_list.push_back(std::string(4, static_cast<char>(i)));
+    s.boolean_list.push_back(i % 2 == 0);
+    s.byte_set.insert(i);
+    s.i16_set.insert(i * 1000);
+    s.i32_set.insert(i * 100000);
+    s.i64_set.insert(i * 10000000000LL);
+    s.double_set.insert(i * 0.5);
+    s.string_set.insert("string " + std::to_string(i));
+    s.binary_set.insert(std::string(4, static_cast<char>(i)));
+    s.byte_byte_map[i] = i;
+    s.i16_byte_map[i * 1000] = i;
+    s.i32_byte_map[i * 100000] = i;
+    s.i64_byte_map[i * 10000000000LL] = i;
+    s.double_byte_map[i * 0.5] = i;
+    s.string_byte_map["string " + std::to_string(i)] = i;
+    s.binary_byte_map[std::string(4, static_cast<char>(i))] = i;
+    s.byte_i16_map[i] = i * 1000;
+    s.byte_i32_map[i] = i * 100000;
+    s.byte_i64_map[i] = i * 10000000000LL;
+    s.byte_double_map[i] = i * 0.5;
+    s.byte_string_map[i] = "string " + std::to_string(i);
+    s.byte_binary_map[i] = std::string(4, static_cast<char>(i));
+    s.byte_boolean_map[i] = i % 2 == 0;
+  }
+  s.boolean_set.insert(true);
+  s.boolean_set.insert(false);
+  s.boolean_byte_map[true] = 1;
+  s.boolean_byte_map[false] = 0;
+  s.struct_list.resize(2);
+  s.struct_set.insert(Empty());
+  s.field500 = 500;
+  s.field5000 = 5000;
+  s.field20000 = 20000;
+  return s;
+}
+
+// A binary tree of the given depth
+RecTree makeTree(int depth) {
+  RecTree tree;
+  tree.item = static_cast<int16_t>(depth);
+  if (depth > 1) {
+    tree.children.push_back(makeTree(depth - 1));
+    tree.children.push_back(makeTree(depth - 1));
+  }
+  return tree;
+}
+
+ListDoublePerf makeBigList() {
+  ListDoublePerf list;
+  for (int i = 0; i < 4096; ++i) {
+    list.field.push_back(i * 1.5);
+  }
+  return list;
+}
+
+// String keyed map of lists of structs
+HolyMoley makeMapHeavy() {
+  HolyMoley hm;
+  for (int i = 0; i < 256; ++i) {
+    std::vector<Bonk> bonks(2);
+    bonks[0].type = i;
+    bonks[0].message = "bonk " + std::to_string(i);
+    bonks[1].type = -i;
+    bonks[1].message = "knob";
+    hm.bonks["key " + std::to_string(i)] = bonks;
+  }
+  return hm;
+}
+
+OneOfEach makeBlobHeavy() {
+  OneOfEach ooe = makeOneOfEach();
+  ooe.base64.resize(64 * 1024);
+  for (size_t i = 0; i < ooe.base64.size(); ++i) {
+    ooe.base64[i] = static_cast<char>(i * 7);
+  }
+  return ooe;
+}
+
+std::string jsonEscape(const std::string& s) {
+  std::string out;
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+    }
+    out += c;
+  }
+  return out;
+}
+
+const int kNameWidth = 40;
+
+void printConsoleHeader() {
+  printf("%-*s %14s %12s %14s %12s\n", kNameWidth, "Benchmark", "Time", "Iterations",
+         "Bytes/s", "Allocs/op");
+}
+
+void printConsole(const Result& r) {
+  printf("%-*s %11.0f ns %12llu %12.1fM/s %12.2f\n", kNameWidth, r.name.c_str(), r.nsPerOp,
+         static_cast<unsigned long long>(r.iterations), r.bytesPerSecond / 1048576.0,
+         r.allocsPerOp);
+  fflush(stdout);
+}
+
+void printCsv(const std::vector<Result>& results) {
+  printf("name,iterations,real_time,cpu_time,time_unit,bytes_per_second,allocs_per_op\n");
+  for (const Result& r : results) {
+    printf("\"%s\",%llu,%.2f,%.2f,ns,%.0f,%.3f\n", r.name.c_str(),
+           static_cast<unsigned long long>(r.iterations), r.nsPerOp, r.nsPerOp, r.bytesPerSecond,
+           r.allocsPerOp);
+  }
+}
+
+void printJson(const std::vector<Result>& results) {
+  char date[64];
+  time_t now = time(nullptr);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+  printf("{\n  \"context\": {\n");
+  printf("    \"date\": \"%s\",\n", date);
+#ifdef NDEBUG
+  printf("    \"library_build_type\": \"release\"\n");
+#else
+  printf("    \"library_build_type\": \"debug\"\n");
+#endif
+  printf("  },\n  \"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    printf("    {\n");
+    printf("      \"name\": \"%s\",\n", jsonEscape(r.name).c_str());
+    printf("      \"run_name\": \"%s\",\n", jsonEscape(r.name).c_str());
+    printf("      \"run_type\": \"iteration\",\n");
+    printf("      \"iterations\": %llu,\n", static_cast<unsigned long long>(r.iterations));
+    printf("      \"real_time\": %.4f,\n", r.nsPerOp);
+    printf("      \"cpu_time\": %.4f,\n", r.nsPerOp);
+    printf("      \"time_unit\": \"ns\",\n");
+    printf("      \"bytes_per_second\": %.4f,\n", r.bytesPerSecond);
+    printf("      \"allocs_per_op\": %.4f\n", r.allocsPerOp);
+    printf("    }%s\n", i + 1 < results.size() ? "," : "");
+  }
+  printf("  ]\n}\n");
+}
+
+void usage(const char* argv0) {
+  std::cerr << argv0 << " [--filter=<substring>] [--min_time=<seconds>] "
+                        "[--format=console|json|csv] [--list]\n"
+            << "\tfilter     Only run benchmarks whose name contains the substring\n"
+            << "\tmin_time   Minimum seconds per benchmark.  Default is 0.5\n"
+            << "\tformat     Output format.  Default is console\n"
+            << "\tlist       Print the benchmark names and exit\n";
+}
+}
+
+int main(int argc, char** argv) {
+  std::string filter;
+  std::string format = "console";
+  double minTime = 0.5;
+  bool list = false;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if (arg.compare(0, 9, "--filter=") == 0) {
+      filter = arg.substr(9);
+    } else if (arg.compare(0, 11, "--min_time=") == 0) {
+      minTime = atof(arg.substr(11).c_str());
+    } else if (arg.compare(0, 9, "--format=") == 0) {
+      format = arg.substr(9);
+    } else if (arg == "--list") {
+      list = true;
+    } else {
+      usage(argv[0]);
+      return arg == "--help" ? 0 : 1;
+    }
+  }
+  if (format != "console" && format != "json" && format != "csv") {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const OneOfEach small = makeOneOfEach();
+  const CompactProtoTestStruct wide = makeWide();
+  const RecTree deep = makeTree(10);
+  const ListDoublePerf bigList = makeBigList();
+  const HolyMoley mapHeavy = makeMapHeavy();
+  const OneOfEach blobHeavy = makeBlobHeavy();
+
+  const char* protocols[] = {"binary", "compact", "json", "header"};
+  const char* transports[] = {"memory", "framed", "buffered", "zlib"};
+
+  std::vector<Benchmark> benchmarks;
+  bool ok = true;
+  for (const char* p : protocols) {
+    for (const char* t : transports) {
+      ok &= addBenchmarks(benchmarks, p, t, "small", small);
+      ok &= addBenchmarks(benchmarks, p, t, "wide", wide);
+      ok &= addBenchmarks(benchmarks, p, t, "deep", deep);
+      ok &= addBenchmarks(benchmarks, p, t, "list", bigList);
+      ok &= addBenchmarks(benchmarks, p, t, "map", mapHeavy);
+      ok &= addBenchmarks(benchmarks, p, t, "blob", blobHeavy);
+    }
+  }
+  if (!ok) {
+    return 1;
+  }
+
+  std::vector<Result> results;
+  if (format == "console" && !list) {
+    printConsoleHeader();
+  }
+  for (const Benchmark& benchmark : benchmarks) {
+    if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    if (list) {
+      printf("%s\n", benchmark.name.c_str());
+      continue;
+    }
+    results.push_back(measure(benchmark, minTime));
+    if (format == "console") {
+      printConsole(results.back());
+    }
+  }
+
+  if (format == "json") {
+    printJson(results);
+  } else if (format == "csv") {
+    printCsv(results);
+  }
+  return 0;
+}
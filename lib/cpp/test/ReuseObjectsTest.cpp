@@ -0,0 +1,161 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/ReuseObjectsTest_types.h"
+
+BOOST_AUTO_TEST_SUITE(ReuseObjectsTest)
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::transport::TMemoryBuffer;
+using thrift::test::reuse::Batch;
+using thrift::test::reuse::Point;
+
+// Longer than any small string buffer
+static std::string longString(char c) {
+  return std::string(64, c);
+}
+
+static Batch makeBatch(int n, bool labels) {
+  Batch b;
+  b.id = n;
+  b.name = longString('n');
+  for (int i = 0; i < n; ++i) {
+    b.names.push_back(longString('a' + i));
+    Point p;
+    p.x = i;
+    if (labels) {
+      p.__set_label(longString('l'));
+    }
+    b.points.push_back(p);
+    b.rows.push_back(std::vector<int32_t>(n, i));
+    b.tags.insert(longString('t' + i));
+    b.counts[longString('c' + i)] = i;
+  }
+  if (labels) {
+    b.__set_payload(longString('p'));
+  }
+  b.origin.x = -1;
+  return b;
+}
+
+template <typename Protocol_>
+static void serialize(const Batch& b, std::shared_ptr<TMemoryBuffer>& buffer) {
+  buffer.reset(new TMemoryBuffer());
+  Protocol_ protocol(buffer);
+  b.write(&protocol);
+}
+
+template <typename Protocol_>
+static void deserialize(Batch& b, const std::shared_ptr<TMemoryBuffer>& buffer) {
+  Protocol_ protocol(buffer);
+  b.read(&protocol);
+}
+
+template <typename Protocol_>
+static void checkRoundTrip() {
+  std::shared_ptr<TMemoryBuffer> buffer;
+  Batch in = makeBatch(4, true);
+  serialize<Protocol_>(in, buffer);
+
+  Batch out;
+  deserialize<Protocol_>(out, buffer);
+  BOOST_CHECK(out == in);
+  BOOST_CHECK(out.__isset.payload);
+  BOOST_CHECK(out.points[2].__isset.label);
+}
+
+BOOST_AUTO_TEST_CASE(test_round_trip) {
+  checkRoundTrip<TBinaryProtocol>();
+  checkRoundTrip<TCompactProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_storage_is_reused) {
+  std::shared_ptr<TMemoryBuffer> first;
+  std::shared_ptr<TMemoryBuffer> second;
+  serialize<TBinaryProtocol>(makeBatch(4, true), first);
+  serialize<TBinaryProtocol>(makeBatch(4, true), second);
+
+  Batch b;
+  deserialize<TBinaryProtocol>(b, first);
+  const void* names = b.names.data();
+  const void* name0 = b.names[0].data();
+  const void* points = b.points.data();
+  const void* label = b.points[1].label.data();
+  const void* row = b.rows[3].data();
+  const void* name = b.name.data();
+
+  deserialize<TBinaryProtocol>(b, second);
+  BOOST_CHECK(b == makeBatch(4, true));
+  BOOST_CHECK_EQUAL(names, static_cast<const void*>(b.names.data()));
+  BOOST_CHECK_EQUAL(name0, static_cast<const void*>(b.names[0].data()));
+  BOOST_CHECK_EQUAL(points, static_cast<const void*>(b.points.data()));
+  BOOST_CHECK_EQUAL(label, static_cast<const void*>(b.points[1].label.data()));
+  BOOST_CHECK_EQUAL(row, static_cast<const void*>(b.rows[3].data()));
+  BOOST_CHECK_EQUAL(name, static_cast<const void*>(b.name.data()));
+}
+
+BOOST_AUTO_TEST_CASE(test_shrink_and_grow) {
+  std::shared_ptr<TMemoryBuffer> big;
+  std::shared_ptr<TMemoryBuffer> small;
+  serialize<TCompactProtocol>(makeBatch(5, true), big);
+  serialize<TCompactProtocol>(makeBatch(2, true), small);
+
+  Batch b;
+  deserialize<TCompactProtocol>(b, big);
+  size_t capacity = b.names.capacity();
+
+  deserialize<TCompactProtocol>(b, small);
+  BOOST_CHECK(b == makeBatch(2, true));
+  BOOST_CHECK_EQUAL(capacity, b.names.capacity());
+
+  serialize<TCompactProtocol>(makeBatch(5, true), big);
+  deserialize<TCompactProtocol>(b, big);
+  BOOST_CHECK(b == makeBatch(5, true));
+}
+
+BOOST_AUTO_TEST_CASE(test_absent_fields_unset) {
+  std::shared_ptr<TMemoryBuffer> labelled;
+  std::shared_ptr<TMemoryBuffer> plain;
+  serialize<TBinaryProtocol>(makeBatch(3, true), labelled);
+  serialize<TBinaryProtocol>(makeBatch(3, false), plain);
+
+  // Elements decoded over old ones must not keep their optional fields
+  Batch b;
+  deserialize<TBinaryProtocol>(b, labelled);
+  deserialize<TBinaryProtocol>(b, plain);
+  BOOST_CHECK(!b.__isset.payload);
+  for (size_t i = 0; i < b.points.size(); ++i) {
+    BOOST_CHECK(!b.points[i].__isset.label);
+  }
+  BOOST_CHECK(b == makeBatch(3, false));
+
+  // ... and writing it out again carries none of them
+  std::shared_ptr<TMemoryBuffer> copy;
+  serialize<TBinaryProtocol>(b, copy);
+  serialize<TBinaryProtocol>(makeBatch(3, false), plain);
+  BOOST_CHECK_EQUAL(plain->getBufferAsString(), copy->getBufferAsString());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
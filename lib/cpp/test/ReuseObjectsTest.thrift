@@ -0,0 +1,40 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+// Generated with cpp:reuse_objects, see ReuseObjectsTest.cpp
+namespace cpp thrift.test.reuse
+
+struct Point
+{
+  1: i32 x,
+  2: optional string label,
+}
+
+struct Batch
+{
+  1: i64 id,
+  2: string name,
+  3: list<string> names,
+  4: list<Point> points,
+  5: list<list<i32>> rows,
+  6: set<string> tags,
+  7: map<string, i32> counts,
+  8: optional binary payload,
+  9: Point origin,
+}
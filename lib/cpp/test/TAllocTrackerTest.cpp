@@ -0,0 +1,182 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <stdexcept>
+#include <thrift/TAllocTracker.h>
+#include <thrift/TAllocTrackerNew.h>
+#include <thrift/processor/TAllocTrackingEventHandler.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/OneWayService.h"
+
+using apache::thrift::TAllocCounts;
+using apache::thrift::TAllocScope;
+using apache::thrift::TAllocTracker;
+using apache::thrift::processor::TAllocMethodStats;
+using apache::thrift::processor::TAllocTrackingEventHandler;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TMemoryBuffer;
+using onewaytest::OneWayServiceClient;
+using onewaytest::OneWayServiceIf;
+using onewaytest::OneWayServiceProcessor;
+
+BOOST_AUTO_TEST_SUITE(TAllocTrackerTest)
+
+namespace {
+
+// Makes one known heap allocation per call, or throws.  The block is kept
+// so that the compiler cannot leave the allocation out.
+class AllocatingHandler : public OneWayServiceIf {
+public:
+  AllocatingHandler() : fail(false) {}
+  void roundTripRPC() override {
+    block.reset(new char[1000]);
+    if (fail) {
+      throw std::runtime_error("fail");
+    }
+  }
+  void oneWayRPC() override { block.reset(new char[1000]); }
+  bool fail;
+  std::unique_ptr<char[]> block;
+};
+
+struct Fixture {
+  explicit Fixture(uint32_t responseSize = TMemoryBuffer::defaultSize)
+    : request(new TMemoryBuffer()),
+      response(new TMemoryBuffer(responseSize)),
+      requestProtocol(new TBinaryProtocol(request)),
+      responseProtocol(new TBinaryProtocol(response)),
+      handler(new AllocatingHandler()),
+      processor(new OneWayServiceProcessor(handler)),
+      tracker(new TAllocTrackingEventHandler()),
+      client(responseProtocol, requestProtocol) {
+    processor->setEventHandler(tracker);
+  }
+
+  bool process() { return processor->process(requestProtocol, responseProtocol, nullptr); }
+
+  std::shared_ptr<TMemoryBuffer> request;
+  std::shared_ptr<TMemoryBuffer> response;
+  std::shared_ptr<TProtocol> requestProtocol;
+  std::shared_ptr<TProtocol> responseProtocol;
+  std::shared_ptr<AllocatingHandler> handler;
+  std::shared_ptr<OneWayServiceProcessor> processor;
+  std::shared_ptr<TAllocTrackingEventHandler> tracker;
+  OneWayServiceClient client;
+};
+}
+
+BOOST_AUTO_TEST_CASE(test_alloc_scope) {
+#ifdef THRIFT_ALLOC_TRACKING
+  // This file includes TAllocTrackerNew.h, so counting must be on
+  BOOST_REQUIRE(TAllocTracker::enabled());
+#endif
+  TAllocScope scope;
+  std::unique_ptr<char[]> block(new char[100]);
+  TAllocCounts counts = scope.counts();
+  if (TAllocTracker::enabled()) {
+    BOOST_CHECK_EQUAL(1u, counts.allocations);
+    BOOST_CHECK_EQUAL(100u, counts.bytes);
+  } else {
+    BOOST_CHECK_EQUAL(0u, counts.allocations);
+    BOOST_CHECK_EQUAL(0u, counts.bytes);
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(test_alloc_tracking_phases, Fixture) {
+  for (int i = 0; i < 3; ++i) {
+    client.send_roundTripRPC();
+    BOOST_CHECK(process());
+    client.recv_roundTripRPC();
+  }
+  client.send_oneWayRPC();
+  BOOST_CHECK(process());
+
+  TAllocTrackingEventHandler::stats_t stats = tracker->getStats();
+  BOOST_REQUIRE_EQUAL(2u, stats.size());
+  const TAllocMethodStats& roundTrip = stats["OneWayService.roundTripRPC"];
+  const TAllocMethodStats& oneWay = stats["OneWayService.oneWayRPC"];
+  BOOST_CHECK_EQUAL(3u, roundTrip.calls);
+  BOOST_CHECK_EQUAL(1u, oneWay.calls);
+  BOOST_CHECK_EQUAL(0u, roundTrip.overBudget);
+
+  using apache::thrift::processor::T_ALLOC_DISPATCH;
+  if (TAllocTracker::enabled()) {
+    BOOST_CHECK_GE(roundTrip.phases[T_ALLOC_DISPATCH].allocations, 3u);
+    BOOST_CHECK_GE(roundTrip.phases[T_ALLOC_DISPATCH].bytes, 3000u);
+    BOOST_CHECK_GE(oneWay.phases[T_ALLOC_DISPATCH].bytes, 1000u);
+  } else {
+    BOOST_CHECK_EQUAL(0u, roundTrip.total().allocations);
+    BOOST_CHECK_EQUAL(0u, oneWay.total().allocations);
+  }
+
+  tracker->reset();
+  BOOST_CHECK(tracker->getStats().empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(test_alloc_tracking_budget, Fixture) {
+  std::vector<std::string> reported;
+  tracker->setBudgetCallback(
+      [&reported](const std::string& method, const TAllocCounts&) { reported.push_back(method); });
+  tracker->setBudget("", 0);
+  tracker->setBudget("OneWayService.oneWayRPC", 1000000);
+
+  handler->fail = true;
+  client.send_roundTripRPC();
+  BOOST_CHECK(process());
+  BOOST_CHECK_THROW(client.recv_roundTripRPC(), apache::thrift::TApplicationException);
+  client.send_oneWayRPC();
+  BOOST_CHECK(process());
+
+  TAllocTrackingEventHandler::stats_t stats = tracker->getStats();
+  BOOST_CHECK_EQUAL(1u, stats["OneWayService.roundTripRPC"].calls);
+  BOOST_CHECK_EQUAL(0u, stats["OneWayService.oneWayRPC"].overBudget);
+  if (TAllocTracker::enabled()) {
+    BOOST_CHECK_EQUAL(1u, stats["OneWayService.roundTripRPC"].overBudget);
+    BOOST_REQUIRE_EQUAL(1u, reported.size());
+    BOOST_CHECK_EQUAL("OneWayService.roundTripRPC", reported[0]);
+  } else {
+    BOOST_CHECK_EQUAL(0u, stats["OneWayService.roundTripRPC"].overBudget);
+    BOOST_CHECK(reported.empty());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_alloc_tracking_buffer_growth) {
+  // Writing the reply grows the one byte response buffer with realloc(),
+  // which operator new does not see
+  Fixture f(1);
+  f.client.send_roundTripRPC();
+  BOOST_CHECK(f.process());
+  uint32_t replySize = f.response->available_read();
+  f.client.recv_roundTripRPC();
+
+  using apache::thrift::processor::T_ALLOC_WRITE;
+  TAllocTrackingEventHandler::stats_t all = f.tracker->getStats();
+  const TAllocMethodStats& stats = all["OneWayService.roundTripRPC"];
+  if (TAllocTracker::enabled()) {
+    BOOST_CHECK_GE(stats.phases[T_ALLOC_WRITE].allocations, 1u);
+    BOOST_CHECK_GE(stats.phases[T_ALLOC_WRITE].bytes, replySize);
+  } else {
+    BOOST_CHECK_EQUAL(0u, stats.phases[T_ALLOC_WRITE].allocations);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
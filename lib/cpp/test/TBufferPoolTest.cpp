@@ -0,0 +1,108 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+#include <thrift/server/TBufferPool.h>
+
+using apache::thrift::server::TBufferPool;
+
+BOOST_AUTO_TEST_SUITE(TBufferPoolTest)
+
+BOOST_AUTO_TEST_CASE(test_size_classes) {
+  TBufferPool pool(0, 1 << 20, 100, 4096);
+  uint32_t capacity;
+
+  uint8_t* small = pool.borrow(1, &capacity);
+  BOOST_CHECK_EQUAL(128u, capacity);
+  pool.giveBack(small, capacity, capacity);
+
+  uint8_t* medium = pool.borrow(1000, &capacity);
+  BOOST_CHECK_EQUAL(1024u, capacity);
+  BOOST_CHECK_EQUAL(1024u, pool.getOutstandingBytes());
+  pool.giveBack(medium, capacity, capacity);
+
+  // Above the largest class buffers are exact and not pooled
+  uint8_t* large = pool.borrow(5000, &capacity);
+  BOOST_CHECK_EQUAL(5000u, capacity);
+  pool.giveBack(large, capacity, capacity);
+
+  BOOST_CHECK_EQUAL(0u, pool.getOutstandingBytes());
+  BOOST_CHECK_EQUAL(128u + 1024u, pool.getPooledBytes());
+  BOOST_CHECK_EQUAL(0u, pool.getReuseCount());
+}
+
+BOOST_AUTO_TEST_CASE(test_reuse) {
+  TBufferPool pool;
+  uint32_t capacity;
+  uint8_t* first = pool.borrow(300, &capacity);
+  pool.giveBack(first, capacity, capacity);
+
+  uint8_t* second = pool.borrow(400, &capacity);
+  BOOST_CHECK(first == second);
+  BOOST_CHECK_EQUAL(1u, pool.getReuseCount());
+  BOOST_CHECK_EQUAL(0u, pool.getPooledBytes());
+
+  // A buffer grown with realloc() goes back into the class it now fits
+  auto* grown = static_cast<uint8_t*>(std::realloc(second, 4096));
+  BOOST_REQUIRE(grown != nullptr);
+  pool.giveBack(grown, capacity, 4096);
+  BOOST_CHECK_EQUAL(0u, pool.getOutstandingBytes());
+  BOOST_CHECK_EQUAL(4096u, pool.getPooledBytes());
+  BOOST_CHECK(pool.borrow(4000, &capacity) == grown);
+  pool.giveBack(grown, capacity, capacity);
+
+  pool.trim();
+  BOOST_CHECK_EQUAL(0u, pool.getPooledBytes());
+}
+
+BOOST_AUTO_TEST_CASE(test_max_pooled_bytes) {
+  TBufferPool pool(0, 1024);
+  uint32_t a, b;
+  uint8_t* first = pool.borrow(1024, &a);
+  uint8_t* second = pool.borrow(1024, &b);
+  pool.giveBack(first, a, a);
+  pool.giveBack(second, b, b);
+  BOOST_CHECK_EQUAL(1024u, pool.getPooledBytes());
+}
+
+BOOST_AUTO_TEST_CASE(test_memory_limit) {
+  TBufferPool pool(2048);
+  uint32_t a, b, c;
+
+  // The first borrow always succeeds, even beyond the limit
+  uint8_t* first = pool.borrow(4096, &a, true);
+  BOOST_REQUIRE(first != nullptr);
+  BOOST_CHECK(pool.borrow(256, &b, true) == nullptr);
+  BOOST_CHECK_EQUAL(1u, pool.getDeferredCount());
+
+  // Borrows that may not be deferred ignore the limit
+  uint8_t* second = pool.borrow(256, &b);
+  BOOST_REQUIRE(second != nullptr);
+  BOOST_CHECK_EQUAL(4096u + 256u, pool.getOutstandingBytes());
+
+  pool.giveBack(first, a, a);
+  uint8_t* third = pool.borrow(1024, &c, true);
+  BOOST_CHECK(third != nullptr);
+  pool.giveBack(second, b, b);
+  pool.giveBack(third, c, c);
+  BOOST_CHECK_EQUAL(0u, pool.getOutstandingBytes());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,246 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <functional>
+#include <queue>
+#include <vector>
+#include <thrift/TApplicationException.h>
+#include <thrift/processor/TConcurrencyLimitProcessor.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/server/TConcurrencyLimiter.h>
+#include <thrift/transport/TBufferTransports.h>
+
+using apache::thrift::TApplicationException;
+using apache::thrift::TProcessor;
+using apache::thrift::processor::TConcurrencyLimitProcessor;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TMessageType;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::server::TConcurrencyLimiter;
+using apache::thrift::transport::TMemoryBuffer;
+using std::chrono::nanoseconds;
+
+namespace {
+
+/**
+ * Drives a limiter with a synthetic handler that serves `capacity` calls at
+ * once in `serviceTime` each; calls beyond that share the handler, so their
+ * latency grows with the number in flight.  Calls arrive at `overload` times
+ * the rate the handler can sustain.
+ *
+ * @return the average limit over the second half of the run.
+ */
+double simulate(TConcurrencyLimiter& limiter,
+                uint32_t capacity,
+                double overload,
+                int64_t serviceTime = 1000000) {
+  const auto interval = static_cast<int64_t>(serviceTime / (capacity * overload));
+  const int arrivals = 200000;
+
+  typedef std::pair<int64_t, int64_t> Completion; // time, latency
+  std::priority_queue<Completion, std::vector<Completion>, std::greater<Completion> > running;
+  double limitSum = 0;
+  int limitSamples = 0;
+
+  for (int i = 0; i < arrivals; ++i) {
+    int64_t now = i * interval;
+    while (!running.empty() && running.top().first <= now) {
+      limiter.release(nanoseconds(running.top().second));
+      running.pop();
+    }
+    if (limiter.tryAcquire()) {
+      uint32_t inFlight = limiter.getInFlight();
+      int64_t latency = inFlight > capacity ? serviceTime * inFlight / capacity : serviceTime;
+      running.push(Completion(now + latency, latency));
+    }
+    if (i >= arrivals / 2) {
+      limitSum += limiter.getLimit();
+      ++limitSamples;
+    }
+  }
+  while (!running.empty()) {
+    limiter.release(nanoseconds(running.top().second));
+    running.pop();
+  }
+  return limitSum / limitSamples;
+}
+
+// Writes a call to `method` with no arguments
+void writeCall(TProtocol& protocol, const std::string& method, TMessageType type) {
+  protocol.writeMessageBegin(method, type, 7);
+  protocol.writeStructBegin("args");
+  protocol.writeFieldStop();
+  protocol.writeStructEnd();
+  protocol.writeMessageEnd();
+  protocol.getTransport()->writeEnd();
+}
+
+// Answers every call with an empty reply, without dispatchMessage()
+class EchoProcessor : public TProcessor {
+public:
+  EchoProcessor() : calls(0) {}
+
+  bool process(std::shared_ptr<TProtocol> in,
+               std::shared_ptr<TProtocol> out,
+               void* connectionContext) override {
+    (void)connectionContext;
+    std::string fname;
+    TMessageType mtype;
+    int32_t seqid;
+    in->readMessageBegin(fname, mtype, seqid);
+    in->skip(apache::thrift::protocol::T_STRUCT);
+    in->readMessageEnd();
+    ++calls;
+    out->writeMessageBegin(fname, apache::thrift::protocol::T_REPLY, seqid);
+    out->writeStructBegin("result");
+    out->writeFieldStop();
+    out->writeStructEnd();
+    out->writeMessageEnd();
+    return true;
+  }
+
+  int calls;
+};
+}
+
+BOOST_AUTO_TEST_SUITE(TConcurrencyLimiterTest)
+
+BOOST_AUTO_TEST_CASE(test_acquire_release) {
+  TConcurrencyLimiter limiter(TConcurrencyLimiter::AIMD, 2);
+  BOOST_CHECK(limiter.tryAcquire());
+  BOOST_CHECK(limiter.tryAcquire());
+  BOOST_CHECK(!limiter.tryAcquire());
+  BOOST_CHECK_EQUAL(2u, limiter.getInFlight());
+  BOOST_CHECK_EQUAL(1u, limiter.getRejectedCount());
+
+  limiter.release(nanoseconds(1000));
+  BOOST_CHECK_EQUAL(1u, limiter.getInFlight());
+  BOOST_CHECK(limiter.tryAcquire());
+}
+
+BOOST_AUTO_TEST_CASE(test_gradient_converges) {
+  TConcurrencyLimiter limiter(TConcurrencyLimiter::GRADIENT, 100);
+  double limit = simulate(limiter, 10, 3);
+  BOOST_TEST_MESSAGE("gradient limit " << limit);
+  BOOST_CHECK_GT(limit, 10.0);
+  BOOST_CHECK_LT(limit, 40.0);
+  BOOST_CHECK_GT(limiter.getRejectedCount(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_gradient_grows) {
+  // Starting far below the handler's capacity
+  TConcurrencyLimiter limiter(TConcurrencyLimiter::GRADIENT, 2);
+  double limit = simulate(limiter, 50, 3);
+  BOOST_TEST_MESSAGE("gradient limit " << limit);
+  BOOST_CHECK_GT(limit, 50.0);
+  BOOST_CHECK_LT(limit, 150.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_gradient_slower_handler) {
+  TConcurrencyLimiter limiter(TConcurrencyLimiter::GRADIENT, 100);
+  simulate(limiter, 10, 3);
+
+  // Once every call takes five times as long the old baseline no longer
+  // applies; the limit must not collapse to the minimum
+  double limit = simulate(limiter, 10, 3, 5000000);
+  BOOST_TEST_MESSAGE("gradient limit " << limit);
+  BOOST_CHECK_GT(limit, 10.0);
+  BOOST_CHECK_LT(limit, 40.0);
+  BOOST_CHECK_EQUAL(0u, limiter.getInFlight());
+}
+
+BOOST_AUTO_TEST_CASE(test_aimd_converges) {
+  TConcurrencyLimiter limiter(TConcurrencyLimiter::AIMD, 100);
+  limiter.setLatencyThreshold(nanoseconds(2000000));
+  double limit = simulate(limiter, 10, 3);
+  BOOST_TEST_MESSAGE("aimd limit " << limit);
+  BOOST_CHECK_GT(limit, 10.0);
+  BOOST_CHECK_LT(limit, 30.0);
+  BOOST_CHECK_GT(limiter.getRejectedCount(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_light_load) {
+  // A server that never uses half its limit keeps the limit where it is
+  TConcurrencyLimiter limiter(TConcurrencyLimiter::AIMD, 100);
+  simulate(limiter, 10, 0.5);
+  BOOST_CHECK_EQUAL(100u, limiter.getLimit());
+  BOOST_CHECK_EQUAL(0u, limiter.getRejectedCount());
+}
+
+BOOST_AUTO_TEST_CASE(test_reject) {
+  std::shared_ptr<TMemoryBuffer> request(new TMemoryBuffer());
+  std::shared_ptr<TMemoryBuffer> response(new TMemoryBuffer());
+  TBinaryProtocol in(request);
+  TBinaryProtocol out(response);
+
+  writeCall(in, "sleep", apache::thrift::protocol::T_ONEWAY);
+  writeCall(in, "ping", apache::thrift::protocol::T_CALL);
+
+  // Oneway calls get no reply
+  TConcurrencyLimiter::reject(&in, &out);
+  BOOST_CHECK_EQUAL(0u, response->available_read());
+  TConcurrencyLimiter::reject(&in, &out);
+  BOOST_CHECK_EQUAL(0u, request->available_read());
+
+  std::string fname;
+  TMessageType mtype;
+  int32_t seqid;
+  out.readMessageBegin(fname, mtype, seqid);
+  BOOST_CHECK_EQUAL("ping", fname);
+  BOOST_CHECK_EQUAL(apache::thrift::protocol::T_EXCEPTION, mtype);
+  BOOST_CHECK_EQUAL(7, seqid);
+  TApplicationException x;
+  x.read(&out);
+  BOOST_CHECK_EQUAL(TApplicationException::INTERNAL_ERROR, x.getType());
+}
+
+BOOST_AUTO_TEST_CASE(test_limit_processor) {
+  std::shared_ptr<TMemoryBuffer> request(new TMemoryBuffer());
+  std::shared_ptr<TMemoryBuffer> response(new TMemoryBuffer());
+  std::shared_ptr<TBinaryProtocol> in(new TBinaryProtocol(request));
+  std::shared_ptr<TBinaryProtocol> out(new TBinaryProtocol(response));
+  std::shared_ptr<EchoProcessor> echo(new EchoProcessor());
+  std::shared_ptr<TConcurrencyLimiter> limiter(new TConcurrencyLimiter(TConcurrencyLimiter::AIMD,
+                                                                       1));
+  TConcurrencyLimitProcessor processor(echo, limiter);
+
+  std::string fname;
+  TMessageType mtype;
+  int32_t seqid;
+
+  // While another call holds the only slot, calls are rejected
+  BOOST_REQUIRE(limiter->tryAcquire());
+  writeCall(*in, "ping", apache::thrift::protocol::T_CALL);
+  BOOST_CHECK(processor.process(in, out, nullptr));
+  BOOST_CHECK_EQUAL(0, echo->calls);
+  out->readMessageBegin(fname, mtype, seqid);
+  BOOST_CHECK_EQUAL(apache::thrift::protocol::T_EXCEPTION, mtype);
+  response->resetBuffer();
+
+  limiter->release(nanoseconds(1000));
+  writeCall(*in, "ping", apache::thrift::protocol::T_CALL);
+  BOOST_CHECK(processor.process(in, out, nullptr));
+  BOOST_CHECK_EQUAL(1, echo->calls);
+  out->readMessageBegin(fname, mtype, seqid);
+  BOOST_CHECK_EQUAL(apache::thrift::protocol::T_REPLY, mtype);
+  BOOST_CHECK_EQUAL(0u, limiter->getInFlight());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,238 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <thrift/transport/TConnectionPool.h>
+#include <thrift/transport/TServerSocket.h>
+#include <thrift/transport/TSocket.h>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "TTransportCheckThrow.h"
+
+using apache::thrift::transport::TConnectionPool;
+using apache::thrift::transport::TConnectionPoolStats;
+using apache::thrift::transport::TServerSocket;
+using apache::thrift::transport::TTransport;
+using apache::thrift::transport::TTransportException;
+using std::shared_ptr;
+
+BOOST_AUTO_TEST_SUITE(TConnectionPoolTest)
+
+namespace {
+
+// A listening socket is enough for the pool: connects complete from the
+// listen backlog without anyone accepting them.
+shared_ptr<TServerSocket> makeServer() {
+  shared_ptr<TServerSocket> server = std::make_shared<TServerSocket>("localhost", 0);
+  server->listen();
+  return server;
+}
+
+int unusedPort() {
+  TServerSocket server("localhost", 0);
+  server.listen();
+  int port = server.getPort();
+  server.close();
+  return port;
+}
+
+TConnectionPoolStats statsFor(const TConnectionPool& pool, int port) {
+  for (const TConnectionPoolStats& s : pool.getStats()) {
+    if (s.port == port) {
+      return s;
+    }
+  }
+  BOOST_FAIL("no such endpoint");
+  return TConnectionPoolStats();
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_reuse) {
+  shared_ptr<TServerSocket> server = makeServer();
+  TConnectionPool pool(1);
+  pool.addServer("localhost", server->getPort());
+
+  TTransport* first;
+  {
+    TConnectionPool::Lease lease = pool.lease();
+    BOOST_REQUIRE(lease.valid());
+    BOOST_CHECK(lease.transport()->isOpen());
+    BOOST_CHECK_EQUAL(1u, statsFor(pool, server->getPort()).inFlight);
+    first = lease.transport().get();
+  }
+  BOOST_CHECK_EQUAL(0u, statsFor(pool, server->getPort()).inFlight);
+  BOOST_CHECK_EQUAL(1u, statsFor(pool, server->getPort()).idle);
+
+  TConnectionPool::Lease lease = pool.lease();
+  BOOST_CHECK_EQUAL(first, lease.transport().get());
+
+  // A second concurrent lease needs a new connection, which is closed rather
+  // than kept when both come back, since only one is kept idle
+  TConnectionPool::Lease other = pool.lease();
+  BOOST_CHECK(other.transport().get() != first);
+  lease.release();
+  other.release();
+  BOOST_CHECK(!lease.valid());
+  BOOST_CHECK_EQUAL(1u, statsFor(pool, server->getPort()).idle);
+}
+
+BOOST_AUTO_TEST_CASE(test_warm_up) {
+  shared_ptr<TServerSocket> server1 = makeServer();
+  shared_ptr<TServerSocket> server2 = makeServer();
+  std::vector<std::pair<std::string, int> > servers;
+  servers.push_back(std::make_pair("localhost", server1->getPort()));
+  servers.push_back(std::make_pair("localhost", server2->getPort()));
+  TConnectionPool pool(servers, 3);
+
+  pool.maintain();
+  for (const TConnectionPoolStats& s : pool.getStats()) {
+    BOOST_CHECK_EQUAL(3u, s.idle);
+    BOOST_CHECK_EQUAL(0u, s.inFlight);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_least_loaded) {
+  shared_ptr<TServerSocket> server1 = makeServer();
+  shared_ptr<TServerSocket> server2 = makeServer();
+  TConnectionPool pool(2);
+  pool.setSelection(TConnectionPool::LEAST_LOADED);
+  pool.addServer("localhost", server1->getPort());
+  pool.addServer("localhost", server2->getPort());
+
+  // While one endpoint has a lease out, the next goes to the other
+  TConnectionPool::Lease first = pool.lease();
+  TConnectionPool::Lease second = pool.lease();
+  BOOST_CHECK(first.port() != second.port());
+  BOOST_CHECK_EQUAL(1u, statsFor(pool, server1->getPort()).inFlight);
+  BOOST_CHECK_EQUAL(1u, statsFor(pool, server2->getPort()).inFlight);
+}
+
+BOOST_AUTO_TEST_CASE(test_dead_endpoint) {
+  shared_ptr<TServerSocket> server = makeServer();
+  int deadPort = unusedPort();
+  TConnectionPool pool(2);
+  pool.setSelection(TConnectionPool::LEAST_LOADED);
+  pool.setRetryBackoff(60000, 60000);
+  pool.addServer("localhost", deadPort);
+  pool.addServer("localhost", server->getPort());
+
+  // Every lease ends up on the live server, and the dead one is backed off
+  for (int i = 0; i < 4; ++i) {
+    TConnectionPool::Lease lease = pool.lease();
+    BOOST_CHECK_EQUAL(server->getPort(), lease.port());
+  }
+  TConnectionPoolStats dead = statsFor(pool, deadPort);
+  BOOST_CHECK(dead.down);
+  BOOST_CHECK_EQUAL(1u, dead.consecutiveFailures);
+  BOOST_CHECK_EQUAL(0u, dead.inFlight);
+}
+
+BOOST_AUTO_TEST_CASE(test_all_down) {
+  TConnectionPool empty;
+  TTRANSPORT_CHECK_THROW(empty.lease(), TTransportException::NOT_OPEN);
+
+  TConnectionPool pool(1);
+  pool.addServer("localhost", unusedPort());
+  TTRANSPORT_CHECK_THROW(pool.lease(), TTransportException::NOT_OPEN);
+  BOOST_CHECK_EQUAL(0u, pool.getStats()[0].inFlight);
+}
+
+BOOST_AUTO_TEST_CASE(test_mark_failed) {
+  shared_ptr<TServerSocket> server = makeServer();
+  TConnectionPool pool(2);
+  pool.setMaxConsecutiveFailures(2);
+  pool.setRetryBackoff(60000, 60000);
+  pool.addServer("localhost", server->getPort());
+  pool.maintain();
+  BOOST_CHECK_EQUAL(2u, statsFor(pool, server->getPort()).idle);
+
+  TConnectionPool::Lease lease = pool.lease();
+  shared_ptr<TTransport> transport = lease.transport();
+  lease.markFailed();
+  BOOST_CHECK(!lease.valid());
+  BOOST_CHECK(!transport->isOpen());
+  TConnectionPoolStats s = statsFor(pool, server->getPort());
+  BOOST_CHECK_EQUAL(1u, s.consecutiveFailures);
+  BOOST_CHECK(!s.down);
+  BOOST_CHECK_EQUAL(1u, s.idle);
+
+  // The second failure in a row takes the endpoint out and drains its
+  // idle connections
+  pool.lease().markFailed();
+  s = statsFor(pool, server->getPort());
+  BOOST_CHECK(s.down);
+  BOOST_CHECK_EQUAL(0u, s.idle);
+
+  // With nowhere else to go the endpoint is still tried, and a successful
+  // lease brings it back
+  pool.lease().release();
+  s = statsFor(pool, server->getPort());
+  BOOST_CHECK_EQUAL(0u, s.consecutiveFailures);
+  BOOST_CHECK(!s.down);
+}
+
+BOOST_AUTO_TEST_CASE(test_health_check) {
+  shared_ptr<TServerSocket> server = makeServer();
+  TConnectionPool pool(1);
+  pool.addServer("localhost", server->getPort());
+
+  shared_ptr<TTransport> stale;
+  {
+    TConnectionPool::Lease lease = pool.lease();
+    stale = lease.transport();
+  }
+
+  // The server hangs up on the idle connection
+  shared_ptr<TTransport> accepted = server->accept();
+  accepted->close();
+
+  TConnectionPool::Lease lease = pool.lease();
+  BOOST_CHECK(lease.transport() != stale);
+  BOOST_CHECK(!stale->isOpen());
+  BOOST_CHECK_EQUAL(0u, statsFor(pool, server->getPort()).consecutiveFailures);
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_leases) {
+  shared_ptr<TServerSocket> server1 = makeServer();
+  shared_ptr<TServerSocket> server2 = makeServer();
+  TConnectionPool pool(2);
+  pool.addServer("localhost", server1->getPort());
+  pool.addServer("localhost", server2->getPort());
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&pool]() {
+      for (int i = 0; i < 50; ++i) {
+        TConnectionPool::Lease lease = pool.lease();
+        BOOST_CHECK(lease.transport()->isOpen());
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  for (const TConnectionPoolStats& s : pool.getStats()) {
+    BOOST_CHECK_EQUAL(0u, s.inFlight);
+    BOOST_CHECK(s.idle <= 2u);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
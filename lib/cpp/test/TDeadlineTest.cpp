@@ -0,0 +1,164 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE TDeadlineTest
+#include <boost/test/unit_test.hpp>
+#include <thrift/TDeadline.h>
+#include <thrift/protocol/THeaderProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/OneWayService.h"
+
+using apache::thrift::TApplicationException;
+using apache::thrift::TDeadline;
+using apache::thrift::TDeadlineScope;
+using apache::thrift::protocol::THeaderProtocol;
+using apache::thrift::transport::TMemoryBuffer;
+using onewaytest::OneWayServiceClient;
+using onewaytest::OneWayServiceIf;
+using onewaytest::OneWayServiceProcessor;
+using std::chrono::milliseconds;
+
+namespace {
+
+// Records the deadline each call sees
+class Handler : public OneWayServiceIf {
+public:
+  Handler() : calls(0), remaining(0), hadDeadline(false) {}
+  void roundTripRPC() override { record(); }
+  void oneWayRPC() override { record(); }
+
+  void record() {
+    ++calls;
+    hadDeadline = TDeadline::isSet();
+    remaining = TDeadline::remaining();
+  }
+
+  int calls;
+  milliseconds remaining;
+  bool hadDeadline;
+};
+
+struct Fixture {
+  Fixture()
+    : request(new TMemoryBuffer()),
+      response(new TMemoryBuffer()),
+      clientProtocol(new THeaderProtocol(response, request)),
+      serverProtocol(new THeaderProtocol(request, response)),
+      handler(new Handler()),
+      processor(handler),
+      client(clientProtocol) {}
+
+  bool process() { return processor.process(serverProtocol, serverProtocol, nullptr); }
+
+  std::shared_ptr<TMemoryBuffer> request;
+  std::shared_ptr<TMemoryBuffer> response;
+  std::shared_ptr<THeaderProtocol> clientProtocol;
+  std::shared_ptr<THeaderProtocol> serverProtocol;
+  std::shared_ptr<Handler> handler;
+  OneWayServiceProcessor processor;
+  OneWayServiceClient client;
+};
+}
+
+BOOST_AUTO_TEST_CASE(test_scope) {
+  BOOST_CHECK(!TDeadline::isSet());
+  BOOST_CHECK(!TDeadline::expired());
+  BOOST_CHECK(TDeadline::remaining() == milliseconds::max());
+  {
+    TDeadlineScope outer(milliseconds(10000));
+    BOOST_CHECK(TDeadline::isSet());
+    BOOST_CHECK_GT(TDeadline::remaining().count(), 9000);
+    BOOST_CHECK_LE(TDeadline::remaining().count(), 10000);
+    {
+      // An inner scope may only narrow the deadline
+      TDeadlineScope wider(milliseconds(20000));
+      BOOST_CHECK_LE(TDeadline::remaining().count(), 10000);
+      TDeadlineScope narrower(milliseconds(100));
+      BOOST_CHECK_LE(TDeadline::remaining().count(), 100);
+    }
+    BOOST_CHECK_GT(TDeadline::remaining().count(), 9000);
+
+    TDeadlineScope expired(milliseconds(0));
+    BOOST_CHECK(TDeadline::expired());
+    BOOST_CHECK_EQUAL(0, TDeadline::remaining().count());
+  }
+  BOOST_CHECK(!TDeadline::isSet());
+
+  TDeadline::clock::time_point now = TDeadline::clock::now();
+  BOOST_CHECK(TDeadline::after(now, milliseconds::max()) == TDeadline::clock::time_point::max());
+  BOOST_CHECK(TDeadline::after(now, milliseconds(-5)) == now);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_no_deadline, Fixture) {
+  client.send_roundTripRPC();
+  BOOST_CHECK(process());
+  client.recv_roundTripRPC();
+  BOOST_CHECK_EQUAL(1, handler->calls);
+  BOOST_CHECK(!handler->hadDeadline);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_propagation, Fixture) {
+  {
+    TDeadlineScope scope(milliseconds(5000));
+    client.send_roundTripRPC();
+  }
+  BOOST_CHECK(process());
+  client.recv_roundTripRPC();
+  BOOST_CHECK_EQUAL(1, handler->calls);
+  BOOST_CHECK(handler->hadDeadline);
+  BOOST_CHECK_GT(handler->remaining.count(), 0);
+  BOOST_CHECK_LE(handler->remaining.count(), 5000);
+
+  // The deadline only lasts for the call
+  BOOST_CHECK(!TDeadline::isSet());
+}
+
+BOOST_FIXTURE_TEST_CASE(test_expired_call_dropped, Fixture) {
+  {
+    TDeadlineScope scope(milliseconds(0));
+    client.send_roundTripRPC();
+    client.send_oneWayRPC();
+  }
+  BOOST_CHECK(process());
+  BOOST_CHECK(process());
+  BOOST_CHECK_EQUAL(0, handler->calls);
+  BOOST_CHECK_THROW(client.recv_roundTripRPC(), TApplicationException);
+
+  // The connection is still usable
+  client.send_roundTripRPC();
+  BOOST_CHECK(process());
+  client.recv_roundTripRPC();
+  BOOST_CHECK_EQUAL(1, handler->calls);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_queueing_counts, Fixture) {
+  {
+    TDeadlineScope scope(milliseconds(500));
+    client.send_roundTripRPC();
+  }
+
+  // As if the request had waited in a queue for a second
+  {
+    TDeadlineScope serverScope;
+    TDeadline::setReceived(TDeadline::clock::now() - milliseconds(1000));
+    BOOST_CHECK(process());
+  }
+  BOOST_CHECK_EQUAL(0, handler->calls);
+  BOOST_CHECK_THROW(client.recv_roundTripRPC(), TApplicationException);
+}
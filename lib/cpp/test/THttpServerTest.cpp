@@ -0,0 +1,185 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <thrift/transport/THttpServer.h>
+#include <thrift/transport/TVirtualTransport.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+using apache::thrift::transport::THttpServer;
+using apache::thrift::transport::TTransportException;
+using apache::thrift::transport::TVirtualTransport;
+using std::shared_ptr;
+using std::string;
+
+BOOST_AUTO_TEST_SUITE(THttpServerTest)
+
+// Hands out its input at most chunk bytes per read, and records each write
+class ScriptedTransport : public TVirtualTransport<ScriptedTransport> {
+public:
+  ScriptedTransport(const string& input, uint32_t chunk)
+    : input_(input), pos_(0), chunk_(chunk), open_(true) {}
+
+  bool isOpen() const override { return open_; }
+  bool peek() override { return pos_ < input_.size(); }
+  void close() override { open_ = false; }
+
+  uint32_t read(uint8_t* buf, uint32_t len) {
+    auto give = static_cast<uint32_t>((std::min)(static_cast<size_t>((std::min)(len, chunk_)),
+                                                 input_.size() - pos_));
+    std::copy(input_.data() + pos_, input_.data() + pos_ + give, buf);
+    pos_ += give;
+    return give;
+  }
+
+  void write(const uint8_t* buf, uint32_t len) {
+    writes_.push_back(string(reinterpret_cast<const char*>(buf), len));
+  }
+
+  string input_;
+  size_t pos_;
+  uint32_t chunk_;
+  bool open_;
+  std::vector<string> writes_;
+};
+
+string request(const string& body, const string& extraHeaders = "", const string& version = "HTTP/1.1") {
+  return "POST /service " + version + "\r\nHost: localhost\r\n" + extraHeaders
+         + "Content-Type: application/x-thrift\r\nContent-Length: " + std::to_string(body.size())
+         + "\r\n\r\n" + body;
+}
+
+string readBody(THttpServer& server, uint32_t len) {
+  string body(len, '\0');
+  server.readAll(reinterpret_cast<uint8_t*>(&body[0]), len);
+  return body;
+}
+
+BOOST_AUTO_TEST_CASE(test_pipelined_requests) {
+  shared_ptr<ScriptedTransport> trans(
+      new ScriptedTransport(request("first") + request("second"), 4096));
+  THttpServer server(trans);
+
+  BOOST_CHECK_EQUAL(readBody(server, 5), "first");
+  server.readEnd();
+  // Both requests came in one read; the second must still be seen
+  BOOST_CHECK(!trans->peek());
+  BOOST_CHECK(server.peek());
+
+  server.write(reinterpret_cast<const uint8_t*>("reply"), 5);
+  server.flush();
+  BOOST_REQUIRE_EQUAL(trans->writes_.size(), 1u);
+  const string& response = trans->writes_[0];
+  BOOST_CHECK_EQUAL(response.compare(0, 17, "HTTP/1.1 200 OK\r\n"), 0);
+  BOOST_CHECK(response.find("\r\nContent-Length: 5\r\n") != string::npos);
+  BOOST_CHECK(response.find("\r\nConnection: Keep-Alive\r\n\r\nreply") != string::npos);
+  BOOST_CHECK_EQUAL(response.substr(response.size() - 5), "reply");
+
+  BOOST_CHECK_EQUAL(readBody(server, 6), "second");
+  server.readEnd();
+  BOOST_CHECK(!server.peek());
+
+  // The header room is kept for every response
+  server.write(reinterpret_cast<const uint8_t*>("again"), 5);
+  server.flush();
+  BOOST_REQUIRE_EQUAL(trans->writes_.size(), 2u);
+  BOOST_CHECK_EQUAL(trans->writes_[1].substr(trans->writes_[1].size() - 5), "again");
+}
+
+BOOST_AUTO_TEST_CASE(test_headers_across_reads) {
+  // A long header, read a few bytes at a time so that lines, and CRLFs,
+  // are split between reads and the buffer has to grow
+  string longValue(3000, 'x');
+  for (uint32_t chunk : {1u, 3u, 16u, 17u, 100u}) {
+    shared_ptr<ScriptedTransport> trans(new ScriptedTransport(
+        request("payload", "X-Long: " + longValue + "\r\nX-Forwarded-For: 10.0.0.1\r\n"), chunk));
+    THttpServer server(trans);
+    BOOST_CHECK_EQUAL(readBody(server, 7), "payload");
+    BOOST_CHECK_EQUAL(server.getOrigin().find(" 10.0.0.1"), 0u);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_header_names_match_exactly) {
+  // "Content" is not "Content-Length", and names are case insensitive
+  shared_ptr<ScriptedTransport> trans(new ScriptedTransport(
+      "POST / HTTP/1.1\r\nContent: 99\r\ncontent-length: 4\r\n\r\nbody", 4096));
+  THttpServer server(trans);
+  BOOST_CHECK_EQUAL(readBody(server, 4), "body");
+}
+
+BOOST_AUTO_TEST_CASE(test_bare_lf_is_not_a_line_end) {
+  shared_ptr<ScriptedTransport> trans(new ScriptedTransport(
+      "POST / HTTP/1.1\r\nX-Odd: a\nb\r\nContent-Length: 2\r\n\r\nok", 4096));
+  THttpServer server(trans);
+  BOOST_CHECK_EQUAL(readBody(server, 2), "ok");
+}
+
+BOOST_AUTO_TEST_CASE(test_connection_close) {
+  shared_ptr<ScriptedTransport> trans(
+      new ScriptedTransport(request("one", "", "HTTP/1.0") + request("two"), 4096));
+  THttpServer server(trans);
+  BOOST_CHECK_EQUAL(readBody(server, 3), "one");
+  server.write(reinterpret_cast<const uint8_t*>("r"), 1);
+  server.flush();
+  BOOST_REQUIRE_EQUAL(trans->writes_.size(), 1u);
+  BOOST_CHECK(trans->writes_[0].find("\r\nConnection: close\r\n") != string::npos);
+  BOOST_CHECK(!trans->isOpen());
+
+  // HTTP/1.1 keep-alive can also be turned off by the client
+  trans.reset(new ScriptedTransport(request("one", "Connection: close\r\n"), 4096));
+  THttpServer server2(trans);
+  BOOST_CHECK_EQUAL(readBody(server2, 3), "one");
+  server2.flush();
+  BOOST_CHECK(trans->writes_[0].find("\r\nContent-Length: 0\r\nConnection: close\r\n") != string::npos);
+  BOOST_CHECK(!trans->isOpen());
+  uint8_t byte;
+  try {
+    server2.read(&byte, 1);
+    BOOST_ERROR("read after close");
+  } catch (const TTransportException& ex) {
+    BOOST_CHECK_EQUAL(ex.getType(), TTransportException::END_OF_FILE);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_oversized_header) {
+  // A subclass header that does not fit the reserved room goes out separately
+  class BigHeaderServer : public THttpServer {
+  public:
+    using THttpServer::THttpServer;
+
+  protected:
+    std::string getHeader(uint32_t len) override {
+      return THttpServer::getHeader(len).insert(17, "X-Pad: " + string(400, 'p') + "\r\n");
+    }
+  };
+
+  shared_ptr<ScriptedTransport> trans(new ScriptedTransport(request("q"), 4096));
+  BigHeaderServer server(trans);
+  BOOST_CHECK_EQUAL(readBody(server, 1), "q");
+  server.write(reinterpret_cast<const uint8_t*>("answer"), 6);
+  server.flush();
+  BOOST_REQUIRE_EQUAL(trans->writes_.size(), 2u);
+  BOOST_CHECK(trans->writes_[0].find("X-Pad: ppp") != string::npos);
+  BOOST_CHECK_EQUAL(trans->writes_[1], "answer");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
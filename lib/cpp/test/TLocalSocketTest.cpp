@@ -0,0 +1,180 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TLocalServerSocket.h>
+#include <thrift/transport/TLocalSocket.h>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include "gen-cpp/ThriftTest_types.h"
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::transport::TLocalServerSocket;
+using apache::thrift::transport::TLocalSocket;
+using apache::thrift::transport::TTransportException;
+using std::shared_ptr;
+using std::string;
+
+BOOST_AUTO_TEST_SUITE(TLocalSocketTest)
+
+namespace {
+
+// Unique per test run, so that parallel runs do not collide
+string testPath(const string& name) {
+  return TLocalSocket::abstractPath("thrift-TLocalSocketTest-" + name + "-"
+                                    + std::to_string(getpid()));
+}
+
+struct Connected {
+  explicit Connected(const string& path) : server(path), client(new TLocalSocket(path)) {
+    server.listen();
+    client->open();
+    accepted = std::dynamic_pointer_cast<TLocalSocket>(server.accept());
+    BOOST_REQUIRE(accepted);
+  }
+
+  TLocalServerSocket server;
+  shared_ptr<TLocalSocket> client;
+  shared_ptr<TLocalSocket> accepted;
+};
+}
+
+BOOST_AUTO_TEST_CASE(test_abstract_path_survives_listen) {
+  string path = testPath("abstract");
+  TLocalServerSocket server(path);
+  server.listen();
+  BOOST_CHECK(server.isUnixDomainSocket());
+  BOOST_CHECK_EQUAL(path, server.getPath());
+}
+
+BOOST_AUTO_TEST_CASE(test_message_per_flush) {
+  Connected c(testPath("messages"));
+
+  c.client->write(reinterpret_cast<const uint8_t*>("hello"), 5);
+  c.client->flush();
+  c.client->write(reinterpret_cast<const uint8_t*>("world!"), 6);
+  c.client->flush();
+
+  // Each message arrives whole, and one read never crosses into the next
+  uint8_t buf[64];
+  BOOST_CHECK_EQUAL(5u, c.accepted->read(buf, sizeof(buf)));
+  BOOST_CHECK_EQUAL(string("hello"), string(reinterpret_cast<char*>(buf), 5));
+  BOOST_CHECK_EQUAL(6u, c.accepted->read(buf, sizeof(buf)));
+  BOOST_CHECK_EQUAL(string("world!"), string(reinterpret_cast<char*>(buf), 6));
+
+  c.client->close();
+  BOOST_CHECK_EQUAL(0u, c.accepted->read(buf, sizeof(buf)));
+}
+
+BOOST_AUTO_TEST_CASE(test_message_larger_than_packet) {
+  Connected c(testPath("large"));
+
+  string message(3 * TLocalSocket::MAX_PACKET_SIZE + 17, 'x');
+  for (size_t i = 0; i < message.size(); ++i) {
+    message[i] = static_cast<char>(i * 7);
+  }
+  c.client->write(reinterpret_cast<const uint8_t*>(message.data()),
+                 static_cast<uint32_t>(message.size()));
+  c.client->flush();
+
+  string received(message.size(), '\0');
+  c.accepted->readAll(reinterpret_cast<uint8_t*>(&received[0]),
+                      static_cast<uint32_t>(received.size()));
+  BOOST_CHECK(message == received);
+}
+
+BOOST_AUTO_TEST_CASE(test_protocol_round_trip) {
+  Connected c(testPath("protocol"));
+
+  thrift::test::Xtruct sent;
+  sent.string_thing = string(1000, 's');
+  sent.i32_thing = 42;
+  sent.i64_thing = -1;
+  TBinaryProtocol out(c.client);
+  sent.write(&out);
+  c.client->flush();
+
+  // borrow() never waits; once a read has pulled the packet in, strings are
+  // copied straight out of it
+  uint32_t len = 1;
+  BOOST_CHECK(c.accepted->borrow(nullptr, &len) == nullptr);
+  thrift::test::Xtruct received;
+  TBinaryProtocol in(c.accepted);
+  received.read(&in);
+  BOOST_CHECK(sent == received);
+}
+
+BOOST_AUTO_TEST_CASE(test_descriptor_passing) {
+  Connected c(testPath("descriptors"));
+
+  int pipeFds[2];
+  BOOST_REQUIRE_EQUAL(0, pipe(pipeFds));
+
+  // Descriptors need a message to go with
+  c.client->sendDescriptors({pipeFds[0]});
+  BOOST_CHECK_THROW(c.client->flush(), TTransportException);
+  c.client->write(reinterpret_cast<const uint8_t*>("fd"), 2);
+  c.client->flush();
+  ::close(pipeFds[0]);
+
+  uint8_t buf[2];
+  c.accepted->readAll(buf, 2);
+  std::vector<int> fds = c.accepted->takeDescriptors();
+  BOOST_REQUIRE_EQUAL(1u, fds.size());
+  BOOST_CHECK(c.accepted->takeDescriptors().empty());
+
+  // The received descriptor is the read end of the same pipe
+  BOOST_REQUIRE_EQUAL(3, ::write(pipeFds[1], "abc", 3));
+  char piped[3];
+  BOOST_REQUIRE_EQUAL(3, ::read(fds[0], piped, 3));
+  BOOST_CHECK_EQUAL(string("abc"), string(piped, 3));
+  ::close(fds[0]);
+  ::close(pipeFds[1]);
+
+  std::vector<int> tooMany(TLocalSocket::MAX_DESCRIPTORS + 1, pipeFds[1]);
+  BOOST_CHECK_THROW(c.client->sendDescriptors(tooMany), TTransportException);
+}
+
+BOOST_AUTO_TEST_CASE(test_peer_credentials) {
+  Connected c(testPath("credentials"));
+
+  TLocalSocket::PeerCredentials credentials = c.accepted->getPeerCredentials();
+  BOOST_CHECK_EQUAL(getuid(), credentials.uid);
+  BOOST_CHECK_EQUAL(getgid(), credentials.gid);
+#ifdef __linux__
+  BOOST_CHECK_EQUAL(getpid(), credentials.pid);
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(test_interrupt_children) {
+  Connected c(testPath("interrupt"));
+
+  c.server.interruptChildren();
+  uint8_t buf[1];
+  try {
+    c.accepted->read(buf, 1);
+    BOOST_ERROR("read was not interrupted");
+  } catch (const TTransportException& ex) {
+    BOOST_CHECK_EQUAL(TTransportException::INTERRUPTED, ex.getType());
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
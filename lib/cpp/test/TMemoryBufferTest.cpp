@@ -25,6 +25,7 @@
 #include <memory>
 #include <numeric>
 #include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <vector>
 
@@ -33,6 +34,7 @@
 BOOST_AUTO_TEST_SUITE(TMemoryBufferTest)
 
 using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
 using apache::thrift::transport::TMemoryBuffer;
 using apache::thrift::transport::TTransportException;
 using std::shared_ptr;
@@ -409,4 +411,91 @@ BOOST_AUTO_TEST_CASE(test_memory_buffer_to_get_sizeof_objects)
   BOOST_CHECK_EQUAL(47, size);
 }
 
+BOOST_AUTO_TEST_CASE(test_serialized_size)
+{
+  thrift::test::Xtruct object;
+  object.i32_thing = 10;
+  object.i64_thing = 30;
+  object.string_thing = "who's your daddy?";
+  BOOST_CHECK_EQUAL(47, object.serializedSize<TBinaryProtocol>());
+
+  thrift::test::Insanity insanity;
+  insanity.userMap[thrift::test::Numberz::FIVE] = 5;
+  insanity.userMap[thrift::test::Numberz::EIGHT] = -8000000000LL;
+  for (int i = 0; i < 20; ++i) {
+    insanity.xtructs.push_back(object);
+    insanity.xtructs.back().i32_thing = -i * 100000;
+  }
+
+  shared_ptr<TMemoryBuffer> binaryBuffer(new TMemoryBuffer());
+  TBinaryProtocol binaryProtocol(binaryBuffer);
+  uint32_t binarySize = insanity.write(&binaryProtocol);
+  BOOST_CHECK_EQUAL(binarySize, binaryBuffer->available_read());
+  BOOST_CHECK_EQUAL(binarySize, insanity.serializedSize<TBinaryProtocol>());
+
+  shared_ptr<TMemoryBuffer> compactBuffer(new TMemoryBuffer());
+  TCompactProtocol compactProtocol(compactBuffer);
+  uint32_t compactSize = insanity.write(&compactProtocol);
+  BOOST_CHECK_EQUAL(compactSize, compactBuffer->available_read());
+  BOOST_CHECK_EQUAL(compactSize, insanity.serializedSize<TCompactProtocol>());
+}
+
+BOOST_AUTO_TEST_CASE(test_reserve)
+{
+  thrift::test::Insanity insanity;
+  insanity.xtructs.resize(100);
+  insanity.xtructs[0].string_thing.assign(10000, 'x');
+  uint32_t size = insanity.serializedSize<TBinaryProtocol>();
+
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(1));
+  buffer->reserve(size);
+  BOOST_CHECK_EQUAL(size, buffer->available_write());
+
+  uint8_t* before;
+  uint32_t len;
+  buffer->getBuffer(&before, &len);
+
+  TBinaryProtocol protocol(buffer);
+  insanity.write(&protocol);
+
+  uint8_t* after;
+  buffer->getBuffer(&after, &len);
+  BOOST_CHECK(before == after);
+  BOOST_CHECK_EQUAL(size, len);
+  BOOST_CHECK_EQUAL(0, buffer->available_write());
+
+  // Reserving what is already available is a no-op
+  buffer->reserve(0);
+  buffer->getBuffer(&after, &len);
+  BOOST_CHECK(before == after);
+
+  uint8_t data[] = "foo";
+  TMemoryBuffer observed(data, sizeof(data));
+  BOOST_CHECK_THROW(observed.reserve(1), TTransportException);
+}
+
+BOOST_AUTO_TEST_CASE(test_adopt_release_buffer) {
+  TMemoryBuffer buffer(0);
+  auto* block = static_cast<uint8_t*>(std::malloc(64));
+  buffer.adoptBuffer(block, 64);
+  BOOST_CHECK_EQUAL(64u, buffer.available_write());
+  buffer.write(reinterpret_cast<const uint8_t*>("abc"), 3);
+  BOOST_CHECK_EQUAL("abc", buffer.getBufferAsString());
+
+  uint32_t size;
+  BOOST_CHECK(buffer.releaseBuffer(&size) == block);
+  BOOST_CHECK_EQUAL(64u, size);
+  BOOST_CHECK_EQUAL(0u, buffer.getBufferSize());
+  std::free(block);
+
+  // The released transport is still writable
+  buffer.write(reinterpret_cast<const uint8_t*>("xyz"), 3);
+  BOOST_CHECK_EQUAL("xyz", buffer.getBufferAsString());
+
+  uint8_t data[] = "foo";
+  TMemoryBuffer observed(data, sizeof(data));
+  BOOST_CHECK(observed.releaseBuffer(&size) == nullptr);
+  BOOST_CHECK_EQUAL(0u, size);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
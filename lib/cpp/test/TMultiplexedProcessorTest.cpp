@@ -0,0 +1,210 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <thrift/processor/TMultiplexedProcessor.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TMultiplexedProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/OneWayService.h"
+
+using apache::thrift::TApplicationException;
+using apache::thrift::TException;
+using apache::thrift::TMultiplexedProcessor;
+using apache::thrift::TProcessor;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TMessageType;
+using apache::thrift::protocol::TMultiplexedProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TMemoryBuffer;
+using onewaytest::OneWayServiceClient;
+using onewaytest::OneWayServiceIf;
+using onewaytest::OneWayServiceProcessor;
+
+BOOST_AUTO_TEST_SUITE(TMultiplexedProcessorTest)
+
+namespace {
+
+class CountingHandler : public OneWayServiceIf {
+public:
+  CountingHandler() : roundTrips(0), oneWays(0) {}
+  void roundTripRPC() override { ++roundTrips; }
+  void oneWayRPC() override { ++oneWays; }
+  int roundTrips;
+  int oneWays;
+};
+
+// A hand-written processor that only implements process(), so it has to be
+// given a protocol that replays the message header.
+class HeaderRecordingProcessor : public TProcessor {
+public:
+  bool process(std::shared_ptr<TProtocol> in,
+               std::shared_ptr<TProtocol>,
+               void*) override {
+    TMessageType type;
+    in->readMessageBegin(name, type, seqid);
+    in->skip(apache::thrift::protocol::T_STRUCT);
+    in->readMessageEnd();
+    in->getTransport()->readEnd();
+    return true;
+  }
+  std::string name;
+  int32_t seqid = 0;
+};
+
+// A generated processor whose process() is overridden, which routing
+// processors must still call.
+class CountingProcessor : public OneWayServiceProcessor {
+public:
+  CountingProcessor(std::shared_ptr<OneWayServiceIf> iface)
+    : OneWayServiceProcessor(iface), calls(0) {}
+  bool process(std::shared_ptr<TProtocol> in,
+               std::shared_ptr<TProtocol> out,
+               void* connectionContext) override {
+    ++calls;
+    return OneWayServiceProcessor::process(in, out, connectionContext);
+  }
+  int calls;
+};
+
+struct Fixture {
+  Fixture()
+    : request(new TMemoryBuffer()),
+      response(new TMemoryBuffer()),
+      requestProtocol(new TBinaryProtocol(request)),
+      responseProtocol(new TBinaryProtocol(response)),
+      handler(new CountingHandler()),
+      processor(new TMultiplexedProcessor()) {}
+
+  // Write a call to "name" with empty arguments, as a client would.
+  void writeCall(const std::string& name, int32_t seqid) {
+    requestProtocol->writeMessageBegin(name, apache::thrift::protocol::T_CALL, seqid);
+    requestProtocol->writeStructBegin("args");
+    requestProtocol->writeFieldStop();
+    requestProtocol->writeStructEnd();
+    requestProtocol->writeMessageEnd();
+  }
+
+  bool process() { return processor->process(requestProtocol, responseProtocol, nullptr); }
+
+  std::shared_ptr<TMemoryBuffer> request;
+  std::shared_ptr<TMemoryBuffer> response;
+  std::shared_ptr<TProtocol> requestProtocol;
+  std::shared_ptr<TProtocol> responseProtocol;
+  std::shared_ptr<CountingHandler> handler;
+  std::shared_ptr<TMultiplexedProcessor> processor;
+};
+}
+
+BOOST_FIXTURE_TEST_CASE(test_multiplexed_routing, Fixture) {
+  processor->registerProcessor("OneWay", std::make_shared<OneWayServiceProcessor>(handler));
+  BOOST_CHECK(std::make_shared<OneWayServiceProcessor>(handler)->canDispatchMessage());
+
+  std::shared_ptr<TProtocol> sendProtocol(new TMultiplexedProtocol(requestProtocol, "OneWay"));
+  OneWayServiceClient client(responseProtocol, sendProtocol);
+  for (int i = 0; i < 3; ++i) {
+    client.send_roundTripRPC();
+    BOOST_CHECK(process());
+    client.recv_roundTripRPC();
+  }
+  client.send_oneWayRPC();
+  BOOST_CHECK(process());
+
+  BOOST_CHECK_EQUAL(3, handler->roundTrips);
+  BOOST_CHECK_EQUAL(1, handler->oneWays);
+  BOOST_CHECK_EQUAL(0u, request->available_read());
+  BOOST_CHECK_EQUAL(0u, response->available_read());
+}
+
+BOOST_FIXTURE_TEST_CASE(test_multiplexed_overridden_process, Fixture) {
+  std::shared_ptr<CountingProcessor> counting(new CountingProcessor(handler));
+  BOOST_CHECK(!counting->canDispatchMessage());
+  processor->registerProcessor("OneWay", counting);
+
+  std::shared_ptr<TProtocol> sendProtocol(new TMultiplexedProtocol(requestProtocol, "OneWay"));
+  OneWayServiceClient client(responseProtocol, sendProtocol);
+  client.send_roundTripRPC();
+  BOOST_CHECK(process());
+  client.recv_roundTripRPC();
+  client.send_oneWayRPC();
+  BOOST_CHECK(process());
+
+  BOOST_CHECK_EQUAL(2, counting->calls);
+  BOOST_CHECK_EQUAL(1, handler->roundTrips);
+  BOOST_CHECK_EQUAL(1, handler->oneWays);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_multiplexed_default_processor, Fixture) {
+  processor->registerDefault(std::make_shared<OneWayServiceProcessor>(handler));
+
+  OneWayServiceClient client(responseProtocol, requestProtocol);
+  client.send_roundTripRPC();
+  BOOST_CHECK(process());
+  client.recv_roundTripRPC();
+  BOOST_CHECK_EQUAL(1, handler->roundTrips);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_multiplexed_name_tokens, Fixture) {
+  std::shared_ptr<HeaderRecordingProcessor> recorder(new HeaderRecordingProcessor());
+  processor->registerProcessor("Svc", recorder);
+
+  // Empty tokens are ignored, as boost::char_separator does.
+  const char* names[] = {"Svc:method", "Svc::method", ":Svc:method:", "::Svc::method"};
+  for (int32_t i = 0; i < 4; ++i) {
+    writeCall(names[i], i + 1);
+    BOOST_CHECK(process());
+    BOOST_CHECK_EQUAL("method", recorder->name);
+    BOOST_CHECK_EQUAL(i + 1, recorder->seqid);
+  }
+
+  // A single token goes to the default processor.
+  std::shared_ptr<HeaderRecordingProcessor> fallback(new HeaderRecordingProcessor());
+  processor->registerDefault(fallback);
+  writeCall(":plain:", 9);
+  BOOST_CHECK(process());
+  BOOST_CHECK_EQUAL("plain", fallback->name);
+  BOOST_CHECK_EQUAL(9, fallback->seqid);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_multiplexed_errors, Fixture) {
+  processor->registerProcessor("Svc", std::make_shared<HeaderRecordingProcessor>());
+
+  const char* names[] = {"Other:method", "a:b:c", "", "method"};
+  for (auto name : names) {
+    writeCall(name, 7);
+    BOOST_CHECK_THROW(process(), TException);
+
+    // The request is consumed and answered with an exception carrying the
+    // original name.
+    BOOST_CHECK_EQUAL(0u, request->available_read());
+    std::string replyName;
+    TMessageType type;
+    int32_t seqid;
+    responseProtocol->readMessageBegin(replyName, type, seqid);
+    BOOST_CHECK_EQUAL(name, replyName);
+    BOOST_CHECK_EQUAL(apache::thrift::protocol::T_EXCEPTION, type);
+    BOOST_CHECK_EQUAL(7, seqid);
+    TApplicationException x;
+    x.read(responseProtocol.get());
+    responseProtocol->readMessageEnd();
+    BOOST_CHECK_EQUAL(TApplicationException::PROTOCOL_ERROR, x.getType());
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
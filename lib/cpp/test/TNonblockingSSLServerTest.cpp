@@ -22,6 +22,7 @@
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
 
+#include "thrift/concurrency/ThreadManager.h"
 #include "thrift/server/TNonblockingServer.h"
 #include "thrift/transport/TSSLSocket.h"
 #include "thrift/transport/TNonblockingSSLServerSocket.h"
@@ -37,6 +38,7 @@ using namespace apache::thrift;
 using apache::thrift::concurrency::Guard;
 using apache::thrift::concurrency::Monitor;
 using apache::thrift::concurrency::Mutex;
+using apache::thrift::concurrency::ThreadManager;
 using apache::thrift::server::TServerEventHandler;
 using apache::thrift::transport::TSSLSocketFactory;
 using apache::thrift::transport::TSSLSocket;
@@ -149,6 +151,7 @@ private:
     std::shared_ptr<event_base> userEventBase;
     std::shared_ptr<TProcessor> processor;
     std::shared_ptr<server::TNonblockingServer> server;
+    std::shared_ptr<ThreadManager> handshakeThreadManager;
     std::shared_ptr<ListenEventHandler> listenHandler;
     std::shared_ptr<TSSLSocketFactory> pServerSocketFactory;
     std::shared_ptr<transport::TNonblockingSSLServerSocket> socket;
@@ -179,6 +182,7 @@ private:
         server.reset(new server::TNonblockingServer(processor, socket));
 	      server->setServerEventHandler(listenHandler);
         server->setNumIOThreads(1);
+        server->setHandshakeThreadManager(handshakeThreadManager);
         if (userEventBase) {
           server->registerEvents(userEventBase.get());
         }
@@ -208,6 +212,9 @@ protected:
     if (thread) {
       thread->join();
     }
+    if (handshakeThreadManager_) {
+      handshakeThreadManager_->stop();
+    }
   }
 
   void setEventBase(event_base* user_event_base) {
@@ -219,6 +226,7 @@ protected:
     runner->port = port;
     runner->processor = processor;
     runner->userEventBase = userEventBase_;
+    runner->handshakeThreadManager = handshakeThreadManager_;
 
     std::unique_ptr<apache::thrift::concurrency::ThreadFactory> threadFactory(
         new apache::thrift::concurrency::ThreadFactory(false));
@@ -233,6 +241,7 @@ protected:
   bool canCommunicate(int serverPort) {
     std::shared_ptr<TSSLSocketFactory> pClientSocketFactory = createClientSocketFactory();
     std::shared_ptr<TSSLSocket> socket = pClientSocketFactory->createSocket("localhost", serverPort);
+    socket->setRecvTimeout(5000);
     socket->open();
     test::ParentServiceClient client(std::make_shared<protocol::TBinaryProtocol>(
         std::make_shared<transport::TFramedTransport>(socket)));
@@ -242,9 +251,46 @@ protected:
     return strings.size() == 1 && !(strings[0].compare("foo"));
   }
 
+  void useHandshakeThreadManager() {
+    handshakeThreadManager_ = ThreadManager::newSimpleThreadManager(2);
+    handshakeThreadManager_->threadFactory(
+        std::make_shared<apache::thrift::concurrency::ThreadFactory>());
+    handshakeThreadManager_->start();
+  }
+
+  // A client that sends the start of a TLS record and then nothing
+  std::shared_ptr<transport::TSocket> stalledClient(int serverPort) {
+    std::shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", serverPort));
+    socket->open();
+    const uint8_t recordStart[] = {0x16, 0x03, 0x01};
+    socket->write(recordStart, sizeof(recordStart));
+    return socket;
+  }
+
+  // Whether the server hangs up on a client whose handshake is garbage
+  bool rejectsGarbage(int serverPort) {
+    transport::TSocket socket("localhost", serverPort);
+    socket.setRecvTimeout(5000);
+    socket.open();
+    std::string garbage(64, 'x');
+    socket.write(reinterpret_cast<const uint8_t*>(garbage.data()),
+                 static_cast<uint32_t>(garbage.size()));
+    uint8_t buf[256];
+    try {
+      while (socket.read(buf, sizeof(buf)) > 0) {
+        // skip any alert
+      }
+    } catch (const transport::TTransportException& te) {
+      // A reset connection was hung up on too
+      return te.getType() != transport::TTransportException::TIMED_OUT;
+    }
+    return true;
+  }
+
 private:
   std::shared_ptr<event_base> userEventBase_;
   std::shared_ptr<test::ParentServiceProcessor> processor;
+  std::shared_ptr<ThreadManager> handshakeThreadManager_;
 protected:
   std::shared_ptr<server::TNonblockingServer> server;
 private:
@@ -286,4 +332,26 @@ BOOST_FIXTURE_TEST_CASE(provide_event_base, Fixture) {
 #endif
 }
 
+BOOST_FIXTURE_TEST_CASE(stalled_handshake, Fixture) {
+  startServer(0);
+  int port = server->getListenPort();
+  std::shared_ptr<transport::TSocket> stalled = stalledClient(port);
+
+  // The IO thread is not stuck on the stalled client's handshake
+  BOOST_CHECK(rejectsGarbage(port));
+  BOOST_CHECK(canCommunicate(port));
+  stalled->close();
+}
+
+BOOST_FIXTURE_TEST_CASE(handshake_thread_pool, Fixture) {
+  useHandshakeThreadManager();
+  startServer(0);
+  int port = server->getListenPort();
+  std::shared_ptr<transport::TSocket> stalled = stalledClient(port);
+
+  BOOST_CHECK(rejectsGarbage(port));
+  BOOST_CHECK(canCommunicate(port));
+  stalled->close();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -19,10 +19,18 @@
 
 #define BOOST_TEST_MODULE TNonblockingServerTest
 #include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <chrono>
+#include <map>
 #include <memory>
+#include <thread>
+#include <unistd.h>
 
 #include "thrift/concurrency/Monitor.h"
 #include "thrift/concurrency/Thread.h"
+#include "thrift/concurrency/ThreadAffinity.h"
 #include "thrift/server/TNonblockingServer.h"
 #include "thrift/transport/TNonblockingServerSocket.h"
 
@@ -36,6 +44,7 @@ using apache::thrift::concurrency::Mutex;
 using apache::thrift::concurrency::ThreadFactory;
 using apache::thrift::concurrency::Runnable;
 using apache::thrift::concurrency::Thread;
+using apache::thrift::concurrency::ThreadAffinity;
 using apache::thrift::concurrency::ThreadFactory;
 using apache::thrift::server::TServerEventHandler;
 using std::make_shared;
@@ -80,10 +89,19 @@ private:
     shared_ptr<server::TNonblockingServer> server;
     shared_ptr<ListenEventHandler> listenHandler;
     shared_ptr<transport::TNonblockingServerSocket> socket;
+    shared_ptr<server::TBufferPool> bufferPool;
+    shared_ptr<server::TConcurrencyLimiter> limiter;
+    shared_ptr<concurrency::ThreadManager> threadManager;
+    server::TNonblockingServer::TaskClassifier classifier;
+    size_t numIOThreads;
+    bool numaPlacement;
+    std::map<int, shared_ptr<concurrency::ThreadManager> > nodeThreadManagers;
     Mutex mutex_;
 
     Runner() {
       port = 0;
+      numIOThreads = 0;
+      numaPlacement = false;
       listenHandler.reset(new ListenEventHandler(&mutex_));
     }
 
@@ -105,7 +123,18 @@ private:
       try {
         socket.reset(new transport::TNonblockingServerSocket(port));
         server.reset(new server::TNonblockingServer(processor, socket));
+        server->setThreadManager(threadManager);
         server->setServerEventHandler(listenHandler);
+        server->setBufferPool(bufferPool);
+        server->setConcurrencyLimiter(limiter);
+        server->setTaskClassifier(classifier);
+        if (numIOThreads) {
+          server->setNumIOThreads(numIOThreads);
+        }
+        server->setNumaPlacement(numaPlacement);
+        for (const auto& nodeThreadManager : nodeThreadManagers) {
+          server->setNodeThreadManager(nodeThreadManager.first, nodeThreadManager.second);
+        }
         if (userEventBase) {
           server->registerEvents(userEventBase.get());
         }
@@ -126,7 +155,10 @@ private:
   };
 
 protected:
-  Fixture() : processor(new test::ParentServiceProcessor(make_shared<Handler>())) {}
+  Fixture()
+    : numIOThreads_(0),
+      numaPlacement_(false),
+      processor(new test::ParentServiceProcessor(make_shared<Handler>())) {}
 
   ~Fixture() {
     if (server) {
@@ -141,11 +173,42 @@ protected:
     userEventBase_.reset(user_event_base, EventDeleter());
   }
 
+  void setBufferPool(shared_ptr<server::TBufferPool> pool) { bufferPool_ = pool; }
+
+  void setConcurrencyLimiter(shared_ptr<server::TConcurrencyLimiter> limiter) {
+    limiter_ = limiter;
+  }
+
+  void setThreadManager(shared_ptr<concurrency::ThreadManager> threadManager,
+                        const server::TNonblockingServer::TaskClassifier& classifier) {
+    threadManager_ = threadManager;
+    classifier_ = classifier;
+  }
+
+  void setNumIOThreads(size_t numIOThreads) { numIOThreads_ = numIOThreads; }
+
+  void setNumaPlacement(bool numaPlacement) { numaPlacement_ = numaPlacement; }
+
+  void setNodeThreadManager(int node, shared_ptr<concurrency::ThreadManager> threadManager) {
+    nodeThreadManagers_[node] = threadManager;
+  }
+
+  void setHandler(shared_ptr<test::ParentServiceIf> handler) {
+    processor.reset(new test::ParentServiceProcessor(handler));
+  }
+
   int startServer(int port) {
     shared_ptr<Runner> runner(new Runner);
     runner->port = port;
     runner->processor = processor;
     runner->userEventBase = userEventBase_;
+    runner->bufferPool = bufferPool_;
+    runner->limiter = limiter_;
+    runner->threadManager = threadManager_;
+    runner->classifier = classifier_;
+    runner->numIOThreads = numIOThreads_;
+    runner->numaPlacement = numaPlacement_;
+    runner->nodeThreadManagers = nodeThreadManagers_;
 
     shared_ptr<ThreadFactory> threadFactory(
         new ThreadFactory(false));
@@ -154,9 +217,16 @@ protected:
     runner->readyBarrier();
 
     server = runner->server;
+    serverSocket = runner->socket;
     return runner->port;
   }
 
+  // Waits for serve() to return
+  void joinServer() {
+    thread->join();
+    thread.reset();
+  }
+
   bool canCommunicate(int serverPort) {
     shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", serverPort));
     socket->open();
@@ -170,9 +240,17 @@ protected:
 
 private:
   shared_ptr<event_base> userEventBase_;
+  shared_ptr<server::TBufferPool> bufferPool_;
+  shared_ptr<server::TConcurrencyLimiter> limiter_;
+  shared_ptr<concurrency::ThreadManager> threadManager_;
+  server::TNonblockingServer::TaskClassifier classifier_;
+  size_t numIOThreads_;
+  bool numaPlacement_;
+  std::map<int, shared_ptr<concurrency::ThreadManager> > nodeThreadManagers_;
   shared_ptr<test::ParentServiceProcessor> processor;
 protected:
   shared_ptr<server::TNonblockingServer> server;
+  shared_ptr<transport::TNonblockingServerSocket> serverSocket;
 private:
   shared_ptr<apache::thrift::concurrency::Thread> thread;
 
@@ -212,4 +290,252 @@ BOOST_FIXTURE_TEST_CASE(provide_event_base, Fixture) {
 #endif
 }
 
+BOOST_FIXTURE_TEST_CASE(buffer_pool, Fixture) {
+  // A budget of one byte lets only one frame be in flight at a time
+  shared_ptr<server::TBufferPool> pool(new server::TBufferPool(1));
+  setBufferPool(pool);
+  startServer(0);
+  int port = server->getListenPort();
+  BOOST_CHECK(canCommunicate(port));
+
+  std::vector<std::thread> clients;
+  std::atomic<int> failures(0);
+  for (int i = 0; i < 4; ++i) {
+    clients.emplace_back([port, &failures]() {
+      try {
+        shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+        socket->open();
+        test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+            make_shared<transport::TFramedTransport>(socket)));
+        for (int j = 0; j < 20; ++j) {
+          client.addString(std::string(10000, 'x'));
+        }
+      } catch (const std::exception&) {
+        ++failures;
+      }
+    });
+  }
+  for (auto& client : clients) {
+    client.join();
+  }
+  BOOST_CHECK_EQUAL(0, failures.load());
+
+  // Buffers are given back once the reply has been written
+  for (int i = 0; i < 100 && pool->getOutstandingBytes() > 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  BOOST_CHECK_EQUAL(0u, pool->getOutstandingBytes());
+  BOOST_CHECK_GT(pool->getPooledBytes(), 0u);
+  BOOST_CHECK_GT(pool->getReuseCount(), 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(concurrency_limiter, Fixture) {
+  // A fixed limit of one call at a time
+  shared_ptr<server::TConcurrencyLimiter> limiter(
+      new server::TConcurrencyLimiter(server::TConcurrencyLimiter::AIMD, 1, 1, 1));
+  setConcurrencyLimiter(limiter);
+  startServer(0);
+  int port = server->getListenPort();
+  BOOST_CHECK(canCommunicate(port));
+  BOOST_CHECK_EQUAL(0u, limiter->getInFlight());
+
+  shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+  socket->open();
+  test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+      make_shared<transport::TFramedTransport>(socket)));
+
+  // While something else holds the only slot, calls are rejected
+  BOOST_REQUIRE(limiter->tryAcquire());
+  BOOST_CHECK_THROW(client.getGeneration(), TApplicationException);
+  BOOST_CHECK_EQUAL(1u, limiter->getRejectedCount());
+  limiter->release(std::chrono::milliseconds(1));
+
+  // and the connection stays usable
+  BOOST_CHECK_EQUAL(0, client.getGeneration());
+}
+
+BOOST_FIXTURE_TEST_CASE(task_classifier, Fixture) {
+  shared_ptr<concurrency::ThreadManager> threadManager
+      = concurrency::ThreadManager::newSimpleThreadManager(1);
+  threadManager->threadFactory(make_shared<ThreadFactory>());
+  shared_ptr<concurrency::FairTaskQueue> queue(new concurrency::FairTaskQueue());
+  threadManager->taskQueue(queue);
+  threadManager->start();
+
+  // Reads go ahead of writes
+  std::vector<std::string> classified;
+  setThreadManager(threadManager,
+                   [&classified](const std::string& fname, protocol::TProtocol&) {
+                     classified.push_back(fname);
+                     return concurrency::TaskClass(fname == "getStrings" ? 1 : 0, "test");
+                   });
+  startServer(0);
+  BOOST_CHECK(canCommunicate(server->getListenPort()));
+
+  BOOST_REQUIRE_EQUAL(2u, classified.size());
+  BOOST_CHECK_EQUAL("addString", classified[0]);
+  BOOST_CHECK_EQUAL("getStrings", classified[1]);
+  BOOST_CHECK_EQUAL(1u, queue->getStats(0).dequeued);
+  BOOST_CHECK_EQUAL(1u, queue->getStats(1).dequeued);
+}
+
+BOOST_FIXTURE_TEST_CASE(numa_placement, Fixture) {
+  // Records where the calls run
+  struct PlacementHandler : public Handler {
+    void addString(const std::string& s) override {
+      Guard g(mutex_);
+      Handler::addString(s);
+      cpus_.push_back(ThreadAffinity::getCurrentThreadCpus());
+    }
+    Mutex mutex_;
+    std::vector<std::vector<int> > cpus_;
+  };
+  shared_ptr<PlacementHandler> handler(new PlacementHandler);
+  setHandler(handler);
+
+  // Workers of their own on every node, and none shared
+  std::vector<int> nodes = ThreadAffinity::numaNodes();
+  for (int node : nodes) {
+    shared_ptr<concurrency::ThreadManager> threadManager
+        = concurrency::ThreadManager::newSimpleThreadManager(1);
+    shared_ptr<ThreadFactory> threadFactory(new ThreadFactory());
+    threadFactory->setAffinity(ThreadAffinity::node(node));
+    threadManager->threadFactory(threadFactory);
+    threadManager->start();
+    setNodeThreadManager(node, threadManager);
+  }
+  setNumaPlacement(true);
+  setNumIOThreads(2 * nodes.size());
+  // A cpuset, as in a container, can keep some of each node's CPUs from us
+  std::vector<int> allowed = ThreadAffinity::getCurrentThreadCpus();
+  startServer(0);
+
+  // Connections go round the IO threads, so every node gets calls
+  for (size_t i = 0; i < 2 * nodes.size(); ++i) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", server->getListenPort()));
+    socket->open();
+    test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+        make_shared<transport::TFramedTransport>(socket)));
+    client.addString("foo");
+  }
+
+  // Each call ran on the allowed CPUs of one node, where the topology is
+  // known
+  Guard g(handler->mutex_);
+  BOOST_CHECK_EQUAL(2 * nodes.size(), handler->cpus_.size());
+  for (const auto& cpus : handler->cpus_) {
+    BOOST_REQUIRE(!cpus.empty());
+    int node = ThreadAffinity::cpuNode(cpus.front());
+    if (node >= 0) {
+      std::vector<int> nodeCpus = ThreadAffinity::nodeCpus(node);
+      std::vector<int> expected;
+      std::set_intersection(nodeCpus.begin(),
+                            nodeCpus.end(),
+                            allowed.begin(),
+                            allowed.end(),
+                            std::back_inserter(expected));
+      BOOST_CHECK(cpus == expected);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(node_thread_manager_required) {
+  // Calls read on a node without workers would have nowhere to go
+  shared_ptr<concurrency::ThreadManager> threadManager
+      = concurrency::ThreadManager::newSimpleThreadManager(1);
+  std::vector<int> nodes = ThreadAffinity::numaNodes();
+  server::TNonblockingServer server(
+      make_shared<test::ParentServiceProcessor>(make_shared<Handler>()),
+      make_shared<transport::TNonblockingServerSocket>(0));
+  server.setNumaPlacement(true);
+  server.setNodeThreadManager(nodes.back() + 1, threadManager);
+  BOOST_CHECK(server.isThreadPoolProcessing());
+  BOOST_CHECK_THROW(server.serve(), TException);
+}
+
+BOOST_FIXTURE_TEST_CASE(drain_after_handing_off_socket, Fixture) {
+  // A restart under load: a second server takes over the listening socket,
+  // then the first drains, and no call fails
+  setNumIOThreads(2);
+  startServer(0);
+  int port = server->getListenPort();
+
+  // A connection that has made a call and sits idle
+  shared_ptr<transport::TSocket> idleSocket(new transport::TSocket("localhost", port));
+  idleSocket->open();
+  test::ParentServiceClient idleClient(make_shared<protocol::TBinaryProtocol>(
+      make_shared<transport::TFramedTransport>(idleSocket)));
+  idleClient.getGeneration();
+
+  // Clients that connect for each call; one that sends its next call on a
+  // persistent connection just as the server closes it would fail
+  std::atomic<bool> done(false);
+  std::atomic<int> calls(0);
+  std::atomic<int> failures(0);
+  std::vector<std::thread> clients;
+  for (int i = 0; i < 4; ++i) {
+    clients.emplace_back([port, &done, &calls, &failures]() {
+      while (!done) {
+        try {
+          shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+          socket->open();
+          test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+              make_shared<transport::TFramedTransport>(socket)));
+          client.getGeneration();
+          ++calls;
+        } catch (const std::exception&) {
+          ++failures;
+        }
+      }
+    });
+  }
+  // Give up after about ten seconds, stopping the clients first
+  for (int waited = 0; calls < 1000 && waited < 1000; ++waited) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  if (calls < 1000) {
+    done = true;
+    for (auto& client : clients) {
+      client.join();
+    }
+  }
+  BOOST_REQUIRE_MESSAGE(calls >= 1000,
+                        "only " << calls << " calls in 10 s before the handoff, "
+                                << failures << " failed");
+
+  // dup() stands in for passing the socket to the new process, for example
+  // with TLocalSocket::sendDescriptors()
+  THRIFT_SOCKET handedOff = serverSocket->handOffSocket();
+  shared_ptr<transport::TNonblockingServerSocket> successorSocket(
+      new transport::TNonblockingServerSocket(dup(handedOff), transport::SocketType::INET));
+  shared_ptr<server::TNonblockingServer> successor(new server::TNonblockingServer(
+      make_shared<test::ParentServiceProcessor>(make_shared<Handler>()), successorSocket));
+  std::thread successorThread([successor]() { successor->serve(); });
+
+  server->drain(5000);
+  joinServer();
+
+  // The idle connection was closed
+  uint8_t buf[1];
+  BOOST_CHECK_EQUAL(0u, idleSocket->read(buf, 1));
+
+  // The successor serves alone now
+  int drained = calls;
+  for (int waited = 0; calls < drained + 1000 && waited < 1000; ++waited) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  done = true;
+  for (auto& client : clients) {
+    client.join();
+  }
+  BOOST_CHECK_MESSAGE(calls >= drained + 1000,
+                      "only " << calls - drained << " calls in 10 s after the drain, "
+                              << failures << " failed");
+
+  BOOST_CHECK_EQUAL(port, successor->getListenPort());
+  successor->stop();
+  successorThread.join();
+  BOOST_CHECK_EQUAL(0, failures);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,304 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE TSSLSessionTest
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <memory>
+#include <thread>
+#include <thrift/transport/TSSLServerSocket.h>
+#include <thrift/transport/TSSLSocket.h>
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#endif
+
+using apache::thrift::transport::TSSLException;
+using apache::thrift::transport::TSSLHandshakeStats;
+using apache::thrift::transport::TSSLServerSocket;
+using apache::thrift::transport::TSSLSessionCache;
+using apache::thrift::transport::TSSLSocket;
+using apache::thrift::transport::TSSLSocketFactory;
+using apache::thrift::transport::TTransport;
+using apache::thrift::transport::TTransportException;
+using std::shared_ptr;
+
+namespace {
+
+boost::filesystem::path keyDir;
+
+std::string certFile(const std::string& filename) {
+  return (keyDir / filename).string();
+}
+
+struct GlobalFixture {
+  GlobalFixture() {
+    using namespace boost::unit_test::framework;
+#ifdef __linux__
+    // OpenSSL writes to sockets without MSG_NOSIGNAL
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    TSSLSocketFactory::setManualOpenSSLInitialization(true);
+    apache::thrift::transport::initializeOpenSSL();
+
+    keyDir = boost::filesystem::current_path().parent_path().parent_path().parent_path() / "test"
+             / "keys";
+    if (!boost::filesystem::exists(keyDir / "server.crt")) {
+      keyDir = boost::filesystem::path(master_test_suite().argv[master_test_suite().argc - 1]);
+      if (!boost::filesystem::exists(keyDir / "server.crt")) {
+        throw std::invalid_argument(
+            "The last argument to this test must be the directory containing the test "
+            "certificate(s).");
+      }
+    }
+  }
+
+  ~GlobalFixture() {
+    apache::thrift::transport::cleanupOpenSSL();
+#ifdef __linux__
+    signal(SIGPIPE, SIG_DFL);
+#endif
+  }
+};
+
+shared_ptr<TSSLSocketFactory> serverFactory() {
+  shared_ptr<TSSLSocketFactory> factory(new TSSLSocketFactory());
+  factory->server(true);
+  factory->authenticate(true);
+  factory->loadCertificate(certFile("server.crt").c_str());
+  factory->loadPrivateKey(certFile("server.key").c_str());
+  // The test client certificate is self-signed
+  factory->loadTrustedCertificates(certFile("client.crt").c_str());
+  return factory;
+}
+
+shared_ptr<TSSLSocketFactory> clientFactory(shared_ptr<TSSLSessionCache> cache) {
+  shared_ptr<TSSLSocketFactory> factory(new TSSLSocketFactory());
+  factory->authenticate(true);
+  factory->loadCertificate(certFile("client.crt").c_str());
+  factory->loadPrivateKey(certFile("client.key").c_str());
+  factory->loadTrustedCertificates(certFile("CA.pem").c_str());
+  factory->sessionCache(cache);
+  return factory;
+}
+
+// A 80 byte ticket key whose name is made of \p c
+std::string ticketKey(char c) {
+  return std::string(TSSLSocketFactory::TICKET_KEY_SIZE, c);
+}
+
+// Greets every connection with "OK" and hangs up
+class Server {
+public:
+  explicit Server(shared_ptr<TSSLSocketFactory> factory)
+    : socket_(new TSSLServerSocket("localhost", 0, factory)) {
+    socket_->listen();
+    thread_ = std::thread([this] { serve(); });
+  }
+
+  ~Server() {
+    socket_->interrupt();
+    thread_.join();
+    socket_->close();
+  }
+
+  int port() { return socket_->getPort(); }
+
+private:
+  void serve() {
+    for (;;) {
+      shared_ptr<TTransport> client;
+      try {
+        client = socket_->accept();
+      } catch (TTransportException&) {
+        return;
+      }
+      try {
+        uint8_t ok[2] = {'O', 'K'};
+        client->write(ok, 2);
+        client->flush();
+      } catch (TTransportException&) {
+      }
+      client->close();
+    }
+  }
+
+  shared_ptr<TSSLServerSocket> socket_;
+  std::thread thread_;
+};
+
+// Whether the connection resumed a session
+bool connect(shared_ptr<TSSLSocketFactory> factory, int port) {
+  shared_ptr<TSSLSocket> socket = factory->createSocket("localhost", port);
+  socket->open();
+  // Reading also takes in the session tickets sent after the handshake
+  uint8_t buf[2];
+  BOOST_CHECK_EQUAL(2u, socket->readAll(buf, 2));
+  bool reused = socket->sessionReused();
+  socket->close();
+  return reused;
+}
+
+void checkStats(const TSSLHandshakeStats& stats, uint64_t full, uint64_t resumed) {
+  BOOST_CHECK_EQUAL(full, stats.full);
+  BOOST_CHECK_EQUAL(resumed, stats.resumed);
+}
+}
+
+#if (BOOST_VERSION >= 105900)
+BOOST_GLOBAL_FIXTURE(GlobalFixture);
+#else
+BOOST_GLOBAL_FIXTURE(GlobalFixture)
+#endif
+
+BOOST_AUTO_TEST_CASE(test_session_cache) {
+  TSSLSessionCache cache(2);
+  SSL_SESSION* a = SSL_SESSION_new();
+  SSL_SESSION* b = SSL_SESSION_new();
+  cache.put("a:1", a);
+  cache.put("b:1", b);
+  cache.put("a:1", b);
+  BOOST_CHECK_EQUAL(2u, cache.size());
+
+  // "b:1" is now the least recently used
+  cache.put("c:1", a);
+  BOOST_CHECK_EQUAL(2u, cache.size());
+  BOOST_CHECK(cache.get("b:1") == nullptr);
+
+  SSL_SESSION* found = cache.get("a:1");
+  BOOST_CHECK(found == b);
+  SSL_SESSION_free(found);
+
+  cache.remove("a:1");
+  BOOST_CHECK(cache.get("a:1") == nullptr);
+  cache.clear();
+  BOOST_CHECK_EQUAL(0u, cache.size());
+
+  SSL_SESSION_free(a);
+  SSL_SESSION_free(b);
+}
+
+BOOST_AUTO_TEST_CASE(test_resumption) {
+  shared_ptr<TSSLSocketFactory> server = serverFactory();
+  Server listener(server);
+  shared_ptr<TSSLSessionCache> cache(new TSSLSessionCache());
+  shared_ptr<TSSLSocketFactory> client = clientFactory(cache);
+
+  BOOST_CHECK(!connect(client, listener.port()));
+  BOOST_CHECK_EQUAL(1u, cache->size());
+  BOOST_CHECK(connect(client, listener.port()));
+  BOOST_CHECK(connect(client, listener.port()));
+
+  checkStats(client->handshakeStats(), 1, 2);
+  checkStats(server->handshakeStats(), 1, 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_no_cache) {
+  shared_ptr<TSSLSocketFactory> server = serverFactory();
+  Server listener(server);
+  shared_ptr<TSSLSocketFactory> client = clientFactory(nullptr);
+
+  BOOST_CHECK(!connect(client, listener.port()));
+  BOOST_CHECK(!connect(client, listener.port()));
+  checkStats(server->handshakeStats(), 2, 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_without_tickets) {
+  // Resumption from the server's own session cache
+  shared_ptr<TSSLSocketFactory> server = serverFactory();
+  server->sessionTickets(false);
+  server->sessionCacheSize(16);
+  Server listener(server);
+  shared_ptr<TSSLSessionCache> cache(new TSSLSessionCache());
+  shared_ptr<TSSLSocketFactory> client = clientFactory(cache);
+
+  BOOST_CHECK(!connect(client, listener.port()));
+  BOOST_CHECK(connect(client, listener.port()));
+  checkStats(server->handshakeStats(), 1, 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_session_timeout) {
+  shared_ptr<TSSLSocketFactory> server = serverFactory();
+  server->sessionTimeout(1);
+  Server listener(server);
+  shared_ptr<TSSLSessionCache> cache(new TSSLSessionCache());
+  shared_ptr<TSSLSocketFactory> client = clientFactory(cache);
+
+  BOOST_CHECK(!connect(client, listener.port()));
+  std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+  BOOST_CHECK(!connect(client, listener.port()));
+  checkStats(server->handshakeStats(), 2, 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_shared_ticket_keys) {
+  // A ticket issued by one server is accepted by another with the same keys
+  std::vector<std::string> keys(1, ticketKey('k'));
+  shared_ptr<TSSLSocketFactory> first = serverFactory();
+  first->ticketKeys(keys);
+  shared_ptr<TSSLSocketFactory> second = serverFactory();
+  second->ticketKeys(keys);
+  shared_ptr<TSSLSocketFactory> stranger = serverFactory();
+  Server firstListener(first);
+  Server secondListener(second);
+  Server strangerListener(stranger);
+
+  shared_ptr<TSSLSessionCache> cache(new TSSLSessionCache());
+  shared_ptr<TSSLSocketFactory> client = clientFactory(cache);
+  BOOST_CHECK(!connect(client, firstListener.port()));
+
+  // As if all three were behind one address
+  SSL_SESSION* session = cache->get("localhost:" + std::to_string(firstListener.port()));
+  BOOST_REQUIRE(session != nullptr);
+  cache->put("localhost:" + std::to_string(secondListener.port()), session);
+  cache->put("localhost:" + std::to_string(strangerListener.port()), session);
+  SSL_SESSION_free(session);
+
+  BOOST_CHECK(connect(client, secondListener.port()));
+  BOOST_CHECK(!connect(client, strangerListener.port()));
+  checkStats(second->handshakeStats(), 0, 1);
+  checkStats(stranger->handshakeStats(), 1, 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_ticket_key_rotation) {
+  shared_ptr<TSSLSocketFactory> server = serverFactory();
+  server->rotateTicketKey(ticketKey('a'));
+  Server listener(server);
+  shared_ptr<TSSLSessionCache> cache(new TSSLSessionCache());
+  shared_ptr<TSSLSocketFactory> client = clientFactory(cache);
+
+  BOOST_CHECK(!connect(client, listener.port()));
+
+  // The previous key is still accepted, and its tickets renewed
+  server->rotateTicketKey(ticketKey('b'));
+  BOOST_CHECK(connect(client, listener.port()));
+  server->rotateTicketKey(ticketKey('c'));
+  BOOST_CHECK(connect(client, listener.port()));
+
+  // Two rotations later the ticket's key is gone
+  server->rotateTicketKey(ticketKey('d'));
+  server->rotateTicketKey(ticketKey('e'));
+  BOOST_CHECK(!connect(client, listener.port()));
+  checkStats(server->handshakeStats(), 2, 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_bad_ticket_key) {
+  shared_ptr<TSSLSocketFactory> server = serverFactory();
+  BOOST_CHECK_THROW(server->rotateTicketKey("short"), TSSLException);
+  BOOST_CHECK_THROW(server->ticketKeys(std::vector<std::string>(1, std::string(48, 'x'))),
+                    TSSLException);
+}
@@ -35,6 +35,11 @@
 #include "gen-cpp/ParentService.h"
 #include <string>
 #include <vector>
+#ifndef _WIN32
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 using apache::thrift::concurrency::Guard;
 using apache::thrift::concurrency::Monitor;
@@ -46,6 +51,7 @@ using apache::thrift::protocol::TProtocol;
 using apache::thrift::protocol::TProtocolFactory;
 using apache::thrift::transport::TServerSocket;
 using apache::thrift::transport::TServerTransport;
+using apache::thrift::transport::SocketType;
 using apache::thrift::transport::TSocket;
 using apache::thrift::transport::TTransport;
 using apache::thrift::transport::TTransportException;
@@ -533,4 +539,126 @@ BOOST_AUTO_TEST_CASE(test_concurrent_client_limit) {
   t2.join();
 }
 
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(test_drain_after_handing_off_socket) {
+  // A restart under load: a second server takes over the listening socket,
+  // then the first drains, and no call fails
+  startServer();
+  int port = getServerPort();
+
+  // A connection that has made a call and sits idle
+  shared_ptr<TSocket> pIdleSock(new TSocket("localhost", port), autoSocketCloser);
+  ParentServiceClient idleClient(make_shared<TBinaryProtocol>(pIdleSock));
+  pIdleSock->open();
+  idleClient.incrementGeneration();
+
+  // Clients that connect for each call; one that sends its next call on a
+  // persistent connection just as the server closes it would fail
+  std::atomic<bool> done(false);
+  std::atomic<int64_t> calls(0);
+  std::atomic<int64_t> failures(0);
+  std::vector<shared_ptr<boost::thread> > holdThreads;
+  for (int i = 0; i < 4; ++i) {
+    holdThreads.push_back(make_shared<boost::thread>([&]() {
+      while (!done) {
+        try {
+          shared_ptr<TSocket> pSock(new TSocket("localhost", port), autoSocketCloser);
+          ParentServiceClient client(make_shared<TBinaryProtocol>(pSock));
+          pSock->open();
+          client.incrementGeneration();
+          ++calls;
+        } catch (const std::exception& x) {
+          BOOST_TEST_MESSAGE(boost::format("  call failed: %1%") % x.what());
+          ++failures;
+        }
+      }
+    }));
+  }
+  // Give up after about ten seconds, stopping the clients first
+  for (int waited = 0; calls < 1000 && waited < 1000; ++waited) {
+    boost::this_thread::sleep(milliseconds(10));
+  }
+  if (calls < 1000) {
+    done = true;
+    BOOST_FOREACH (shared_ptr<boost::thread> pThread, holdThreads) { pThread->join(); }
+  }
+  BOOST_REQUIRE_MESSAGE(calls >= 1000,
+                        "only " << calls << " calls in 10 s before the handoff, "
+                                << failures << " failed");
+
+  // dup() stands in for passing the socket to the new process, for example
+  // with TLocalSocket::sendDescriptors()
+  THRIFT_SOCKET handedOff
+      = dynamic_pointer_cast<TServerSocket>(pServer->getServerTransport())->handOffSocket();
+  shared_ptr<TServerSocket> pSuccessorSock(new TServerSocket(dup(handedOff), SocketType::INET));
+  shared_ptr<TThreadedServer> pSuccessor(
+      new TThreadedServer(make_shared<ParentServiceProcessor>(make_shared<ParentHandler>()),
+                          pSuccessorSock,
+                          make_shared<TTransportFactory>(),
+                          make_shared<TBinaryProtocolFactory>()));
+  shared_ptr<TServerReadyEventHandler> pSuccessorReady(new TServerReadyEventHandler);
+  pSuccessor->setServerEventHandler(pSuccessorReady);
+  boost::thread successorThread(std::bind(&TThreadedServer::serve, pSuccessor.get()));
+  {
+    Synchronized sync(*pSuccessorReady);
+    while (!pSuccessorReady->isListening()) {
+      pSuccessorReady->wait();
+    }
+  }
+  BOOST_CHECK_EQUAL(port, pSuccessorSock->getPort());
+
+  pServer->drain(5000);
+  pServerThread->join();
+  pServerThread.reset();
+
+  // The idle connection was closed
+  uint8_t buf[1];
+  BOOST_CHECK_EQUAL(0, pIdleSock->read(&buf[0], 1));
+
+  // The successor serves alone now
+  int64_t drained = calls;
+  for (int waited = 0; calls < drained + 1000 && waited < 1000; ++waited) {
+    boost::this_thread::sleep(milliseconds(10));
+  }
+  done = true;
+  BOOST_FOREACH (shared_ptr<boost::thread> pThread, holdThreads) { pThread->join(); }
+  BOOST_CHECK_MESSAGE(calls >= drained + 1000,
+                      "only " << calls - drained << " calls in 10 s after the drain, "
+                              << failures << " failed");
+
+  pSuccessor->stop();
+  successorThread.join();
+  BOOST_CHECK(pSuccessorReady->acceptedCount() > 0);
+  BOOST_CHECK_EQUAL(0, failures);
+}
+
+BOOST_AUTO_TEST_CASE(test_listen_sockets_from_systemd) {
+  // Not for this process: no sockets, and the variables are gone either way
+  setenv("LISTEN_PID", std::to_string(getpid() + 1).c_str(), 1);
+  setenv("LISTEN_FDS", "1", 1);
+  BOOST_CHECK(TServerSocket::listenSocketsFromSystemd().empty());
+  BOOST_CHECK(getenv("LISTEN_PID") == nullptr);
+  BOOST_CHECK(getenv("LISTEN_FDS") == nullptr);
+
+  // systemd passes its first socket as descriptor 3
+  TServerSocket listener("localhost", 0);
+  listener.listen();
+  int saved = dup(3);
+  BOOST_REQUIRE_EQUAL(3, dup2(listener.getSocketFD(), 3));
+  setenv("LISTEN_PID", std::to_string(getpid()).c_str(), 1);
+  setenv("LISTEN_FDS", "1", 1);
+  std::vector<THRIFT_SOCKET> sockets = TServerSocket::listenSocketsFromSystemd();
+  bool closeOnExec = (fcntl(3, F_GETFD) & FD_CLOEXEC) != 0;
+  if (saved >= 0) {
+    dup2(saved, 3);
+    ::close(saved);
+  } else {
+    ::close(3);
+  }
+  BOOST_REQUIRE_EQUAL(1u, sockets.size());
+  BOOST_CHECK_EQUAL(3, sockets[0]);
+  BOOST_CHECK(closeOnExec);
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,240 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TSharedMemoryServerSocket.h>
+#include <thrift/transport/TSharedMemoryTransport.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "gen-cpp/ThriftTest_types.h"
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::transport::TLocalSocket;
+using apache::thrift::transport::TSharedMemoryServerSocket;
+using apache::thrift::transport::TSharedMemoryTransport;
+using apache::thrift::transport::TTransportException;
+using std::shared_ptr;
+using std::string;
+
+BOOST_AUTO_TEST_SUITE(TSharedMemoryTransportTest)
+
+namespace {
+
+// Unique per test run, so that parallel runs do not collide
+string testPath(const string& name) {
+  return TLocalSocket::abstractPath("thrift-TSharedMemoryTransportTest-" + name + "-"
+                                    + std::to_string(getpid()));
+}
+
+// Small rings, so that tests wrap around them quickly
+const uint32_t RING_SIZE = 4096;
+
+struct Connected {
+  explicit Connected(const string& path)
+    : server(path, RING_SIZE), client(new TSharedMemoryTransport(path)) {
+    server.listen();
+    // open() waits for the rings, which accept() sends
+    std::thread opener([this]() { client->open(); });
+    accepted = std::dynamic_pointer_cast<TSharedMemoryTransport>(server.accept());
+    opener.join();
+    BOOST_REQUIRE(accepted);
+    BOOST_REQUIRE(client->isOpen());
+  }
+
+  TSharedMemoryServerSocket server;
+  shared_ptr<TSharedMemoryTransport> client;
+  shared_ptr<TSharedMemoryTransport> accepted;
+};
+
+string pattern(size_t size) {
+  string data(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = static_cast<char>(i * 7 + i / 251);
+  }
+  return data;
+}
+
+void send(TSharedMemoryTransport& transport, const string& data) {
+  transport.write(reinterpret_cast<const uint8_t*>(data.data()), static_cast<uint32_t>(data.size()));
+  transport.flush();
+}
+
+string receive(TSharedMemoryTransport& transport, size_t size) {
+  string data(size, '\0');
+  transport.readAll(reinterpret_cast<uint8_t*>(&data[0]), static_cast<uint32_t>(size));
+  return data;
+}
+}
+
+BOOST_AUTO_TEST_CASE(test_round_trip) {
+  Connected c(testPath("round-trip"));
+  BOOST_CHECK_EQUAL(c.server.getRingSize(), c.client->getRingSize());
+  BOOST_CHECK_EQUAL(c.server.getRingSize(), c.accepted->getRingSize());
+
+  send(*c.client, "hello");
+  BOOST_CHECK_EQUAL(string("hello"), receive(*c.accepted, 5));
+  send(*c.accepted, "world!");
+  BOOST_CHECK_EQUAL(string("world!"), receive(*c.client, 6));
+
+  // Nothing is visible before the flush
+  c.client->write(reinterpret_cast<const uint8_t*>("x"), 1);
+  uint32_t len = 1;
+  BOOST_CHECK(c.accepted->borrow(nullptr, &len) == nullptr);
+  c.client->flush();
+  BOOST_CHECK(c.accepted->borrow(nullptr, &len) != nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(test_message_larger_than_ring) {
+  Connected c(testPath("large"));
+
+  // The writer blocks until the reader makes room, several times over
+  string message = pattern(10 * c.client->getRingSize() + 17);
+  std::thread writer([&]() { send(*c.client, message); });
+  string received = receive(*c.accepted, message.size());
+  writer.join();
+  BOOST_CHECK(message == received);
+}
+
+BOOST_AUTO_TEST_CASE(test_borrow_across_wrap) {
+  Connected c(testPath("wrap"));
+  uint32_t ringSize = c.client->getRingSize();
+
+  send(*c.client, pattern(ringSize - 3));
+  receive(*c.accepted, ringSize - 3);
+
+  // These ten bytes straddle the end of the ring, yet borrow as one run
+  string message = pattern(10);
+  send(*c.client, message);
+  uint32_t len = 11;
+  BOOST_CHECK(c.accepted->borrow(nullptr, &len) == nullptr);
+  len = 10;
+  const uint8_t* borrowed = c.accepted->borrow(nullptr, &len);
+  BOOST_REQUIRE(borrowed != nullptr);
+  BOOST_CHECK_EQUAL(10u, len);
+  BOOST_CHECK(message == string(reinterpret_cast<const char*>(borrowed), len));
+  c.accepted->consume(len);
+  BOOST_CHECK_THROW(c.accepted->consume(1), TTransportException);
+}
+
+BOOST_AUTO_TEST_CASE(test_protocol_round_trip) {
+  Connected c(testPath("protocol"));
+
+  thrift::test::Xtruct sent;
+  sent.string_thing = string(1000, 's');
+  sent.i32_thing = 42;
+  sent.i64_thing = -1;
+  TBinaryProtocol out(c.client);
+  sent.write(&out);
+  c.client->flush();
+
+  thrift::test::Xtruct received;
+  TBinaryProtocol in(c.accepted);
+  received.read(&in);
+  BOOST_CHECK(sent == received);
+}
+
+BOOST_AUTO_TEST_CASE(test_peer_close) {
+  Connected c(testPath("close"));
+
+  // What was flushed before closing still arrives, then end of file
+  send(*c.client, "bye");
+  c.client->close();
+  BOOST_CHECK(!c.client->isOpen());
+  BOOST_CHECK_EQUAL(string("bye"), receive(*c.accepted, 3));
+  uint8_t buf[1];
+  BOOST_CHECK_EQUAL(0u, c.accepted->read(buf, 1));
+  BOOST_CHECK(!c.accepted->peek());
+  BOOST_CHECK_THROW(c.accepted->flush(), TTransportException);
+}
+
+BOOST_AUTO_TEST_CASE(test_recv_timeout) {
+  Connected c(testPath("timeout"));
+
+  c.accepted->setRecvTimeout(50);
+  uint8_t buf[1];
+  try {
+    c.accepted->read(buf, 1);
+    BOOST_ERROR("read did not time out");
+  } catch (const TTransportException& ex) {
+    BOOST_CHECK_EQUAL(TTransportException::TIMED_OUT, ex.getType());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_interrupt_children) {
+  Connected c(testPath("interrupt"));
+
+  c.server.interruptChildren();
+  uint8_t buf[1];
+  try {
+    c.accepted->read(buf, 1);
+    BOOST_ERROR("read was not interrupted");
+  } catch (const TTransportException& ex) {
+    BOOST_CHECK_EQUAL(TTransportException::INTERRUPTED, ex.getType());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_corrupt_head) {
+  // A client that does the handshake itself, then claims to have written
+  // far more than the ring holds
+  string path = testPath("corrupt");
+  TSharedMemoryServerSocket server(path, RING_SIZE);
+  server.listen();
+  TLocalSocket rogue(path);
+  rogue.open();
+  shared_ptr<TSharedMemoryTransport> accepted
+      = std::dynamic_pointer_cast<TSharedMemoryTransport>(server.accept());
+  BOOST_REQUIRE(accepted);
+
+  uint8_t hello[12];
+  rogue.readAll(hello, sizeof(hello));
+  std::vector<int> fds = rogue.takeDescriptors();
+  BOOST_REQUIRE_EQUAL(3u, fds.size());
+
+  // The shared memory is sealed at its size
+  BOOST_CHECK(ftruncate(fds[0], 0) != 0);
+
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  void* header = mmap(nullptr, page, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+  BOOST_REQUIRE(header != MAP_FAILED);
+  // The head of the ring the server reads comes first
+  static_cast<std::atomic<uint64_t>*>(header)->store(4 * RING_SIZE);
+
+  uint8_t buf[1];
+  try {
+    accepted->read(buf, 1);
+    BOOST_ERROR("read accepted a head beyond the ring");
+  } catch (const TTransportException& ex) {
+    BOOST_CHECK_EQUAL(TTransportException::CORRUPTED_DATA, ex.getType());
+  }
+  uint32_t len = 1;
+  BOOST_CHECK_THROW(accepted->borrow(nullptr, &len), TTransportException);
+
+  munmap(header, page);
+  for (int fd : fds) {
+    ::close(fd);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -85,6 +85,13 @@ int main(int argc, char** argv) {
       std::cerr << "\t\ttThreadFactory monitor timeout FAILED" << '\n';
       return 1;
     }
+
+    std::cout << "\t\tThreadFactory affinity test" << '\n';
+
+    if (!threadFactoryTests.affinityTest()) {
+      std::cerr << "\t\ttThreadFactory affinity FAILED" << '\n';
+      return 1;
+    }
   }
 
   if (runAll || args[0].compare("util") == 0) {
@@ -185,6 +192,13 @@ int main(int argc, char** argv) {
         std::cerr << "\t\tThreadManager blockTest FAILED" << '\n';
         return 1;
       }
+
+      std::cout << "\t\tThreadManager fair queue test" << '\n';
+
+      if (!threadManagerTests.fairQueueTest()) {
+        std::cerr << "\t\tThreadManager fairQueueTest FAILED" << '\n';
+        return 1;
+      }
     }
   }
 
@@ -19,6 +19,7 @@
 
 #include <thrift/thrift-config.h>
 #include <thrift/concurrency/Thread.h>
+#include <thrift/concurrency/ThreadAffinity.h>
 #include <thrift/concurrency/ThreadFactory.h>
 #include <thrift/concurrency/Monitor.h>
 #include <thrift/concurrency/Mutex.h>
@@ -300,6 +301,69 @@ public:
 
     return success;
   }
+
+  /**
+   * Records the CPUs it was allowed to run on
+   */
+  class AffinityTask : public Runnable {
+
+  public:
+    void run() override { _cpus = ThreadAffinity::getCurrentThreadCpus(); }
+
+    std::vector<int> _cpus;
+  };
+
+  bool affinityTest() {
+
+    std::vector<int> expected = {0, 1, 2, 3, 8, 10, 11};
+    if (ThreadAffinity::parseCpuList("0-3,8,10-11\n") != expected
+        || !ThreadAffinity::parseCpuList("").empty()
+        || !ThreadAffinity::parseCpuList("3-1").empty()
+        || !ThreadAffinity::parseCpuList("0,x").empty()) {
+      std::cout << "\t\t\tparseCpuList failed" << '\n';
+      return false;
+    }
+
+    ThreadAffinity roundRobin({2, 5}, ThreadAffinity::ROUND_ROBIN);
+    if (roundRobin.cpusFor(0) != std::vector<int>(1, 2) || roundRobin.cpusFor(1) != std::vector<int>(1, 5)
+        || roundRobin.cpusFor(2) != std::vector<int>(1, 2)
+        || ThreadAffinity({2, 5}).cpusFor(1) != std::vector<int>({2, 5})) {
+      std::cout << "\t\t\tcpusFor failed" << '\n';
+      return false;
+    }
+
+    for (int node : ThreadAffinity::numaNodes()) {
+      std::vector<int> cpus = ThreadAffinity::nodeCpus(node);
+      if (!cpus.empty() && ThreadAffinity::cpuNode(cpus.front()) != node) {
+        std::cout << "\t\t\tcpuNode failed for node " << node << '\n';
+        return false;
+      }
+    }
+
+#ifdef __linux__
+    // Each thread runs on just the CPU it was given, whatever the host has
+    std::vector<int> allowed = ThreadAffinity::getCurrentThreadCpus();
+    ThreadFactory threadFactory(false);
+    threadFactory.setAffinity(ThreadAffinity(allowed, ThreadAffinity::ROUND_ROBIN));
+    for (size_t tix = 0; tix < allowed.size() + 1; tix++) {
+      shared_ptr<AffinityTask> task(new AffinityTask);
+      shared_ptr<Thread> thread = threadFactory.newThread(task);
+      thread->start();
+      thread->join();
+      if (task->_cpus != std::vector<int>(1, allowed[tix % allowed.size()])) {
+        std::cout << "\t\t\tthread " << tix << " ran on the wrong CPUs" << '\n';
+        return false;
+      }
+    }
+    if (ThreadAffinity::getCurrentThreadCpus() != allowed) {
+      std::cout << "\t\t\tthe creating thread was pinned" << '\n';
+      return false;
+    }
+#endif
+
+    std::cout << "\t\t\tSuccess!" << '\n';
+    return true;
+  }
 };
 
 }
@@ -629,6 +629,89 @@ public:
     threadManager.reset();
     return true;
   }
+
+  // Records the order in which tasks run
+  class OrderTask : public Runnable {
+  public:
+    OrderTask(Monitor& monitor, std::string& order, char name)
+      : _monitor(monitor), _order(order), _name(name) {}
+
+    void run() override {
+      Synchronized s(_monitor);
+      _order += _name;
+      _monitor.notify();
+    }
+
+    Monitor& _monitor;
+    std::string& _order;
+    char _name;
+  };
+
+  /**
+   * Queue tasks of a noisy tenant, a quiet one and a health check on a
+   * FairTaskQueue before any worker exists, then verify the order in which a
+   * single worker runs them.
+   */
+  bool fairQueueTest() {
+    shared_ptr<ThreadManager> threadManager = ThreadManager::newThreadManager();
+    threadManager->threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
+    shared_ptr<FairTaskQueue> queue(new FairTaskQueue());
+    queue->setWeight("noisy", 2);
+    threadManager->taskQueue(queue);
+    threadManager->start();
+
+    Monitor monitor;
+    std::string order;
+    for (char name = 'a'; name < 'i'; ++name) {
+      threadManager->add(shared_ptr<Runnable>(new OrderTask(monitor, order, name)),
+                         TaskClass(0, "noisy"));
+    }
+    for (char name = 'X'; name < 'Z'; ++name) {
+      threadManager->add(shared_ptr<Runnable>(new OrderTask(monitor, order, name)),
+                         TaskClass(0, "quiet"));
+    }
+    threadManager->add(shared_ptr<Runnable>(new OrderTask(monitor, order, '!')),
+                       TaskClass(10, "health"));
+
+    EXPECT(threadManager->pendingTaskCount(), 11);
+    EXPECT(queue->getStats(0).depth, 10);
+    EXPECT(queue->getStats(10).depth, 1);
+
+    try {
+      threadManager->taskQueue(shared_ptr<TaskQueue>(new FifoTaskQueue()));
+      std::cerr << "\t\t\treplaced the task queue while tasks were pending" << '\n';
+      return false;
+    } catch (IllegalStateException&) {
+      // Expected result
+    }
+
+    threadManager->addWorker();
+    {
+      Synchronized s(monitor);
+      while (order.size() < 11) {
+        monitor.wait();
+      }
+    }
+
+    // The health check overtakes both tenants, and the noisy tenant gets two
+    // tasks per round
+    std::cout << "\t\t\t\torder: " << order << '\n';
+    if (order != "!abXcdYefgh") {
+      std::cerr << "\t\t\tunexpected order " << order << '\n';
+      return false;
+    }
+
+    EXPECT(queue->getStats(0).depth, 0);
+    EXPECT(queue->getStats(0).dequeued, 10);
+    EXPECT(queue->getStats(10).dequeued, 1);
+    if (queue->getStats(0).maxWait < queue->getStats(10).maxWait) {
+      std::cerr << "\t\t\tbulk tasks waited less than the health check" << '\n';
+      return false;
+    }
+
+    threadManager->stop();
+    return true;
+  }
 };
 
 }
@@ -0,0 +1,168 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Exercises code generated with "cpp:table_driven".  The JSON expectations
+ * are shared with JSONProtoTest so that both code paths are held to the same
+ * wire format.
+ */
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <memory>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+
+#define BOOST_TEST_MODULE TableDrivenTest
+#include <boost/test/unit_test.hpp>
+
+using namespace thrift::test::debug;
+using apache::thrift::TUuid;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::protocol::TProtocolException;
+using apache::thrift::transport::TMemoryBuffer;
+
+static OneOfEach makeOneOfEach() {
+  OneOfEach ooe;
+  ooe.im_true = true;
+  ooe.im_false = false;
+  ooe.a_bite = 0x7f;
+  ooe.integer16 = 27000;
+  ooe.integer32 = 1 << 24;
+  ooe.integer64 = (uint64_t)6000 * 1000 * 1000;
+  ooe.double_precision = M_PI;
+  ooe.some_characters = "JSON THIS! \"\1";
+  ooe.zomg_unicode = "\xd7\n\a\t";
+  ooe.base64 = "\1\2\3\255";
+  ooe.rfc4122_uuid = TUuid{"00000000-0000-0000-0000-000000000000"};
+  return ooe;
+}
+
+template <typename Protocol_, typename Struct_>
+static void roundTrip(const Struct_& in, Struct_& out) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  std::shared_ptr<TProtocol> proto(new Protocol_(buffer));
+  in.write(proto.get());
+  out.read(proto.get());
+  BOOST_CHECK_EQUAL(buffer->available_read(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_json_matches_unrolled) {
+  OneOfEach ooe = makeOneOfEach();
+
+  const std::string expected_result(
+  "{\"1\":{\"tf\":1},\"2\":{\"tf\":0},\"3\":{\"i8\":127},\"4\":{\"i16\":27000},"
+  "\"5\":{\"i32\":16777216},\"6\":{\"i64\":6000000000},\"7\":{\"dbl\":3.1415926"
+  "535897931},\"8\":{\"str\":\"JSON THIS! \\\"\\u0001\"},\"9\":{\"str\":\"\xd7\\"
+  "n\\u0007\\t\"},\"10\":{\"tf\":0},\"11\":{\"str\":\"AQIDrQ\"},\"12\":{\"lst\""
+  ":[\"i8\",3,1,2,3]},\"13\":{\"lst\":[\"i16\",3,1,2,3]},\"14\":{\"lst\":[\"i64"
+  "\",3,1,2,3]},\"15\":{\"uid\":\"00000000-0000-0000-0000-000000000000\"},\"16\""
+  ":{\"lst\":[\"uid\",0]}}");
+
+  const std::string result(apache::thrift::ThriftJSONString(ooe));
+
+  BOOST_CHECK_MESSAGE(!expected_result.compare(result),
+    "Expected:\n" << expected_result << "\nGotten:\n" << result);
+}
+
+BOOST_AUTO_TEST_CASE(test_round_trip_nested) {
+  HolyMoley hm;
+  hm.big.push_back(makeOneOfEach());
+  hm.big.push_back(makeOneOfEach());
+  hm.big[1].a_bite = 0x22;
+  std::vector<std::string> stage;
+  stage.push_back("and a one");
+  stage.push_back("and a two");
+  hm.contain.insert(stage);
+  Bonk bonk;
+  bonk.type = 1;
+  bonk.message = "Wait.";
+  hm.bonks["nothing"];
+  hm.bonks["something"].push_back(bonk);
+
+  HolyMoley binary;
+  roundTrip<TBinaryProtocol>(hm, binary);
+  BOOST_CHECK(binary == hm);
+
+  HolyMoley compact;
+  roundTrip<TCompactProtocol>(hm, compact);
+  BOOST_CHECK(compact == hm);
+
+  HolyMoley json;
+  roundTrip<TJSONProtocol>(hm, json);
+  BOOST_CHECK(json == hm);
+}
+
+BOOST_AUTO_TEST_CASE(test_out_of_order_ids) {
+  ReverseOrderStruct ros;
+  ros.first = "first";
+  ros.second = 2;
+  ros.third = 3;
+  ros.fourth = 4;
+
+  ReverseOrderStruct result;
+  roundTrip<TCompactProtocol>(ros, result);
+  BOOST_CHECK(result == ros);
+}
+
+BOOST_AUTO_TEST_CASE(test_optional_fields) {
+  TupleProtocolTestStruct tpts;
+  tpts.__set_field1(1);
+  tpts.__set_field12(12);
+
+  TupleProtocolTestStruct result;
+  roundTrip<TBinaryProtocol>(tpts, result);
+  BOOST_CHECK(result.__isset.field1);
+  BOOST_CHECK(!result.__isset.field2);
+  BOOST_CHECK(result.__isset.field12);
+  BOOST_CHECK_EQUAL(result.field1, 1);
+  BOOST_CHECK_EQUAL(result.field12, 12);
+}
+
+BOOST_AUTO_TEST_CASE(test_missing_required_field) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol proto(buffer);
+  Empty empty;
+  empty.write(&proto);
+
+  SingleMapTestStruct smts;
+  BOOST_CHECK_THROW(smts.read(&proto), TProtocolException);
+}
+
+BOOST_AUTO_TEST_CASE(test_unknown_fields_skipped) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TCompactProtocol proto(buffer);
+  HolyMoley hm;
+  Bonk bonk;
+  bonk.type = 31337;
+  bonk.message = "I am a bonk... xor!";
+  hm.bonks["something"].push_back(bonk);
+  hm.contain.insert(std::vector<std::string>(1, "and a one"));
+  hm.write(&proto);
+
+  Empty empty;
+  empty.read(&proto);
+  BOOST_CHECK_EQUAL(buffer->available_read(), 0u);
+}
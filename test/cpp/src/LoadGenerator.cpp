@@ -0,0 +1,795 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Open-loop load generator for the C++ servers.
+ *
+ * Unlike StressTest, which runs closed-loop client threads and only reports
+ * wall time, every connection here issues requests on a fixed schedule and
+ * latency is measured from the time a request was *due*, not from when it
+ * was actually sent.  A stalled server therefore shows up in the tail instead
+ * of silently lowering the offered load (coordinated omission).
+ *
+ * Latencies are recorded into log-linear (HDR style) histograms and reported
+ * as p50/p99/p99.9/max for every combination of server type, transport and
+ * protocol requested on the command line.
+ *
+ * With the h2c transport all connections of a run share one HTTP/2
+ * connection, so it compares multiplexed calls against one socket per
+ * client thread.  The local transport is a SOCK_SEQPACKET Unix domain
+ * socket, for comparison against loopback TCP.  The shm transport passes
+ * calls through shared memory rings; compare it with unix, a buffered
+ * TSocket over a stream Unix domain socket.  These three are only
+ * available on Linux.
+ *
+ * The nonblocking-pool and nonblocking-numa server types both run the calls
+ * on --workers threads per NUMA node behind --io-threads IO threads; the
+ * latter keeps every IO thread and its workers on the CPUs of one node.  On
+ * a host with several nodes, comparing the two shows what cross-node
+ * traffic costs.
+ */
+
+#include <thrift/concurrency/Monitor.h>
+#include <thrift/concurrency/ThreadAffinity.h>
+#include <thrift/concurrency/ThreadFactory.h>
+#include <thrift/concurrency/ThreadManager.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/THeaderProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/server/THttp2Server.h>
+#include <thrift/server/TNonblockingServer.h>
+#include <thrift/server/TSimpleServer.h>
+#include <thrift/server/TThreadPoolServer.h>
+#include <thrift/server/TThreadedServer.h>
+#include <thrift/transport/THttp2Client.h>
+#include <thrift/transport/THttpClient.h>
+#include <thrift/transport/THttpServer.h>
+#include <thrift/transport/TNonblockingServerSocket.h>
+#include <thrift/transport/TServerSocket.h>
+#include <thrift/transport/TSocket.h>
+#include <thrift/transport/TTransportUtils.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ThriftTest.h"
+
+#if _WIN32
+#include <thrift/windows/TWinsockSingleton.h>
+#endif
+
+#ifdef __linux__
+#include <thrift/transport/TLocalServerSocket.h>
+#include <thrift/transport/TLocalSocket.h>
+#include <thrift/transport/TSharedMemoryServerSocket.h>
+#include <thrift/transport/TSharedMemoryTransport.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace apache::thrift;
+using namespace apache::thrift::concurrency;
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::server;
+using namespace apache::thrift::transport;
+using namespace thrift::test;
+
+namespace po = boost::program_options;
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * Log-linear latency histogram in the style of HdrHistogram.  Values below
+ * 2 * kSubBuckets are counted exactly; above that, every power of two is
+ * split into kSubBuckets linear buckets, which bounds the relative error of
+ * any reported value to 1 / kSubBuckets (about 1.6%).
+ */
+class LatencyHistogram {
+public:
+  static const int kSubBucketBits = 7;
+  static const uint64_t kSubBuckets = 1 << (kSubBucketBits - 1); // per power of two
+
+  LatencyHistogram()
+    : counts_(2 * kSubBuckets + (64 - kSubBucketBits) * kSubBuckets, 0),
+      total_(0),
+      min_(UINT64_MAX),
+      max_(0),
+      sum_(0) {}
+
+  void record(uint64_t value) {
+    ++counts_[indexOf(value)];
+    ++total_;
+    sum_ += value;
+    min_ = (std::min)(min_, value);
+    max_ = (std::max)(max_, value);
+  }
+
+  void add(const LatencyHistogram& other) {
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+    sum_ += other.sum_;
+    min_ = (std::min)(min_, other.min_);
+    max_ = (std::max)(max_, other.max_);
+  }
+
+  uint64_t count() const { return total_; }
+  uint64_t min() const { return total_ ? min_ : 0; }
+  uint64_t max() const { return max_; }
+  double mean() const { return total_ ? static_cast<double>(sum_) / total_ : 0.0; }
+
+  /**
+   * Smallest recorded value such that at least \p percentile percent of all
+   * values are less than or equal to it (reported as the upper edge of its
+   * bucket, capped at the exact maximum).
+   */
+  uint64_t percentile(double percentile) const {
+    if (total_ == 0) {
+      return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(percentile / 100.0 * total_ + 0.5);
+    target = (std::max)(target, static_cast<uint64_t>(1));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen >= target) {
+        return (std::min)(highestEquivalent(i), max_);
+      }
+    }
+    return max_;
+  }
+
+private:
+  static int msb(uint64_t value) {
+    int bit = 0;
+    while (value >>= 1) {
+      ++bit;
+    }
+    return bit;
+  }
+
+  static size_t indexOf(uint64_t value) {
+    if (value < 2 * kSubBuckets) {
+      return static_cast<size_t>(value);
+    }
+    int shift = msb(value) - (kSubBucketBits - 1);
+    return static_cast<size_t>(shift * kSubBuckets + (value >> shift));
+  }
+
+  static uint64_t highestEquivalent(size_t index) {
+    if (index < 2 * kSubBuckets) {
+      return index;
+    }
+    size_t shift = index / kSubBuckets - 1;
+    uint64_t low = (index - shift * kSubBuckets) << shift;
+    return low + ((uint64_t(1) << shift) - 1);
+  }
+
+  std::vector<uint64_t> counts_;
+  uint64_t total_;
+  uint64_t min_;
+  uint64_t max_;
+  uint64_t sum_;
+};
+
+/**
+ * Server side handler: echoes every argument back.
+ */
+class EchoHandler : public ThriftTestNull {
+public:
+  void testString(string& _return, const string& thing) override { _return = thing; }
+  void testBinary(string& _return, const string& thing) override { _return = thing; }
+  void testStruct(Xtruct& _return, const Xtruct& thing) override { _return = thing; }
+  void testNest(Xtruct2& _return, const Xtruct2& thing) override { _return = thing; }
+  void testList(vector<int32_t>& _return, const vector<int32_t>& thing) override {
+    _return = thing;
+  }
+  void testStringMap(map<string, string>& _return, const map<string, string>& thing) override {
+    _return = thing;
+  }
+};
+
+/**
+ * Request arguments for one payload shape from ThriftTest.thrift.
+ */
+struct Payload {
+  Payload(const string& shape, size_t size) : kind(shape) {
+    str.assign(size, 'x');
+    xtruct.string_thing = str;
+    xtruct.byte_thing = 1;
+    xtruct.i32_thing = -3;
+    xtruct.i64_thing = -5;
+    xtruct2.byte_thing = 1;
+    xtruct2.struct_thing = xtruct;
+    xtruct2.i32_thing = 5;
+    for (size_t i = 0; i < size; ++i) {
+      list.push_back(static_cast<int32_t>(i));
+      strMap[to_string(i)] = "value";
+    }
+  }
+
+  void call(ThriftTestClient& client) const {
+    if (kind == "void") {
+      client.testVoid();
+    } else if (kind == "string") {
+      string out;
+      client.testString(out, str);
+    } else if (kind == "binary") {
+      string out;
+      client.testBinary(out, str);
+    } else if (kind == "struct") {
+      Xtruct out;
+      client.testStruct(out, xtruct);
+    } else if (kind == "nest") {
+      Xtruct2 out;
+      client.testNest(out, xtruct2);
+    } else if (kind == "list") {
+      vector<int32_t> out;
+      client.testList(out, list);
+    } else {
+      map<string, string> out;
+      client.testStringMap(out, strMap);
+    }
+  }
+
+  string kind;
+  string str;
+  Xtruct xtruct;
+  Xtruct2 xtruct2;
+  vector<int32_t> list;
+  map<string, string> strMap;
+};
+
+/**
+ * One client connection.  Requests are due every \c interval after \c start;
+ * if the server falls behind, requests are sent back to back until the
+ * schedule is caught up, and the time spent waiting counts as latency.
+ */
+class Connection : public Runnable {
+public:
+  Connection(const string& host,
+             int port,
+             const string& transportType,
+             const string& protocolType,
+             const Payload& payload,
+             Clock::time_point start,
+             Clock::time_point measureFrom,
+             Clock::time_point end,
+             Clock::duration interval,
+             std::shared_ptr<THttp2Connection> h2c)
+    : host_(host),
+      port_(port),
+      transportType_(transportType),
+      protocolType_(protocolType),
+      payload_(payload),
+      start_(start),
+      measureFrom_(measureFrom),
+      end_(end),
+      interval_(interval),
+      h2c_(h2c),
+      errors_(0) {}
+
+  void run() override {
+    std::shared_ptr<TTransport> transport;
+    std::shared_ptr<ThriftTestClient> client;
+    try {
+      client = connect(transport);
+    } catch (TException& e) {
+      cerr << "connect failed: " << e.what() << '\n';
+      ++errors_;
+      return;
+    }
+
+    Clock::time_point due = start_;
+    while (due < end_) {
+      Clock::time_point sent = Clock::now();
+      if (interval_ == Clock::duration::zero()) {
+        // Closed loop: measure from when the request was actually sent
+        due = sent;
+      } else if (sent < due) {
+        std::this_thread::sleep_until(due);
+      }
+
+      try {
+        payload_.call(*client);
+      } catch (TException&) {
+        ++errors_;
+        // The connection state is unknown after a failure; start over.
+        try {
+          transport->close();
+          client = connect(transport);
+        } catch (TException&) {
+          return;
+        }
+      }
+
+      Clock::time_point done = Clock::now();
+      if (due >= measureFrom_) {
+        histogram_.record(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(done - due).count());
+      }
+      due = interval_ == Clock::duration::zero() ? done : due + interval_;
+    }
+    transport->close();
+  }
+
+  const LatencyHistogram& histogram() const { return histogram_; }
+  uint64_t errors() const { return errors_; }
+
+private:
+  std::shared_ptr<ThriftTestClient> connect(std::shared_ptr<TTransport>& transport) {
+    if (transportType_ == "h2c") {
+      transport = std::make_shared<THttp2Client>(h2c_, "/service");
+#ifdef __linux__
+    } else if (transportType_ == "local") {
+      // Every flush() is one message, no framing needed; host_ is the path
+      transport = std::make_shared<TLocalSocket>(host_);
+    } else if (transportType_ == "shm") {
+      transport = std::make_shared<TSharedMemoryTransport>(host_);
+    } else if (transportType_ == "unix") {
+      transport = std::make_shared<TBufferedTransport>(std::make_shared<TSocket>(host_));
+#endif
+    } else {
+      transport = connectSocket();
+    }
+
+    std::shared_ptr<TProtocol> protocol;
+    if (protocolType_ == "json") {
+      protocol = std::make_shared<TJSONProtocol>(transport);
+    } else if (protocolType_ == "compact") {
+      protocol = std::make_shared<TCompactProtocol>(transport);
+    } else if (protocolType_ == "header") {
+      protocol = std::make_shared<THeaderProtocol>(transport);
+    } else {
+      protocol = std::make_shared<TBinaryProtocol>(transport);
+    }
+
+    transport->open();
+    return std::make_shared<ThriftTestClient>(protocol);
+  }
+
+  std::shared_ptr<TTransport> connectSocket() {
+    std::shared_ptr<TSocket> socket(new TSocket(host_, port_));
+    socket->setNoDelay(true);
+    if (transportType_ == "http") {
+      return std::make_shared<THttpClient>(socket, host_, "/service");
+    } else if (transportType_ == "framed") {
+      return std::make_shared<TFramedTransport>(socket);
+    }
+    return std::make_shared<TBufferedTransport>(socket);
+  }
+
+  string host_;
+  int port_;
+  string transportType_;
+  string protocolType_;
+  const Payload& payload_;
+  Clock::time_point start_;
+  Clock::time_point measureFrom_;
+  Clock::time_point end_;
+  Clock::duration interval_;
+  std::shared_ptr<THttp2Connection> h2c_;
+  LatencyHistogram histogram_;
+  uint64_t errors_;
+};
+
+class TStartObserver : public TServerEventHandler {
+public:
+  TStartObserver() : awake_(false) {}
+  void preServe() override {
+    Synchronized s(m_);
+    awake_ = true;
+    m_.notifyAll();
+  }
+  void waitForService() {
+    Synchronized s(m_);
+    while (!awake_)
+      m_.waitForever();
+  }
+
+private:
+  Monitor m_;
+  bool awake_;
+};
+
+struct RunConfig {
+  string serverType;
+  string transportType;
+  string protocolType;
+};
+
+struct Options {
+  string host;
+  int port;
+  size_t connections;
+  double rate;
+  double duration;
+  double warmup;
+  size_t workers;
+  size_t ioThreads;
+  string payload;
+  size_t payloadSize;
+};
+
+// Server types that run a TNonblockingServer
+static bool isNonblocking(const string& serverType) {
+  return serverType == "nonblocking" || serverType == "nonblocking-pool"
+         || serverType == "nonblocking-numa";
+}
+
+/**
+ * Starts an in-process server for \p config listening on an ephemeral port.
+ */
+static std::shared_ptr<TServer> makeServer(const RunConfig& config, const Options& options) {
+  std::shared_ptr<TProtocolFactory> protocolFactory;
+  if (config.protocolType == "json") {
+    protocolFactory = std::make_shared<TJSONProtocolFactory>();
+  } else if (config.protocolType == "compact") {
+    protocolFactory = std::make_shared<TCompactProtocolFactoryT<TBufferBase> >();
+  } else if (config.protocolType == "header") {
+    protocolFactory = std::make_shared<THeaderProtocolFactory>();
+  } else {
+    protocolFactory = std::make_shared<TBinaryProtocolFactoryT<TBufferBase> >();
+  }
+
+  std::shared_ptr<TProcessor> processor(
+      new ThriftTestProcessor(std::make_shared<EchoHandler>()));
+
+  std::shared_ptr<TServer> server;
+  if (config.serverType == "h2c") {
+    std::shared_ptr<ThreadManager> threadManager
+        = ThreadManager::newSimpleThreadManager(options.workers);
+    threadManager->threadFactory(std::make_shared<ThreadFactory>());
+    threadManager->start();
+    server.reset(new THttp2Server(processor,
+                                  std::make_shared<TServerSocket>(0),
+                                  protocolFactory,
+                                  threadManager));
+  } else if (isNonblocking(config.serverType)) {
+    std::shared_ptr<TNonblockingServer> nbServer(new TNonblockingServer(
+        processor, protocolFactory, std::make_shared<TNonblockingServerSocket>(0)));
+    vector<int> nodes = ThreadAffinity::numaNodes();
+    nbServer->setNumIOThreads(options.ioThreads ? options.ioThreads : nodes.size());
+    if (config.serverType == "nonblocking-numa") {
+      nbServer->setNumaPlacement(true);
+      for (int node : nodes) {
+        std::shared_ptr<ThreadManager> threadManager
+            = ThreadManager::newSimpleThreadManager(options.workers);
+        std::shared_ptr<ThreadFactory> threadFactory = std::make_shared<ThreadFactory>();
+        threadFactory->setAffinity(ThreadAffinity::node(node));
+        threadManager->threadFactory(threadFactory);
+        threadManager->start();
+        nbServer->setNodeThreadManager(node, threadManager);
+      }
+    } else if (config.serverType == "nonblocking-pool") {
+      std::shared_ptr<ThreadManager> threadManager
+          = ThreadManager::newSimpleThreadManager(options.workers * nodes.size());
+      threadManager->threadFactory(std::make_shared<ThreadFactory>());
+      threadManager->start();
+      nbServer->setThreadManager(threadManager);
+    }
+    server = nbServer;
+  } else {
+    std::shared_ptr<TTransportFactory> transportFactory;
+    if (config.transportType == "http") {
+      transportFactory = std::make_shared<THttpServerTransportFactory>();
+    } else if (config.transportType == "framed") {
+      transportFactory = std::make_shared<TFramedTransportFactory>();
+    } else if (config.transportType == "local" || config.transportType == "shm") {
+      transportFactory = std::make_shared<TTransportFactory>();
+    } else {
+      transportFactory = std::make_shared<TBufferedTransportFactory>();
+    }
+    std::shared_ptr<TServerSocket> serverSocket(new TServerSocket(0));
+#ifdef __linux__
+    string path = TLocalSocket::abstractPath("thrift-LoadGenerator-" + to_string(getpid()));
+    if (config.transportType == "local") {
+      serverSocket.reset(new TLocalServerSocket(path));
+    } else if (config.transportType == "shm") {
+      serverSocket.reset(new TSharedMemoryServerSocket(path));
+    } else if (config.transportType == "unix") {
+      serverSocket.reset(new TServerSocket(path));
+    }
+#endif
+
+    if (config.serverType == "simple") {
+      server.reset(new TSimpleServer(processor, serverSocket, transportFactory, protocolFactory));
+    } else if (config.serverType == "threaded") {
+      server.reset(new TThreadedServer(processor, serverSocket, transportFactory, protocolFactory));
+    } else {
+      std::shared_ptr<ThreadManager> threadManager
+          = ThreadManager::newSimpleThreadManager(options.workers);
+      threadManager->threadFactory(std::make_shared<ThreadFactory>());
+      threadManager->start();
+      server.reset(new TThreadPoolServer(processor,
+                                         serverSocket,
+                                         transportFactory,
+                                         protocolFactory,
+                                         threadManager));
+    }
+  }
+
+  if (config.protocolType == "header") {
+    // Tell the server to use the same protocol for input / output
+    server->setOutputProtocolFactory(std::shared_ptr<TProtocolFactory>());
+  }
+  return server;
+}
+
+// These transports connect to a path rather than a port
+static bool usesSocketPath(const string& transportType) {
+  return transportType == "local" || transportType == "shm" || transportType == "unix";
+}
+
+static int listenPort(const std::shared_ptr<TServer>& server) {
+  std::shared_ptr<TNonblockingServer> nbServer = std::dynamic_pointer_cast<TNonblockingServer>(server);
+  if (nbServer) {
+    return nbServer->getListenPort();
+  }
+  return std::dynamic_pointer_cast<TServerSocket>(server->getServerTransport())->getPort();
+}
+
+/**
+ * Runs one matrix cell and prints its result line.  Returns the number of
+ * failed requests.
+ */
+static uint64_t runOne(const RunConfig& config, const Options& options, const Payload& payload) {
+  ThreadFactory threadFactory(false);
+  std::shared_ptr<TServer> server;
+  std::shared_ptr<Thread> serverThread;
+  string host = options.host;
+  int port = options.port;
+
+  if (host.empty()) {
+    server = makeServer(config, options);
+    std::shared_ptr<TStartObserver> observer(new TStartObserver);
+    server->setServerEventHandler(observer);
+    serverThread = threadFactory.newThread(server);
+    serverThread->start();
+    observer->waitForService();
+    if (usesSocketPath(config.transportType)) {
+      host = std::dynamic_pointer_cast<TServerSocket>(server->getServerTransport())->getPath();
+    } else {
+      host = "127.0.0.1";
+      port = listenPort(server);
+    }
+  }
+
+  // TSimpleServer serves one connection at a time
+  size_t connections = config.serverType == "simple" ? 1 : options.connections;
+  Clock::duration interval = Clock::duration::zero();
+  if (options.rate > 0) {
+    interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(connections / options.rate));
+  }
+
+  Clock::time_point start = Clock::now() + std::chrono::milliseconds(100);
+  Clock::time_point measureFrom
+      = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.warmup));
+  Clock::time_point end
+      = measureFrom + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.duration));
+
+  // h2c clients multiplex their calls over one connection
+  std::shared_ptr<THttp2Connection> h2c;
+  if (config.transportType == "h2c") {
+    std::shared_ptr<TSocket> socket(new TSocket(host, port));
+    socket->setNoDelay(true);
+    h2c = std::make_shared<THttp2Connection>(socket, host + ":" + to_string(port));
+  }
+
+  vector<std::shared_ptr<Connection> > clients;
+  vector<std::shared_ptr<Thread> > threads;
+  for (size_t i = 0; i < connections; ++i) {
+    // Stagger connections evenly across one interval
+    Clock::time_point first = start + interval * i / connections;
+    clients.push_back(std::make_shared<Connection>(host,
+                                                   port,
+                                                   config.transportType,
+                                                   config.protocolType,
+                                                   payload,
+                                                   first,
+                                                   measureFrom,
+                                                   end,
+                                                   interval,
+                                                   h2c));
+    threads.push_back(threadFactory.newThread(clients.back()));
+    threads.back()->start();
+  }
+
+  LatencyHistogram histogram;
+  uint64_t errors = 0;
+  for (size_t i = 0; i < connections; ++i) {
+    threads[i]->join();
+    histogram.add(clients[i]->histogram());
+    errors += clients[i]->errors();
+  }
+  if (h2c) {
+    h2c->close();
+  }
+
+  if (server) {
+    server->stop();
+    serverThread->join();
+  }
+
+  const double us = 1000.0;
+  printf("%-16s %-9s %-8s %6zu %10.0f %10.0f %10.1f %10.1f %10.1f %10.1f %10.1f %7llu\n",
+         config.serverType.c_str(),
+         config.transportType.c_str(),
+         config.protocolType.c_str(),
+         connections,
+         options.rate,
+         histogram.count() / options.duration,
+         histogram.mean() / us,
+         histogram.percentile(50.0) / us,
+         histogram.percentile(99.0) / us,
+         histogram.percentile(99.9) / us,
+         histogram.max() / us,
+         static_cast<unsigned long long>(errors));
+  fflush(stdout);
+  return errors;
+}
+
+static vector<string> splitList(const string& value) {
+  vector<string> items;
+  boost::split(items, value, boost::is_any_of(","), boost::token_compress_on);
+  items.erase(std::remove(items.begin(), items.end(), string()), items.end());
+  return items;
+}
+
+static void checkChoices(const string& option,
+                         const vector<string>& values,
+                         const vector<string>& allowed) {
+  for (const auto& value : values) {
+    if (std::find(allowed.begin(), allowed.end(), value) == allowed.end()) {
+      throw invalid_argument("Unknown " + option + " " + value);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+#if _WIN32
+  transport::TWinsockSingleton::create();
+#endif
+
+  Options options;
+  options.port = 9090;
+  options.connections = 4;
+  options.rate = 1000;
+  options.duration = 10;
+  options.warmup = 2;
+  options.workers = 4;
+  options.ioThreads = 0;
+  options.payload = "void";
+  options.payloadSize = 64;
+  string serverTypes = "thread-pool";
+  string transportTypes = "buffered";
+  string protocolTypes = "binary";
+
+  po::options_description desc("Allowed options");
+  desc.add_options()
+    ("help,h", "produce help message")
+    ("host", po::value<string>(&options.host), "Load an already running server (e.g. TestServer) instead of starting one per run; the socket path for the local, shm and unix transports")
+    ("port", po::value<int>(&options.port)->default_value(options.port), "Port of the external server, only used with --host")
+    ("server-types", po::value<string>(&serverTypes)->default_value(serverTypes), "Comma separated list of \"simple\", \"thread-pool\", \"threaded\", \"nonblocking\", \"nonblocking-pool\", \"nonblocking-numa\", \"h2c\"")
+    ("transports", po::value<string>(&transportTypes)->default_value(transportTypes), "Comma separated list of \"buffered\", \"framed\", \"http\", \"h2c\", \"local\" (Unix SEQPACKET socket), \"shm\" (shared memory), \"unix\" (buffered over a Unix stream socket); the last three on Linux only")
+    ("protocols", po::value<string>(&protocolTypes)->default_value(protocolTypes), "Comma separated list of \"binary\", \"compact\", \"header\", \"json\"")
+    ("connections,c", po::value<size_t>(&options.connections)->default_value(options.connections), "Client connections, each on its own thread")
+    ("rate,r", po::value<double>(&options.rate)->default_value(options.rate), "Total requests per second across all connections; 0 runs closed-loop")
+    ("duration,d", po::value<double>(&options.duration)->default_value(options.duration), "Seconds measured per run")
+    ("warmup", po::value<double>(&options.warmup)->default_value(options.warmup), "Seconds of load before measuring starts")
+    ("workers,n", po::value<size_t>(&options.workers)->default_value(options.workers), "Number of thread pools workers. Only valid for thread-pool and h2c server types, and per NUMA node for nonblocking-pool and nonblocking-numa")
+    ("io-threads", po::value<size_t>(&options.ioThreads)->default_value(options.ioThreads), "IO threads of the nonblocking server types; 0 for one per NUMA node")
+    ("payload", po::value<string>(&options.payload)->default_value(options.payload), "Call to make: void, string, binary, struct, nest, list, map")
+    ("payload-size", po::value<size_t>(&options.payloadSize)->default_value(options.payloadSize), "Bytes in string/binary/struct payloads, elements in list/map payloads");
+
+  po::variables_map vm;
+  vector<RunConfig> runs;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+      cout << desc << "\n";
+      return 1;
+    }
+
+    vector<string> servers = splitList(serverTypes);
+    vector<string> transports = splitList(transportTypes);
+    vector<string> protocols = splitList(protocolTypes);
+    checkChoices("server type",
+                 servers,
+                 {"simple", "thread-pool", "threaded", "nonblocking", "nonblocking-pool", "nonblocking-numa", "h2c"});
+    checkChoices("transport",
+                 transports,
+                 {"buffered", "framed", "http", "h2c",
+#ifdef __linux__
+                  "local", "shm", "unix"
+#endif
+                 });
+    checkChoices("protocol", protocols, {"binary", "compact", "header", "json"});
+    checkChoices("payload", {options.payload},
+                 {"void", "string", "binary", "struct", "nest", "list", "map"});
+    if (options.duration <= 0 || options.warmup < 0 || options.rate < 0) {
+      throw invalid_argument("duration must be positive, warmup and rate non-negative");
+    }
+    if (!options.host.empty()) {
+      servers.assign(1, "external");
+    }
+
+    for (const auto& server : servers) {
+      for (const auto& transport : transports) {
+        for (const auto& protocol : protocols) {
+          if (isNonblocking(server) && transport != "framed") {
+            cerr << "skipping " << server << "/" << transport << "/" << protocol
+                 << ": server-type nonblocking requires transport framed" << '\n';
+            continue;
+          }
+          if ((server == "h2c") != (transport == "h2c") && server != "external") {
+            cerr << "skipping " << server << "/" << transport << "/" << protocol
+                 << ": server-type h2c and transport h2c go together" << '\n';
+            continue;
+          }
+          RunConfig config;
+          config.serverType = server;
+          config.transportType = transport;
+          config.protocolType = protocol;
+          runs.push_back(config);
+        }
+      }
+    }
+  } catch (std::exception& e) {
+    cerr << e.what() << '\n';
+    cout << desc << "\n";
+    return 1;
+  }
+
+  Payload payload(options.payload, options.payloadSize);
+
+  cout << "payload " << options.payload << "/" << options.payloadSize << ", " << options.duration
+       << "s per run after " << options.warmup << "s warmup, latencies in microseconds" << '\n';
+  printf("%-16s %-9s %-8s %6s %10s %10s %10s %10s %10s %10s %10s %7s\n",
+         "server", "transport", "protocol", "conns", "target/s", "actual/s",
+         "mean", "p50", "p99", "p99.9", "max", "errors");
+
+  uint64_t errors = 0;
+  for (const auto& config : runs) {
+    try {
+      errors += runOne(config, options, payload);
+    } catch (std::exception& e) {
+      cerr << config.serverType << "/" << config.transportType << "/" << config.protocolType
+           << ": " << e.what() << '\n';
+      ++errors;
+    }
+  }
+
+  return errors == 0 ? 0 : 1;
+}